@@ -11,6 +11,8 @@
 #include "../include/SymbolTable.h"
 
 #include <vector>
+#include <cassert>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <string>
@@ -36,7 +38,7 @@
     {                                                                          \
         x->decRefCount();                                                      \
         if (x->getRefCount() == 0)                                             \
-            delete x;                                                          \
+            ASTNode::destroy(x);                                               \
     }
 
 /* TODO: Define the rest of macros. */
@@ -87,6 +89,7 @@ enum ASTNodeKind
     NK_COMPLEX_CONST,
     NK_STRING_CONST,
     NK_CHAR_CONST,
+    NK_PACKED_CONST_ARRAY,
     NK_CAST_EXPR,
     NK_NEGATE_EXPR,
     NK_BIT_NOT_EXPR,
@@ -154,13 +157,26 @@ enum ASTNodeKind
 class AbstractSyntaxTree;
 class TreeVisitor;
 
+// Whether an expression node is an integer constant expression
+enum ConstState
+{
+    CS_UNKNOWN,     // Not evaluated yet
+    CS_CONSTANT,    // Its value is in constValue
+    CS_NOT_CONSTANT
+};
+
 class ASTNode
 {
 protected:
     ASTNodeKind kind;
     int lineNum;
-    unsigned flags; // Additional flags
+    // Additional flags. Declarations hold the flags of their specifiers,
+    // types the ones they are qualified with, see getQualifiedType().
+    unsigned flags;
     unsigned refCount;
+    uint64_t hash; // Structural hash, 0 until computed (see TreeHash.h)
+    int64_t constValue; // Value of a constant expression (see ConstEval.h)
+    unsigned char constState; // ConstState of constValue
 
 public:
     ASTNodeKind getKind() { return kind; }
@@ -170,6 +186,9 @@ public:
         flags = 0;
         refCount = 0;
         lineNum = 0;
+        hash = 0;
+        constValue = 0;
+        constState = CS_UNKNOWN;
         kind = NK_UNKNOWN;
     }
 
@@ -179,6 +198,9 @@ public:
         kind = Kind;
         refCount = 0;
         lineNum = 0;
+        hash = 0;
+        constValue = 0;
+        constState = CS_UNKNOWN;
     }
 
     // Virtual destructor
@@ -187,7 +209,12 @@ public:
     int getLineNum() { return lineNum; }
     void setLineNum(int LineNum) { lineNum = LineNum; }
     unsigned getFlags() { return flags; }
-    void setFlags(unsigned Flags) { flags = Flags; }
+    // Flags are hashed, see hashTree(), so they are set before that.
+    void setFlags(unsigned Flags)
+    {
+        assert(hash == 0 && "flags of a hashed node changed");
+        flags = Flags;
+    }
 
     // Virtual functions
     virtual void declare(AbstractSyntaxTree *ast) {}
@@ -208,6 +235,21 @@ public:
     void incRefCount() { refCount++; }
     void decRefCount() { refCount--; }
     unsigned getRefCount() { return refCount; }
+
+    uint64_t getHash() { return hash; }
+    void setHash(uint64_t Hash) { hash = Hash; }
+
+    ConstState getConstState() { return (ConstState) constState; }
+    int64_t getConstValue() { return constValue; }
+    void setConstValue(ConstState State, int64_t Value)
+    {
+        constState = State;
+        constValue = Value;
+    }
+
+    // Delete n and every subtree it owns without recursing, so that the
+    // depth of the tree does not matter.
+    static void destroy(ASTNode *n);
 };
 
 // Singleton class
@@ -234,23 +276,23 @@ public:
 
 class IdentASTNode : public ASTNode
 {
-    std::string _value;
+    const char *_value; // Interned, see StringInterner
 
 public:
     IdentASTNode(const std::string &VALUE)
     {
-        _value = VALUE;
+        _value = internName(VALUE);
         kind = NK_IDENT_NODE;
     }
 
     IdentASTNode(const std::string &VALUE, int LineNum)
     {
-        _value = VALUE;
+        _value = internName(VALUE);
         lineNum = LineNum;
         kind = NK_IDENT_NODE;
     }
 
-    const char *getValue() { return _value.c_str(); }
+    const char *getValue() { return _value; }
 
     //STType *checkType(AbstractSyntaxTree *ast);
     void accept(TreeVisitor *v);
@@ -323,6 +365,58 @@ public:
     void accept(TreeVisitor *v);
 };
 
+// Initializer list made only of integer or only of character constants,
+// such as a generated lookup table. The values are kept in one array of the
+// narrowest element size that holds them all, instead of a node per value.
+class PackedConstArrayASTNode : public ASTNode
+{
+    ASTNodeKind _elementKind; // NK_INTEGER_CONST or NK_CHAR_CONST
+    unsigned _elementSize;
+    std::vector<uint8_t> _data;
+
+public:
+    PackedConstArrayASTNode(ASTNodeKind ElementKind,
+                            const std::vector<int> &values)
+    {
+        kind = NK_PACKED_CONST_ARRAY;
+        _elementKind = ElementKind;
+        _elementSize = 1;
+        for (unsigned i = 0; i < values.size(); i++)
+        {
+            if (values[i] < 0 || values[i] > 0xffff)
+                _elementSize = 4;
+            else if (values[i] > 0xff && _elementSize < 2)
+                _elementSize = 2;
+        }
+
+        _data.resize(values.size() * _elementSize);
+        for (unsigned i = 0; i < values.size(); i++)
+        {
+            if (_elementSize == 1)
+                _data[i] = values[i];
+            else if (_elementSize == 2)
+                ((uint16_t *) _data.data())[i] = values[i];
+            else
+                ((int32_t *) _data.data())[i] = values[i];
+        }
+    }
+
+    ASTNodeKind getElementKind() { return _elementKind; }
+    unsigned getElementSize() { return _elementSize; }
+    unsigned size() { return _data.size() / _elementSize; }
+
+    int getValue(unsigned i)
+    {
+        if (_elementSize == 1)
+            return _data[i];
+        if (_elementSize == 2)
+            return ((uint16_t *) _data.data())[i];
+        return ((int32_t *) _data.data())[i];
+    }
+
+    void accept(TreeVisitor *v);
+};
+
 class SizeOfExprASTNode : public ASTNode
 {
     ASTNode *_expr;
@@ -353,7 +447,7 @@ class AlignOfExprASTNode : public ASTNode
 public:
     AlignOfExprASTNode(ASTNode *Expr)
     {
-        kind = NK_SIZEOF_EXPR;
+        kind = NK_ALIGNOF_EXPR;
         ASSIGN_AST_NODE_REF(_expr, Expr);
     }
 
@@ -397,6 +491,16 @@ public:
     void accept(TreeVisitor *v);
 };
 
+// Produces a subtree on demand, used for parts of the tree whose parsing
+// has been deferred.
+class ASTNodeLoader
+{
+public:
+    virtual ~ASTNodeLoader() {}
+
+    virtual ASTNode *load() = 0;
+};
+
 class FunctionDeclASTNode : public ASTNode
 {
     ASTNode *_type;
@@ -404,6 +508,7 @@ class FunctionDeclASTNode : public ASTNode
     ASTNode *_prms;
     ASTNode *_body;
     STScope *_scope;
+    ASTNodeLoader *_bodyLoader; // Set while the body is not parsed yet
 
 public:
     FunctionDeclASTNode(ASTNode *tp, ASTNode *n, ASTNode *p, ASTNode *b)
@@ -414,6 +519,7 @@ public:
         ASSIGN_AST_NODE_REF(_prms, p);
         ASSIGN_AST_NODE_REF(_body, b);
         _scope = nullptr;
+        _bodyLoader = nullptr;
     }
 
     ~FunctionDeclASTNode()
@@ -422,12 +528,34 @@ public:
         DELETE_AST_NODE_REF(_name);
         DELETE_AST_NODE_REF(_prms);
         DELETE_AST_NODE_REF(_body);
+        delete _bodyLoader;
     }
 
     ASTNode *getType() { return _type; }
     ASTNode *getName() { return _name; }
     ASTNode *getPrms() { return _prms; }
-    ASTNode *getBody() { return _body; }
+
+    ASTNode *getBody()
+    {
+        materialize();
+        return _body;
+    }
+
+    // Parse the deferred body, if any.
+    void materialize()
+    {
+        if (_bodyLoader != nullptr)
+        {
+            ASTNodeLoader *loader = _bodyLoader;
+
+            _bodyLoader = nullptr;
+            setBody(loader->load());
+            delete loader;
+        }
+    }
+
+    bool isMaterialized() { return _bodyLoader == nullptr; }
+    void setBodyLoader(ASTNodeLoader *loader) { _bodyLoader = loader; }
 
     void setType(ASTNode *Type) { ASSIGN_AST_NODE_REF(_type, Type); }
     void setName(ASTNode *Name) { ASSIGN_AST_NODE_REF(_name, Name); }
@@ -436,7 +564,10 @@ public:
 
     void setScope(STScope *s) { _scope = s; }
     STScope *getScope() { return _scope; }
-    bool isForwardDeclaration() { return _body == NULL_AST_NODE; }
+    bool isForwardDeclaration()
+    {
+        return _body == NULL_AST_NODE && _bodyLoader == nullptr;
+    }
 
     void accept(TreeVisitor *v);
 };
@@ -511,20 +642,24 @@ public:
 class FieldDeclASTNode : public ASTNode
 {
     ASTNode *_type;
-    ASTNode *_name;
+    ASTNode *_name;     // NULL_AST_NODE for anonymous members
+    ASTNode *_bitWidth; // NULL_AST_NODE unless this is a bit-field
 
 public:
-    FieldDeclASTNode(ASTNode *Type, ASTNode *Name)
+    FieldDeclASTNode(ASTNode *Type, ASTNode *Name,
+                     ASTNode *BitWidth = NULL_AST_NODE)
     {
         kind = NK_FIELD_DECL;
         ASSIGN_AST_NODE_REF(_type, Type);
         ASSIGN_AST_NODE_REF(_name, Name);
+        ASSIGN_AST_NODE_REF(_bitWidth, BitWidth);
     }
 
     ~FieldDeclASTNode()
     {
         DELETE_AST_NODE_REF(_type);
         DELETE_AST_NODE_REF(_name);
+        DELETE_AST_NODE_REF(_bitWidth);
     }
 
     void setType(ASTNode *Type) { ASSIGN_AST_NODE_REF(_type, Type); }
@@ -532,6 +667,7 @@ public:
 
     ASTNode *getName() { return _name; }
     ASTNode *getType() { return _type; }
+    ASTNode *getBitWidth() { return _bitWidth; }
 
     //void declare(AbstractSyntaxTree *ast);
     void accept(TreeVisitor *v);
@@ -544,6 +680,7 @@ class AsmStmtASTNode : public ASTNode
 public:
     AsmStmtASTNode(const std::string &data)
     {
+        kind = NK_ASM_STMT;
         _data = data;
     }
 
@@ -812,6 +949,7 @@ public:
         DELETE_AST_NODE_REF(_expr);
     }
 
+    ASTNode *getType() { return _type; }
     ASTNode *getExpr() { return _expr; }
 
     //STType *checkType(AbstractSyntaxTree *ast);
@@ -915,6 +1053,7 @@ public:
         DELETE_AST_NODE_REF(_expr);
     }
 
+    ASTNode *getType() { return _type; }
     ASTNode *getExpr() { return _expr; }
 
     //STType *checkType(AbstractSyntaxTree *ast);
@@ -940,6 +1079,7 @@ public:
         DELETE_AST_NODE_REF(_expr);
     }
 
+    ASTNode *getType() { return _type; }
     ASTNode *getExpr() { return _expr; }
 
     //STType *checkType(AbstractSyntaxTree *ast);
@@ -1042,6 +1182,7 @@ public:
         DELETE_AST_NODE_REF(_expr);
     }
 
+    ASTNode *getType() { return _type; }
     ASTNode *getExpr() { return _expr; }
 
     //STType *checkType(AbstractSyntaxTree *ast);
@@ -1052,7 +1193,8 @@ class IndirectRefASTNode : public ASTNode
 {
     ASTNode *_type;
     ASTNode *_expr;
-    ASTNode *_field;
+    ASTNode *_field;     // NULL_AST_NODE for unary *
+    STType *_recordType; // Record the field is in, see getFieldLayout()
 
 public:
     IndirectRefASTNode(ASTNode *Type, ASTNode *Expr, ASTNode *Field)
@@ -1061,6 +1203,7 @@ public:
         ASSIGN_AST_NODE_REF(_type, Type);
         ASSIGN_AST_NODE_REF(_expr, Expr);
         ASSIGN_AST_NODE_REF(_field, Field);
+        _recordType = nullptr;
     }
 
     ~IndirectRefASTNode()
@@ -1086,6 +1229,9 @@ public:
         ASSIGN_AST_NODE_REF(_field, f);
     }
 
+    STType *getRecordType() { return _recordType; }
+    void setRecordType(STType *type) { _recordType = type; }
+
     //STType *checkType(AbstractSyntaxTree *ast);
     void accept(TreeVisitor *v);
 };
@@ -1123,6 +1269,7 @@ public:
         DELETE_AST_NODE_REF(_rhs);
     }
 
+    ASTNode *getType() { return _type; }
     ASTNode *getLhs() { return _lhs; }
     ASTNode *getRhs() { return _rhs; }
 
@@ -1152,6 +1299,7 @@ public:
         DELETE_AST_NODE_REF(_rhs);
     }
 
+    ASTNode *getType() { return _type; }
     ASTNode *getLhs() { return _lhs; }
     ASTNode *getRhs() { return _rhs; }
 
@@ -1181,6 +1329,7 @@ public:
         DELETE_AST_NODE_REF(_rhs);
     }
 
+    ASTNode *getType() { return _type; }
     ASTNode *getLhs() { return _lhs; }
     ASTNode *getRhs() { return _rhs; }
 
@@ -1210,6 +1359,7 @@ public:
         DELETE_AST_NODE_REF(_rhs);
     }
 
+    ASTNode *getType() { return _type; }
     ASTNode *getLhs() { return _lhs; }
     ASTNode *getRhs() { return _rhs; }
 
@@ -1239,6 +1389,7 @@ public:
         DELETE_AST_NODE_REF(_rhs);
     }
 
+    ASTNode *getType() { return _type; }
     ASTNode *getLhs() { return _lhs; }
     ASTNode *getRhs() { return _rhs; }
 
@@ -1268,6 +1419,7 @@ public:
         DELETE_AST_NODE_REF(_rhs);
     }
 
+    ASTNode *getType() { return _type; }
     ASTNode *getLhs() { return _lhs; }
     ASTNode *getRhs() { return _rhs; }
 
@@ -1297,6 +1449,7 @@ public:
         DELETE_AST_NODE_REF(_rhs);
     }
 
+    ASTNode *getType() { return _type; }
     ASTNode *getLhs() { return _lhs; }
     ASTNode *getRhs() { return _rhs; }
 
@@ -1326,6 +1479,7 @@ public:
         DELETE_AST_NODE_REF(_rhs);
     }
 
+    ASTNode *getType() { return _type; }
     ASTNode *getLhs() { return _lhs; }
     ASTNode *getRhs() { return _rhs; }
 
@@ -1355,6 +1509,7 @@ public:
         DELETE_AST_NODE_REF(_rhs);
     }
 
+    ASTNode *getType() { return _type; }
     ASTNode *getLhs() { return _lhs; }
     ASTNode *getRhs() { return _rhs; }
 
@@ -1384,6 +1539,7 @@ public:
         DELETE_AST_NODE_REF(_rhs);
     }
 
+    ASTNode *getType() { return _type; }
     ASTNode *getLhs() { return _lhs; }
     ASTNode *getRhs() { return _rhs; }
 
@@ -1413,6 +1569,7 @@ public:
         DELETE_AST_NODE_REF(_rhs);
     }
 
+    ASTNode *getType() { return _type; }
     ASTNode *getLhs() { return _lhs; }
     ASTNode *getRhs() { return _rhs; }
 
@@ -1442,6 +1599,7 @@ public:
         DELETE_AST_NODE_REF(_rhs);
     }
 
+    ASTNode *getType() { return _type; }
     ASTNode *getLhs() { return _lhs; }
     ASTNode *getRhs() { return _rhs; }
 
@@ -1483,6 +1641,7 @@ class StructRefASTNode : public ASTNode
 {
     ASTNode *_name;
     ASTNode *_member;
+    STType *_recordType; // Record the member is in, see getFieldLayout()
 
 public:
     StructRefASTNode(ASTNode *Name, ASTNode *Member)
@@ -1490,6 +1649,7 @@ public:
         kind = NK_STRUCT_REF;
         ASSIGN_AST_NODE_REF(_name, Name);
         ASSIGN_AST_NODE_REF(_member, Member);
+        _recordType = nullptr;
     }
 
     ~StructRefASTNode()
@@ -1504,6 +1664,9 @@ public:
     ASTNode *getName() { return _name; }
     ASTNode *getMember() { return _member; }
 
+    STType *getRecordType() { return _recordType; }
+    void setRecordType(STType *type) { _recordType = type; }
+
     //STType *checkType(AbstractSyntaxTree *ast);
     void accept(TreeVisitor *v);
 };
@@ -1530,6 +1693,7 @@ public:
         DELETE_AST_NODE_REF(_rhs);
     }
 
+    ASTNode *getType() { return _type; }
     ASTNode *getLhs() { return _lhs; }
     ASTNode *getRhs() { return _rhs; }
 
@@ -1559,6 +1723,7 @@ public:
         DELETE_AST_NODE_REF(_rhs);
     }
 
+    ASTNode *getType() { return _type; }
     ASTNode *getLhs() { return _lhs; }
     ASTNode *getRhs() { return _rhs; }
 
@@ -1588,6 +1753,7 @@ public:
         DELETE_AST_NODE_REF(_rhs);
     }
 
+    ASTNode *getType() { return _type; }
     ASTNode *getLhs() { return _lhs; }
     ASTNode *getRhs() { return _rhs; }
 
@@ -1618,6 +1784,7 @@ public:
         DELETE_AST_NODE_REF(_rhs);
     }
 
+    ASTNode *getType() { return _type; }
     ASTNode *getLhs() { return _lhs; }
     ASTNode *getRhs() { return _rhs; }
 
@@ -1647,6 +1814,7 @@ public:
         DELETE_AST_NODE_REF(_rhs);
     }
 
+    ASTNode *getType() { return _type; }
     ASTNode *getLhs() { return _lhs; }
     ASTNode *getRhs() { return _rhs; }
 
@@ -1676,6 +1844,7 @@ public:
         DELETE_AST_NODE_REF(_rhs);
     }
 
+    ASTNode *getType() { return _type; }
     ASTNode *getLhs() { return _lhs; }
     ASTNode *getRhs() { return _rhs; }
 
@@ -1705,6 +1874,7 @@ public:
         DELETE_AST_NODE_REF(_rhs);
     }
 
+    ASTNode *getType() { return _type; }
     ASTNode *getLhs() { return _lhs; }
     ASTNode *getRhs() { return _rhs; }
 
@@ -1909,6 +2079,7 @@ public:
     }
 
     void setType(ASTNode *Type) { _type = Type; }
+    ASTNode *getType() { return _type; }
     ASTNode *getExpr() { return _expr; }
     ASTNode *getElementType() { return _type; }
 
@@ -1919,6 +2090,7 @@ class StructTypeASTNode : public ASTNode
 {
     ASTNode *_name;
     ASTNode *_body;
+    STType *_recordType; // Symbol table type holding the layout
 
 public:
     StructTypeASTNode(ASTNode *Name, ASTNode *Body)
@@ -1926,6 +2098,7 @@ public:
         kind = NK_STRUCT_TYPE;
         ASSIGN_AST_NODE_REF(_name, Name);
         ASSIGN_AST_NODE_REF(_body, Body);
+        _recordType = nullptr;
     }
 
     ~StructTypeASTNode()
@@ -1937,6 +2110,9 @@ public:
     ASTNode *getName() { return _name; }
     ASTNode *getBody() { return _body; }
 
+    STType *getRecordType() { return _recordType; }
+    void setRecordType(STType *type) { _recordType = type; }
+
     void accept(TreeVisitor *v);
 };
 
@@ -1944,6 +2120,7 @@ class UnionTypeASTNode : public ASTNode
 {
     ASTNode *_name;
     ASTNode *_body;
+    STType *_recordType; // Symbol table type holding the layout
 
 public:
     UnionTypeASTNode(ASTNode *Name, ASTNode *Body)
@@ -1951,6 +2128,7 @@ public:
         kind = NK_UNION_TYPE;
         ASSIGN_AST_NODE_REF(_name, Name);
         ASSIGN_AST_NODE_REF(_body, Body);
+        _recordType = nullptr;
     }
 
     ~UnionTypeASTNode()
@@ -1962,6 +2140,9 @@ public:
     ASTNode *getName() { return _name; }
     ASTNode *getBody() { return _body; }
 
+    STType *getRecordType() { return _recordType; }
+    void setRecordType(STType *type) { _recordType = type; }
+
     void accept(TreeVisitor *v);
 };
 
@@ -1981,6 +2162,7 @@ public:
     SequenceASTNode(ASTNode *n)
     {
         kind = NK_LIST;
+        _scope = nullptr;
         add(n);
     }
 
@@ -2006,7 +2188,7 @@ public:
                 PUSH_BACK_AST_NODE_REF(_elements, tmpVec[i]);
 
             // We don't need n anymore.
-            delete n;
+            ASTNode::destroy(n);
         }
         else
         {
@@ -11,6 +11,8 @@
 #include <cstring>
 #include <queue>
 #include <stack>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "ASTNode.h"
 
@@ -75,11 +77,44 @@ namespace cparser
 {
 
 class ASTNode;
+class TreeWalker;
+
+// Identifies a derived type by its structure
+struct DerivedTypeKey
+{
+    ASTNodeKind kind;
+    ASTNode *base;
+    int size; // Number of elements of an array type
+    unsigned flags;
+
+    bool operator==(const DerivedTypeKey &k) const
+    {
+        return kind == k.kind && base == k.base && size == k.size &&
+               flags == k.flags;
+    }
+};
+
+struct DerivedTypeKeyHash
+{
+    size_t operator()(const DerivedTypeKey &k) const
+    {
+        size_t h = std::hash<ASTNode *>()(k.base);
+
+        h = h * 31 + k.kind;
+        h = h * 31 + k.size;
+        return h * 31 + k.flags;
+    }
+};
 
 class AbstractSyntaxTree
 {
     ASTNode *_root;
 
+    // Canonical type nodes, shared by every declaration of the same type
+    std::unordered_map<DerivedTypeKey, ASTNode *, DerivedTypeKeyHash>
+        _derivedTypes;
+    std::unordered_set<ASTNode *> _canonicalTypes;
+
     SymbolTable *_stb;
 
     STObject *_currentFuncDecl;
@@ -122,9 +157,26 @@ public:
     STType *getStbType(ASTNode *typeASTNode);
 
     void visit(TreeVisitor *visitor);
+    void visit(TreeVisitor *visitor, unsigned jobs);
+    void walk(TreeWalker *walker);
 
     SymbolTable *getSymbolTable() { return _stb; }
 
+    // Return the canonical pointer or array type. Types derived from a
+    // type that is not canonical itself (a struct, say) are created fresh.
+    ASTNode *getPointerType(ASTNode *baseType, unsigned flags = 0);
+    ASTNode *getArrayType(ASTNode *elementType, ASTNode *size);
+
+    // Return type with the declaration flags. A canonical type is shared,
+    // so it is never changed; its variant with the flags is returned, which
+    // is canonical as well.
+    ASTNode *getQualifiedType(ASTNode *type, unsigned flags);
+
+    bool isCanonicalType(ASTNode *type)
+    {
+        return _canonicalTypes.count(type) > 0;
+    }
+
     StructTypeASTNode *createStructTypeASTNode(ASTNode *typeName,
                                                ASTNode *typeBody)
     {
@@ -146,6 +198,14 @@ public:
                             new IntegralTypeASTNode(4, false));
         ASSIGN_AST_NODE_REF(floatTypeASTNode, new RealTypeASTNode(4, false));
 
+        _canonicalTypes.insert(voidTypeASTNode);
+        _canonicalTypes.insert(charTypeASTNode);
+        _canonicalTypes.insert(shortTypeASTNode);
+        _canonicalTypes.insert(integerTypeASTNode);
+        _canonicalTypes.insert(longTypeASTNode);
+        _canonicalTypes.insert(unsignedTypeASTNode);
+        _canonicalTypes.insert(floatTypeASTNode);
+
         _currentFuncDecl = nullptr;
         currentRecordObj = nullptr;
         _errors = 0;
@@ -157,7 +217,7 @@ public:
     ~AbstractSyntaxTree()
     {
         if (_root)
-            delete _root;
+            ASTNode::destroy(_root);
 
         DELETE_AST_NODE_REF(voidTypeASTNode);
         DELETE_AST_NODE_REF(charTypeASTNode);
@@ -167,8 +227,11 @@ public:
         DELETE_AST_NODE_REF(unsignedTypeASTNode);
         DELETE_AST_NODE_REF(floatTypeASTNode);
 
+        for (auto &t : _derivedTypes)
+            DELETE_AST_NODE_REF(t.second);
+
         for (unsigned n = 0; n < structTypes.size(); n++)
-            delete structTypes[n];
+            ASTNode::destroy(structTypes[n]);
     }
 };
 
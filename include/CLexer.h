@@ -144,6 +144,12 @@ enum TokenKind
     TK___ASM,
     TK__NULLABLE,
 
+    // Preprocessing tokens, only in preprocessing mode
+    TK_PP_DIRECTIVE, // # at the start of a line
+    TK_PP_LINE_END,  // End of the line of a directive
+    TK_HASH,         // # in a directive
+    TK_HASHHASH,     // ##
+
     TK_EOF
 };
 
@@ -155,8 +161,15 @@ enum TokenKind
 
 class CLexer : public Lexer
 {
-    TokenMap _kwmap;
-    TokenMap _fstmtmap;
+    // Keyword tables are built once and shared by all lexers.
+    static TokenMap _kwmap;
+    static TokenMap _fstmtmap;
+
+    // In preprocessing mode directives are returned as tokens, see
+    // Preprocessor.h.
+    bool _preprocessing;
+    bool _inDirective; // Between TK_PP_DIRECTIVE and TK_PP_LINE_END
+    bool _lineStart;   // No token was read on the current line yet
 
     unsigned keyword(const char *s);
     void readName(Token *t);
@@ -164,12 +177,37 @@ class CLexer : public Lexer
     void readStringLit(Token *t);
     void readCharLit(Token *t);
     void comment();
-    void initialize();
+    void directive();
+    void skipLiteral(int quote);
 
 public:
     unsigned next(Token *t);
 
-    CLexer(const char *filename) : Lexer(filename)
+    void setPreprocessing(bool preprocessing)
+    {
+        _preprocessing = preprocessing;
+    }
+
+    // Skip the rest of the current line, ending a directive.
+    void skipLine();
+
+    // Skip lines up to the next one that starts with #, without making
+    // tokens of them. Returns false at the end of the input.
+    bool skipGroup();
+
+    // Build the keyword tables, if they are not built yet.
+    static void initialize();
+
+    CLexer(const char *filename)
+        : Lexer(filename), _preprocessing(false), _inDirective(false),
+          _lineStart(true)
+    {
+        initialize();
+    }
+
+    CLexer(FILE *fp)
+        : Lexer(fp), _preprocessing(false), _inDirective(false),
+          _lineStart(true)
     {
         initialize();
     }
@@ -9,24 +9,147 @@
 #define CPARSER_H
 
 #include <map>
+#include <vector>
 
 #include "AbstractSyntaxTree.h"
 #include "Parser.h"
 #include "Lexer.h"
 #include "CLexer.h"
+#include "RecordLayout.h"
 
 namespace cparser
 {
 
+// Binary operator precedence levels, from the loosest to the tightest binding.
+enum BinaryPrecedence
+{
+    PREC_NONE,
+    PREC_LOGICAL_OR,
+    PREC_LOGICAL_AND,
+    PREC_INCLUSIVE_OR,
+    PREC_EXCLUSIVE_OR,
+    PREC_AND,
+    PREC_EQUALITY,
+    PREC_RELATIONAL,
+    PREC_SHIFT,
+    PREC_ADDITIVE,
+    PREC_MULTIPLICATIVE
+};
+
+class PrecompiledHeader;
+
+struct BinaryOperator
+{
+    unsigned prec;
+    ASTNodeKind kind;
+};
+
+// Receives each top-level declaration as soon as it is parsed, while the
+// global scope of the symbol table is still open. The sink returns true to
+// keep the declaration in the translation unit, or false to let the parser
+// release it. A sink that wants to hold on to a released declaration takes
+// its own reference with incRefCount().
+class DeclarationSink
+{
+public:
+    virtual ~DeclarationSink() {}
+
+    virtual bool declaration(ASTNode *decl) = 0;
+};
+
+// What a name refers to where a ReferenceSink receives it
+enum ReferenceKind
+{
+    REF_USE,   // A function, variable or constant used in an expression
+    REF_CALL,  // A function called by its name
+    REF_FIELD, // A member after . or ->
+    REF_TYPE   // A typedef name, or a struct, union or enum tag
+};
+
+// A parameter, or a variable declared in a block of a function body
+struct LocalVariable
+{
+    const char *name; // Interned
+    RecordRef type;
+};
+
+// Receives the references to names that are not local to a function, as
+// they are parsed. name, file and function are interned. file is nullptr
+// for the input itself, and function, the function whose body holds the
+// reference, is nullptr outside of function bodies. A member is named
+// tag.member if the struct or union it is a member of is known and has a
+// tag, and by its name alone otherwise.
+class ReferenceSink
+{
+public:
+    virtual ~ReferenceSink() {}
+
+    virtual void reference(ReferenceKind kind, const char *name,
+                           const char *file, int line, int col,
+                           const char *function) = 0;
+};
+
+#define INSERT_BINARY_OPERATOR(tokKind, precedence, nodeKind)                  \
+    {                                                                          \
+        _binOp[tokKind].prec = precedence;                                     \
+        _binOp[tokKind].kind = nodeKind;                                       \
+    }
+
 class CParser : public Parser
 {
     bool _inTypedef;
+    bool _inField; // In the declarator of a member of a struct or union
+    bool _lazyFunctionBodies;
+    bool _skipSystemHeaders;
+    DeclarationSink *_sink;
+    PrecompiledHeader *_pch;
+    ReferenceSink *_refSink;
+
+    // With a reference sink, the function being parsed. The parameters of
+    // the function being parsed, and the variables of the blocks open in it.
+    const char *_function;
+    std::vector<LocalVariable> _locals;
+
+    // With a reference sink, the member names of the . and -> expression
+    // being parsed, reported once it is resolved, see reportMembers().
+    struct MemberName
+    {
+        const char *name;
+        int line, col;
+    };
+    std::vector<MemberName> _members;
+
+    // Binary operator table indexed by token kind
+    BinaryOperator _binOp[TK_EOF + 1];
 
-    void initNames();
+    void initBinaryOperators();
 
     bool isTypeSpecifier(unsigned _kind, int n);
     bool isTypeQualifier(unsigned kind);
     bool isStorageClassSpecifier(unsigned kind);
+    bool isInSystemHeader();
+    void locateGlobal(STObject *obj, int line, bool isDefinition);
+    void declareFunction(ASTNode *funcName, unsigned flags, bool isDefinition);
+    void declareFunction(const char *name, int line, unsigned flags,
+                         bool isDefinition);
+    void declareVariable(ASTNode *varName, ASTNode *type, unsigned flags,
+                         bool hasInit);
+    void declareVariable(const char *name, int line, RecordRef type,
+                         unsigned flags, bool hasInit);
+    void releaseDeclaration(ASTNode *decl);
+    void addReference(ReferenceKind kind, const char *name);
+    void addReference(ReferenceKind kind, const char *name, int line,
+                      int col);
+    void addMemberName();
+    void reportMembers(ASTNode *ref, size_t first);
+    void referenceName(ReferenceKind kind);
+    void declareLocal(ASTNode *name, ASTNode *type, unsigned flags);
+    void getParameters(ASTNode *prms, std::vector<LocalVariable> &locals);
+    void enterFunction(ASTNode *funcName, ASTNode *prms);
+    STType *getSymbolType(RecordRef type);
+    RecordRef getVariableRecord(const char *name);
+    RecordRef getExpressionRecord(ASTNode *expr);
+    void resolveMember(ASTNode *ref, RecordRef object);
 
     // THE PARSER RULES
 
@@ -41,16 +164,8 @@ class CParser : public Parser
     ASTNode *UnaryExpression(ASTNode *typeName);
     ASTNodeKind UnaryOperator();
     ASTNode *CastExpression();
-    ASTNode *MultiplicativeExpression();
-    ASTNode *AdditiveExpression();
-    ASTNode *ShiftExpression();
-    ASTNode *RelationalExpression();
-    ASTNode *EqualityExpression();
-    ASTNode *AndExpression();
-    ASTNode *ExclusiveOrExpression();
-    ASTNode *InclusiveOrExpression();
-    ASTNode *LogicalAndExpression();
-    ASTNode *LogicalOrExpression();
+    ASTNode *createBinaryExpr(ASTNodeKind kind, ASTNode *lhs, ASTNode *rhs);
+    ASTNode *BinaryExpression(unsigned minPrec);
     ASTNode *ConditionalExpression();
     ASTNode *AssignmentExpression();
     ASTNode *Expression();
@@ -95,6 +210,8 @@ class CParser : public Parser
     ASTNode *LabeledStatement();
     ASTNode *CompoundStatement();
     ASTNode *FunctionBody();
+    void skipFunctionBody();
+    void skipGroup();
     ASTNode *DeclarationList();
     ASTNode *StmtOrDeclList();
     ASTNode *SelectionStatement();
@@ -103,14 +220,87 @@ class CParser : public Parser
     ASTNode *ExpressionStatement();
     ASTNode *TranslationUnit();
     ASTNode *ExternalDeclaration();
+    void SystemHeaderDeclaration();
+    void SystemHeaderTagSpecifier();
+    void SystemHeaderEnumerator(int64_t &value);
+    void SystemHeaderNegatedValue(int64_t &value);
     ASTNode *FunctionDefinition(ASTNode *funcType);
 public:
     void parse(const char *output);
 
-    CParser(CLexer *LEX) : Parser(LEX)
+    // When set, function bodies are only skipped by brace matching and are
+    // parsed on the first FunctionDeclASTNode::getBody() or materialize().
+    void setLazyFunctionBodies(bool lazy) { _lazyFunctionBodies = lazy; }
+    // When set, declarations coming from system or ignored headers (see
+    // SourceManager) are only entered into the symbol table and are not
+    // added to the tree.
+    void setSkipSystemHeaders(bool skip) { _skipSystemHeaders = skip; }
+
+    // Stream top-level declarations to the sink, see DeclarationSink.
+    void setDeclarationSink(DeclarationSink *sink) { _sink = sink; }
+
+    // Start from the snapshot pch of a header, as if the input began with
+    // #include of it. See PrecompiledHeader.
+    void setPrecompiledHeader(PrecompiledHeader *pch) { _pch = pch; }
+    PrecompiledHeader *getPrecompiledHeader() { return _pch; }
+
+    // Report references to the sink, see ReferenceSink. Lazy function
+    // bodies are reported only when they are parsed, so they should be off.
+    void setReferenceSink(ReferenceSink *sink) { _refSink = sink; }
+
+    // Parse a body deferred in lazy mode in scope, seeing only the globals
+    // allocated before globalLimit, see SymbolTable::setGlobalLimit(), and
+    // the parameters of its function.
+    ASTNode *
+    parseDeferredFunctionBody(long offset, int line, int col, STScope *scope,
+                              unsigned globalLimit,
+                              const std::vector<LocalVariable> &parameters);
+
+    // Build the token name table, if it is not built yet.
+    static void initNames();
+
+    CParser(Lexer *LEX) : Parser(LEX)
     {
         _inTypedef = false;
+        _inField = false;
+        _lazyFunctionBodies = false;
+        _skipSystemHeaders = false;
+        _sink = nullptr;
+        _pch = nullptr;
+        _refSink = nullptr;
+        _function = nullptr;
         initNames();
+        initBinaryOperators();
+    }
+};
+
+// Function body left unparsed by a CParser in lazy mode. Only the position
+// of its opening brace, its scope, the number of objects declared before it
+// and its parameters are kept.
+class DeferredFunctionBody : public ASTNodeLoader
+{
+    CParser *_parser;
+    long _offset;
+    int _line;
+    int _col;
+    STScope *_scope;
+    unsigned _globalLimit;
+    std::vector<LocalVariable> _parameters;
+
+public:
+    DeferredFunctionBody(CParser *parser, const Token &lbrace, STScope *scope,
+                         const std::vector<LocalVariable> &parameters)
+        : _parser(parser), _offset(lbrace.offset), _line(lbrace.line),
+          _col(lbrace.col), _scope(scope),
+          _globalLimit(parser->getSymbolTable()->getNumObjects()),
+          _parameters(parameters)
+    {
+    }
+
+    ASTNode *load()
+    {
+        return _parser->parseDeferredFunctionBody(
+            _offset, _line, _col, _scope, _globalLimit, _parameters);
     }
 };
 
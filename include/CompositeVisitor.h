@@ -0,0 +1,47 @@
+// Composite visitor - header file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#ifndef COMPOSITE_VISITOR_H
+#define COMPOSITE_VISITOR_H
+
+#include "ASTNode.h"
+#include "TreeWalker.h"
+
+#include <vector>
+
+namespace cparser
+{
+
+// Runs several independent passes in a single walk over the tree. Every node
+// is handed to all of the passes before its children are visited, so the
+// tree is read once no matter how many passes are attached.
+class CompositeVisitor : public TreeWalker
+{
+    std::vector<TreeWalker *> _passes;
+
+    // Depth of the node whose children a pass asked to skip, or NO_SKIP.
+    std::vector<unsigned> _skipDepth;
+
+    enum { NO_SKIP = ~0u };
+
+public:
+    // Passes are run in the order they were added. They are not owned.
+    void add(TreeWalker *pass)
+    {
+        _passes.push_back(pass);
+        _skipDepth.push_back(NO_SKIP);
+    }
+
+    unsigned size() { return _passes.size(); }
+
+    bool preVisit(ASTNode *n, unsigned depth);
+    void postVisit(ASTNode *n, unsigned depth);
+};
+
+} // namespace cparser
+
+#endif
@@ -0,0 +1,33 @@
+// Constant expression evaluation - header file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#ifndef CONST_EVAL_H
+#define CONST_EVAL_H
+
+#include "ASTNode.h"
+
+#include <cstdint>
+
+namespace cparser
+{
+
+// Evaluate the integer constant expression expr into value. Operands are
+// integer and character constants, enumeration constants, sizeof and
+// _Alignof of a type, and the unary, binary and conditional operators on
+// them. Arithmetic is done in 64 bits and casts keep the value.
+//
+// The result of every node is cached in the node, so a subtree is evaluated
+// only once and must not be modified after that. Identifiers are looked up
+// as enumeration constants in stb. Without stb only results cached by an
+// earlier evaluation are available for them, and false is returned without
+// caching anything that depends on them.
+bool evaluateConstant(ASTNode *expr, int64_t &value,
+                      SymbolTable *stb = nullptr);
+
+} // namespace cparser
+
+#endif
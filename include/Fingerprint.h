@@ -0,0 +1,61 @@
+// Token stream fingerprints - header file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#ifndef FINGERPRINT_H
+#define FINGERPRINT_H
+
+#include "Lexer.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace cparser
+{
+
+// Hash of the remaining tokens of lex: their kinds and the values of
+// identifiers, literals and strings. Whitespace, comments and line numbers do
+// not contribute, so reformatting a file does not change its fingerprint.
+// With skipSystemHeaders, whether each token comes from a system header is
+// hashed as well, since that changes what gets emitted.
+uint64_t fingerprintTokens(Lexer *lex, bool skipSystemHeaders);
+
+// Fingerprints of the files formatted by earlier runs, kept in a text file
+// with one "fingerprint version path" line per file.
+class FingerprintManifest
+{
+    struct Entry
+    {
+        uint64_t fingerprint;
+        std::string version;
+    };
+
+    std::string _path;
+    std::map<std::string, Entry> _entries;
+
+    void load(FILE *fp);
+
+public:
+    FingerprintManifest(const char *path) : _path(path) {}
+
+    // Read the manifest. A missing manifest is empty.
+    void load();
+
+    // True if file was formatted with this fingerprint and version. The
+    // version, a word without white space, must change whenever the output
+    // of the formatter may.
+    bool isUnchanged(const char *file, uint64_t fingerprint,
+                     const char *version);
+
+    // Record file and write the manifest back. The manifest is locked and
+    // re-read first, so concurrent runs do not drop each other's entries.
+    bool update(const char *file, uint64_t fingerprint, const char *version);
+};
+
+} // namespace cparser
+
+#endif
@@ -0,0 +1,159 @@
+// Flat abstract syntax tree - header file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#ifndef FLAT_TREE_H
+#define FLAT_TREE_H
+
+#include "ASTNode.h"
+#include "CParser.h"
+#include "TreeVisitor.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cparser
+{
+
+typedef uint32_t FlatNodeId;
+
+// Id of the null node, stands for NULL_AST_NODE.
+#define FLAT_NULL_NODE 0
+
+// Symbol table pointers of the nodes of a flat tree
+struct FlatTreeSymbols
+{
+    // Scopes of function declarations, compound statements and lists
+    std::unordered_map<FlatNodeId, STScope *> scopes;
+
+    // Symbol table types of struct and union types, and of the records of
+    // . and -> expressions
+    std::unordered_map<FlatNodeId, STType *> recordTypes;
+
+    STScope *getScope(FlatNodeId id) const;
+    STType *getRecordType(FlatNodeId id) const;
+};
+
+// Compact encoding of a tree. Nodes live in parallel arrays indexed by a
+// 32-bit id, and the children of a node are a contiguous range of ids in
+// _children. A node is always added after its children, so child ids are
+// smaller than the id of their parent.
+class FlatTree
+{
+    std::vector<uint8_t> _kinds;
+    std::vector<int> _lineNums;
+    std::vector<unsigned> _flags;
+    std::vector<uint32_t> _values; // Constant, or index into _strings
+    std::vector<uint32_t> _firstChild;
+    std::vector<uint32_t> _numChildren;
+    std::vector<FlatNodeId> _children;
+
+    std::vector<std::string> _strings;
+    std::unordered_map<std::string, uint32_t> _stringIds;
+
+    FlatTreeSymbols _symbols;
+
+    // Packed arrays are already flat, they are shared instead of copied.
+    std::vector<ASTNode *> _packedArrays;
+
+    std::vector<FlatNodeId> _topLevel;
+
+    FlatNodeId addNode(ASTNode *n, const std::vector<FlatNodeId> &children);
+    ASTNode *createNode(FlatNodeId id,
+                        std::unordered_map<FlatNodeId, ASTNode *> &nodes,
+                        const FlatTreeSymbols &symbols, bool copyShared);
+    ASTNode *expandTree(FlatNodeId id, const FlatTreeSymbols &symbols,
+                        bool copyShared);
+
+public:
+    FlatTree();
+    ~FlatTree();
+
+    // Append the subtree n and return the id of its root.
+    FlatNodeId add(ASTNode *n);
+
+    // Append a top-level declaration. Lists are spliced, the same way they
+    // are spliced into the translation unit.
+    void addDeclaration(ASTNode *decl);
+
+    // Append a node given by its fields, as getKind() and the other getters
+    // return them. For identifiers, string constants and asm statements
+    // value is a string id from addString(). Packed arrays are appended
+    // with add().
+    FlatNodeId addNode(ASTNodeKind kind, int lineNum, unsigned flags,
+                       uint32_t value, const std::vector<FlatNodeId> &children);
+    uint32_t addString(const char *s);
+
+    // Build a pointer tree for the subtree id.
+    ASTNode *expand(FlatNodeId id);
+
+    // Build a pointer tree for the subtree id with the symbol table pointers
+    // in symbols instead of the ones of the tree. The new tree shares no
+    // node with the flat tree, so threads can expand one tree at once.
+    ASTNode *expand(FlatNodeId id, const FlatTreeSymbols &symbols);
+
+    // Run an ordinary tree visitor over the top-level declarations. Each
+    // declaration is expanded, visited and freed in turn.
+    void visit(TreeVisitor *visitor);
+
+    unsigned size() { return _kinds.size(); }
+
+    ASTNodeKind getKind(FlatNodeId id) { return (ASTNodeKind) _kinds[id]; }
+    int getLineNum(FlatNodeId id) { return _lineNums[id]; }
+    unsigned getFlags(FlatNodeId id) { return _flags[id]; }
+    uint32_t getValue(FlatNodeId id) { return _values[id]; }
+    unsigned getNumChildren(FlatNodeId id) { return _numChildren[id]; }
+
+    FlatNodeId getChild(FlatNodeId id, unsigned i)
+    {
+        return _children[_firstChild[id] + i];
+    }
+
+    // Value of an identifier, string constant or asm statement
+    const std::string &getString(FlatNodeId id)
+    {
+        return _strings[_values[id]];
+    }
+
+    // The pointer node of a packed array
+    ASTNode *getPackedArray(FlatNodeId id)
+    {
+        return _packedArrays[_values[id]];
+    }
+
+    STScope *getScope(FlatNodeId id) { return _symbols.getScope(id); }
+    STType *getRecordType(FlatNodeId id)
+    {
+        return _symbols.getRecordType(id);
+    }
+
+    std::vector<FlatNodeId> &getTopLevel() { return _topLevel; }
+
+    // Bytes held by the node arrays
+    size_t getMemoryUsage();
+};
+
+// Stores every declaration into a flat tree as soon as it is parsed and
+// frees the pointer nodes.
+class FlatTreeBuilder : public DeclarationSink
+{
+    FlatTree *_tree;
+
+public:
+    FlatTreeBuilder(FlatTree *tree) : _tree(tree) {}
+
+    bool declaration(ASTNode *decl)
+    {
+        _tree->addDeclaration(decl);
+        return false;
+    }
+};
+
+} // namespace cparser
+
+#endif
@@ -0,0 +1,55 @@
+// Formatter server and client - header file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#ifndef FORMAT_SERVER_H
+#define FORMAT_SERVER_H
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+namespace cparser
+{
+
+// Request flags
+#define FORMAT_SKIP_SYSTEM_HEADERS 0x1
+
+// Formats input to the standard output. Errors are reported the same way
+// as by cformat, by printing a message and calling exit().
+typedef void (*FormatFunc)(FILE *input, unsigned flags);
+
+// Called for each request, in the process forked to serve it, before the
+// request is formatted. The note it returns, unless it is empty, is passed
+// to an AdoptFunc in the server, so the server can keep what it made for
+// the requests that follow. An error must not end it, unlike in a
+// FormatFunc.
+typedef std::string (*PrepareFunc)(const std::string &source, unsigned flags);
+typedef void (*AdoptFunc)(const std::string &note);
+
+// Serve format requests on the Unix domain socket socketPath. Every request
+// is read and formatted by format in a process forked from the server, so
+// the tables built before the call are already warm, a slow client does not
+// hold up the others, and an error in one request can not take the server
+// down. Each request is passed to prepare first, and its note to adopt,
+// unless they are NULL. Returns only if the socket can not be set up, with
+// errno set. A file at socketPath is replaced only if it is a socket,
+// otherwise errno is EEXIST.
+//
+// A request is the line "FORMAT <flags> <size>" followed by size bytes of
+// source. The response is the line "<status> <size>" followed by size bytes
+// of output, where status is the exit status of the formatting process.
+bool runFormatServer(const char *socketPath, FormatFunc format,
+                     PrepareFunc prepare = NULL, AdoptFunc adopt = NULL);
+
+// Send source to the server at socketPath and store the output. Returns the
+// exit status of the formatting, or -1 if the server can not be reached.
+int formatRemote(const char *socketPath, const std::string &source,
+                 unsigned flags, std::string &output);
+
+} // namespace cparser
+
+#endif
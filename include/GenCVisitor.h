@@ -11,6 +11,9 @@
 #include "ASTNode.h"
 #include "TreeVisitor.h"
 
+#include <iostream>
+#include <sstream>
+
 namespace cparser
 {
 
@@ -19,16 +22,46 @@ class GenCVisitor : public TreeVisitor
     int _level; // Indentation level
     int _inList;
     bool _inEnum;
+    std::ostream *_out;
+    std::ostringstream *_buffer; // Output of a clone
+
+    void printTab(int n);
+    void emitElement(ASTNode *n, bool first);
 
 public:
-    GenCVisitor() { _level = 0; _inList = 0; _inEnum = false; }
+    GenCVisitor()
+    {
+        _level = 0;
+        _inList = 0;
+        _inEnum = false;
+        _out = &std::cout;
+        _buffer = nullptr;
+    }
+
+    GenCVisitor(int L) : _level(L)
+    {
+        _inList = 0;
+        _inEnum = false;
+        _out = &std::cout;
+        _buffer = nullptr;
+    }
+
+    ~GenCVisitor() { delete _buffer; }
+
+    void setOutput(std::ostream *out) { _out = out; }
+
+    TreeVisitor *clone();
+    void merge(TreeVisitor *v);
 
-    GenCVisitor(int L) : _level(L) { _inList = 0; _inEnum = false; }
+    // Emit a single top-level declaration exactly as it is emitted when the
+    // whole translation unit is visited.
+    void emitDeclaration(ASTNode *decl);
 
     void visit(IdentASTNode *n);
     void visit(IntegerConstASTNode *n);
     void visit(StringConstASTNode *n);
     void visit(CharConstASTNode *n);
+    void visit(PackedConstArrayASTNode *n);
     void visit(SizeOfExprASTNode *n);
     void visit(AlignOfExprASTNode *n);
     void visit(TypeDeclASTNode *n);
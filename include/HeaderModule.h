@@ -0,0 +1,133 @@
+// Header modules - header file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#ifndef HEADER_MODULE_H
+#define HEADER_MODULE_H
+
+#include "CParser.h"
+#include "PrecompiledHeader.h"
+#include "Preprocessor.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cparser
+{
+
+// The #include lines a translation unit begins with, up to its first other
+// line. Blank lines and comments may come between them.
+struct Preamble
+{
+    std::string directives; // The #include lines, one per line
+    bool hasQuoted;         // One of them is #include "..."
+    long end;               // Offset of the line after the last of them
+    int endLine;
+};
+
+// Find the preamble of text. Returns false if text has none.
+bool findPreamble(const char *text, size_t size, Preamble &preamble);
+
+// Preambles of the translation units of a batch, each parsed only once. The
+// first translation unit that begins with a preamble parses it and
+// publishes its snapshot, see PrecompiledHeader. The others, on any thread,
+// wait for it and start from the snapshot instead. Two preambles are the
+// same if their #include lines are, and if they are in the same directory
+// when one of the lines is #include "...".
+//
+// A published snapshot is never changed, so the memory held grows with the
+// number of different preambles, not with the number of translation units.
+// If the files are checked, see setCheckFiles(), a snapshot whose files
+// changed is replaced, but kept until the cache is destroyed.
+class HeaderModuleCache
+{
+    struct Module
+    {
+        bool isReady;
+        bool isChecked;              // Its files are known to be unchanged
+        PrecompiledHeader *snapshot; // nullptr if it could not be made
+    };
+
+    std::vector<std::string> _includeDirs;
+    std::vector<std::string> _macros;
+    bool _skipSystemHeaders;
+    std::vector<std::string> _ignoredPaths;
+    std::string _options;
+    IncludeSkipCache _skipCache;
+
+    std::mutex _mutex;
+    std::condition_variable _ready;
+    std::unordered_map<std::string, Module> _modules;
+    std::vector<PrecompiledHeader *> _replaced;
+    bool _checkFiles;
+
+    bool isCurrent(Module &module);
+    void replace(const std::string &key, const Module &module);
+
+    bool parsePreamble(const char *path, const std::string &text,
+                       const Preamble &preamble, ReferenceSink *refSink,
+                       PrecompiledHeader *snapshot, const char *output);
+    PrecompiledHeader *build(const char *path, const std::string &text,
+                             const Preamble &preamble, ReferenceSink *refSink);
+
+public:
+    // The options of the batch, see Preprocessor and CParser. options is
+    // their description, see PrecompiledHeader::write().
+    HeaderModuleCache(const std::vector<const char *> &includeDirs,
+                      const std::vector<const char *> &macros,
+                      bool skipSystemHeaders, const std::string &options);
+    ~HeaderModuleCache();
+
+    // Treat the files under prefix as system headers, see SourceManager.
+    void addIgnoredPath(const std::string &prefix)
+    {
+        _ignoredPaths.push_back(prefix);
+    }
+    const std::vector<std::string> &getIgnoredPaths() { return _ignoredPaths; }
+
+    // Check, once per process, that the files a module read did not change
+    // before the module is used, and make it again if they did. Modules that
+    // could not be made are then tried again too. For a cache that outlives
+    // a batch, as the one of a format server.
+    void setCheckFiles(bool checkFiles) { _checkFiles = checkFiles; }
+
+    // Preprocessor for the translation unit at path, set up with the
+    // options of the batch.
+    Preprocessor *createPreprocessor(const char *path);
+
+    // Start parser, and its lexer pp from createPreprocessor(), from the
+    // module of the preamble of path, so only the rest of path is read.
+    // Returns false, and leaves both as they were, if path has no preamble
+    // or its module could not be made. If this call builds the module,
+    // isBuilt is set, and refSink receives the references of the preamble,
+    // see CParser::setReferenceSink().
+    bool attach(const char *path, Preprocessor *pp, CParser *parser,
+                ReferenceSink *refSink = nullptr, bool *isBuilt = nullptr);
+
+    // The same for the translation unit text, read from path, or from
+    // standard input if path is NULL, see Preprocessor::setMainText().
+    bool attach(const char *path, const std::string &text, Preprocessor *pp,
+                CParser *parser, ReferenceSink *refSink = nullptr,
+                bool *isBuilt = nullptr);
+
+    // Build the module of the preamble of text, as attach() would, in a
+    // child process, and keep it if the child succeeds. A format server
+    // calls it in the process it forks for a request, so a header that
+    // crashes the parser does not take the server with it. Returns a note,
+    // empty if no module was made, which adopt() takes in the server, so
+    // the module outlives the request.
+    std::string prepare(const char *path, const std::string &text);
+
+    // Keep the module of a note from prepare(), made in another process.
+    void adopt(const std::string &note);
+};
+
+} // namespace cparser
+
+#endif
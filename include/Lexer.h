@@ -14,6 +14,7 @@
 #include <string>
 
 #include "common.h"
+#include "SourceManager.h"
 #include <map>
 
 namespace cparser
@@ -29,7 +30,9 @@ struct Token
         float fval;
     } info;
     std::string sval;
+    const char *name = nullptr; // Interned sval of an identifier
     int line, col;
+    long offset; // Offset of the first character in the source file
 };
 
 typedef std::map<const char *, unsigned, CharCompare> TokenMap;
@@ -38,9 +41,12 @@ class Lexer
 {
 protected:
     FILE *_fp;
-    int _ch;   // Current character
-    int _line; // Current line
-    int _col;  // Current column
+    int _ch;      // Current character
+    int _line;    // Current line
+    int _col;     // Current column
+    long _offset; // Offset of the character after the current one
+    bool _seekable;
+    SourceManager _srcMgr;
 
     void error(int lineNum, const char *format, ...);
     bool isHexDigit(char c);
@@ -52,13 +58,37 @@ protected:
     virtual void readCharLit(Token *t) {}
     virtual void comment() {}
 
+    // For lexers that do not read a stream of their own
+    Lexer();
+
 public:
+    // Saved reading position, see getState() and setState().
+    struct State
+    {
+        long offset;
+        int ch, line, col;
+    };
+
     void nextCh();
     virtual unsigned next(Token *t) { return 0; }
 
+    // Read the first character, before the first next().
+    virtual void start() { nextCh(); }
+
+    SourceManager *getSourceManager() { return &_srcMgr; }
+
+    // Tokens can be re-read only if the input is a regular file.
+    bool isSeekable() const { return _seekable; }
+    State getState() const;
+    void setState(const State &s);
+    void seek(long offset, int line, int col);
+
     Lexer(const char *filename);
 
-    ~Lexer() {}
+    // Read from an already opened stream, e.g. one made by fmemopen().
+    Lexer(FILE *fp);
+
+    virtual ~Lexer() {}
 };
 
 } // namespace cparser
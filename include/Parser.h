@@ -37,7 +37,8 @@ protected:
     unsigned _sym;
     int _parsingErrors;
 
-    std::map<unsigned, const char *> _name;
+    // Token names for error messages, shared by all parsers
+    static std::map<unsigned, const char *> _name;
 
     Token *_tok, *_la;
     Token _tokbuf[TOK_BUF_LEN];
@@ -52,7 +53,6 @@ protected:
     void check(unsigned expected);
 
     void initTokenBuffer();
-    virtual void initNames() {}
 
 public:
     virtual void parse(const char *output) {}
@@ -0,0 +1,154 @@
+// Precompiled header - header file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#ifndef PRECOMPILED_HEADER_H
+#define PRECOMPILED_HEADER_H
+
+#include "CParser.h"
+#include "FlatTree.h"
+#include "Preprocessor.h"
+#include "RecordLayout.h"
+#include "SymbolTable.h"
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace cparser
+{
+
+// Snapshot of a parse right after a header: the global scope of the symbol
+// table with every scope, object and type reachable from it, the top-level
+// declarations, and with the preprocessor its macros and include guards. A
+// translation unit parsed from the snapshot starts as if it began with
+// #include of the header, without reading it.
+//
+// The file is written in one piece and read from a mapping of it. It keeps
+// the path, size and a hash of the contents of every file the header read,
+// and the options it was made with. load() rejects it if any of them
+// changed.
+class PrecompiledHeader
+{
+    struct ScopeRecord
+    {
+        uint32_t outer, locals;
+        int nVars, nPars, size;
+    };
+
+    struct TypeRecord
+    {
+        STTypeKind kind;
+        uint32_t elemType, baseType, funcType, fields;
+        unsigned nFields, length, size;
+        bool isSigned;
+        const char *name; // Interned, or nullptr
+        uint32_t layout;  // Index into _layouts
+        std::vector<uint32_t> fieldRecords; // Types of the fields of layout
+    };
+
+    struct ObjectRecord
+    {
+        STObjectKind kind;
+        const char *name; // Interned
+        uint32_t type, locals, next;
+        int ival, level;
+        unsigned prmc;
+        bool isConstant;
+        const char *file; // Interned
+        int line;
+        bool isDefinition, isStatic;
+    };
+
+    struct NodeRef
+    {
+        FlatNodeId id;
+        uint32_t ref; // Scope, or type of a struct or union
+        bool isRecordType;
+    };
+
+    struct ReadFile
+    {
+        std::string path;
+        bool isOnce;
+        std::string guard;
+    };
+
+    std::string _header;
+    std::string _error;
+
+    std::vector<ScopeRecord> _scopes;
+    std::vector<TypeRecord> _types;
+    std::vector<RecordLayout> _layouts;
+    std::vector<ObjectRecord> _objects;
+    FlatTree _tree;
+    std::vector<NodeRef> _nodeRefs;
+    std::vector<std::pair<std::string, Macro>> _macros;
+    std::deque<std::string> _spellings; // Of the tokens of the macros
+    std::vector<ReadFile> _readFiles;
+    std::vector<std::string> _sourceFiles;
+    std::vector<std::pair<uint64_t, uint64_t>> _sourceStamps; // Size, hash
+
+    bool decode(const char *data, size_t size, const std::string &options);
+    static bool encode(std::string &data, const std::string &options,
+                       const char *header, CParser *parser, FlatTree *tree,
+                       Preprocessor *pp);
+
+public:
+    // Write the snapshot of parser, which has just parsed header with its
+    // top-level declarations stored into tree, see FlatTreeBuilder. pp is
+    // the lexer of parser if it was preprocessing, or nullptr.
+    static bool write(const char *path, const std::string &options,
+                      const char *header, CParser *parser, FlatTree *tree,
+                      Preprocessor *pp);
+
+    // Read the snapshot at path. Returns false, see getError(), if it can
+    // not be read, or was made with other options or from other files.
+    bool load(const char *path, const std::string &options);
+
+    // Make the snapshot in memory, as write() and load() would.
+    bool build(const std::string &options, const char *header,
+               CParser *parser, FlatTree *tree, Preprocessor *pp);
+
+    const char *getError() { return _error.c_str(); }
+
+    // The header the snapshot was made from
+    const std::string &getHeader() { return _header; }
+
+    // Every file the header read, the header too
+    const std::vector<std::string> &getSourceFiles() { return _sourceFiles; }
+
+    // Whether the files the header read are still as they were when the
+    // snapshot was made, as load() checks. Returns false, see getError(),
+    // if one of them changed.
+    bool isCurrent();
+
+    // Restoring does not change the snapshot. Threads can restore one
+    // snapshot at the same time, and a snapshot can start one parse after
+    // another.
+
+    // Define the macros and mark the files the header read.
+    void restoreMacros(Preprocessor *pp);
+
+    // Fill the current scope of stb, the global scope of a translation
+    // unit, with new symbols made from the snapshot. The symbols of the
+    // nodes of the declarations are stored into nodeSymbols.
+    void restoreSymbols(SymbolTable *stb, FlatTreeSymbols &nodeSymbols);
+
+    unsigned getNumDeclarations() { return _tree.getTopLevel().size(); }
+
+    // A new pointer tree for the top-level declaration i, with the symbols
+    // from restoreSymbols()
+    ASTNode *getDeclaration(unsigned i, const FlatTreeSymbols &nodeSymbols)
+    {
+        return _tree.expand(_tree.getTopLevel()[i], nodeSymbols);
+    }
+};
+
+} // namespace cparser
+
+#endif
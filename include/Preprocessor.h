@@ -0,0 +1,272 @@
+// Preprocessor - header file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#ifndef PREPROCESSOR_H
+#define PREPROCESSOR_H
+
+#include "CLexer.h"
+#include "Lexer.h"
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace cparser
+{
+
+// Source file read by the preprocessor. Files are mapped into memory once
+// and kept until the preprocessor is destroyed, the spellings of tokens
+// point into them.
+struct SourceFile
+{
+    std::string path;
+    std::string id; // The same for every path to the file
+    const char *data;
+    size_t size;
+    bool isMapped;
+    bool isSystemHeader;
+    std::string text; // Contents of a file that is not mapped
+};
+
+// Token with the source text it was made from
+struct PPToken
+{
+    Token tok;
+    SourceFile *file; // Where the token, or the macro call, comes from
+    const char *spelling;
+    unsigned length;
+    bool hasSpace; // Preceded by white space
+    bool noExpand; // Names a macro that must not be expanded any more
+};
+
+struct Macro
+{
+    bool isDefined;
+    bool isFunctionLike;
+    bool isVariadic;
+    bool isDisabled; // Being expanded
+    std::vector<std::string> params;
+    std::vector<PPToken> body;
+    std::vector<int> bodyParams; // Parameter of each body token, or -1
+};
+
+// Files that are not read again when they are included again: files with
+// #pragma once, and files that are wholly inside an #ifndef guard, which are
+// skipped while the guard macro is defined. One cache can be shared by the
+// preprocessors of a batch, on any thread. Files are expected not to change
+// while it is in use.
+class IncludeSkipCache
+{
+    struct Entry
+    {
+        bool isOnce;
+        std::string guard; // Guard macro, if not isOnce
+        std::string id;    // See SourceFile::id, if isOnce
+    };
+
+    std::mutex _mutex;
+    std::unordered_map<std::string, Entry> _entries;
+
+public:
+    void setOnce(const std::string &path, const std::string &id);
+    void setGuard(const std::string &path, const std::string &macro);
+
+    // Returns false if nothing is known about the file at path. id is set
+    // if the file has #pragma once.
+    bool find(const std::string &path, bool &isOnce, std::string &guard,
+              std::string &id);
+};
+
+// Preprocessor in front of CLexer. It reads #include files, expands macros
+// and evaluates conditional directives, and hands the resulting tokens
+// straight to the parser. Line numbers of the tokens are numbered through
+// all the files, with line markers in the source manager telling which
+// file each line comes from, as for preprocessed input.
+class Preprocessor : public Lexer
+{
+    struct IncludeDir
+    {
+        std::string path;
+        bool isSystem;
+    };
+
+    // How much of the file is known to be inside an include guard
+    enum GuardState
+    {
+        GS_START,  // Nothing was read yet
+        GS_INSIDE, // Inside the #ifndef that opened the file
+        GS_AFTER,  // After its #endif
+        GS_NONE    // The file is not guarded
+    };
+
+    struct IncludedFile
+    {
+        SourceFile *file;
+        FILE *fp;
+        CLexer *lexer;
+        int dirIndex;     // Include directory of the file, or -1
+        size_t condDepth; // Conditionals open when the file was entered
+        long lastEnd;     // Offset after the last token
+        int line;         // Line of the last token
+        GuardState guardState;
+        std::string guardMacro;
+        size_t guardCond; // Index of the guard in _conds
+    };
+
+    struct Conditional
+    {
+        bool wasTaken; // One of the groups was read
+        bool hasElse;
+    };
+
+    // Tokens of a macro expansion, or tokens that were read ahead
+    struct Context
+    {
+        std::vector<PPToken> tokens;
+        size_t pos;
+        Macro *macro; // Enabled again when the tokens are read
+    };
+
+    const char *_mainPath;        // NULL for the standard input
+    const std::string *_mainText; // Read instead of the standard input
+    long _mainStart;              // Part of the main file that is read
+    int _mainStartLine;
+    long _mainEnd;                // -1 for the end of the file
+    bool _started;
+    std::string _predefined; // Definitions read before the main file
+
+    std::vector<IncludeDir> _includeDirs;
+    std::unordered_map<std::string, SourceFile *> _sourceFiles;
+    std::unordered_map<std::string, Macro> _macros;
+
+    std::vector<IncludedFile> _files;
+    std::vector<Conditional> _conds;
+    std::vector<Context> _contexts;
+    std::deque<std::string> _spellings; // Of tokens made by # and ##
+
+    IncludeSkipCache _ownSkipCache;
+    IncludeSkipCache *_skipCache;
+    // #pragma once files read, see SourceFile::id
+    std::unordered_set<std::string> _onceIncluded;
+
+    // Numbering of the lines handed out, see getOutputLine()
+    SourceFile *_outFile;
+    int _outLine, _outSourceLine;
+
+    void fatal(const char *format, ...);
+
+    SourceFile *loadFile(const std::string &path, bool isSystemHeader);
+    void pushFile(SourceFile *file, int dirIndex);
+    void popFile();
+    SourceFile *findInclude(const std::string &name, bool isQuoted,
+                            bool isNext, int &dirIndex, bool &skip);
+    SourceFile *loadInclude(const std::string &path, bool isSystemHeader,
+                            bool &skip);
+
+    void lexToken(IncludedFile &f, PPToken &t);
+    void readFileToken(PPToken &t);
+    void readToken(PPToken &t);
+    void ungetToken(const PPToken &t);
+    void readDirectiveLine(std::vector<PPToken> &line);
+
+    void directive();
+    void updateGuardState(const std::vector<PPToken> &line);
+    void endGuardedGroup(bool isEndif);
+    void defineDirective(std::vector<PPToken> &line);
+    void includeDirective(std::vector<PPToken> &line, bool isNext);
+    void skipGroup();
+    bool isMacroDefined(const std::string &name);
+    bool evaluateCondition(std::vector<PPToken> &line);
+    int64_t evaluateExpression(const std::vector<PPToken> &tokens,
+                               size_t &pos, bool live);
+    int64_t evaluateBinary(const std::vector<PPToken> &tokens, size_t &pos,
+                           int minPrecedence, bool live);
+    int64_t evaluateUnary(const std::vector<PPToken> &tokens, size_t &pos,
+                          bool live);
+
+    void nextExpanded(PPToken &t);
+    bool expandMacro(PPToken &name);
+    void collectArguments(Macro &m, const PPToken &name,
+                          std::vector<std::vector<PPToken>> &args);
+    void substitute(Macro &m, std::vector<std::vector<PPToken>> &args,
+                    std::vector<PPToken> &result);
+    void expandTokens(const std::vector<PPToken> &tokens,
+                      std::vector<PPToken> &result);
+    PPToken stringify(const PPToken &hash, const std::vector<PPToken> &arg);
+    PPToken paste(const PPToken &lhs, const PPToken &rhs);
+    PPToken makeToken(const PPToken &where, unsigned kind, int value,
+                      const char *spelling, unsigned length);
+
+    int getOutputLine(const PPToken &t);
+
+public:
+    // Preprocess filename, or the standard input if it is NULL.
+    Preprocessor(const char *filename);
+    ~Preprocessor();
+
+    // Directories searched for #include files, in the order they are
+    // added. The standard system directories are searched last.
+    void addIncludeDir(const std::string &dir, bool isSystem = false);
+
+    // Define a macro given as NAME or NAME=VALUE, like the -D option of a
+    // compiler.
+    void defineMacro(const std::string &definition);
+
+    // Share cache with other preprocessors, instead of a cache of its own.
+    // Must be called before start().
+    void setSkipCache(IncludeSkipCache *cache) { _skipCache = cache; }
+
+    // Read the file at path before the main file, like the -include option
+    // of a compiler. Must be called before start().
+    void addForcedInclude(const std::string &path);
+
+    // State kept by precompiled headers, see PrecompiledHeader.h
+
+    const std::unordered_map<std::string, Macro> &getMacros()
+    {
+        return _macros;
+    }
+
+    // Define name as macro. The spellings of its tokens are copied.
+    void addMacro(const std::string &name, const Macro &macro);
+
+    // Files read so far, not counting the predefined macros and the
+    // standard input.
+    void getSourceFiles(std::vector<const SourceFile *> &files);
+
+    IncludeSkipCache *getSkipCache() { return _skipCache; }
+
+    // Preprocess text, which must outlive this, instead of the standard
+    // input. Must be called before start().
+    void setMainText(const std::string *text) { _mainText = text; }
+
+    // Read the main file only from offset start, the beginning of the line
+    // startLine, up to offset end, or to the end of the file if end is -1.
+    // Must be called before start().
+    void setMainFileRange(long start, int startLine, long end)
+    {
+        _mainStart = start;
+        _mainStartLine = startLine;
+        _mainEnd = end;
+    }
+
+    // Record that the file at path was read and is guarded by guard, or
+    // has #pragma once, so later #includes of it are skipped.
+    void addReadFile(const std::string &path, bool isOnce,
+                     const std::string &guard);
+
+    void start();
+    unsigned next(Token *t);
+};
+
+} // namespace cparser
+
+#endif
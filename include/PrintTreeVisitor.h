@@ -9,24 +9,49 @@
 #define PRINT_TREE_VISITOR
 
 #include "ASTNode.h"
+#include "TreeEmitter.h"
 #include "TreeVisitor.h"
 
+#include <iostream>
+
 namespace cparser
 {
 
+// Dumps a tree through an emitter, by default as indented text to the
+// standard output.
 class PrintTreeVisitor : public TreeVisitor
 {
-    int _level; // Indentation level
+    TreeEmitter *_emitter;
+    bool _ownsEmitter;
 
 public:
-    PrintTreeVisitor() { _level = 0; }
+    PrintTreeVisitor()
+        : _emitter(new TextTreeEmitter(std::cout)), _ownsEmitter(true)
+    {
+    }
+
+    // L is the initial indentation level.
+    PrintTreeVisitor(int L)
+        : _emitter(new TextTreeEmitter(std::cout, L)), _ownsEmitter(true)
+    {
+    }
+
+    PrintTreeVisitor(TreeEmitter *emitter)
+        : _emitter(emitter), _ownsEmitter(false)
+    {
+    }
 
-    PrintTreeVisitor(int L) : _level(L) {}
+    ~PrintTreeVisitor()
+    {
+        if (_ownsEmitter)
+            delete _emitter;
+    }
 
     void visit(IdentASTNode *n);
     void visit(IntegerConstASTNode *n);
     void visit(StringConstASTNode *n);
     void visit(CharConstASTNode *n);
+    void visit(PackedConstArrayASTNode *n);
     void visit(SizeOfExprASTNode *n);
     void visit(TypeDeclASTNode *n);
     void visit(FunctionDeclASTNode *n);
@@ -0,0 +1,96 @@
+// Record layout - header file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#ifndef RECORD_LAYOUT_H
+#define RECORD_LAYOUT_H
+
+#include "ASTNode.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cparser
+{
+
+// The struct or union a type reaches through indirection pointers and
+// arrays, as the type of a field or variable. record is nullptr if the type
+// is not one of them, or the record is not known.
+struct RecordRef
+{
+    STType *record;
+    unsigned indirection;
+};
+
+struct FieldLayout
+{
+    std::string name;
+    unsigned offset;    // In bytes, of the storage unit for bit-fields
+    unsigned size;      // In bytes, of the storage unit for bit-fields
+    unsigned bitOffset; // Within the storage unit
+    unsigned bitWidth;  // Zero unless this is a bit-field
+    RecordRef type;     // Record of the field, for member access through it
+};
+
+// Size, alignment and field offsets of a struct or union, computed once
+// when its body is parsed and kept in the STType of the record. Members of
+// anonymous nested records are lifted into the enclosing record, the way C
+// lets them be accessed. Sizes follow the LP64 model.
+class RecordLayout
+{
+    bool _isUnion;
+    bool _isComplete;
+    unsigned _size;
+    unsigned _alignment;
+    std::vector<FieldLayout> _fields;
+
+    // Open addressing hash index of the named fields. Each slot holds a
+    // field index plus one, or zero if the slot is empty.
+    std::vector<uint32_t> _index;
+
+    void addField(ASTNode *type, const char *name, ASTNode *bitWidth,
+                  uint64_t &bitPos);
+    void addAnonymousRecord(RecordLayout *nested, uint64_t &bitPos);
+    void addField(const FieldLayout &field, unsigned alignment);
+    void buildIndex();
+
+public:
+    // Lay out the fields of body, a list of field declarations.
+    RecordLayout(ASTNode *body, bool isUnion);
+
+    // A layout computed before, as a precompiled header keeps it.
+    RecordLayout(bool isUnion, bool isComplete, unsigned size,
+                 unsigned alignment, const std::vector<FieldLayout> &fields);
+
+    // False if the size of some field is not known. Sizes and offsets of
+    // the fields before it are still valid.
+    bool isComplete() { return _isComplete; }
+
+    bool isUnion() { return _isUnion; }
+    unsigned getSize() { return _size; }
+    unsigned getAlignment() { return _alignment; }
+    std::vector<FieldLayout> &getFields() { return _fields; }
+
+    // Field called name, or nullptr.
+    const FieldLayout *findField(const char *name);
+};
+
+// Size and alignment of the type node type, as it appears in declarations
+// and in sizeof and _Alignof. Struct and union layouts are taken from their
+// STType. Returns false if they are not known.
+bool getTypeLayout(ASTNode *type, unsigned &size, unsigned &alignment);
+
+// The record of the type node type, see RecordRef.
+RecordRef getRecordRef(ASTNode *type);
+
+// The field selected by ref, a . or -> expression, once the parser resolved
+// it, see StructRefASTNode::getRecordType(). Returns nullptr otherwise.
+const FieldLayout *getFieldLayout(ASTNode *ref);
+
+} // namespace cparser
+
+#endif
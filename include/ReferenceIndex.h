@@ -0,0 +1,164 @@
+// Cross-reference index - header file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#ifndef REFERENCE_INDEX_H
+#define REFERENCE_INDEX_H
+
+#include "CParser.h"
+#include "HeaderModule.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cparser
+{
+
+class ReferenceIndex;
+
+// A reference in a ReferenceDatabase, see ReferenceSink. Strings are
+// interned.
+struct Reference
+{
+    const char *name;
+    ReferenceKind kind;
+    int line;
+    int col;
+    const char *function;
+};
+
+// Size and hash of the contents of a file, size is UINT64_MAX if it can not
+// be read.
+struct FileStamp
+{
+    uint64_t size;
+    uint64_t hash;
+
+    bool operator==(const FileStamp &s) const
+    {
+        return size == s.size && hash == s.hash;
+    }
+    bool operator!=(const FileStamp &s) const { return !(*this == s); }
+};
+
+// A translation unit of a ReferenceDatabase and the files it was read from,
+// itself first. Files are interned.
+struct ReferenceUnit
+{
+    std::string path;
+    std::vector<const char *> files;
+};
+
+// References to the names that are not local to a function, of the files of
+// many translation units.
+//
+// References are kept by the file they are in. A header is parsed with
+// every translation unit that includes it, and its references are taken
+// from the first one. update() parses only the translation units whose
+// files changed since the database was made, on several threads, and
+// replaces the references of the files they read.
+class ReferenceDatabase
+{
+    std::string _options;
+    std::vector<ReferenceUnit> _units;
+    std::unordered_map<const char *, std::vector<Reference>> _files;
+    std::unordered_map<const char *, FileStamp> _oldStamps;
+    std::unordered_map<const char *, FileStamp> _stamps;
+
+    const FileStamp &getStamp(const char *file);
+
+public:
+    // options describe how the translation units are read, an index made
+    // with other options is not used, see ReferenceIndex::getOptions().
+    ReferenceDatabase(const std::string &options) : _options(options) {}
+
+    // Start from the contents of index.
+    bool read(const ReferenceIndex &index);
+
+    // Parse the translation units at paths, and the ones in the database
+    // whose files changed, on jobs threads. Translation units that can no
+    // longer be read are removed. With preprocess, they are read through
+    // the preprocessors of modules. Returns the number of units parsed.
+    unsigned update(const std::vector<const char *> &paths, unsigned jobs,
+                    bool preprocess, HeaderModuleCache *modules);
+
+    const std::vector<ReferenceUnit> &getUnits() { return _units; }
+
+    // Write the database to path, see ReferenceIndex.
+    bool write(const char *path);
+};
+
+// A reference read from a ReferenceIndex
+struct IndexedReference
+{
+    ReferenceKind kind;
+    const char *file;
+    unsigned line;
+    unsigned col;
+    const char *function; // nullptr outside of function bodies
+};
+
+// Cross-reference index written by ReferenceDatabase::write(), read from a
+// mapping of the file. Names are numbered in their order, and only the
+// references of the names looked up are decoded.
+//
+// The file starts with the counts of the tables that follow it, of the
+// translation units, the files they read, the files with their sizes and
+// hashes, and the names, followed by the references and all strings. The
+// references to a name are sorted by their file, line and column, and each
+// one is stored as variable-length differences to the one before it.
+class ReferenceIndex
+{
+    const char *_data;
+    size_t _size;
+    std::string _error;
+
+    uint32_t _nUnits, _nDependencies, _nFiles, _nNames;
+    uint32_t _postingsSize, _stringsSize, _options;
+    const char *_unitTable, *_dependencyTable, *_fileTable, *_nameTable;
+    const char *_postings, *_strings;
+
+    uint32_t word(const char *p, unsigned i) const;
+    const char *string(uint32_t offset) const;
+
+public:
+    ReferenceIndex();
+    ~ReferenceIndex();
+
+    // Map the index at path. Returns false, see getError(), if it is not
+    // an index.
+    bool load(const char *path);
+
+    const char *getError() { return _error.c_str(); }
+
+    const char *getOptions() const { return string(_options); }
+
+    unsigned getNumUnits() const { return _nUnits; }
+    const char *getUnit(unsigned unit) const;
+    unsigned getNumDependencies(unsigned unit) const;
+    unsigned getDependency(unsigned unit, unsigned i) const; // A file
+
+    unsigned getNumFiles() const { return _nFiles; }
+    const char *getFile(unsigned file) const;
+    FileStamp getFileStamp(unsigned file) const;
+
+    unsigned getNumNames() const { return _nNames; }
+    const char *getName(unsigned name) const;
+
+    // The number of name, or -1 if it has no references.
+    int find(const char *name) const;
+
+    // Decode the references to name into refs. Returns false if they are
+    // damaged.
+    bool getReferences(unsigned name,
+                       std::vector<IndexedReference> &refs) const;
+};
+
+} // namespace cparser
+
+#endif
@@ -0,0 +1,62 @@
+// Source manager - header file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#ifndef SOURCE_MANAGER_H
+#define SOURCE_MANAGER_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace cparser
+{
+
+// Line marker of preprocessed input, i.e. # 123 "/usr/include/stdio.h" 3 4.
+// Physical lines starting with physLine come from the given file, starting
+// with its line presumedLine.
+struct LineMarker
+{
+    int physLine;
+    int presumedLine;
+    unsigned fileId;
+    bool isSystemHeader;
+};
+
+class SourceManager
+{
+    std::vector<std::string> _files;
+    std::map<std::string, unsigned> _fileIds;
+    std::vector<LineMarker> _markers; // Sorted by physical line
+    std::vector<std::string> _ignoredPaths;
+    unsigned _lastMarker; // Index of the marker found last
+
+public:
+    unsigned getFileId(const std::string &name);
+    const char *getFileName(unsigned fileId) const
+    {
+        return _files[fileId].c_str();
+    }
+
+    // Files whose path starts with one of the ignored paths are treated as
+    // system headers.
+    void addIgnoredPath(const std::string &prefix);
+    bool isIgnoredFile(const std::string &name) const;
+
+    void addLineMarker(int physLine, int presumedLine, const std::string &file,
+                       bool isSystemHeader);
+    const LineMarker *findLineMarker(int physLine);
+
+    bool isSystemHeader(int physLine);
+    int getPresumedLine(int physLine);
+    const char *getPresumedFileName(int physLine);
+
+    SourceManager() : _lastMarker(0) {}
+};
+
+} // namespace cparser
+
+#endif
@@ -0,0 +1,574 @@
+// Static tree visitor - header file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#ifndef STATIC_TREE_VISITOR_H
+#define STATIC_TREE_VISITOR_H
+
+#include "ASTNode.h"
+
+namespace cparser
+{
+
+// Alternative to TreeVisitor without virtual calls. Nodes are dispatched by
+// a switch on ASTNode::getKind() to Derived::visit(), so the visit functions
+// can be inlined into the traversal. The default visit functions traverse
+// the children in the same way as TreeVisitor does.
+//
+// A derived visitor has to bring the default functions into its scope:
+//
+//     class CountCalls : public StaticTreeVisitor<CountCalls>
+//     {
+//     public:
+//         int count = 0;
+//
+//         using StaticTreeVisitor<CountCalls>::visit;
+//
+//         void visit(CallExprASTNode *n)
+//         {
+//             count++;
+//             StaticTreeVisitor<CountCalls>::visit(n);
+//         }
+//     };
+template <typename Derived> class StaticTreeVisitor
+{
+public:
+    void dispatch(ASTNode *n)
+    {
+        Derived *d = static_cast<Derived *>(this);
+
+        switch (n->getKind())
+        {
+            case NK_IDENT_NODE:
+                d->visit(static_cast<IdentASTNode *>(n));
+                break;
+            case NK_INTEGER_CONST:
+                d->visit(static_cast<IntegerConstASTNode *>(n));
+                break;
+            case NK_REAL_CONST:
+                d->visit(static_cast<RealConstASTNode *>(n));
+                break;
+            case NK_STRING_CONST:
+                d->visit(static_cast<StringConstASTNode *>(n));
+                break;
+            case NK_CHAR_CONST:
+                d->visit(static_cast<CharConstASTNode *>(n));
+                break;
+            case NK_PACKED_CONST_ARRAY:
+                d->visit(static_cast<PackedConstArrayASTNode *>(n));
+                break;
+            case NK_SIZEOF_EXPR:
+                d->visit(static_cast<SizeOfExprASTNode *>(n));
+                break;
+            case NK_ALIGNOF_EXPR:
+                d->visit(static_cast<AlignOfExprASTNode *>(n));
+                break;
+            case NK_TYPE_DECL:
+                d->visit(static_cast<TypeDeclASTNode *>(n));
+                break;
+            case NK_FUNCTION_DECL:
+                d->visit(static_cast<FunctionDeclASTNode *>(n));
+                break;
+            case NK_VAR_DECL:
+                d->visit(static_cast<VarDeclASTNode *>(n));
+                break;
+            case NK_PARM_DECL:
+                d->visit(static_cast<ParmDeclASTNode *>(n));
+                break;
+            case NK_FIELD_DECL:
+                d->visit(static_cast<FieldDeclASTNode *>(n));
+                break;
+            case NK_ASM_STMT:
+                d->visit(static_cast<AsmStmtASTNode *>(n));
+                break;
+            case NK_BREAK_STMT:
+                d->visit(static_cast<BreakStmtASTNode *>(n));
+                break;
+            case NK_CASE_LABEL:
+                d->visit(static_cast<CaseLabelASTNode *>(n));
+                break;
+            case NK_COMPOUND_STMT:
+                d->visit(static_cast<CompoundStmtASTNode *>(n));
+                break;
+            case NK_CONTINUE_STMT:
+                d->visit(static_cast<ContinueStmtASTNode *>(n));
+                break;
+            case NK_DO_STMT:
+                d->visit(static_cast<DoStmtASTNode *>(n));
+                break;
+            case NK_FOR_STMT:
+                d->visit(static_cast<ForStmtASTNode *>(n));
+                break;
+            case NK_GOTO_STMT:
+                d->visit(static_cast<GotoStmtASTNode *>(n));
+                break;
+            case NK_IF_STMT:
+                d->visit(static_cast<IfStmtASTNode *>(n));
+                break;
+            case NK_LABEL_STMT:
+                d->visit(static_cast<LabelStmtASTNode *>(n));
+                break;
+            case NK_RETURN_STMT:
+                d->visit(static_cast<ReturnStmtASTNode *>(n));
+                break;
+            case NK_SWITCH_STMT:
+                d->visit(static_cast<SwitchStmtASTNode *>(n));
+                break;
+            case NK_WHILE_STMT:
+                d->visit(static_cast<WhileStmtASTNode *>(n));
+                break;
+            case NK_CAST_EXPR:
+                d->visit(static_cast<CastExprASTNode *>(n));
+                break;
+            case NK_BIT_NOT_EXPR:
+                d->visit(static_cast<BitNotExprASTNode *>(n));
+                break;
+            case NK_LOG_NOT_EXPR:
+                d->visit(static_cast<LogNotExprASTNode *>(n));
+                break;
+            case NK_PREDECREMENT_EXPR:
+                d->visit(static_cast<PredecrementExprASTNode *>(n));
+                break;
+            case NK_PREINCREMENT_EXPR:
+                d->visit(static_cast<PreincrementExprASTNode *>(n));
+                break;
+            case NK_POSTDECREMENT_EXPR:
+                d->visit(static_cast<PostdecrementExprASTNode *>(n));
+                break;
+            case NK_POSTINCREMENT_EXPR:
+                d->visit(static_cast<PostincrementExprASTNode *>(n));
+                break;
+            case NK_ADDR_EXPR:
+                d->visit(static_cast<AddrExprASTNode *>(n));
+                break;
+            case NK_INDIRECT_REF:
+                d->visit(static_cast<IndirectRefASTNode *>(n));
+                break;
+            case NK_NOP_EXPR:
+                d->visit(static_cast<NopExprASTNode *>(n));
+                break;
+            case NK_LSHIFT_EXPR:
+                d->visit(static_cast<LShiftExprASTNode *>(n));
+                break;
+            case NK_RSHIFT_EXPR:
+                d->visit(static_cast<RShiftExprASTNode *>(n));
+                break;
+            case NK_BIT_IOR_EXPR:
+                d->visit(static_cast<BitIorExprASTNode *>(n));
+                break;
+            case NK_BIT_XOR_EXPR:
+                d->visit(static_cast<BitXorExprASTNode *>(n));
+                break;
+            case NK_BIT_AND_EXPR:
+                d->visit(static_cast<BitAndExprASTNode *>(n));
+                break;
+            case NK_LOG_AND_EXPR:
+                d->visit(static_cast<LogAndExprASTNode *>(n));
+                break;
+            case NK_LOG_OR_EXPR:
+                d->visit(static_cast<LogOrExprASTNode *>(n));
+                break;
+            case NK_PLUS_EXPR:
+                d->visit(static_cast<PlusExprASTNode *>(n));
+                break;
+            case NK_MINUS_EXPR:
+                d->visit(static_cast<MinusExprASTNode *>(n));
+                break;
+            case NK_MULT_EXPR:
+                d->visit(static_cast<MultExprASTNode *>(n));
+                break;
+            case NK_TRUNC_DIV_EXPR:
+                d->visit(static_cast<TruncDivExprASTNode *>(n));
+                break;
+            case NK_TRUNC_MOD_EXPR:
+                d->visit(static_cast<TruncModExprASTNode *>(n));
+                break;
+            case NK_ARRAY_REF:
+                d->visit(static_cast<ArrayRefASTNode *>(n));
+                break;
+            case NK_STRUCT_REF:
+                d->visit(static_cast<StructRefASTNode *>(n));
+                break;
+            case NK_LT_EXPR:
+                d->visit(static_cast<LtExprASTNode *>(n));
+                break;
+            case NK_LE_EXPR:
+                d->visit(static_cast<LeExprASTNode *>(n));
+                break;
+            case NK_GT_EXPR:
+                d->visit(static_cast<GtExprASTNode *>(n));
+                break;
+            case NK_GE_EXPR:
+                d->visit(static_cast<GeExprASTNode *>(n));
+                break;
+            case NK_EQ_EXPR:
+                d->visit(static_cast<EqExprASTNode *>(n));
+                break;
+            case NK_NE_EXPR:
+                d->visit(static_cast<NeExprASTNode *>(n));
+                break;
+            case NK_ASSIGN_EXPR:
+                d->visit(static_cast<AssignExprASTNode *>(n));
+                break;
+            case NK_COND_EXPR:
+                d->visit(static_cast<CondExprASTNode *>(n));
+                break;
+            case NK_CALL_EXPR:
+                d->visit(static_cast<CallExprASTNode *>(n));
+                break;
+            case NK_VOID_TYPE:
+                d->visit(static_cast<VoidTypeASTNode *>(n));
+                break;
+            case NK_INTEGRAL_TYPE:
+                d->visit(static_cast<IntegralTypeASTNode *>(n));
+                break;
+            case NK_REAL_TYPE:
+                d->visit(static_cast<RealTypeASTNode *>(n));
+                break;
+            case NK_ENUMERAL_TYPE:
+                d->visit(static_cast<EnumeralTypeASTNode *>(n));
+                break;
+            case NK_POINTER_TYPE:
+                d->visit(static_cast<PointerTypeASTNode *>(n));
+                break;
+            case NK_FUNCTION_TYPE:
+                d->visit(static_cast<FunctionTypeASTNode *>(n));
+                break;
+            case NK_ARRAY_TYPE:
+                d->visit(static_cast<ArrayTypeASTNode *>(n));
+                break;
+            case NK_STRUCT_TYPE:
+                d->visit(static_cast<StructTypeASTNode *>(n));
+                break;
+            case NK_UNION_TYPE:
+                d->visit(static_cast<UnionTypeASTNode *>(n));
+                break;
+            case NK_UNKNOWN:
+                d->visit(static_cast<NullASTNode *>(n));
+                break;
+            case NK_LIST:
+                d->visit(static_cast<SequenceASTNode *>(n));
+                break;
+            default:
+                break;
+        }
+    }
+
+    void visit(IdentASTNode *n) {}
+
+    void visit(IntegerConstASTNode *n) {}
+
+    void visit(RealConstASTNode *n) {}
+
+    void visit(StringConstASTNode *n) {}
+
+    void visit(CharConstASTNode *n) {}
+
+    void visit(PackedConstArrayASTNode *n) {}
+
+    void visit(SizeOfExprASTNode *n) { dispatch(n->getExpr()); }
+
+    void visit(AlignOfExprASTNode *n) { dispatch(n->getExpr()); }
+
+    void visit(TypeDeclASTNode *n)
+    {
+        dispatch(n->getName());
+        dispatch(n->getBody());
+    }
+
+    void visit(FunctionDeclASTNode *n)
+    {
+        dispatch(n->getName());
+        dispatch(n->getType());
+        dispatch(n->getPrms());
+        dispatch(n->getBody());
+    }
+
+    void visit(VarDeclASTNode *n)
+    {
+        dispatch(n->getName());
+        dispatch(n->getType());
+        dispatch(n->getInit());
+    }
+
+    void visit(ParmDeclASTNode *n)
+    {
+        dispatch(n->getName());
+        dispatch(n->getType());
+    }
+
+    void visit(FieldDeclASTNode *n)
+    {
+        dispatch(n->getName());
+        dispatch(n->getType());
+        dispatch(n->getBitWidth());
+    }
+
+    void visit(AsmStmtASTNode *n) {}
+
+    void visit(BreakStmtASTNode *n) {}
+
+    void visit(CaseLabelASTNode *n)
+    {
+        dispatch(n->getExpr());
+        dispatch(n->getStmt());
+    }
+
+    void visit(CompoundStmtASTNode *n)
+    {
+        dispatch(n->getDecls());
+        dispatch(n->getStmts());
+    }
+
+    void visit(ContinueStmtASTNode *n) {}
+
+    void visit(DoStmtASTNode *n)
+    {
+        dispatch(n->getCondition());
+        dispatch(n->getBody());
+    }
+
+    void visit(ForStmtASTNode *n)
+    {
+        dispatch(n->getInit());
+        dispatch(n->getCondition());
+        dispatch(n->getBody());
+        dispatch(n->getStep());
+    }
+
+    void visit(GotoStmtASTNode *n) {}
+
+    void visit(IfStmtASTNode *n)
+    {
+        dispatch(n->getCondition());
+        dispatch(n->getThenClause());
+        dispatch(n->getElseClause());
+    }
+
+    void visit(LabelStmtASTNode *n)
+    {
+        dispatch(n->getLabel());
+        dispatch(n->getStmt());
+    }
+
+    void visit(ReturnStmtASTNode *n) { dispatch(n->getExpr()); }
+
+    void visit(SwitchStmtASTNode *n)
+    {
+        dispatch(n->getExpr());
+        dispatch(n->getStmt());
+    }
+
+    void visit(WhileStmtASTNode *n)
+    {
+        dispatch(n->getCondition());
+        dispatch(n->getBody());
+    }
+
+    void visit(CastExprASTNode *n) { dispatch(n->getExpr()); }
+
+    void visit(BitNotExprASTNode *n) { dispatch(n->getExpr()); }
+
+    void visit(LogNotExprASTNode *n) {}
+
+    void visit(PredecrementExprASTNode *n)
+    {
+        dispatch(n->getExpr());
+    }
+
+    void visit(PreincrementExprASTNode *n)
+    {
+        dispatch(n->getExpr());
+    }
+
+    void visit(PostdecrementExprASTNode *n)
+    {
+        dispatch(n->getExpr());
+    }
+
+    void visit(PostincrementExprASTNode *n)
+    {
+        dispatch(n->getExpr());
+    }
+
+    void visit(AddrExprASTNode *n) { dispatch(n->getExpr()); }
+
+    void visit(IndirectRefASTNode *n) {}
+
+    void visit(NopExprASTNode *n) {}
+
+    void visit(LShiftExprASTNode *n)
+    {
+        dispatch(n->getLhs());
+        dispatch(n->getRhs());
+    }
+
+    void visit(RShiftExprASTNode *n)
+    {
+        dispatch(n->getLhs());
+        dispatch(n->getRhs());
+    }
+
+    void visit(BitIorExprASTNode *n)
+    {
+        dispatch(n->getLhs());
+        dispatch(n->getRhs());
+    }
+
+    void visit(BitXorExprASTNode *n)
+    {
+        dispatch(n->getLhs());
+        dispatch(n->getRhs());
+    }
+
+    void visit(BitAndExprASTNode *n)
+    {
+        dispatch(n->getLhs());
+        dispatch(n->getRhs());
+    }
+
+    void visit(LogAndExprASTNode *n)
+    {
+        dispatch(n->getLhs());
+        dispatch(n->getRhs());
+    }
+
+    void visit(LogOrExprASTNode *n)
+    {
+        dispatch(n->getLhs());
+        dispatch(n->getRhs());
+    }
+
+    void visit(PlusExprASTNode *n)
+    {
+        dispatch(n->getLhs());
+        dispatch(n->getRhs());
+    }
+
+    void visit(MinusExprASTNode *n)
+    {
+        dispatch(n->getLhs());
+        dispatch(n->getRhs());
+    }
+
+    void visit(MultExprASTNode *n)
+    {
+        dispatch(n->getLhs());
+        dispatch(n->getRhs());
+    }
+
+    void visit(TruncDivExprASTNode *n)
+    {
+        dispatch(n->getLhs());
+        dispatch(n->getRhs());
+    }
+
+    void visit(TruncModExprASTNode *n)
+    {
+        dispatch(n->getLhs());
+        dispatch(n->getRhs());
+    }
+
+    void visit(ArrayRefASTNode *n) {}
+
+    void visit(StructRefASTNode *n) {}
+
+    void visit(LtExprASTNode *n)
+    {
+        dispatch(n->getLhs());
+        dispatch(n->getRhs());
+    }
+
+    void visit(LeExprASTNode *n)
+    {
+        dispatch(n->getLhs());
+        dispatch(n->getRhs());
+    }
+
+    void visit(GtExprASTNode *n)
+    {
+        dispatch(n->getLhs());
+        dispatch(n->getRhs());
+    }
+
+    void visit(GeExprASTNode *n)
+    {
+        dispatch(n->getLhs());
+        dispatch(n->getRhs());
+    }
+
+    void visit(EqExprASTNode *n)
+    {
+        dispatch(n->getLhs());
+        dispatch(n->getRhs());
+    }
+
+    void visit(NeExprASTNode *n)
+    {
+        dispatch(n->getLhs());
+        dispatch(n->getRhs());
+    }
+
+    void visit(AssignExprASTNode *n)
+    {
+        dispatch(n->getLhs());
+        dispatch(n->getRhs());
+    }
+
+    void visit(CondExprASTNode *n) {}
+
+    void visit(CallExprASTNode *n)
+    {
+        dispatch(n->getExpr());
+        dispatch(n->getArgs());
+    }
+
+    void visit(VoidTypeASTNode *n) {}
+
+    void visit(IntegralTypeASTNode *n) {}
+
+    void visit(RealTypeASTNode *n) {}
+
+    void visit(EnumeralTypeASTNode *n)
+    {
+        dispatch(n->getName());
+        dispatch(n->getBody());
+    }
+
+    void visit(PointerTypeASTNode *n)
+    {
+        dispatch(n->getBaseType());
+    }
+
+    void visit(FunctionTypeASTNode *n)
+    {
+        dispatch(n->getType());
+        dispatch(n->getPrms());
+    }
+
+    void visit(ArrayTypeASTNode *n) {}
+
+    void visit(StructTypeASTNode *n)
+    {
+        dispatch(n->getName());
+        dispatch(n->getBody());
+    }
+
+    void visit(UnionTypeASTNode *n) {}
+
+    void visit(NullASTNode *n) {}
+
+    void visit(SequenceASTNode *n)
+    {
+        std::vector<ASTNode *> &elements = n->getElements();
+        for (unsigned i = 0; i < elements.size(); i++)
+            dispatch(elements[i]);
+    }
+};
+
+} // namespace cparser
+
+#endif
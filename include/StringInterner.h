@@ -0,0 +1,105 @@
+// String interner - header file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#ifndef STRING_INTERNER_H
+#define STRING_INTERNER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cparser
+{
+
+#define INTERNER_SHARD_BITS 6
+#define INTERNER_SHARDS (1 << INTERNER_SHARD_BITS)
+
+// Process-wide set of names, shared by every thread. Interning a string
+// returns its one copy in the set, a handle that stays valid and unchanged
+// until the process ends. Two handles are equal if and only if their
+// strings are, so names from different translation units and threads are
+// compared by their pointers alone.
+//
+// Looking up a name takes no lock. The set is split into shards by the hash
+// of the name, and only a name that is not in the set yet takes the lock of
+// its shard. A shard grows by publishing a bigger table. Readers still on
+// the old table find every name that was in it, so old tables are kept, as
+// are the names, until the process ends.
+class StringInterner
+{
+    struct Entry
+    {
+        uint64_t hash;
+        size_t length;
+        char chars[1]; // NUL-terminated, allocated with the entry
+    };
+
+    struct Table
+    {
+        size_t mask; // Number of slots minus one
+        std::atomic<Entry *> *slots;
+        Table *previous; // Retired, smaller table
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::atomic<Table *> table;
+        size_t count;
+        std::vector<char *> blocks; // Storage of the entries
+        size_t blockLeft;
+    };
+
+    Shard _shards[INTERNER_SHARDS];
+
+    StringInterner();
+    ~StringInterner();
+
+    static Entry *lookup(Table *table, uint64_t hash, const char *s,
+                         size_t length);
+    Entry *allocEntry(Shard &shard, uint64_t hash, const char *s,
+                      size_t length);
+    void grow(Shard &shard);
+
+public:
+    static StringInterner *getInstance();
+
+    // The handle of the first length characters of s, added if needed
+    const char *intern(const char *s, size_t length);
+    const char *intern(const char *s) { return intern(s, strlen(s)); }
+    const char *intern(const std::string &s)
+    {
+        return intern(s.data(), s.size());
+    }
+
+    // The handle of s if it was interned, or nullptr. Never adds s. A name
+    // that another thread is interning at the same time may not be found.
+    const char *find(const char *s, size_t length);
+    const char *find(const char *s) { return find(s, strlen(s)); }
+
+    // Number of names interned so far
+    size_t size();
+};
+
+// The handle of s in the process-wide interner
+inline const char *internName(const char *s)
+{
+    return StringInterner::getInstance()->intern(s);
+}
+
+inline const char *internName(const std::string &s)
+{
+    return StringInterner::getInstance()->intern(s);
+}
+
+} // namespace cparser
+
+#endif
@@ -0,0 +1,138 @@
+// Symbol database - header file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#ifndef SYMBOL_DATABASE_H
+#define SYMBOL_DATABASE_H
+
+#include "HeaderModule.h"
+#include "SymbolTable.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cparser
+{
+
+// Where a symbol is declared or defined. file is interned.
+struct SymbolSite
+{
+    uint32_t unit; // Index of the translation unit
+    const char *file;
+    int line;
+};
+
+// A function, variable or type of the whole program, with every place it is
+// defined, and every other place it is declared. Functions and variables
+// with internal linkage are one symbol per translation unit. A type may be
+// defined once in every translation unit, from the same place.
+struct Symbol
+{
+    const char *name; // Interned
+    STObjectKind kind;
+    bool isStatic;
+    std::vector<SymbolSite> definitions;
+    std::vector<SymbolSite> declarations;
+
+    // A function or variable with external linkage that is defined more
+    // than once. Each translation unit may define its own types and
+    // statics.
+    bool isDuplicate() const
+    {
+        return kind != STOK_TYPE && !isStatic && definitions.size() > 1;
+    }
+};
+
+// Global scopes of translation units merged into one program-wide table.
+//
+// build() parses the translation units on several threads and takes the
+// functions, variables and types from the global scope of each one (map).
+// The symbols are split into shards by name, and each shard is merged on
+// its own thread, joining the symbols of all translation units by their
+// interned names (reduce).
+class SymbolDatabase
+{
+    std::vector<std::string> _units;
+    std::vector<Symbol> _symbols; // Sorted by name
+
+public:
+    // Parse the translation units at paths on jobs threads. With
+    // preprocess, they are read through the preprocessors of modules.
+    void build(const std::vector<const char *> &paths, unsigned jobs,
+               bool preprocess, HeaderModuleCache *modules);
+
+    const std::vector<std::string> &getUnits() { return _units; }
+    const std::vector<Symbol> &getSymbols() { return _symbols; }
+
+    // Write the database to path, see SymbolIndex.
+    bool write(const char *path);
+};
+
+// A place of a symbol in a SymbolIndex
+struct SymbolLocation
+{
+    const char *unit;
+    const char *file;
+    unsigned line;
+};
+
+// Symbol database written by SymbolDatabase::write(), read from a mapping
+// of the file without decoding it. Symbols are numbered in the order of
+// their names.
+//
+// The file starts with the number of translation units, symbols and
+// places, followed by the tables of each one and all strings. Each symbol
+// holds the offset of its name, its kind and the range of its places,
+// definitions first. Every number is a 32-bit little-endian word.
+class SymbolIndex
+{
+    const char *_data;
+    size_t _size;
+    std::string _error;
+
+    uint32_t _nUnits, _nSymbols, _nSites, _stringsSize;
+    const char *_unitTable, *_symbolTable, *_siteTable;
+    const char *_strings;
+
+    uint32_t word(const char *p, unsigned i) const;
+    const char *string(uint32_t offset) const;
+    SymbolLocation site(uint32_t i) const;
+    uint32_t symbolWord(unsigned symbol, unsigned i) const
+    {
+        return word(_symbolTable, symbol * 5 + i);
+    }
+
+public:
+    SymbolIndex();
+    ~SymbolIndex();
+
+    // Map the index at path. Returns false, see getError(), if it is not
+    // an index.
+    bool load(const char *path);
+
+    const char *getError() { return _error.c_str(); }
+
+    unsigned getNumSymbols() const { return _nSymbols; }
+
+    // The symbols named name are first, first + 1, ..., last - 1.
+    void find(const char *name, unsigned &first, unsigned &last) const;
+
+    const char *getName(unsigned symbol) const;
+    STObjectKind getKind(unsigned symbol) const;
+    bool isStatic(unsigned symbol) const;
+    unsigned getNumDefinitions(unsigned symbol) const;
+    unsigned getNumDeclarations(unsigned symbol) const;
+    SymbolLocation getDefinition(unsigned symbol, unsigned i) const;
+    SymbolLocation getDeclaration(unsigned symbol, unsigned i) const;
+
+    // See Symbol::isDuplicate().
+    bool isDuplicate(unsigned symbol) const;
+};
+
+} // namespace cparser
+
+#endif
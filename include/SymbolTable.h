@@ -9,6 +9,7 @@
 #define SYMBOL_TABLE_H
 
 #include "common.h"
+#include "StringInterner.h"
 #include <map>
 #include <vector>
 
@@ -53,6 +54,7 @@ enum STTypeKind
 struct STType;
 struct STObject;
 struct STScope;
+class RecordLayout;
 
 struct STType
 {
@@ -65,19 +67,23 @@ struct STType
     struct STObject *fields;    // Struct fields
     unsigned size;
     bool isSigned;
+    RecordLayout *layout; // Struct and union layout, once defined
+    const char *name;     // Tag of a struct, union or enum, interned
 
     STType(STTypeKind Kind)
         : kind(Kind), elemType(nullptr), baseType(nullptr),
           funcType(nullptr), nFields(0), length(0), fields(nullptr),
-          size(0), isSigned(false)
+          size(0), isSigned(false), layout(nullptr), name(nullptr)
     {
     }
+
+    ~STType();
 };
 
 struct STObject
 {
     STObjectKind kind;
-    char name[IDLEN];
+    const char *name; // Interned, see StringInterner
     STType *type;
 
     int ival;  // Integer constant value.
@@ -89,14 +95,25 @@ struct STObject
 
     bool isConstant;
 
+    // Where a global object is declared, at its definition once there is
+    // one. file is interned, or nullptr for the input itself. line is 0 if
+    // the location is not known. See CParser.
+    const char *file;
+    int line;
+    bool isDefinition;
+    bool isStatic; // Internal linkage
+
+    // Order of allocation, see SymbolTable::setGlobalLimit()
+    unsigned serial;
+
     // Next object in a list
     struct STObject *next;
 
     STObject(const char *Name, STObjectKind Kind, STType *Type)
-        : ival(0), level(0), prmc(0), locals(nullptr),
-          isConstant(false), next(nullptr)
+        : name(internName(Name)), ival(0), level(0), prmc(0),
+          locals(nullptr), isConstant(false), file(nullptr), line(0),
+          isDefinition(false), isStatic(false), serial(0), next(nullptr)
     {
-        strcpy(name, Name);
         kind = Kind;
         type = Type;
     }
@@ -109,8 +126,13 @@ struct STScope
     int nVars;           // Number of variables in this scope
     int nPars;           // Number of variables in this scope
     int size;            // Size of scope in bytes
+    int level;           // Level of the objects in this scope
 
-    STScope() : outer(nullptr), locals(nullptr), nVars(0), nPars(0), size(0) {}
+    STScope()
+        : outer(nullptr), locals(nullptr), nVars(0), nPars(0), size(0),
+          level(-1)
+    {
+    }
 };
 
 class SymbolTable
@@ -118,6 +140,7 @@ class SymbolTable
     STScope *topScope;    // Current scope
     STScope *globalScope; // Current scope
     int level;           // (0 = global, 1 >= local)
+    unsigned globalLimit; // Globals from this serial on are not found
     std::vector<STScope *> scopePool;
     std::vector<STObject *> objectPool;
     std::vector<STType *> typePool;
@@ -149,8 +172,17 @@ public:
 
     int getLevel() { return level; }
 
+    // Objects are numbered in the order they are allocated. While a limit
+    // is set, find() does not find the globals numbered from it on, so a
+    // part of the input can be parsed again as if the globals declared
+    // after it were not declared yet. UINT_MAX finds every object.
+    unsigned getNumObjects() { return objectPool.size(); }
+    unsigned getGlobalLimit() { return globalLimit; }
+    void setGlobalLimit(unsigned limit) { globalLimit = limit; }
+
     void openScope(void);
     void closeScope(void);
+    // Make s the current scope, at its level.
     void setTopScope(STScope *s);
     STScope *getTopScope();
 
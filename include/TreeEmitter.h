@@ -0,0 +1,169 @@
+// Tree dump emitters - header file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#ifndef TREE_EMITTER_H
+#define TREE_EMITTER_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace cparser
+{
+
+// Output is collected and written in blocks of about this many bytes.
+#define EMITTER_BUFFER_SIZE (64 * 1024)
+
+// Output format of a tree dump. PrintTreeVisitor describes the tree as a
+// sequence of events: a node begins, it has fields and labeled children, and
+// it ends. An emitter turns the events into one of the formats.
+class TreeEmitter
+{
+    std::ostream &_out;
+
+protected:
+    std::string _buf;
+
+    void flushIfFull()
+    {
+        if (_buf.size() >= EMITTER_BUFFER_SIZE)
+            flush();
+    }
+
+public:
+    TreeEmitter(std::ostream &out) : _out(out) {}
+    virtual ~TreeEmitter() { flush(); }
+
+    // Write out the buffered output.
+    void flush();
+
+    virtual void beginNode(const char *kind) = 0;
+    virtual void endNode() = 0;
+
+    // The next node is the child label of the current node.
+    virtual void child(const char *label) = 0;
+
+    // The next node is the element index of the current list. If the element
+    // is empty, missing() is called instead.
+    virtual void element(unsigned index) = 0;
+    virtual void missing() = 0;
+
+    virtual void stringField(const char *name, const std::string &value) = 0;
+    virtual void intField(const char *name, long value) = 0;
+    virtual void boolField(const char *name, bool value) = 0;
+
+    // Values of a packed array. With asChars they are characters.
+    virtual void intListField(const char *name, const std::vector<int> &values,
+                              bool asChars) = 0;
+
+    // A longer text, such as the body of an asm statement
+    virtual void dataField(const char *name, const std::string &value)
+    {
+        stringField(name, value);
+    }
+};
+
+// The indented text format, one node or field per line
+class TextTreeEmitter : public TreeEmitter
+{
+    int _depth;
+
+    void indent(int depth) { _buf.append(depth * 4, ' '); }
+
+public:
+    TextTreeEmitter(std::ostream &out, int depth = 0)
+        : TreeEmitter(out), _depth(depth)
+    {
+    }
+
+    void beginNode(const char *kind);
+    void endNode() { _depth--; }
+    void child(const char *label);
+    void element(unsigned index);
+    void missing() {}
+    void stringField(const char *name, const std::string &value);
+    void intField(const char *name, long value);
+    void boolField(const char *name, bool value);
+    void intListField(const char *name, const std::vector<int> &values,
+                      bool asChars);
+    void dataField(const char *name, const std::string &value);
+};
+
+// Compact JSON. A node is an object with its kind, fields and children as
+// members, and list elements in the array "elements". Every top-level node
+// is written on a line of its own.
+class JSONTreeEmitter : public TreeEmitter
+{
+    // Nodes that are open, true if the node has an open elements array
+    std::vector<bool> _inElements;
+
+    // A child or an element was announced but no node followed yet. Some
+    // node kinds print nothing, their value is null.
+    bool _valuePending;
+
+    void appendString(const std::string &s);
+    void appendKey(const char *name);
+
+public:
+    JSONTreeEmitter(std::ostream &out) : TreeEmitter(out)
+    {
+        _valuePending = false;
+    }
+
+    void beginNode(const char *kind);
+    void endNode();
+    void child(const char *label);
+    void element(unsigned index);
+    void missing();
+    void stringField(const char *name, const std::string &value);
+    void intField(const char *name, long value);
+    void boolField(const char *name, bool value);
+    void intListField(const char *name, const std::vector<int> &values,
+                      bool asChars);
+};
+
+// Records of the binary format. Every record starts with one of these tags.
+// Integers are little endian, a string is its u32 length and its bytes, and
+// a name is its u16 length and its bytes.
+enum BinaryTreeTag
+{
+    BTT_BEGIN_NODE = 1, // name kind
+    BTT_END_NODE,       //
+    BTT_CHILD,          // name label
+    BTT_ELEMENT,        // u32 index
+    BTT_MISSING,        //
+    BTT_STRING,         // name, string value
+    BTT_INT,            // name, i64 value
+    BTT_BOOL,           // name, u8 value
+    BTT_INT_LIST        // name, u32 count, count i32 values
+};
+
+// Length-prefixed binary records, see BinaryTreeTag
+class BinaryTreeEmitter : public TreeEmitter
+{
+    void appendInt(uint64_t v, unsigned size);
+    void appendName(const char *s);
+
+public:
+    BinaryTreeEmitter(std::ostream &out) : TreeEmitter(out) {}
+
+    void beginNode(const char *kind);
+    void endNode();
+    void child(const char *label);
+    void element(unsigned index);
+    void missing();
+    void stringField(const char *name, const std::string &value);
+    void intField(const char *name, long value);
+    void boolField(const char *name, bool value);
+    void intListField(const char *name, const std::vector<int> &values,
+                      bool asChars);
+};
+
+} // namespace cparser
+
+#endif
@@ -0,0 +1,54 @@
+// Structural tree hashing and diff - header file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#ifndef TREE_HASH_H
+#define TREE_HASH_H
+
+#include "ASTNode.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cparser
+{
+
+// Structural hash of the subtree n. It covers node kinds, flags, the values
+// of identifiers, constants and builtin types, and the hashes of all child
+// slots, but not line numbers, so moving a declaration does not change its
+// hash. Hashes are computed bottom-up and cached in the nodes, so a subtree
+// is hashed only once and must not be modified after that. Type nodes shared
+// by declarations are never modified, see getQualifiedType(), and each
+// declaration holds the flags of its own specifiers.
+uint64_t hashTree(ASTNode *n);
+
+enum DeclChangeKind
+{
+    DECL_ADDED,
+    DECL_REMOVED,
+    DECL_CHANGED
+};
+
+struct DeclChange
+{
+    DeclChangeKind kind;
+    std::string name; // Empty for declarations without a name
+    ASTNode *oldDecl; // NULL_AST_NODE for added declarations
+    ASTNode *newDecl; // NULL_AST_NODE for removed declarations
+};
+
+// Compare the top-level declarations of two translation units. Named
+// declarations are matched by name, in order of appearance, and reported as
+// changed when their hashes differ. Declarations without a name are matched
+// by hash only. Added and changed declarations are reported in the order of
+// newRoot, followed by the removed ones in the order of oldRoot.
+void diffTrees(ASTNode *oldRoot, ASTNode *newRoot,
+               std::vector<DeclChange> &changes);
+
+} // namespace cparser
+
+#endif
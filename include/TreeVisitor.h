@@ -19,11 +19,18 @@ public:
     // Virtual destructor
     virtual ~TreeVisitor() {}
 
+    // Return a fresh visitor that can visit a part of the tree on another
+    // thread, or nullptr if the visitor has to run serially. Clones are
+    // merged back in source order.
+    virtual TreeVisitor *clone() { return nullptr; }
+    virtual void merge(TreeVisitor *v) {}
+
     virtual void visit(IdentASTNode *n);
     virtual void visit(IntegerConstASTNode *n);
     virtual void visit(RealConstASTNode *n);
     virtual void visit(StringConstASTNode *n);
     virtual void visit(CharConstASTNode *n);
+    virtual void visit(PackedConstArrayASTNode *n);
     virtual void visit(SizeOfExprASTNode *n);
     virtual void visit(AlignOfExprASTNode *n);
     virtual void visit(TypeDeclASTNode *n);
@@ -0,0 +1,57 @@
+// Tree walker - header file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#ifndef TREE_WALKER_H
+#define TREE_WALKER_H
+
+#include "ASTNode.h"
+
+#include <vector>
+
+namespace cparser
+{
+
+// Walks a tree with an explicit stack instead of recursing through accept(),
+// so arbitrarily deep trees (long else-if chains, machine generated
+// expressions) can be traversed without running out of stack.
+class TreeWalker
+{
+    struct Frame
+    {
+        ASTNode *node;
+        unsigned depth;
+        bool post; // Children have been pushed already
+    };
+
+    std::vector<Frame> _stack;
+    std::vector<ASTNode *> _children;
+
+public:
+    // Virtual destructor
+    virtual ~TreeWalker() {}
+
+    // Called before the children of n are walked. Returning false skips
+    // the children (postVisit is still called).
+    virtual bool preVisit(ASTNode *n, unsigned depth) { return true; }
+
+    // Called after all the children of n have been walked.
+    virtual void postVisit(ASTNode *n, unsigned depth) {}
+
+    void walk(ASTNode *root);
+
+    // Append the children of n, in source order, to children. Null nodes are
+    // left out.
+    static void getChildren(ASTNode *n, std::vector<ASTNode *> &children);
+
+    // Append every child slot of n, null ones included, in the order the
+    // constructor of the node takes them.
+    static void getSlots(ASTNode *n, std::vector<ASTNode *> &slots);
+};
+
+} // namespace cparser
+
+#endif
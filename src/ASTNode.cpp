@@ -13,6 +13,32 @@ namespace cparser
 
 NullASTNode *NullASTNode::s_instance = 0;
 
+// Nodes released while another node is being deleted. Destructors release
+// their children through DELETE_AST_NODE_REF, which ends up here; queueing
+// the children instead of deleting them keeps the stack flat.
+static thread_local std::vector<ASTNode *> s_pendingNodes;
+static thread_local bool s_destroying = false;
+
+void ASTNode::destroy(ASTNode *n)
+{
+    if (s_destroying)
+    {
+        s_pendingNodes.push_back(n);
+        return;
+    }
+
+    s_destroying = true;
+    delete n;
+    while (!s_pendingNodes.empty())
+    {
+        ASTNode *p = s_pendingNodes.back();
+
+        s_pendingNodes.pop_back();
+        delete p;
+    }
+    s_destroying = false;
+}
+
 void IdentASTNode::accept(TreeVisitor *v) { v->visit(this); }
 
 void IntegerConstASTNode::accept(TreeVisitor *v) { v->visit(this); }
@@ -23,6 +49,8 @@ void StringConstASTNode::accept(TreeVisitor *v) { v->visit(this); }
 
 void CharConstASTNode::accept(TreeVisitor *v) { v->visit(this); }
 
+void PackedConstArrayASTNode::accept(TreeVisitor *v) { v->visit(this); }
+
 void SizeOfExprASTNode::accept(TreeVisitor *v) { v->visit(this); }
 
 void AlignOfExprASTNode::accept(TreeVisitor *v) { v->visit(this); }
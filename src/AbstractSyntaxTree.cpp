@@ -9,12 +9,17 @@
 #include "../include/ASTNode.h"
 #include "../include/PrintTreeVisitor.h"
 #include "../include/TreeVisitor.h"
+#include "../include/TreeWalker.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstdarg>
 #include <cstdio>
 #include <cstring>
 #include <iostream>
 #include <queue>
+#include <thread>
 #include <vector>
 
 namespace cparser
@@ -56,6 +61,210 @@ void AbstractSyntaxTree::visit(TreeVisitor *visitor)
         _stb->setTopScope(nullptr);
 }
 
+ASTNode *AbstractSyntaxTree::getPointerType(ASTNode *baseType, unsigned flags)
+{
+    ASTNode *type;
+
+    if (!isCanonicalType(baseType))
+    {
+        type = new PointerTypeASTNode(baseType);
+        type->setFlags(flags);
+        return type;
+    }
+
+    DerivedTypeKey key = {NK_POINTER_TYPE, baseType, 0, flags};
+    auto it = _derivedTypes.find(key);
+
+    if (it != _derivedTypes.end())
+        return it->second;
+
+    type = new PointerTypeASTNode(baseType);
+    type->setFlags(flags);
+    type->incRefCount();
+    _derivedTypes[key] = type;
+    _canonicalTypes.insert(type);
+    return type;
+}
+
+// Only arrays with a constant number of elements are shared. The size node
+// of a shared array is freed if nobody else holds it.
+ASTNode *AbstractSyntaxTree::getArrayType(ASTNode *elementType, ASTNode *size)
+{
+    ASTNode *type;
+
+    if (!isCanonicalType(elementType) || size->getKind() != NK_INTEGER_CONST)
+        return new ArrayTypeASTNode(elementType, size);
+
+    DerivedTypeKey key = {NK_ARRAY_TYPE, elementType,
+                          static_cast<IntegerConstASTNode *>(size)->getValue(),
+                          0};
+    auto it = _derivedTypes.find(key);
+
+    if (it != _derivedTypes.end())
+    {
+        if (size->getRefCount() == 0)
+            ASTNode::destroy(size);
+        return it->second;
+    }
+
+    type = new ArrayTypeASTNode(elementType, size);
+    type->incRefCount();
+    _derivedTypes[key] = type;
+    _canonicalTypes.insert(type);
+    return type;
+}
+
+ASTNode *AbstractSyntaxTree::getQualifiedType(ASTNode *type, unsigned flags)
+{
+    ASTNode *variant;
+
+    if (type->getFlags() == flags)
+        return type;
+
+    if (!isCanonicalType(type))
+    {
+        type->setFlags(flags);
+        return type;
+    }
+
+    if (type->getKind() == NK_POINTER_TYPE)
+        return getPointerType(
+            static_cast<PointerTypeASTNode *>(type)->getBaseType(), flags);
+
+    // Other variants are keyed by the type they are made from.
+    DerivedTypeKey key = {type->getKind(), type, -1, flags};
+    auto it = _derivedTypes.find(key);
+
+    if (it != _derivedTypes.end())
+        return it->second;
+
+    switch (type->getKind())
+    {
+        case NK_VOID_TYPE:
+            variant = new VoidTypeASTNode();
+            break;
+        case NK_INTEGRAL_TYPE:
+        {
+            IntegralTypeASTNode *t = static_cast<IntegralTypeASTNode *>(type);
+
+            variant =
+                new IntegralTypeASTNode(t->getAlignment(), t->getIsSigned());
+            break;
+        }
+        case NK_REAL_TYPE:
+        {
+            RealTypeASTNode *t = static_cast<RealTypeASTNode *>(type);
+
+            variant = new RealTypeASTNode(t->getAlignment(), t->getIsDouble());
+            break;
+        }
+        case NK_ARRAY_TYPE:
+        {
+            ArrayTypeASTNode *t = static_cast<ArrayTypeASTNode *>(type);
+
+            variant = new ArrayTypeASTNode(t->getElementType(), t->getExpr());
+            break;
+        }
+        default:
+            return type;
+    }
+
+    variant->setFlags(flags);
+    variant->incRefCount();
+    _derivedTypes[key] = variant;
+    _canonicalTypes.insert(variant);
+    return variant;
+}
+
+// Number of top-level declarations handed to a worker at a time.
+#define VISIT_CHUNK_SIZE 16
+
+// Visit the top-level declarations on up to jobs threads. Each chunk of
+// declarations is visited by its own clone of the visitor; the clones are
+// merged back in source order, so the result is the same as in serial mode.
+void AbstractSyntaxTree::visit(TreeVisitor *visitor, unsigned jobs)
+{
+    if (jobs <= 1 || _root->getKind() != NK_LIST)
+    {
+        visit(visitor);
+        return;
+    }
+
+    std::vector<ASTNode *> &elements =
+        static_cast<SequenceASTNode *>(_root)->getElements();
+    unsigned numChunks =
+        (elements.size() + VISIT_CHUNK_SIZE - 1) / VISIT_CHUNK_SIZE;
+    std::vector<TreeVisitor *> clones;
+
+    for (unsigned i = 0; i < numChunks; i++)
+    {
+        TreeVisitor *v = visitor->clone();
+
+        if (v == nullptr)
+            break;
+        clones.push_back(v);
+    }
+
+    if (numChunks <= 1 || clones.size() < numChunks)
+    {
+        for (unsigned i = 0; i < clones.size(); i++)
+            delete clones[i];
+        visit(visitor);
+        return;
+    }
+
+    // Deferred function bodies are parsed here, the parser is not thread
+    // safe.
+    for (unsigned i = 0; i < elements.size(); i++)
+        if (elements[i]->getKind() == NK_FUNCTION_DECL)
+            static_cast<FunctionDeclASTNode *>(elements[i])->materialize();
+
+    _stb->setTopScope(static_cast<SequenceASTNode *>(_root)->getScope());
+
+    std::atomic<unsigned> nextChunk(0);
+    auto worker = [&]() {
+        unsigned c;
+
+        while ((c = nextChunk++) < numChunks)
+        {
+            unsigned end = std::min<unsigned>((c + 1) * VISIT_CHUNK_SIZE,
+                                              elements.size());
+            SequenceASTNode *chunk = new SequenceASTNode();
+
+            for (unsigned i = c * VISIT_CHUNK_SIZE; i < end; i++)
+                chunk->addElement(elements[i]);
+            clones[c]->visit(chunk);
+            ASTNode::destroy(chunk);
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    for (unsigned i = 0; i < jobs && i < numChunks; i++)
+        threads.push_back(std::thread(worker));
+    for (unsigned i = 0; i < threads.size(); i++)
+        threads[i].join();
+
+    _stb->setTopScope(nullptr);
+
+    for (unsigned i = 0; i < numChunks; i++)
+    {
+        visitor->merge(clones[i]);
+        delete clones[i];
+    }
+}
+
+void AbstractSyntaxTree::walk(TreeWalker *walker)
+{
+    if (_root->getKind() == NK_LIST)
+        _stb->setTopScope(static_cast<SequenceASTNode *>(_root)->getScope());
+
+    walker->walk(_root);
+
+    if (_root->getKind() == NK_LIST)
+        _stb->setTopScope(nullptr);
+}
+
 STType *AbstractSyntaxTree::getStbType(ASTNode *typeASTNode)
 {
     switch (typeASTNode->getKind())
@@ -7,6 +7,7 @@
 
 #include "../include/Lexer.h"
 #include "../include/CLexer.h"
+#include "../include/StringInterner.h"
 
 #include <cstdio>
 #include <ctype.h>
@@ -16,6 +17,9 @@
 namespace cparser
 {
 
+TokenMap CLexer::_kwmap;
+TokenMap CLexer::_fstmtmap;
+
 // Search of keyword
 unsigned CLexer::keyword(const char *s)
 {
@@ -45,7 +49,21 @@ void CLexer::readName(Token *t)
         nextCh();
     }
 
+    // Prefixes of wide and Unicode literals are dropped.
+    if ((_ch == '\'' || _ch == '"') &&
+        (t->sval == "L" || t->sval == "u" || t->sval == "U" ||
+         t->sval == "u8"))
+    {
+        if (_ch == '"')
+            readStringLit(t);
+        else
+            readCharLit(t);
+        return;
+    }
+
     t->kind = keyword(t->sval.c_str());
+    if (t->kind == TK_IDENT)
+        t->name = internName(t->sval);
 }
 
 void CLexer::readNumberLit(Token *t)
@@ -62,14 +80,11 @@ void CLexer::readNumberLit(Token *t)
     {
         nextCh();
         hex = true;
-        while (isdigit(_ch) || isHexDigit(_ch))
+        while (isxdigit(_ch))
         {
             buffer[n++] = _ch;
             nextCh();
         }
-        // TODO: Handle this
-        if (_ch == 'L')
-            nextCh();
     }
     else
     {
@@ -96,7 +111,7 @@ void CLexer::readNumberLit(Token *t)
             if (isdigit(buffer[n]))
                 currentDigit = buffer[n] - '0';
             else
-                currentDigit = buffer[n] - '7';
+                currentDigit = toupper(buffer[n]) - '7';
 
             result += currentDigit * powr(16, power);
             power++;
@@ -126,53 +141,49 @@ void CLexer::readNumberLit(Token *t)
             }
             t->info.fval =
                 ((float)t->info.ival) + ((float)mantissa / (float)digitcnt);
+            if (_ch == 'f' || _ch == 'F' || _ch == 'l' || _ch == 'L')
+                nextCh();
+            return;
         }
     }
+
+    // Integer suffixes do not change the value.
+    while (_ch == 'u' || _ch == 'U' || _ch == 'l' || _ch == 'L')
+        nextCh();
 }
 
-// TODO: Handle escape characters like: \", \n, \t, ...
+// Escape sequences are kept as they are written. Adjacent literals are
+// concatenated.
 void CLexer::readStringLit(Token *t)
 {
-    // Skip the "
-    nextCh();
     t->kind = TK_STRING_LIT;
     t->sval.clear();
-    t->sval.push_back(_ch);
-    nextCh();
-
-    while (_ch != '"')
-    {
-        t->sval.push_back(_ch);
-        nextCh();
-    }
-
-    // Skip again the "
-    nextCh();
-
-    bool searchNextStringLit = true;
 
     do
     {
-        while (isspace(_ch))
-            nextCh();
-
-        if (_ch == '"')
+        // Skip the "
+        nextCh();
+        while (_ch != '"' && _ch != EOF)
         {
-            nextCh();
-            while (_ch != '"')
+            if (_ch == '\\')
             {
                 t->sval.push_back(_ch);
                 nextCh();
             }
-            // Skip again the "
+            t->sval.push_back(_ch);
             nextCh();
         }
-        else
-        {
-            searchNextStringLit = false;
-        }
+        // Skip again the "
+        nextCh();
+
+        // The preprocessor concatenates them after macro expansion.
+        if (_preprocessing)
+            return;
+
+        while (isspace(_ch))
+            nextCh();
     }
-    while (searchNextStringLit);
+    while (_ch == '"');
 }
 
 void CLexer::readCharLit(Token *t)
@@ -260,13 +271,122 @@ void CLexer::comment()
     nextCh();
 }
 
-unsigned CLexer::next(Token *t)
+// Line markers of preprocessed input, like # 123 "/usr/include/stdio.h" 3 4
+// or #line 123 "file.c", are recorded in the source manager. Other
+// directives are skipped.
+void CLexer::directive()
 {
-    while (isspace(_ch))
+    std::string name, file;
+    int presumedLine = 0;
+    bool isSystemHeader = false;
+
+    nextCh(); // Eat '#'
+    while (_ch == ' ' || _ch == '\t')
+        nextCh();
+
+    while (isalpha(_ch))
+    {
+        name.push_back(_ch);
         nextCh();
+    }
+
+    if (name.empty() || name == "line")
+    {
+        while (_ch == ' ' || _ch == '\t')
+            nextCh();
+
+        if (isdigit(_ch))
+        {
+            while (isdigit(_ch))
+            {
+                presumedLine = presumedLine * 10 + _ch - '0';
+                nextCh();
+            }
+            while (_ch == ' ' || _ch == '\t')
+                nextCh();
+
+            if (_ch == '"')
+            {
+                nextCh();
+                while (_ch != '"' && _ch != '\n' && _ch != EOF)
+                {
+                    file.push_back(_ch);
+                    nextCh();
+                }
+            }
+
+            // Flags: 1 - enter file, 2 - return to file, 3 - system header,
+            // 4 - implicit extern "C".
+            while (_ch != '\n' && _ch != EOF)
+            {
+                if (_ch == '3')
+                    isSystemHeader = true;
+                nextCh();
+            }
+            if (_ch == '\n')
+                nextCh();
+
+            if (file.empty())
+            {
+                // Line marker without a file name stays in the same file.
+                const char *current = _srcMgr.getPresumedFileName(_line);
+
+                if (current != nullptr)
+                    file = current;
+            }
+            _srcMgr.addLineMarker(_line, presumedLine, file, isSystemHeader);
+            return;
+        }
+    }
+
+    while (_ch != '\n' && _ch != EOF)
+        nextCh();
+}
+
+unsigned CLexer::next(Token *t)
+{
+    if (!_preprocessing)
+    {
+        while (isspace(_ch))
+            nextCh();
+    }
+    else
+    {
+        for (;;)
+        {
+            if (_ch == '\\')
+            {
+                // Lines ending with a backslash are joined.
+                int c = getc(_fp);
+
+                ungetc(c, _fp);
+                if (c != '\n')
+                    break;
+                nextCh();
+            }
+            else if (_ch == '\n')
+            {
+                // The newline is left for the next token.
+                if (_inDirective)
+                    break;
+                _lineStart = true;
+            }
+            else if (!isspace(_ch))
+                break;
+            nextCh();
+        }
+    }
 
     t->line = _line;
     t->col = _col;
+    t->offset = _offset - 1;
+
+    if (_ch == '\n')
+    {
+        _inDirective = false;
+        t->kind = TK_PP_LINE_END;
+        return t->kind;
+    }
 
     if (isalpha(_ch) || _ch == '_')
     {
@@ -287,9 +407,27 @@ unsigned CLexer::next(Token *t)
                 readCharLit(t);
                 break;
             case '#':
-                while (_ch != '\n')
+                if (!_preprocessing)
+                {
+                    directive();
+                    return next(t);
+                }
+                nextCh();
+                if (_ch == '#' && _inDirective)
+                {
                     nextCh();
-                return next(t);
+                    t->kind = TK_HASHHASH;
+                }
+                else if (_lineStart && !_inDirective)
+                {
+                    _inDirective = true;
+                    t->kind = TK_PP_DIRECTIVE;
+                }
+                else
+                {
+                    t->kind = TK_HASH;
+                }
+                break;
             case '&':
                 nextCh();
                 if (_ch == '&')
@@ -423,7 +561,7 @@ unsigned CLexer::next(Token *t)
                 nextCh();
                 if (_ch == '/')
                 {
-                    while (_ch != '\n')
+                    while (_ch != '\n' && _ch != EOF)
                         nextCh();
                     return next(t);
                 }
@@ -559,7 +697,15 @@ unsigned CLexer::next(Token *t)
                     t->kind = TK_PERIOD;
                 break;
             case EOF:
-                t->kind = TK_EOF;
+                if (_inDirective)
+                {
+                    _inDirective = false;
+                    t->kind = TK_PP_LINE_END;
+                }
+                else
+                {
+                    t->kind = TK_EOF;
+                }
                 break;
             default:
                 nextCh();
@@ -568,11 +714,82 @@ unsigned CLexer::next(Token *t)
         }
     }
 
+    _lineStart = false;
     return t->kind;
 }
 
+void CLexer::skipLiteral(int quote)
+{
+    nextCh();
+    while (_ch != quote && _ch != '\n' && _ch != EOF)
+    {
+        if (_ch == '\\')
+            nextCh();
+        if (_ch != EOF)
+            nextCh();
+    }
+    if (_ch == quote)
+        nextCh();
+}
+
+void CLexer::skipLine()
+{
+    while (_ch != '\n' && _ch != EOF)
+    {
+        switch (_ch)
+        {
+            case '\\':
+                nextCh();
+                if (_ch == '\n')
+                    nextCh();
+                break;
+            case '"':
+            case '\'':
+                skipLiteral(_ch);
+                break;
+            case '/':
+                nextCh();
+                if (_ch == '*')
+                    comment();
+                else if (_ch == '/')
+                    while (_ch != '\n' && _ch != EOF)
+                        nextCh();
+                break;
+            default:
+                nextCh();
+                break;
+        }
+    }
+    _inDirective = false;
+}
+
+bool CLexer::skipGroup()
+{
+    for (;;)
+    {
+        while (_ch == ' ' || _ch == '\t' || _ch == '\r' || _ch == '\f' ||
+               _ch == '\v')
+            nextCh();
+
+        if (_ch == '#')
+        {
+            _lineStart = true;
+            return true;
+        }
+        if (_ch == EOF)
+            return false;
+
+        skipLine();
+        if (_ch == '\n')
+            nextCh();
+    }
+}
+
 void CLexer::initialize()
 {
+    if (!_kwmap.empty())
+        return;
+
     // Insert reserved words
     INSERT_KEYWORD("_Alignas", TK__ALIGNAS);
     INSERT_KEYWORD("_Alignof", TK__ALIGNOF);
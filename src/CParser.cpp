@@ -8,8 +8,12 @@
 #include "../include/Parser.h"
 #include "../include/CParser.h"
 #include "../include/AbstractSyntaxTree.h"
+#include "../include/ConstEval.h"
 #include "../include/Lexer.h"
+#include "../include/PrecompiledHeader.h"
+#include "../include/RecordLayout.h"
 #include <cassert>
+#include <cstring>
 #include <iostream>
 #include <stack>
 
@@ -49,12 +53,21 @@ bool CParser::isStorageClassSpecifier(unsigned kind)
            kind == TK_AUTO || kind == TK_REGISTER;
 }
 
+// Is the lookahead token in a region of a system or ignored header?
+bool CParser::isInSystemHeader()
+{
+    return _lex->getSourceManager()->isSystemHeader(_tokbuf[_laIdx].line);
+}
+
 //
 // Initialization
 //
 
 void CParser::initNames()
 {
+    if (!_name.empty())
+        return;
+
     _name.insert(std::make_pair(TK_UNKNOWN, "unknown"));
     _name.insert(std::make_pair(TK_IDENT, "identifier"));
     _name.insert(std::make_pair(TK_INT_LIT, "integer constant"));
@@ -150,7 +163,7 @@ void CParser::parse(const char *output)
     ASTNode *tree;
     // int errors;
 
-    _lex->nextCh();
+    _lex->start();
     initTokenBuffer();
 
     tree = TranslationUnit();
@@ -203,6 +216,7 @@ ASTNode *CParser::PrimaryExpression()
     {
         getTok();
         res = new IdentASTNode(_tok->sval, _tok->line);
+        referenceName(_sym == TK_LPAR ? REF_CALL : REF_USE);
     }
     else if (_sym == TK_INT_LIT)
     {
@@ -233,6 +247,7 @@ ASTNode *CParser::PrimaryExpression()
             getTok();
             check(TK_IDENT);
             res = new IdentASTNode(_tok->sval, _tok->line);
+            referenceName(REF_USE);
         }
         else
         {
@@ -313,7 +328,9 @@ ASTNode *CParser::parsePostfixExpression(ASTNode *expr)
 
         getTok();
         check(TK_IDENT);
+        addMemberName();
         tmp = new IdentASTNode(_tok->sval, _tok->line);
+        // Resolved with the access this one is the member of.
         return new StructRefASTNode(expr, parsePostfixExpression(tmp));
     }
     else if (_sym == TK_PTR_OP)
@@ -322,6 +339,7 @@ ASTNode *CParser::parsePostfixExpression(ASTNode *expr)
 
         getTok();
         check(TK_IDENT);
+        addMemberName();
         tmp = new IdentASTNode(_tok->sval, _tok->line);
         return new IndirectRefASTNode(NULL_AST_NODE, expr,
                                       parsePostfixExpression(tmp));
@@ -336,6 +354,7 @@ ASTNode *CParser::PostfixExpression(ASTNode *typeName)
 {
     ASTNode *index = NULL_AST_NODE;
     ASTNode *expr = PrimaryExpression();
+    RecordRef object;
 
     for (;;)
     {
@@ -360,21 +379,31 @@ ASTNode *CParser::PostfixExpression(ASTNode *typeName)
         else if (_sym == TK_PERIOD)
         {
             ASTNode *tmp;
+            size_t first = _members.size();
 
             getTok();
             check(TK_IDENT);
+            addMemberName();
             tmp = new IdentASTNode(_tok->sval, _tok->line);
+            object = getExpressionRecord(expr);
             expr = new StructRefASTNode(expr, parsePostfixExpression(tmp));
+            resolveMember(expr, object);
+            reportMembers(expr, first);
         }
         else if (_sym == TK_PTR_OP)
         { // '->'
             ASTNode *tmp;
+            size_t first = _members.size();
 
             getTok();
             check(TK_IDENT);
+            addMemberName();
             tmp = new IdentASTNode(_tok->sval, _tok->line);
+            object = getExpressionRecord(expr);
             expr = new IndirectRefASTNode(NULL_AST_NODE, expr,
                                           parsePostfixExpression(tmp));
+            resolveMember(expr, object);
+            reportMembers(expr, first);
         }
         else if (_sym == TK_INC_OP)
         { // '++'
@@ -441,7 +470,7 @@ ASTNode *CParser::UnaryExpression(ASTNode *typeName)
 
         if (kind == NK_INDIRECT_REF || kind == NK_ADDR_EXPR)
         {
-            type = new PointerTypeASTNode(_ast->integerTypeASTNode);
+            type = _ast->getPointerType(_ast->integerTypeASTNode);
 
             if (kind == NK_ADDR_EXPR)
                 res = new AddrExprASTNode(type, CastExpression());
@@ -470,7 +499,7 @@ ASTNode *CParser::UnaryExpression(ASTNode *typeName)
             if (_sym == TK_TIMES)
             {
                 getTok();
-                expr = new PointerTypeASTNode(expr);
+                expr = _ast->getPointerType(expr);
             }
             check(TK_RPAR);
         }
@@ -543,7 +572,7 @@ ASTNode *CParser::CastExpression()
     if (cast)
     {
         if (isPtrType)
-            typeName = new PointerTypeASTNode(typeName);
+            typeName = _ast->getPointerType(typeName);
 
         return new CastExprASTNode(typeName, expr);
     }
@@ -553,232 +582,98 @@ ASTNode *CParser::CastExpression()
     }
 }
 
-ASTNode *CParser::MultiplicativeExpression()
-{
-    ASTNode *res = CastExpression();
-
-    for (;;)
-    {
-        if (_sym == TK_TIMES)
-        {
-            getTok();
-            res = AST_MULT(_ast->integerTypeASTNode, res, CastExpression());
-        }
-        else if (_sym == TK_DIV)
-        {
-            getTok();
-            res = new TruncDivExprASTNode(_ast->integerTypeASTNode, res,
-                                          CastExpression());
-        }
-        else if (_sym == TK_MOD)
-        {
-            getTok();
-            res = new TruncModExprASTNode(_ast->integerTypeASTNode, res,
-                                          CastExpression());
-        }
-        else
-        {
-            break;
-        }
-    }
-
-    res->setLineNum(_tok->line);
-    return res;
-}
-
-ASTNode *CParser::AdditiveExpression()
-{
-    ASTNode *res = MultiplicativeExpression();
-
-    for (;;)
-    {
-        if (_sym == TK_PLUS)
-        {
-            getTok();
-            res = AST_PLUS(_ast->integerTypeASTNode, res,
-                           MultiplicativeExpression());
-        }
-        else if (_sym == TK_MINUS)
-        {
-            getTok();
-            res = AST_MINUS(_ast->integerTypeASTNode, res,
-                            MultiplicativeExpression());
-        }
-        else
-        {
-            break;
-        }
-    }
-    res->setLineNum(_tok->line);
-
-    return res;
-}
-
-ASTNode *CParser::ShiftExpression()
-{
-    ASTNode *res = AdditiveExpression();
-
-    for (;;)
-    {
-        if (_sym == TK_LSHIFT_OP)
-        {
-            getTok();
-            res = new LShiftExprASTNode(_ast->integerTypeASTNode, res,
-                                        AdditiveExpression());
-        }
-        else if (_sym == TK_RSHIFT_OP)
-        {
-            getTok();
-            res = new RShiftExprASTNode(_ast->integerTypeASTNode, res,
-                                        AdditiveExpression());
-        }
-        else
-        {
-            break;
-        }
-    }
-    res->setLineNum(_tok->line);
-
-    return res;
-}
-
-ASTNode *CParser::RelationalExpression()
-{
-    ASTNode *res = ShiftExpression();
-
-    for (;;)
-    {
-        if (_sym == TK_LSS)
-        {
-            getTok();
-            res = new LtExprASTNode(_ast->integerTypeASTNode, res,
-                                    ShiftExpression());
-        }
-        else if (_sym == TK_GTR)
-        {
-            getTok();
-            res = new GtExprASTNode(_ast->integerTypeASTNode, res,
-                                    ShiftExpression());
-        }
-        else if (_sym == TK_LEQ)
-        {
-            getTok();
-            res = new LeExprASTNode(_ast->integerTypeASTNode, res,
-                                    ShiftExpression());
-        }
-        else if (_sym == TK_GEQ)
-        {
-            getTok();
-            res = new GeExprASTNode(_ast->integerTypeASTNode, res,
-                                    ShiftExpression());
-        }
-        else
-        {
-            break;
-        }
-    }
-    res->setLineNum(_tok->line);
-
-    return res;
-}
-
-ASTNode *CParser::EqualityExpression()
-{
-    ASTNode *res = RelationalExpression();
-
-    for (;;)
-    {
-        if (_sym == TK_EQL)
-        {
-            getTok();
-            res = new EqExprASTNode(_ast->integerTypeASTNode, res,
-                                    RelationalExpression());
-        }
-        else if (_sym == TK_NEQ)
-        {
-            getTok();
-            res = new NeExprASTNode(_ast->integerTypeASTNode, res,
-                                    RelationalExpression());
-        }
-        else
-        {
-            break;
-        }
-    }
-    res->setLineNum(_tok->line);
-
-    return res;
-}
-
-ASTNode *CParser::AndExpression()
-{
-    ASTNode *res = EqualityExpression();
-
-    while (_sym == TK_AND)
-    {
-        getTok();
-        res = new BitAndExprASTNode(_ast->integerTypeASTNode, res,
-                                    EqualityExpression());
-    }
-    res->setLineNum(_tok->line);
-
-    return res;
-}
-
-ASTNode *CParser::ExclusiveOrExpression()
-{
-    ASTNode *res = AndExpression();
-
-    while (_sym == TK_EXCLUSIVE_OR)
-    {
-        getTok();
-        res = new BitXorExprASTNode(_ast->integerTypeASTNode, res,
-                                    AndExpression());
-    }
-    res->setLineNum(_tok->line);
-
-    return res;
-}
-
-ASTNode *CParser::InclusiveOrExpression()
-{
-    ASTNode *res = ExclusiveOrExpression();
-
-    while (_sym == TK_OR)
-    {
-        getTok();
-        res = new BitIorExprASTNode(_ast->integerTypeASTNode, res,
-                                    ExclusiveOrExpression());
+//-----------------------------------------------------------------------------+
+//  Binary operators are parsed by precedence climbing instead of one rule     |
+//  per precedence level. Operands are cast expressions; an operator with      |
+//  precedence p takes a right operand of precedence p + 1, which makes all    |
+//  binary operators left associative.                                         |
+//-----------------------------------------------------------------------------+
+void CParser::initBinaryOperators()
+{
+    for (unsigned i = 0; i <= TK_EOF; i++)
+    {
+        _binOp[i].prec = PREC_NONE;
+        _binOp[i].kind = NK_UNKNOWN;
+    }
+
+    INSERT_BINARY_OPERATOR(TK_LOGICAL_OR, PREC_LOGICAL_OR, NK_LOG_OR_EXPR);
+    INSERT_BINARY_OPERATOR(TK_LOGICAL_AND, PREC_LOGICAL_AND, NK_LOG_AND_EXPR);
+    INSERT_BINARY_OPERATOR(TK_OR, PREC_INCLUSIVE_OR, NK_BIT_IOR_EXPR);
+    INSERT_BINARY_OPERATOR(TK_EXCLUSIVE_OR, PREC_EXCLUSIVE_OR, NK_BIT_XOR_EXPR);
+    INSERT_BINARY_OPERATOR(TK_AND, PREC_AND, NK_BIT_AND_EXPR);
+    INSERT_BINARY_OPERATOR(TK_EQL, PREC_EQUALITY, NK_EQ_EXPR);
+    INSERT_BINARY_OPERATOR(TK_NEQ, PREC_EQUALITY, NK_NE_EXPR);
+    INSERT_BINARY_OPERATOR(TK_LSS, PREC_RELATIONAL, NK_LT_EXPR);
+    INSERT_BINARY_OPERATOR(TK_GTR, PREC_RELATIONAL, NK_GT_EXPR);
+    INSERT_BINARY_OPERATOR(TK_LEQ, PREC_RELATIONAL, NK_LE_EXPR);
+    INSERT_BINARY_OPERATOR(TK_GEQ, PREC_RELATIONAL, NK_GE_EXPR);
+    INSERT_BINARY_OPERATOR(TK_LSHIFT_OP, PREC_SHIFT, NK_LSHIFT_EXPR);
+    INSERT_BINARY_OPERATOR(TK_RSHIFT_OP, PREC_SHIFT, NK_RSHIFT_EXPR);
+    INSERT_BINARY_OPERATOR(TK_PLUS, PREC_ADDITIVE, NK_PLUS_EXPR);
+    INSERT_BINARY_OPERATOR(TK_MINUS, PREC_ADDITIVE, NK_MINUS_EXPR);
+    INSERT_BINARY_OPERATOR(TK_TIMES, PREC_MULTIPLICATIVE, NK_MULT_EXPR);
+    INSERT_BINARY_OPERATOR(TK_DIV, PREC_MULTIPLICATIVE, NK_TRUNC_DIV_EXPR);
+    INSERT_BINARY_OPERATOR(TK_MOD, PREC_MULTIPLICATIVE, NK_TRUNC_MOD_EXPR);
+}
+
+ASTNode *CParser::createBinaryExpr(ASTNodeKind kind, ASTNode *lhs, ASTNode *rhs)
+{
+    ASTNode *type = _ast->integerTypeASTNode;
+
+    switch (kind)
+    {
+        case NK_MULT_EXPR:
+            return AST_MULT(type, lhs, rhs);
+        case NK_TRUNC_DIV_EXPR:
+            return new TruncDivExprASTNode(type, lhs, rhs);
+        case NK_TRUNC_MOD_EXPR:
+            return new TruncModExprASTNode(type, lhs, rhs);
+        case NK_PLUS_EXPR:
+            return AST_PLUS(type, lhs, rhs);
+        case NK_MINUS_EXPR:
+            return AST_MINUS(type, lhs, rhs);
+        case NK_LSHIFT_EXPR:
+            return new LShiftExprASTNode(type, lhs, rhs);
+        case NK_RSHIFT_EXPR:
+            return new RShiftExprASTNode(type, lhs, rhs);
+        case NK_LT_EXPR:
+            return new LtExprASTNode(type, lhs, rhs);
+        case NK_GT_EXPR:
+            return new GtExprASTNode(type, lhs, rhs);
+        case NK_LE_EXPR:
+            return new LeExprASTNode(type, lhs, rhs);
+        case NK_GE_EXPR:
+            return new GeExprASTNode(type, lhs, rhs);
+        case NK_EQ_EXPR:
+            return new EqExprASTNode(type, lhs, rhs);
+        case NK_NE_EXPR:
+            return new NeExprASTNode(type, lhs, rhs);
+        case NK_BIT_AND_EXPR:
+            return new BitAndExprASTNode(type, lhs, rhs);
+        case NK_BIT_XOR_EXPR:
+            return new BitXorExprASTNode(type, lhs, rhs);
+        case NK_BIT_IOR_EXPR:
+            return new BitIorExprASTNode(type, lhs, rhs);
+        case NK_LOG_AND_EXPR:
+            return new LogAndExprASTNode(type, lhs, rhs);
+        case NK_LOG_OR_EXPR:
+            return new LogOrExprASTNode(type, lhs, rhs);
+        default:
+            assert(false && "not a binary operator");
+            return NULL_AST_NODE;
     }
-    res->setLineNum(_tok->line);
-
-    return res;
 }
 
-ASTNode *CParser::LogicalAndExpression()
+ASTNode *CParser::BinaryExpression(unsigned minPrec)
 {
-    ASTNode *res = InclusiveOrExpression();
+    ASTNode *res = CastExpression();
 
-    while (_sym == TK_LOGICAL_AND)
+    while (_binOp[_sym].prec >= minPrec)
     {
-        getTok();
-        res = new LogAndExprASTNode(_ast->integerTypeASTNode, res,
-                                    InclusiveOrExpression());
-    }
-    res->setLineNum(_tok->line);
-
-    return res;
-}
-
-ASTNode *CParser::LogicalOrExpression()
-{
-    ASTNode *res = LogicalAndExpression();
+        const BinaryOperator &op = _binOp[_sym];
 
-    while (_sym == TK_LOGICAL_OR)
-    {
         getTok();
-        res = new LogOrExprASTNode(_ast->integerTypeASTNode, res,
-                                   LogicalAndExpression());
+        res = createBinaryExpr(op.kind, res, BinaryExpression(op.prec + 1));
     }
     res->setLineNum(_tok->line);
 
@@ -788,7 +683,7 @@ ASTNode *CParser::LogicalOrExpression()
 ASTNode *CParser::ConditionalExpression()
 {
     ASTNode *expr = NULL_AST_NODE;
-    ASTNode *res = LogicalOrExpression();
+    ASTNode *res = BinaryExpression(PREC_LOGICAL_OR);
 
     if (_sym == TK_COND_OP)
     {
@@ -929,7 +824,9 @@ ASTNode *CParser::DeclarationSpecifiers()
         else if (isTypeSpecifier(_sym, 1))
         {
             declSpec = TypeSpecifier();
-            declSpec->setFlags(flags);
+            // The null node is shared by every tree, even across threads.
+            if (declSpec != NULL_AST_NODE)
+                declSpec = _ast->getQualifiedType(declSpec, flags);
         }
         // else if (isTypeSpecifier(_sym, 1))
         // {
@@ -938,7 +835,7 @@ ASTNode *CParser::DeclarationSpecifiers()
         else if (_sym == TK_TIMES) // ??? TODO: Check grammar ???
         {
             getTok();
-            declSpec = new PointerTypeASTNode(declSpec);
+            declSpec = _ast->getPointerType(declSpec);
             if (isTypeQualifier(_sym))
             {
                 TypeQualifier(flags);
@@ -978,7 +875,12 @@ SequenceASTNode *CParser::InitDeclaratorList(ASTNode *typeSpec)
 ASTNode *CParser::InitDeclarator(ASTNode *typeSpec)
 {
     ASTNode *init = NULL_AST_NODE;
-    VarDeclASTNode *declr = new VarDeclASTNode(typeSpec, Declarator(typeSpec));
+    unsigned flags = typeSpec->getFlags();
+    // The declarator adds its pointers and arrays to typeSpec.
+    ASTNode *name = Declarator(typeSpec);
+    VarDeclASTNode *declr = new VarDeclASTNode(typeSpec, name);
+
+    declr->setFlags(flags);
 
     if (_sym == TK_ASSIGN)
     {
@@ -991,6 +893,8 @@ ASTNode *CParser::InitDeclarator(ASTNode *typeSpec)
         // }
         declr->setInit(init);
     }
+    declareVariable(name, typeSpec, flags, init != NULL_AST_NODE);
+    declareLocal(name, typeSpec, flags);
 
     return declr;
 }
@@ -1069,9 +973,8 @@ stbTypeToASTNodeType(AbstractSyntaxTree *ast, STType *type, const char *objName)
         case STTK_REAL:
             return NULL_AST_NODE;
         case STTK_POINTER:
-            return new PointerTypeASTNode(stbTypeToASTNodeType(ast,
-                                                               type->baseType,
-                                                               objName));
+            return ast->getPointerType(
+                stbTypeToASTNodeType(ast, type->baseType, objName));
         case STTK_ENUM:
             return NULL_AST_NODE;
         case STTK_FUNCTION:
@@ -1142,7 +1045,11 @@ ASTNode *CParser::TypeSpecifier()
 
         obj = _stb.find(_tok->sval.c_str());
         if (obj != _stb.noObj)
+        {
+            if (obj->level == 0)
+                addReference(REF_TYPE, obj->name);
             return stbTypeToASTNodeType(_ast, obj->type, obj->name);
+        }
 
         sprintf(msg, "unknown type '%s'", obj->name);
         parsingError(msg);
@@ -1158,29 +1065,27 @@ ASTNode *CParser::StructOrUnionSpecifier()
     ASTNode *typeName = NULL_AST_NODE;
     ASTNode *typeBody = NULL_AST_NODE;
     STObject *obj = nullptr;
+    STType *recordType = nullptr;
     ASTNodeKind typeKind;
+    STTypeKind recordKind;
 
     if (_sym == TK_STRUCT)
     {
         getTok();
         typeKind = NK_STRUCT_TYPE;
+        recordKind = STTK_STRUCT;
     }
     else
     { // _sym == UNION
         getTok();
         typeKind = NK_UNION_TYPE;
+        recordKind = STTK_UNION;
     }
 
     if (_sym == TK_IDENT)
     {
-        STType *recordType;
-
         getTok();
         typeName = new IdentASTNode(_tok->sval, _tok->line);
-        if (typeKind == NK_STRUCT_TYPE)
-            recordType = _stb.allocType(STTK_STRUCT);
-        else
-            recordType = _stb.allocType(STTK_UNION);
         obj = _stb.find(_tok->sval.c_str());
         // if (obj != _stb.noObj && obj->type->fields != NULL)
         // {
@@ -1190,40 +1095,46 @@ ASTNode *CParser::StructOrUnionSpecifier()
         // }
         // else
         if (obj == _stb.noObj)
-            obj = _stb.insert(_tok->sval.c_str(), STOK_TYPE, recordType);
+        {
+            obj = _stb.insert(_tok->sval.c_str(), STOK_TYPE,
+                              _stb.allocType(recordKind));
+            obj->type->name = obj->name;
+        }
+        if (obj->kind == STOK_TYPE)
+            locateGlobal(obj, _tok->line, _sym == TK_LBRACE);
+        if (obj->kind == STOK_TYPE && obj->level == 0 && _sym != TK_LBRACE)
+            addReference(REF_TYPE, obj->name);
+        recordType = obj->type;
     }
     if (_sym == TK_LBRACE)
     {
         getTok();
         _stb.openScope();
         typeBody = StructDeclarationList();
-        // FIXME: What if we have anonymous struct type?
-        if (obj != nullptr)
-        {
-            if (typeKind == NK_UNION_TYPE)
-            {
-                STObject *tmp = _stb.getTopScope()->locals;
-                unsigned maxFieldTypeSize = 0;
-
-                while (tmp != nullptr)
-                {
-                    if (maxFieldTypeSize < tmp->type->size)
-                        maxFieldTypeSize = tmp->type->size;
-                    tmp = tmp->next;
-                }
-                _stb.getTopScope()->size = maxFieldTypeSize;
-            }
-            obj->type->fields = _stb.getTopScope()->locals;
-            obj->type->size = _stb.getTopScope()->size;
-        }
+        // Anonymous records get a type of their own to hold the layout.
+        if (recordType == nullptr)
+            recordType = _stb.allocType(recordKind);
+        delete recordType->layout;
+        recordType->layout =
+            new RecordLayout(typeBody, typeKind == NK_UNION_TYPE);
+        recordType->fields = _stb.getTopScope()->locals;
+        recordType->size = recordType->layout->getSize();
         _stb.closeScope();
         check(TK_RBRACE);
     }
     if (typeKind == NK_STRUCT_TYPE)
+    {
         // return _ast->createStructTypeASTNode(typeName, typeBody);
-        return new StructTypeASTNode(typeName, typeBody);
+        StructTypeASTNode *type = new StructTypeASTNode(typeName, typeBody);
+        type->setRecordType(recordType);
+        return type;
+    }
     else
-        return new UnionTypeASTNode(typeName, typeBody);
+    {
+        UnionTypeASTNode *type = new UnionTypeASTNode(typeName, typeBody);
+        type->setRecordType(recordType);
+        return type;
+    }
 }
 
 SequenceASTNode *CParser::StructDeclarationList()
@@ -1240,7 +1151,14 @@ ASTNode *CParser::StructDeclaration()
 {
     //ASTNode *typeSpec = TypeSpecifier();
     ASTNode *typeSpec = SpecifierQualifierList();
-    SequenceASTNode *declaratorList = StructDeclaratorList(typeSpec);
+    SequenceASTNode *declaratorList;
+
+    // A nested struct or union without a declarator is an anonymous member.
+    if (_sym == TK_SEMICOLON)
+        declaratorList =
+            new SequenceASTNode(new FieldDeclASTNode(typeSpec, NULL_AST_NODE));
+    else
+        declaratorList = StructDeclaratorList(typeSpec);
 
     // declaratorList->declare(_ast);
     check(TK_SEMICOLON);
@@ -1273,7 +1191,27 @@ SequenceASTNode *CParser::StructDeclaratorList(ASTNode *typeSpec)
 
 ASTNode *CParser::StructDeclarator(ASTNode *typeSpec)
 {
-    return new FieldDeclASTNode(typeSpec, Declarator(typeSpec));
+    ASTNode *name = NULL_AST_NODE;
+    ASTNode *bitWidth = NULL_AST_NODE;
+
+    // The declarator of a bit-field can be left out.
+    if (_sym != TK_COLON)
+    {
+        _inField = true;
+        name = Declarator(typeSpec);
+        _inField = false;
+    }
+
+    if (_sym == TK_COLON)
+    {
+        int64_t width;
+
+        getTok();
+        bitWidth = ConstantExpression();
+        evaluateConstant(bitWidth, width, &_stb);
+    }
+
+    return new FieldDeclASTNode(typeSpec, name, bitWidth);
 }
 
 ASTNode *CParser::EnumSpecifier()
@@ -1286,11 +1224,20 @@ ASTNode *CParser::EnumSpecifier()
     if (_sym == TK_IDENT)
     {
         STType *enumType;
+        STObject *obj;
 
         getTok();
         name = new IdentASTNode(_tok->sval);
         enumType = _stb.allocType(STTK_ENUM);
-        _stb.insert(_tok->sval.c_str(), STOK_TYPE, enumType);
+        obj = _stb.insert(_tok->sval.c_str(), STOK_TYPE, enumType);
+        if (obj == _stb.noObj)
+            obj = _stb.find(_tok->sval.c_str());
+        else
+            enumType->name = obj->name;
+        if (obj->kind == STOK_TYPE)
+            locateGlobal(obj, _tok->line, _sym == TK_LBRACE);
+        if (obj->kind == STOK_TYPE && obj->level == 0 && _sym != TK_LBRACE)
+            addReference(REF_TYPE, obj->name);
     }
 
     if (_sym == TK_LBRACE)
@@ -1305,37 +1252,39 @@ ASTNode *CParser::EnumSpecifier()
 
 SequenceASTNode *CParser::EnumeratorList()
 {
-    SequenceASTNode *enums;
+    SequenceASTNode *enums = nullptr;
     STObject *obj;
-    unsigned i = 0;
-
-    check(TK_IDENT);
-    enums = new SequenceASTNode(new IdentASTNode(_tok->sval));
-
-    obj = _stb.insert(_tok->sval.c_str(), STOK_CON, _stb.intType);
-    obj->ival = i;
+    int64_t value = 0;
 
-    if (_sym == TK_ASSIGN)
-    {
-        getTok();
-        ConstantExpression();
-    }
-
-    while (_sym == TK_COMMA)
+    for (;;)
     {
-        getTok();
         check(TK_IDENT);
-        enums->add(new IdentASTNode(_tok->sval));
+        if (enums == nullptr)
+            enums = new SequenceASTNode(new IdentASTNode(_tok->sval));
+        else
+            enums->add(new IdentASTNode(_tok->sval));
 
-        i++;
         obj = _stb.insert(_tok->sval.c_str(), STOK_CON, _stb.intType);
-        obj->ival = i;
 
+        // Without a usable value the enumerator follows the previous one.
         if (_sym == TK_ASSIGN)
         {
+            ASTNode *expr;
+            int64_t v;
+
             getTok();
-            ConstantExpression();
+            expr = ConstantExpression();
+            if (evaluateConstant(expr, v, &_stb))
+                value = v;
+            // The tree keeps only the names of the enumerators.
+            if (expr != NULL_AST_NODE && expr->getRefCount() == 0)
+                ASTNode::destroy(expr);
         }
+        obj->ival = value++;
+
+        if (_sym != TK_COMMA)
+            break;
+        getTok();
     }
 
     return enums;
@@ -1419,8 +1368,7 @@ ASTNode *CParser::Declarator(ASTNode * &typeSpec)
 
         // Flags needs to be preserved
         flags = typeSpec->getFlags();
-        typeSpec = new PointerTypeASTNode(typeSpec);
-        typeSpec->setFlags(flags);
+        typeSpec = _ast->getPointerType(typeSpec, flags);
     }
 
     ASTNode *decl = DirectDeclarator(typeSpec);
@@ -1461,7 +1409,7 @@ ASTNode *CParser::DirectDeclarator(ASTNode * &typeSpec)
             isFuncPtr = true;
             // FIXME: Make this direct type without T_POINTER.
             funcType = new FunctionTypeASTNode(typeSpec, NULL_AST_NODE);
-            typeSpec = new PointerTypeASTNode(funcType);
+            typeSpec = _ast->getPointerType(funcType);
         }
         ASTNode *dummy = NULL_AST_NODE;
         declr = Declarator(dummy);
@@ -1475,13 +1423,23 @@ ASTNode *CParser::DirectDeclarator(ASTNode * &typeSpec)
 
             if (_sym != TK_RBRACK)
             {
+                int64_t length;
+
                 expr = Expression();
-                typeSpec = new ArrayTypeASTNode(typeSpec, expr);
+                // Evaluated while the enumeration constants are in scope,
+                // for getTypeLayout().
+                evaluateConstant(expr, length, &_stb);
+                typeSpec = _ast->getArrayType(typeSpec, expr);
+            }
+            else if (_inField)
+            {
+                // A flexible array member, see getTypeLayout()
+                typeSpec = new ArrayTypeASTNode(typeSpec, NULL_AST_NODE);
             }
             else
             {
                 // Declarations like int a[] are treated as a pointers.
-                typeSpec = new PointerTypeASTNode(typeSpec);
+                typeSpec = _ast->getPointerType(typeSpec);
             }
             check(TK_RBRACK);
         }
@@ -1751,13 +1709,47 @@ ASTNode *CParser::Initializer()
     return res;
 }
 
+// A list of plain integer or character literals is read straight from the
+// tokens into a PackedConstArrayASTNode. If some element turns out to be
+// anything else, the values read so far become ordinary constant nodes.
 ASTNode *CParser::InitializerList()
 {
     SequenceASTNode *res;
     ASTNode *init;
 
+    if (_sym == TK_INT_LIT || _sym == TK_CHAR_LIT)
+    {
+        unsigned lit = _sym;
+        ASTNodeKind kind =
+            lit == TK_INT_LIT ? NK_INTEGER_CONST : NK_CHAR_CONST;
+        std::vector<int> values;
+
+        while (_sym == lit &&
+               (getLATok(2) == TK_COMMA || getLATok(2) == TK_RBRACE))
+        {
+            getTok();
+            values.push_back(_tok->info.ival);
+            if (_sym == TK_RBRACE)
+                return new PackedConstArrayASTNode(kind, values);
+            getTok();
+        }
+
+        res = new SequenceASTNode();
+        for (unsigned i = 0; i < values.size(); i++)
+        {
+            if (kind == NK_INTEGER_CONST)
+                res->add(new IntegerConstASTNode(values[i]));
+            else
+                res->add(new CharConstASTNode(values[i]));
+        }
+    }
+    else
+    {
+        res = new SequenceASTNode();
+    }
+
     init = Initializer();
-    res = new SequenceASTNode(init);
+    res->add(init);
 
     while (_sym == TK_COMMA)
     {
@@ -1895,6 +1887,10 @@ ASTNode *CParser::LabeledStatement()
     {
         getTok();
         ASTNode *expr = ConstantExpression();
+        int64_t value;
+
+        // The value stays cached in expr for later passes.
+        evaluateConstant(expr, value, &_stb);
         check(TK_COLON);
         ASTNode *stmt = Statement();
         labstmt = new CaseLabelASTNode(expr, stmt);
@@ -1912,11 +1908,14 @@ ASTNode *CParser::LabeledStatement()
 ASTNode *CParser::CompoundStatement()
 {
     ASTNode *compstmt = NULL_AST_NODE;
+    size_t nLocals = _locals.size();
 
     check(TK_LBRACE);
     if (_sym != TK_RBRACE)
         compstmt = StmtOrDeclList();
     check(TK_RBRACE);
+    // The variables of the block go out of scope.
+    _locals.resize(nLocals);
 
     return compstmt;
 }
@@ -1950,6 +1949,7 @@ ASTNode *CParser::FunctionBody()
             {
                 _inTypedef = false;
                 decl = new TypeDeclASTNode(Declarator(declSpec), declSpec);
+                decl->setFlags(declSpec->getFlags());
                 decl->declare(_ast);
                 check(TK_SEMICOLON);
             }
@@ -2004,6 +2004,93 @@ ASTNode *CParser::FunctionBody()
     return compound;
 }
 
+// Skip a function body by brace matching.
+void CParser::skipFunctionBody()
+{
+    unsigned depth = 0;
+
+    do
+    {
+        if (_sym == TK_LBRACE)
+            depth++;
+        else if (_sym == TK_RBRACE)
+            depth--;
+        else if (_sym == TK_EOF)
+            check(TK_RBRACE);
+        getTok();
+    }
+    while (depth > 0);
+}
+
+// Skip a parenthesized, bracketed or braced group of tokens, with the groups
+// nested in it.
+void CParser::skipGroup()
+{
+    unsigned depth = 0;
+
+    do
+    {
+        if (_sym == TK_LPAR || _sym == TK_LBRACK || _sym == TK_LBRACE)
+            depth++;
+        else if (_sym == TK_RPAR || _sym == TK_RBRACK || _sym == TK_RBRACE)
+            depth--;
+        else if (_sym == TK_EOF)
+            parsingError("unexpected end of file");
+        getTok();
+    }
+    while (depth > 0);
+}
+
+// Parse a function body skipped by skipFunctionBody(). The state of the
+// lexer and of the parser is restored afterwards, so this can be called at
+// any time, even in the middle of parsing. Globals declared after the body
+// are hidden, so it is parsed as it would have been in place.
+ASTNode *
+CParser::parseDeferredFunctionBody(long offset, int line, int col,
+                                   STScope *scope, unsigned globalLimit,
+                                   const std::vector<LocalVariable> &parameters)
+{
+    Lexer::State lexState = _lex->getState();
+    Token tokbuf[TOK_BUF_LEN];
+    unsigned sym = _sym;
+    unsigned tokIdx = _tokIdx;
+    unsigned laIdx = _laIdx;
+    unsigned newLaIdx = _newLaIdx;
+    bool inTypedef = _inTypedef;
+    STScope *topScope = _stb.getTopScope();
+    unsigned oldLimit = _stb.getGlobalLimit();
+    std::vector<LocalVariable> locals;
+    ASTNode *body;
+
+    for (unsigned i = 0; i < TOK_BUF_LEN; i++)
+        tokbuf[i] = _tokbuf[i];
+
+    _lex->seek(offset, line, col);
+    initTokenBuffer();
+    _inTypedef = false;
+    _stb.setTopScope(scope);
+    _stb.setGlobalLimit(globalLimit);
+    locals.swap(_locals);
+    _locals = parameters;
+
+    body = FunctionBody();
+
+    _locals.swap(locals);
+    _stb.setGlobalLimit(oldLimit);
+    _stb.setTopScope(topScope);
+    _inTypedef = inTypedef;
+    for (unsigned i = 0; i < TOK_BUF_LEN; i++)
+        _tokbuf[i] = tokbuf[i];
+    _sym = sym;
+    _tokIdx = tokIdx;
+    _laIdx = laIdx;
+    _newLaIdx = newLaIdx;
+    _tok = &_tokbuf[_tokIdx];
+    _lex->setState(lexState);
+
+    return body;
+}
+
 ASTNode *CParser::DeclarationList()
 {
     // Declaration()
@@ -2028,6 +2115,7 @@ ASTNode *CParser::StmtOrDeclList()
         {
             _inTypedef = false;
             decl = new TypeDeclASTNode(Declarator(declSpec), declSpec);
+            decl->setFlags(declSpec->getFlags());
             decl->declare(_ast);
             check(TK_SEMICOLON);
         }
@@ -2238,30 +2326,52 @@ ASTNode *CParser::ExpressionStatement()
 
 ASTNode *CParser::TranslationUnit()
 {
-    ASTNode *extdecl = NULL_AST_NODE;
-    ASTNode *tunit = NULL_AST_NODE;
+    SequenceASTNode *tunit = new SequenceASTNode();
 
     _stb.openScope();
 
-    for (;;)
+    if (_pch != nullptr)
     {
-        if (isStorageClassSpecifier(_sym) || isTypeQualifier(_sym) ||
-            isTypeSpecifier(_sym, 1) ||
-            _sym == TK___ASM || _sym == TK___ATTRIBUTE__ ||
-            _sym == TK_INLINE || _sym == TK__NORETURN)
+        FlatTreeSymbols nodeSymbols;
+
+        _pch->restoreSymbols(&_stb, nodeSymbols);
+        for (unsigned i = 0; i < _pch->getNumDeclarations(); i++)
         {
-            // _inTypedef is set in ExternalDeclaration/DeclartionSpecifiers/
-            // StorageClassSpecifier
-            extdecl = ExternalDeclaration();
-            if (tunit == NULL_AST_NODE)
-                tunit = new SequenceASTNode(extdecl);
-            else
-                static_cast<SequenceASTNode *>(tunit)->add(extdecl);
+            ASTNode *decl = _pch->getDeclaration(i, nodeSymbols);
 
-            //_inTypedef = false;
+            if (_sink == nullptr || _sink->declaration(decl))
+                tunit->add(decl);
+            else
+                releaseDeclaration(decl);
         }
-        else if (_sym == TK_EOF)
-        {
+    }
+
+    for (;;)
+    {
+        // Whatever a declaration of a system header begins with, it is only
+        // scanned.
+        if (_skipSystemHeaders && _sym != TK_EOF && isInSystemHeader())
+        {
+            SystemHeaderDeclaration();
+        }
+        else if (isStorageClassSpecifier(_sym) || isTypeQualifier(_sym) ||
+                 isTypeSpecifier(_sym, 1) ||
+                 _sym == TK___ASM || _sym == TK___ATTRIBUTE__ ||
+                 _sym == TK_INLINE || _sym == TK__NORETURN)
+        {
+            // _inTypedef is set in ExternalDeclaration/DeclartionSpecifiers/
+            // StorageClassSpecifier
+            ASTNode *extdecl = ExternalDeclaration();
+
+            if (_sink == nullptr || _sink->declaration(extdecl))
+                tunit->add(extdecl);
+            else
+                releaseDeclaration(extdecl);
+
+            //_inTypedef = false;
+        }
+        else if (_sym == TK_EOF)
+        {
             break;
         }
         else
@@ -2272,7 +2382,7 @@ ASTNode *CParser::TranslationUnit()
         }
     }
 
-    static_cast<SequenceASTNode *>(tunit)->setScope(_stb.getTopScope());
+    tunit->setScope(_stb.getTopScope());
     _stb.closeScope();
 
     return tunit;
@@ -2293,9 +2403,15 @@ ASTNode *CParser::ExternalDeclaration()
 
         if (_inTypedef)
         {
+            TypeDeclASTNode *typeDecl;
+
             _inTypedef = false;
-            decl = new TypeDeclASTNode(Declarator(declSpec), declSpec);
-            decl->declare(_ast);
+            typeDecl = new TypeDeclASTNode(Declarator(declSpec), declSpec);
+            typeDecl->setFlags(declSpec->getFlags());
+            typeDecl->declare(_ast);
+            locateGlobal(_stb.find(AST_IDENT_VALUE(typeDecl->getName())),
+                         AST_IDENT_LINE_NUM(typeDecl->getName()), true);
+            decl = typeDecl;
             check(TK_SEMICOLON);
         }
         else
@@ -2310,16 +2426,648 @@ ASTNode *CParser::ExternalDeclaration()
     }
 }
 
+// Declarations from system or ignored headers are only scanned, no tree is
+// built for them. What the rest of the input can refer to is entered into
+// the symbol table: typedef names, tags, enumeration constants, functions
+// and variables. Function bodies, initializers, parameters and the members
+// of records are skipped.
+void CParser::SystemHeaderDeclaration()
+{
+    unsigned flags = 0;
+    bool hasType = false;
+
+    for (;;)
+    {
+        if (_sym == TK_TYPEDEF || _sym == TK_EXTERN || _sym == TK_STATIC)
+        {
+            flags |= _sym == TK_TYPEDEF  ? SCS_TYPEDEF
+                     : _sym == TK_EXTERN ? SCS_EXTERN
+                                         : SCS_STATIC;
+            getTok();
+        }
+        else if (_sym == TK_STRUCT || _sym == TK_UNION || _sym == TK_ENUM)
+        {
+            SystemHeaderTagSpecifier();
+            hasType = true;
+        }
+        else if (_sym == TK___ASM || _sym == TK___ATTRIBUTE__)
+        {
+            getTok();
+            skipGroup();
+        }
+        else if (isTypeSpecifier(_sym, 1) && (_sym != TK_IDENT || !hasType))
+        {
+            // After a type, a name that is a tag too, like sigaction, is
+            // the declared one.
+            getTok();
+            hasType = true;
+        }
+        else if (isStorageClassSpecifier(_sym) || isTypeQualifier(_sym) ||
+                 _sym == TK_INLINE ||
+                 _sym == TK__NORETURN ||
+                 (_sym == TK_IDENT &&
+                  strcmp(getLATokInfoSval(1), "__extension__") == 0))
+        {
+            getTok();
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    while (_sym != TK_SEMICOLON)
+    {
+        const char *name = nullptr;
+        int line = 0;
+        bool isFunction = false;
+        bool hasInit = false;
+        unsigned depth = 0;
+
+        // The declared name is the last identifier before its parameters,
+        // if it is a function, as extensions like __inline may precede it.
+        for (;;)
+        {
+            if (_sym == TK_IDENT && !isFunction)
+            {
+                getTok();
+                name = _tok->name;
+                line = _tok->line;
+                isFunction = _sym == TK_LPAR;
+            }
+            else if (_sym == TK_LPAR && name == nullptr)
+            {
+                getTok();
+                depth++;
+            }
+            else if (_sym == TK_LPAR || _sym == TK_LBRACK)
+            {
+                skipGroup();
+            }
+            else if (_sym == TK_RPAR && depth > 0)
+            {
+                getTok();
+                depth--;
+            }
+            else if (_sym == TK___ASM || _sym == TK___ATTRIBUTE__)
+            {
+                getTok();
+                skipGroup();
+            }
+            else if (_sym == TK_TIMES || isTypeQualifier(_sym))
+            {
+                getTok();
+            }
+            else if (name != nullptr && _sym != TK_COMMA &&
+                     _sym != TK_SEMICOLON && _sym != TK_ASSIGN &&
+                     _sym != TK_LBRACE && _sym != TK_EOF)
+            {
+                // Extensions the parser does not know, like __asm__
+                getTok();
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        if (_sym == TK_ASSIGN)
+        {
+            hasInit = true;
+            while (_sym != TK_COMMA && _sym != TK_SEMICOLON)
+            {
+                if (_sym == TK_LPAR || _sym == TK_LBRACK || _sym == TK_LBRACE)
+                    skipGroup();
+                else if (_sym == TK_EOF)
+                    check(TK_SEMICOLON);
+                else
+                    getTok();
+            }
+        }
+
+        if (name == nullptr)
+        {
+            parsingError("expected declarator");
+        }
+        else if (flags & SCS_TYPEDEF)
+        {
+            STObject *obj = _stb.insert(name, STOK_TYPE, _stb.noType);
+
+            // A tag and a typedef name share the table, as in
+            // typedef union pthread_attr_t pthread_attr_t.
+            if (obj == _stb.noObj && _stb.find(name)->kind != STOK_TYPE)
+                _ast->error(line, "type name '%s' already exists", name);
+            locateGlobal(obj, line, true);
+        }
+        else if (isFunction)
+        {
+            declareFunction(name, line, flags, _sym == TK_LBRACE);
+            if (_sym == TK_LBRACE)
+            {
+                skipFunctionBody();
+                return;
+            }
+        }
+        else
+        {
+            declareVariable(name, line, RecordRef{nullptr, 0}, flags,
+                            hasInit);
+        }
+
+        if (_sym != TK_COMMA)
+            break;
+        getTok();
+    }
+    check(TK_SEMICOLON);
+}
+
+// struct, union or enum specifier of a system or ignored header. Its tag is
+// declared as by StructOrUnionSpecifier() and EnumSpecifier(), but only the
+// enumerators of its body are.
+void CParser::SystemHeaderTagSpecifier()
+{
+    STTypeKind kind = _sym == TK_STRUCT  ? STTK_STRUCT
+                      : _sym == TK_UNION ? STTK_UNION
+                                         : STTK_ENUM;
+
+    getTok();
+    while (_sym == TK___ATTRIBUTE__)
+    {
+        getTok();
+        skipGroup();
+    }
+
+    if (_sym == TK_IDENT)
+    {
+        getTok();
+
+        STObject *obj = _stb.find(_tok->name);
+        if (obj == _stb.noObj)
+        {
+            obj = _stb.insert(_tok->name, STOK_TYPE, _stb.allocType(kind));
+            obj->type->name = obj->name;
+        }
+        if (obj->kind == STOK_TYPE)
+            locateGlobal(obj, _tok->line, _sym == TK_LBRACE);
+    }
+
+    if (_sym != TK_LBRACE)
+        return;
+    if (kind != STTK_ENUM)
+    {
+        skipGroup();
+        return;
+    }
+
+    int64_t value = 0;
+
+    getTok();
+    while (_sym != TK_RBRACE)
+    {
+        SystemHeaderEnumerator(value);
+        if (_sym != TK_COMMA)
+            break;
+        getTok();
+    }
+    check(TK_RBRACE);
+}
+
+// Enumerator of a system or ignored header. Without a value that is an
+// integer constant expression it follows the previous one, as in
+// EnumeratorList(). The parser has no unary minus, so a negated value is
+// only used if it is an integer constant or another enumerator.
+void CParser::SystemHeaderEnumerator(int64_t &value)
+{
+    check(TK_IDENT);
+
+    STObject *obj = _stb.insert(_tok->name, STOK_CON, _stb.intType);
+
+    if (_sym == TK_ASSIGN)
+    {
+        getTok();
+        if (_sym == TK_MINUS)
+            SystemHeaderNegatedValue(value);
+        else
+        {
+            ASTNode *expr = ConstantExpression();
+            int64_t v;
+
+            if (evaluateConstant(expr, v, &_stb))
+                value = v;
+            if (expr != NULL_AST_NODE && expr->getRefCount() == 0)
+                ASTNode::destroy(expr);
+        }
+    }
+    if (obj != _stb.noObj)
+        obj->ival = value;
+    value++;
+}
+
+// Negated value of an enumerator of a system or ignored header, see
+// SystemHeaderEnumerator(). The rest of it is skipped.
+void CParser::SystemHeaderNegatedValue(int64_t &value)
+{
+    bool isKnown = false;
+    int64_t v = 0;
+
+    check(TK_MINUS);
+    if (_sym == TK_INT_LIT)
+    {
+        getTok();
+        v = _tok->info.ival;
+        isKnown = true;
+    }
+    else if (_sym == TK_IDENT)
+    {
+        getTok();
+
+        STObject *con = _stb.find(_tok->name);
+        if (con != _stb.noObj && con->kind == STOK_CON)
+        {
+            v = con->ival;
+            isKnown = true;
+        }
+    }
+
+    if (isKnown && (_sym == TK_COMMA || _sym == TK_RBRACE))
+        value = -v;
+    while (_sym != TK_COMMA && _sym != TK_RBRACE)
+    {
+        if (_sym == TK_LPAR || _sym == TK_LBRACK)
+            skipGroup();
+        else if (_sym == TK_EOF)
+            check(TK_RBRACE);
+        else
+            getTok();
+    }
+}
+
+// Free a declaration that is not going to be added to the tree, unless
+// somebody else holds a reference to it.
+void CParser::releaseDeclaration(ASTNode *decl)
+{
+    if (decl != NULL_AST_NODE && decl->getRefCount() == 0)
+        ASTNode::destroy(decl);
+}
+
+// Record where the global obj is declared. The first declaration is kept
+// until a definition replaces it.
+void CParser::locateGlobal(STObject *obj, int line, bool isDefinition)
+{
+    if (obj == _stb.noObj || _stb.getLevel() != 0)
+        return;
+    if (obj->line != 0 && (obj->isDefinition || !isDefinition))
+        return;
+
+    SourceManager *srcMgr = _lex->getSourceManager();
+    const char *file = srcMgr->getPresumedFileName(line);
+
+    obj->file = file != nullptr ? internName(file) : nullptr;
+    obj->line = srcMgr->getPresumedLine(line);
+    obj->isDefinition = isDefinition;
+}
+
+void CParser::declareFunction(ASTNode *funcName, unsigned flags,
+                              bool isDefinition)
+{
+    if (AST_MATCH_IDENT(funcName))
+        declareFunction(AST_IDENT_VALUE(funcName),
+                        AST_IDENT_LINE_NUM(funcName), flags, isDefinition);
+}
+
+void CParser::declareFunction(const char *name, int line, unsigned flags,
+                              bool isDefinition)
+{
+    // FIXME: Using noType is only temporary solution
+    STType *type = _stb.allocType(STTK_FUNCTION);
+    type->funcType = _stb.noType;
+
+    // A function may be declared more than once, the first one is kept.
+    STObject *obj = _stb.insert(name, STOK_FUNC, type);
+    if (obj == _stb.noObj)
+        obj = _stb.find(name);
+    if (obj->kind != STOK_FUNC)
+        return;
+
+    if (flags & SCS_STATIC)
+        obj->isStatic = true;
+    locateGlobal(obj, line, isDefinition);
+}
+
+// Only variables of the global scope are entered into the symbol table.
+void CParser::declareVariable(ASTNode *varName, ASTNode *type, unsigned flags,
+                              bool hasInit)
+{
+    if (AST_MATCH_IDENT(varName))
+        declareVariable(AST_IDENT_VALUE(varName), AST_IDENT_LINE_NUM(varName),
+                        getRecordRef(type), flags, hasInit);
+}
+
+void CParser::declareVariable(const char *name, int line, RecordRef type,
+                              unsigned flags, bool hasInit)
+{
+    if (_stb.getLevel() != 0)
+        return;
+
+    STObject *obj = _stb.insert(name, STOK_VAR, getSymbolType(type));
+    if (obj == _stb.noObj)
+        obj = _stb.find(name);
+    if (obj->kind != STOK_VAR)
+        return;
+
+    if (flags & SCS_STATIC)
+        obj->isStatic = true;
+    // Without extern, a declaration is also a definition.
+    locateGlobal(obj, line, hasInit || !(flags & SCS_EXTERN));
+}
+
+// Report a reference to name at the token just read to the reference sink.
+void CParser::addReference(ReferenceKind kind, const char *name)
+{
+    addReference(kind, name, _tok->line, _tok->col);
+}
+
+void CParser::addReference(ReferenceKind kind, const char *name, int line,
+                           int col)
+{
+    if (_refSink == nullptr)
+        return;
+
+    SourceManager *srcMgr = _lex->getSourceManager();
+    const char *file = srcMgr->getPresumedFileName(line);
+
+    _refSink->reference(kind, name,
+                        file != nullptr ? internName(file) : nullptr,
+                        srcMgr->getPresumedLine(line), col, _function);
+}
+
+// Keep the member name just read after . or ->, see reportMembers().
+void CParser::addMemberName()
+{
+    if (_refSink != nullptr)
+        _members.push_back(MemberName{_tok->name, _tok->line, _tok->col});
+}
+
+// Report the member names kept since first, the one of ref and those of
+// the accesses chained in its member, once resolveMember() has found their
+// records.
+void CParser::reportMembers(ASTNode *ref, size_t first)
+{
+    for (size_t i = first; i < _members.size(); i++)
+    {
+        const char *name = _members[i].name;
+        STType *record = nullptr;
+        ASTNode *member = NULL_AST_NODE;
+
+        if (ref->getKind() == NK_STRUCT_REF)
+        {
+            record = static_cast<StructRefASTNode *>(ref)->getRecordType();
+            member = static_cast<StructRefASTNode *>(ref)->getMember();
+        }
+        else if (ref->getKind() == NK_INDIRECT_REF)
+        {
+            record = static_cast<IndirectRefASTNode *>(ref)->getRecordType();
+            member = static_cast<IndirectRefASTNode *>(ref)->getField();
+        }
+        if (record != nullptr && record->name != nullptr)
+            name = internName(std::string(record->name) + "." + name);
+        addReference(REF_FIELD, name, _members[i].line, _members[i].col);
+        ref = member;
+    }
+    _members.resize(first);
+}
+
+// Report the identifier just read in an expression, unless it is a local
+// variable or parameter. The symbol table only holds the globals, types and
+// constants, see declareVariable(). Names it does not hold, like functions
+// that are declared implicitly, are reported as well.
+void CParser::referenceName(ReferenceKind kind)
+{
+    if (_refSink == nullptr)
+        return;
+
+    const char *name = _tok->name;
+
+    for (const LocalVariable &local : _locals)
+        if (local.name == name)
+            return;
+
+    STObject *obj = _stb.find(name);
+    if (obj != _stb.noObj)
+    {
+        if (obj->level != 0)
+            return;
+        if (obj->kind == STOK_TYPE)
+            kind = REF_TYPE;
+    }
+    addReference(kind, name);
+}
+
+// A variable declared in a block hides the global of the same name until
+// the block ends, unless it is declared extern.
+void CParser::declareLocal(ASTNode *name, ASTNode *type, unsigned flags)
+{
+    if (_stb.getLevel() == 0 || !AST_MATCH_IDENT(name) ||
+        (flags & SCS_EXTERN))
+        return;
+
+    _locals.push_back(LocalVariable{AST_IDENT_VALUE(name), getRecordRef(type)});
+}
+
+// Append the parameters prms of a function to locals.
+void CParser::getParameters(ASTNode *prms, std::vector<LocalVariable> &locals)
+{
+    if (prms == NULL_AST_NODE || !AST_MATCH_LIST(prms))
+        return;
+
+    for (ASTNode *prm : static_cast<SequenceASTNode *>(prms)->getElements())
+    {
+        if (prm->getKind() != NK_PARM_DECL)
+            continue;
+
+        ParmDeclASTNode *decl = static_cast<ParmDeclASTNode *>(prm);
+        if (AST_MATCH_IDENT(decl->getName()))
+            locals.push_back(LocalVariable{AST_IDENT_VALUE(decl->getName()),
+                                           getRecordRef(decl->getType())});
+    }
+}
+
+// The body of funcName follows. Its parameters prms hide the globals of the
+// same names.
+void CParser::enterFunction(ASTNode *funcName, ASTNode *prms)
+{
+    _function =
+        AST_MATCH_IDENT(funcName) ? AST_IDENT_VALUE(funcName) : nullptr;
+    _locals.clear();
+    getParameters(prms, _locals);
+}
+
+// Symbol table type of a global variable of type type. The pointers and
+// arrays to a record are pointer types, as member access sees them.
+STType *CParser::getSymbolType(RecordRef type)
+{
+    // FIXME: As for functions, other types are only a placeholder.
+    if (type.record == nullptr)
+        return _stb.allocType(STTK_NONE);
+
+    STType *t = type.record;
+    for (unsigned i = 0; i < type.indirection; i++)
+    {
+        STType *pointer = _stb.allocType(STTK_POINTER);
+
+        pointer->baseType = t;
+        t = pointer;
+    }
+    return t;
+}
+
+// Type of the variable name where it is used, see getSymbolType().
+RecordRef CParser::getVariableRecord(const char *name)
+{
+    RecordRef none = {nullptr, 0};
+
+    for (size_t i = _locals.size(); i-- > 0;)
+        if (_locals[i].name == name)
+            return _locals[i].type;
+
+    STObject *obj = _stb.find(name);
+    if (obj == _stb.noObj || obj->kind != STOK_VAR || obj->type == nullptr)
+        return none;
+
+    RecordRef type = {nullptr, 0};
+    STType *t = obj->type;
+    for (; t->kind == STTK_POINTER && t->baseType != nullptr;
+         t = t->baseType)
+        type.indirection++;
+    if (t->kind != STTK_STRUCT && t->kind != STTK_UNION)
+        return none;
+    type.record = t;
+    return type;
+}
+
+// Type of expr as far as member access needs it: variables, the fields
+// of the accesses resolved before, indexing and * and &.
+RecordRef CParser::getExpressionRecord(ASTNode *expr)
+{
+    RecordRef none = {nullptr, 0};
+    RecordRef type;
+
+    switch (expr->getKind())
+    {
+        case NK_IDENT_NODE:
+            return getVariableRecord(AST_IDENT_VALUE(expr));
+        case NK_STRUCT_REF:
+        case NK_INDIRECT_REF:
+        {
+            ASTNode *member;
+
+            if (expr->getKind() == NK_INDIRECT_REF &&
+                static_cast<IndirectRefASTNode *>(expr)->getField() ==
+                    NULL_AST_NODE)
+            {
+                // Unary *
+                type = getExpressionRecord(
+                    static_cast<IndirectRefASTNode *>(expr)->getExpr());
+                if (type.indirection == 0)
+                    return none;
+                type.indirection--;
+                return type;
+            }
+
+            // The type of a.b->c is the type of its last field, c.
+            for (;;)
+            {
+                if (expr->getKind() == NK_STRUCT_REF)
+                    member = static_cast<StructRefASTNode *>(expr)->getMember();
+                else
+                    member = static_cast<IndirectRefASTNode *>(expr)->getField();
+                if (member->getKind() != NK_STRUCT_REF &&
+                    member->getKind() != NK_INDIRECT_REF)
+                    break;
+                expr = member;
+            }
+
+            const FieldLayout *field = getFieldLayout(expr);
+            return field != nullptr ? field->type : none;
+        }
+        case NK_ARRAY_REF:
+            type = getExpressionRecord(
+                static_cast<ArrayRefASTNode *>(expr)->getExpr());
+            if (type.indirection == 0)
+                return none;
+            type.indirection--;
+            return type;
+        case NK_ADDR_EXPR:
+            type = getExpressionRecord(
+                static_cast<AddrExprASTNode *>(expr)->getExpr());
+            if (type.record != nullptr)
+                type.indirection++;
+            return type;
+        default:
+            return none;
+    }
+}
+
+static void setMemberRecord(ASTNode *ref, STType *record)
+{
+    if (ref->getKind() == NK_STRUCT_REF)
+        static_cast<StructRefASTNode *>(ref)->setRecordType(record);
+    else
+        static_cast<IndirectRefASTNode *>(ref)->setRecordType(record);
+}
+
+// Find the field of ref, a . or -> expression whose object has the type
+// object, and the fields of the accesses chained in its member, as in
+// a.b->c. The record of each one that is found is kept in its node.
+void CParser::resolveMember(ASTNode *ref, RecordRef object)
+{
+    for (;;)
+    {
+        ASTNode *member;
+        unsigned indirection;
+
+        if (ref->getKind() == NK_STRUCT_REF)
+        {
+            member = static_cast<StructRefASTNode *>(ref)->getMember();
+            indirection = 0;
+        }
+        else if (ref->getKind() == NK_INDIRECT_REF)
+        {
+            member = static_cast<IndirectRefASTNode *>(ref)->getField();
+            indirection = 1;
+        }
+        else
+            return;
+
+        if (object.record == nullptr || object.record->layout == nullptr ||
+            object.indirection != indirection)
+            return;
+
+        setMemberRecord(ref, object.record);
+        const FieldLayout *field = getFieldLayout(ref);
+        if (field == nullptr)
+        {
+            // The record has no such member.
+            setMemberRecord(ref, nullptr);
+            return;
+        }
+
+        ref = member;
+        object = field->type;
+    }
+}
+
 ASTNode *CParser::FunctionDefinition(ASTNode *funcType)
 {
     ASTNode *funcName = NULL_AST_NODE;
     ASTNode *funcPrms = NULL_AST_NODE;
+    unsigned flags = funcType->getFlags();
     // bool isPtrType = false;
 
     if (_sym == TK_TIMES)
     {
         getTok();
-        funcType = new PointerTypeASTNode(funcType);
+        funcType = _ast->getPointerType(funcType);
     }
 
     // Function name
@@ -2333,6 +3081,8 @@ ASTNode *CParser::FunctionDefinition(ASTNode *funcType)
                                                             NULL_AST_NODE,
                                                             NULL_AST_NODE);
 
+    funcDecl->setFlags(flags);
+
     // TODO: Move ParameterTypeList to DirectDeclarator
     if (_sym != TK_RPAR)
     {
@@ -2344,7 +3094,7 @@ ASTNode *CParser::FunctionDefinition(ASTNode *funcType)
     while (_sym == TK___ASM || _sym == TK___ATTRIBUTE__)
         GccDeclaratorExtension();
 
-    //_ast->declare(funcDecl);
+    declareFunction(funcName, flags, _sym == TK_LBRACE);
 
     _stb.openScope();
 
@@ -2352,10 +3102,26 @@ ASTNode *CParser::FunctionDefinition(ASTNode *funcType)
     // if (funcPrms != NULL_AST_NODE)
     //    _ast->declare(funcPrms);
 
-    if (_sym != TK_SEMICOLON)
-        funcDecl->setBody(FunctionBody());
-    else
+    if (_sym == TK_SEMICOLON)
+    {
         getTok();
+    }
+    else if (_lazyFunctionBodies && _sym == TK_LBRACE && _lex->isSeekable())
+    {
+        std::vector<LocalVariable> parameters;
+
+        getParameters(funcPrms, parameters);
+        funcDecl->setBodyLoader(new DeferredFunctionBody(
+            this, _tokbuf[_laIdx], _stb.getTopScope(), parameters));
+        skipFunctionBody();
+    }
+    else
+    {
+        enterFunction(funcName, funcPrms);
+        funcDecl->setBody(FunctionBody());
+        _function = nullptr;
+        _locals.clear();
+    }
 
     funcDecl->setScope(_stb.getTopScope());
     _stb.closeScope();
@@ -0,0 +1,48 @@
+// Composite visitor - implementation file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#include "../include/CompositeVisitor.h"
+#include "../include/ASTNode.h"
+
+namespace cparser
+{
+
+bool CompositeVisitor::preVisit(ASTNode *n, unsigned depth)
+{
+    bool descend = false;
+
+    for (unsigned i = 0; i < _passes.size(); i++)
+    {
+        // Inside a subtree this pass has skipped
+        if (_skipDepth[i] < depth)
+            continue;
+
+        if (_passes[i]->preVisit(n, depth))
+            descend = true;
+        else
+            _skipDepth[i] = depth;
+    }
+
+    return descend;
+}
+
+void CompositeVisitor::postVisit(ASTNode *n, unsigned depth)
+{
+    for (unsigned i = 0; i < _passes.size(); i++)
+    {
+        if (_skipDepth[i] < depth)
+            continue;
+
+        // Leaving the node whose children were skipped
+        if (_skipDepth[i] == depth)
+            _skipDepth[i] = NO_SKIP;
+
+        _passes[i]->postVisit(n, depth);
+    }
+}
+
+} // namespace cparser
@@ -0,0 +1,281 @@
+// Constant expression evaluation - implementation file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#include "../include/ConstEval.h"
+#include "../include/RecordLayout.h"
+#include "../include/TreeWalker.h"
+
+#include <vector>
+
+namespace cparser
+{
+
+// Number of operands of an operator of constant expressions. They are the
+// last child slots of the node, the slots before them hold its type. -1 for
+// nodes that can not appear in a constant expression.
+static int getOperandCount(ASTNodeKind kind)
+{
+    switch (kind)
+    {
+        case NK_INTEGER_CONST:
+        case NK_CHAR_CONST:
+        case NK_IDENT_NODE:
+        case NK_SIZEOF_EXPR:
+        case NK_ALIGNOF_EXPR:
+            return 0;
+        case NK_CAST_EXPR:
+        case NK_BIT_NOT_EXPR:
+        case NK_LOG_NOT_EXPR:
+            return 1;
+        case NK_LSHIFT_EXPR:
+        case NK_RSHIFT_EXPR:
+        case NK_BIT_IOR_EXPR:
+        case NK_BIT_XOR_EXPR:
+        case NK_BIT_AND_EXPR:
+        case NK_LOG_AND_EXPR:
+        case NK_LOG_OR_EXPR:
+        case NK_PLUS_EXPR:
+        case NK_MINUS_EXPR:
+        case NK_MULT_EXPR:
+        case NK_TRUNC_DIV_EXPR:
+        case NK_TRUNC_MOD_EXPR:
+        case NK_LT_EXPR:
+        case NK_LE_EXPR:
+        case NK_GT_EXPR:
+        case NK_GE_EXPR:
+        case NK_EQ_EXPR:
+        case NK_NE_EXPR:
+            return 2;
+        case NK_COND_EXPR:
+            return 3;
+        default:
+            return -1;
+    }
+}
+
+static ConstState evaluateLeaf(ASTNode *n, SymbolTable *stb, int64_t &v)
+{
+    unsigned size, alignment;
+
+    switch (n->getKind())
+    {
+        case NK_INTEGER_CONST:
+            v = static_cast<IntegerConstASTNode *>(n)->getValue();
+            return CS_CONSTANT;
+        case NK_CHAR_CONST:
+            v = static_cast<CharConstASTNode *>(n)->getValue();
+            return CS_CONSTANT;
+        case NK_IDENT_NODE:
+        {
+            if (stb == nullptr)
+                return CS_UNKNOWN;
+
+            STObject *obj =
+                stb->find(static_cast<IdentASTNode *>(n)->getValue());
+            if (obj == stb->noObj || obj->kind != STOK_CON)
+                return CS_NOT_CONSTANT;
+            v = obj->ival;
+            return CS_CONSTANT;
+        }
+        case NK_SIZEOF_EXPR:
+            if (!getTypeLayout(static_cast<SizeOfExprASTNode *>(n)->getExpr(),
+                               size, alignment))
+                return CS_NOT_CONSTANT;
+            v = size;
+            return CS_CONSTANT;
+        case NK_ALIGNOF_EXPR:
+            if (!getTypeLayout(static_cast<AlignOfExprASTNode *>(n)->getExpr(),
+                               size, alignment))
+                return CS_NOT_CONSTANT;
+            v = alignment;
+            return CS_CONSTANT;
+        default:
+            return CS_NOT_CONSTANT;
+    }
+}
+
+// Evaluate n from the cached results of its operands ops.
+static ConstState evaluateOperator(ASTNode *n, ASTNode **ops, int count,
+                                   int64_t &v)
+{
+    ASTNodeKind kind = n->getKind();
+
+    // The operand that is not evaluated may be anything.
+    if (ops[0]->getConstState() == CS_CONSTANT)
+    {
+        int64_t a = ops[0]->getConstValue();
+
+        if (kind == NK_COND_EXPR)
+        {
+            ASTNode *chosen = a != 0 ? ops[1] : ops[2];
+
+            v = chosen->getConstValue();
+            return chosen->getConstState();
+        }
+        if ((kind == NK_LOG_AND_EXPR && a == 0) ||
+            (kind == NK_LOG_OR_EXPR && a != 0))
+        {
+            v = kind == NK_LOG_OR_EXPR;
+            return CS_CONSTANT;
+        }
+    }
+
+    ConstState state = CS_CONSTANT;
+    for (int i = 0; i < count; i++)
+    {
+        if (ops[i]->getConstState() == CS_NOT_CONSTANT)
+            return CS_NOT_CONSTANT;
+        if (ops[i]->getConstState() == CS_UNKNOWN)
+            state = CS_UNKNOWN;
+    }
+    if (state == CS_UNKNOWN)
+        return CS_UNKNOWN;
+
+    // Wrap around instead of overflowing.
+    uint64_t a = ops[0]->getConstValue();
+    uint64_t b = count > 1 ? ops[1]->getConstValue() : 0;
+    int64_t sa = a, sb = b;
+
+    switch (kind)
+    {
+        case NK_CAST_EXPR:
+            v = sa;
+            break;
+        case NK_BIT_NOT_EXPR:
+            v = ~a;
+            break;
+        case NK_LOG_NOT_EXPR:
+            v = a == 0;
+            break;
+        case NK_LSHIFT_EXPR:
+            if (sb < 0 || sb >= 64)
+                return CS_NOT_CONSTANT;
+            v = a << b;
+            break;
+        case NK_RSHIFT_EXPR:
+            if (sb < 0 || sb >= 64)
+                return CS_NOT_CONSTANT;
+            v = sa >> b;
+            break;
+        case NK_BIT_IOR_EXPR:
+            v = a | b;
+            break;
+        case NK_BIT_XOR_EXPR:
+            v = a ^ b;
+            break;
+        case NK_BIT_AND_EXPR:
+            v = a & b;
+            break;
+        case NK_LOG_AND_EXPR:
+            v = a != 0 && b != 0;
+            break;
+        case NK_LOG_OR_EXPR:
+            v = a != 0 || b != 0;
+            break;
+        case NK_PLUS_EXPR:
+            v = a + b;
+            break;
+        case NK_MINUS_EXPR:
+            v = a - b;
+            break;
+        case NK_MULT_EXPR:
+            v = a * b;
+            break;
+        case NK_TRUNC_DIV_EXPR:
+        case NK_TRUNC_MOD_EXPR:
+            if (sb == 0 || (sa == INT64_MIN && sb == -1))
+                return CS_NOT_CONSTANT;
+            v = kind == NK_TRUNC_DIV_EXPR ? sa / sb : sa % sb;
+            break;
+        case NK_LT_EXPR:
+            v = sa < sb;
+            break;
+        case NK_LE_EXPR:
+            v = sa <= sb;
+            break;
+        case NK_GT_EXPR:
+            v = sa > sb;
+            break;
+        case NK_GE_EXPR:
+            v = sa >= sb;
+            break;
+        case NK_EQ_EXPR:
+            v = sa == sb;
+            break;
+        case NK_NE_EXPR:
+            v = sa != sb;
+            break;
+        default:
+            return CS_NOT_CONSTANT;
+    }
+    return CS_CONSTANT;
+}
+
+// Post-order with an explicit stack, like hashTree(). Subtrees that already
+// carry a result are not descended into.
+bool evaluateConstant(ASTNode *expr, int64_t &value, SymbolTable *stb)
+{
+    struct Frame
+    {
+        ASTNode *node;
+        bool post;
+    };
+
+    std::vector<Frame> stack;
+    std::vector<ASTNode *> slots;
+
+    stack.push_back({expr, false});
+    while (!stack.empty())
+    {
+        Frame f = stack.back();
+        ASTNode *n = f.node;
+        int count;
+        int64_t v = 0;
+        ConstState state;
+
+        if (n->getConstState() != CS_UNKNOWN)
+        {
+            stack.pop_back();
+            continue;
+        }
+
+        count = getOperandCount(n->getKind());
+        if (count <= 0)
+        {
+            stack.pop_back();
+            state = count == 0 ? evaluateLeaf(n, stb, v) : CS_NOT_CONSTANT;
+            if (state != CS_UNKNOWN)
+                n->setConstValue(state, v);
+            continue;
+        }
+
+        slots.clear();
+        TreeWalker::getSlots(n, slots);
+        ASTNode **ops = &slots[slots.size() - count];
+
+        if (!f.post)
+        {
+            stack.back().post = true;
+            for (int i = 0; i < count; i++)
+                if (ops[i]->getConstState() == CS_UNKNOWN)
+                    stack.push_back({ops[i], false});
+            continue;
+        }
+
+        stack.pop_back();
+        state = evaluateOperator(n, ops, count, v);
+        // Results that depend on an identifier stb could not resolve are
+        // not cached, a later evaluation may have stb.
+        if (state != CS_UNKNOWN)
+            n->setConstValue(state, v);
+    }
+
+    value = expr->getConstValue();
+    return expr->getConstState() == CS_CONSTANT;
+}
+
+} // namespace cparser
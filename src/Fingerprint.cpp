@@ -0,0 +1,140 @@
+// Token stream fingerprints - implementation file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#include "../include/Fingerprint.h"
+#include "../include/CLexer.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+namespace cparser
+{
+
+// FNV-1a over the bytes of the token stream
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static inline uint64_t hashBytes(uint64_t h, const void *data, size_t size)
+{
+    const unsigned char *p = (const unsigned char *) data;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        h ^= p[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+uint64_t fingerprintTokens(Lexer *lex, bool skipSystemHeaders)
+{
+    SourceManager *srcMgr = lex->getSourceManager();
+    uint64_t h = FNV_OFFSET_BASIS;
+    uint8_t skip = skipSystemHeaders;
+    Token t;
+
+    h = hashBytes(h, &skip, sizeof(skip));
+    lex->start();
+    while (lex->next(&t) != TK_EOF)
+    {
+        h = hashBytes(h, &t.kind, sizeof(t.kind));
+        switch (t.kind)
+        {
+        case TK_IDENT:
+        case TK_STRING_LIT:
+            // The terminating zero separates adjacent strings.
+            h = hashBytes(h, t.sval.c_str(), t.sval.size() + 1);
+            break;
+        case TK_INT_LIT:
+        case TK_CHAR_LIT:
+            h = hashBytes(h, &t.info.ival, sizeof(t.info.ival));
+            break;
+        case TK_FLOAT_LIT:
+            h = hashBytes(h, &t.info.fval, sizeof(t.info.fval));
+            break;
+        default:
+            break;
+        }
+
+        if (skipSystemHeaders)
+        {
+            uint8_t sys = srcMgr->isSystemHeader(t.line);
+            h = hashBytes(h, &sys, sizeof(sys));
+        }
+    }
+    return h;
+}
+
+void FingerprintManifest::load(FILE *fp)
+{
+    char version[64];
+    char path[4096];
+    uint64_t fingerprint;
+
+    _entries.clear();
+    while (fscanf(fp, "%" SCNx64 " %63s %4095[^\n]", &fingerprint, version,
+                  path) == 3)
+        _entries[path] = Entry{fingerprint, version};
+}
+
+void FingerprintManifest::load()
+{
+    FILE *fp = fopen(_path.c_str(), "r");
+
+    if (fp == NULL)
+        return;
+    load(fp);
+    fclose(fp);
+}
+
+bool FingerprintManifest::isUnchanged(const char *file, uint64_t fingerprint,
+                                      const char *version)
+{
+    auto it = _entries.find(file);
+
+    return it != _entries.end() && it->second.fingerprint == fingerprint &&
+           it->second.version == version;
+}
+
+bool FingerprintManifest::update(const char *file, uint64_t fingerprint,
+                                 const char *version)
+{
+    std::string lockPath = _path + ".lock";
+    std::string tmpPath = _path + ".tmp";
+    int lockFd = open(lockPath.c_str(), O_RDWR | O_CREAT, 0644);
+    bool ok = false;
+
+    if (lockFd < 0)
+        return false;
+    if (flock(lockFd, LOCK_EX) == 0)
+    {
+        load();
+        _entries[file] = Entry{fingerprint, version};
+
+        // Write a new manifest and rename it over the old one, so readers
+        // never see a partial file.
+        FILE *fp = fopen(tmpPath.c_str(), "w");
+        if (fp != NULL)
+        {
+            for (auto &e : _entries)
+                fprintf(fp, "%016" PRIx64 " %s %s\n", e.second.fingerprint,
+                        e.second.version.c_str(), e.first.c_str());
+            ok = fclose(fp) == 0 &&
+                 rename(tmpPath.c_str(), _path.c_str()) == 0;
+        }
+        flock(lockFd, LOCK_UN);
+    }
+    close(lockFd);
+    return ok;
+}
+
+} // namespace cparser
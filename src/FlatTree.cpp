@@ -0,0 +1,585 @@
+// Flat abstract syntax tree - implementation file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#include "../include/FlatTree.h"
+#include "../include/ASTNode.h"
+#include "../include/TreeWalker.h"
+
+#include <algorithm>
+
+namespace cparser
+{
+
+FlatTree::FlatTree()
+{
+    // The null node
+    _kinds.push_back(NK_UNKNOWN);
+    _lineNums.push_back(0);
+    _flags.push_back(0);
+    _values.push_back(0);
+    _firstChild.push_back(0);
+    _numChildren.push_back(0);
+}
+
+FlatTree::~FlatTree()
+{
+    for (unsigned i = 0; i < _packedArrays.size(); i++)
+        DELETE_AST_NODE_REF(_packedArrays[i]);
+}
+
+uint32_t FlatTree::addString(const char *s)
+{
+    std::unordered_map<std::string, uint32_t>::iterator it =
+        _stringIds.find(s);
+
+    if (it != _stringIds.end())
+        return it->second;
+
+    _strings.push_back(s);
+    _stringIds[s] = _strings.size() - 1;
+    return _strings.size() - 1;
+}
+
+FlatNodeId FlatTree::addNode(ASTNode *n,
+                             const std::vector<FlatNodeId> &children)
+{
+    FlatNodeId id = _kinds.size();
+    uint32_t value = 0;
+
+    switch (n->getKind())
+    {
+        case NK_IDENT_NODE:
+            value = addString(static_cast<IdentASTNode *>(n)->getValue());
+            break;
+        case NK_STRING_CONST:
+            value =
+                addString(static_cast<StringConstASTNode *>(n)->getValue());
+            break;
+        case NK_ASM_STMT:
+            value = addString(static_cast<AsmStmtASTNode *>(n)->getData());
+            break;
+        case NK_INTEGER_CONST:
+            value = static_cast<IntegerConstASTNode *>(n)->getValue();
+            break;
+        case NK_REAL_CONST:
+            value = (int) static_cast<RealConstASTNode *>(n)->getValue();
+            break;
+        case NK_CHAR_CONST:
+            value = static_cast<CharConstASTNode *>(n)->getValue();
+            break;
+        case NK_PACKED_CONST_ARRAY:
+            value = _packedArrays.size();
+            PUSH_BACK_AST_NODE_REF(_packedArrays, n);
+            break;
+        case NK_INTEGRAL_TYPE:
+        {
+            IntegralTypeASTNode *t = static_cast<IntegralTypeASTNode *>(n);
+
+            value = (t->getAlignment() << 1) | t->getIsSigned();
+            break;
+        }
+        case NK_REAL_TYPE:
+        {
+            RealTypeASTNode *t = static_cast<RealTypeASTNode *>(n);
+
+            value = (t->getAlignment() << 1) | t->getIsDouble();
+            break;
+        }
+        case NK_FUNCTION_DECL:
+            _symbols.scopes[id] = static_cast<FunctionDeclASTNode *>(n)->getScope();
+            break;
+        case NK_COMPOUND_STMT:
+            _symbols.scopes[id] = static_cast<CompoundStmtASTNode *>(n)->getScope();
+            break;
+        case NK_LIST:
+            _symbols.scopes[id] = static_cast<SequenceASTNode *>(n)->getScope();
+            break;
+        case NK_STRUCT_TYPE:
+            _symbols.recordTypes[id] =
+                static_cast<StructTypeASTNode *>(n)->getRecordType();
+            break;
+        case NK_UNION_TYPE:
+            _symbols.recordTypes[id] =
+                static_cast<UnionTypeASTNode *>(n)->getRecordType();
+            break;
+        case NK_STRUCT_REF:
+        case NK_INDIRECT_REF:
+        {
+            // Only the member accesses that were resolved are kept.
+            STType *record =
+                n->getKind() == NK_STRUCT_REF
+                    ? static_cast<StructRefASTNode *>(n)->getRecordType()
+                    : static_cast<IndirectRefASTNode *>(n)->getRecordType();
+
+            if (record != nullptr)
+                _symbols.recordTypes[id] = record;
+            break;
+        }
+        default:
+            break;
+    }
+
+    return addNode(n->getKind(), n->getLineNum(), n->getFlags(), value,
+                   children);
+}
+
+FlatNodeId FlatTree::addNode(ASTNodeKind kind, int lineNum, unsigned flags,
+                             uint32_t value,
+                             const std::vector<FlatNodeId> &children)
+{
+    FlatNodeId id = _kinds.size();
+
+    _kinds.push_back(kind);
+    _lineNums.push_back(lineNum);
+    _flags.push_back(flags);
+    _values.push_back(value);
+    _firstChild.push_back(_children.size());
+    _numChildren.push_back(children.size());
+    _children.insert(_children.end(), children.begin(), children.end());
+
+    return id;
+}
+
+STScope *FlatTreeSymbols::getScope(FlatNodeId id) const
+{
+    auto it = scopes.find(id);
+
+    return it != scopes.end() ? it->second : nullptr;
+}
+
+STType *FlatTreeSymbols::getRecordType(FlatNodeId id) const
+{
+    auto it = recordTypes.find(id);
+
+    return it != recordTypes.end() ? it->second : nullptr;
+}
+
+// Nodes are added in post-order with an explicit stack. A node that is
+// shared inside the subtree is added only once.
+FlatNodeId FlatTree::add(ASTNode *n)
+{
+    struct Frame
+    {
+        ASTNode *node;
+        bool post;
+    };
+
+    std::unordered_map<ASTNode *, FlatNodeId> ids;
+    std::vector<Frame> stack;
+    std::vector<ASTNode *> slots;
+    std::vector<FlatNodeId> children;
+
+    if (n == NULL_AST_NODE)
+        return FLAT_NULL_NODE;
+
+    ids[NULL_AST_NODE] = FLAT_NULL_NODE;
+    stack.push_back({n, false});
+    while (!stack.empty())
+    {
+        Frame f = stack.back();
+
+        if (ids.count(f.node))
+        {
+            stack.pop_back();
+            continue;
+        }
+
+        slots.clear();
+        TreeWalker::getSlots(f.node, slots);
+
+        if (!f.post)
+        {
+            stack.back().post = true;
+            for (size_t i = slots.size(); i > 0; i--)
+                if (!ids.count(slots[i - 1]))
+                    stack.push_back({slots[i - 1], false});
+            continue;
+        }
+
+        stack.pop_back();
+        children.clear();
+        for (size_t i = 0; i < slots.size(); i++)
+            children.push_back(ids[slots[i]]);
+        ids[f.node] = addNode(f.node, children);
+    }
+
+    return ids[n];
+}
+
+void FlatTree::addDeclaration(ASTNode *decl)
+{
+    if (decl == NULL_AST_NODE)
+        return;
+
+    FlatNodeId id = add(decl);
+
+    if (getKind(id) == NK_LIST)
+    {
+        for (unsigned i = 0; i < getNumChildren(id); i++)
+            if (getChild(id, i) != FLAT_NULL_NODE)
+                _topLevel.push_back(getChild(id, i));
+    }
+    else
+    {
+        _topLevel.push_back(id);
+    }
+}
+
+#define CHILD(i) nodes[getChild(id, i)]
+
+#define NEW_BINARY(T) new T(CHILD(0), CHILD(1), CHILD(2))
+
+// Create the pointer node for id. The nodes of its children are already in
+// nodes. Packed arrays are copied if copyShared is set.
+ASTNode *FlatTree::createNode(FlatNodeId id,
+                              std::unordered_map<FlatNodeId, ASTNode *> &nodes,
+                              const FlatTreeSymbols &symbols, bool copyShared)
+{
+    ASTNode *n = NULL_AST_NODE;
+    uint32_t value = _values[id];
+
+    switch (getKind(id))
+    {
+        case NK_IDENT_NODE:
+            n = new IdentASTNode(_strings[value]);
+            break;
+        case NK_INTEGER_CONST:
+            n = new IntegerConstASTNode(value);
+            break;
+        case NK_REAL_CONST:
+            n = new RealConstASTNode(value);
+            break;
+        case NK_STRING_CONST:
+            n = new StringConstASTNode(_strings[value]);
+            break;
+        case NK_CHAR_CONST:
+            n = new CharConstASTNode(value);
+            break;
+        case NK_PACKED_CONST_ARRAY:
+        {
+            PackedConstArrayASTNode *array =
+                static_cast<PackedConstArrayASTNode *>(_packedArrays[value]);
+            std::vector<int> values(array->size());
+
+            if (!copyShared)
+                return array;
+            for (unsigned i = 0; i < values.size(); i++)
+                values[i] = array->getValue(i);
+            n = new PackedConstArrayASTNode(array->getElementKind(), values);
+            break;
+        }
+        case NK_SIZEOF_EXPR:
+            n = new SizeOfExprASTNode(CHILD(0));
+            break;
+        case NK_ALIGNOF_EXPR:
+            n = new AlignOfExprASTNode(CHILD(0));
+            break;
+        case NK_TYPE_DECL:
+            n = new TypeDeclASTNode(CHILD(0), CHILD(1));
+            break;
+        case NK_FUNCTION_DECL:
+        {
+            FunctionDeclASTNode *f = new FunctionDeclASTNode(
+                CHILD(0), CHILD(1), CHILD(2), CHILD(3));
+
+            f->setScope(symbols.getScope(id));
+            n = f;
+            break;
+        }
+        case NK_VAR_DECL:
+            n = new VarDeclASTNode(CHILD(0), CHILD(1), CHILD(2));
+            break;
+        case NK_PARM_DECL:
+            n = new ParmDeclASTNode(CHILD(0), CHILD(1));
+            break;
+        case NK_FIELD_DECL:
+            n = new FieldDeclASTNode(CHILD(0), CHILD(1), CHILD(2));
+            break;
+        case NK_ASM_STMT:
+            n = new AsmStmtASTNode(_strings[value]);
+            break;
+        case NK_BREAK_STMT:
+            n = new BreakStmtASTNode();
+            break;
+        case NK_CASE_LABEL:
+            n = new CaseLabelASTNode(CHILD(0), CHILD(1));
+            break;
+        case NK_COMPOUND_STMT:
+        {
+            CompoundStmtASTNode *s =
+                new CompoundStmtASTNode(CHILD(0), CHILD(1));
+
+            s->setScope(symbols.getScope(id));
+            n = s;
+            break;
+        }
+        case NK_CONTINUE_STMT:
+            n = new ContinueStmtASTNode();
+            break;
+        case NK_DO_STMT:
+            n = new DoStmtASTNode(CHILD(0), CHILD(1));
+            break;
+        case NK_FOR_STMT:
+            n = new ForStmtASTNode(CHILD(0), CHILD(1), CHILD(2), CHILD(3));
+            break;
+        case NK_GOTO_STMT:
+            n = new GotoStmtASTNode(CHILD(0));
+            break;
+        case NK_IF_STMT:
+            n = new IfStmtASTNode(CHILD(0), CHILD(1), CHILD(2));
+            break;
+        case NK_LABEL_STMT:
+            n = new LabelStmtASTNode(CHILD(0), CHILD(1));
+            break;
+        case NK_RETURN_STMT:
+            n = new ReturnStmtASTNode(CHILD(0), CHILD(1));
+            break;
+        case NK_SWITCH_STMT:
+            n = new SwitchStmtASTNode(CHILD(0), CHILD(1));
+            break;
+        case NK_WHILE_STMT:
+            n = new WhileStmtASTNode(CHILD(0), CHILD(1));
+            break;
+        case NK_CAST_EXPR:
+            n = new CastExprASTNode(CHILD(0), CHILD(1));
+            break;
+        case NK_BIT_NOT_EXPR:
+            n = new BitNotExprASTNode(CHILD(0), CHILD(1));
+            break;
+        case NK_LOG_NOT_EXPR:
+            n = new LogNotExprASTNode(CHILD(0), CHILD(1));
+            break;
+        case NK_PREDECREMENT_EXPR:
+            n = new PredecrementExprASTNode(CHILD(0));
+            break;
+        case NK_PREINCREMENT_EXPR:
+            n = new PreincrementExprASTNode(CHILD(0));
+            break;
+        case NK_POSTDECREMENT_EXPR:
+            n = new PostdecrementExprASTNode(CHILD(0));
+            break;
+        case NK_POSTINCREMENT_EXPR:
+            n = new PostincrementExprASTNode(CHILD(0));
+            break;
+        case NK_ADDR_EXPR:
+            n = new AddrExprASTNode(CHILD(0), CHILD(1));
+            break;
+        case NK_INDIRECT_REF:
+        {
+            IndirectRefASTNode *r =
+                new IndirectRefASTNode(CHILD(0), CHILD(1), CHILD(2));
+
+            r->setRecordType(symbols.getRecordType(id));
+            n = r;
+            break;
+        }
+        case NK_NOP_EXPR:
+            n = new NopExprASTNode();
+            break;
+        case NK_LSHIFT_EXPR:
+            n = NEW_BINARY(LShiftExprASTNode);
+            break;
+        case NK_RSHIFT_EXPR:
+            n = NEW_BINARY(RShiftExprASTNode);
+            break;
+        case NK_BIT_IOR_EXPR:
+            n = NEW_BINARY(BitIorExprASTNode);
+            break;
+        case NK_BIT_XOR_EXPR:
+            n = NEW_BINARY(BitXorExprASTNode);
+            break;
+        case NK_BIT_AND_EXPR:
+            n = NEW_BINARY(BitAndExprASTNode);
+            break;
+        case NK_LOG_AND_EXPR:
+            n = NEW_BINARY(LogAndExprASTNode);
+            break;
+        case NK_LOG_OR_EXPR:
+            n = NEW_BINARY(LogOrExprASTNode);
+            break;
+        case NK_PLUS_EXPR:
+            n = NEW_BINARY(PlusExprASTNode);
+            break;
+        case NK_MINUS_EXPR:
+            n = NEW_BINARY(MinusExprASTNode);
+            break;
+        case NK_MULT_EXPR:
+            n = NEW_BINARY(MultExprASTNode);
+            break;
+        case NK_TRUNC_DIV_EXPR:
+            n = NEW_BINARY(TruncDivExprASTNode);
+            break;
+        case NK_TRUNC_MOD_EXPR:
+            n = NEW_BINARY(TruncModExprASTNode);
+            break;
+        case NK_ARRAY_REF:
+            n = new ArrayRefASTNode(CHILD(0), CHILD(1), CHILD(2));
+            break;
+        case NK_STRUCT_REF:
+        {
+            StructRefASTNode *r = new StructRefASTNode(CHILD(0), CHILD(1));
+
+            r->setRecordType(symbols.getRecordType(id));
+            n = r;
+            break;
+        }
+        case NK_LT_EXPR:
+            n = NEW_BINARY(LtExprASTNode);
+            break;
+        case NK_LE_EXPR:
+            n = NEW_BINARY(LeExprASTNode);
+            break;
+        case NK_GT_EXPR:
+            n = NEW_BINARY(GtExprASTNode);
+            break;
+        case NK_GE_EXPR:
+            n = NEW_BINARY(GeExprASTNode);
+            break;
+        case NK_EQ_EXPR:
+            n = NEW_BINARY(EqExprASTNode);
+            break;
+        case NK_NE_EXPR:
+            n = NEW_BINARY(NeExprASTNode);
+            break;
+        case NK_ASSIGN_EXPR:
+            n = NEW_BINARY(AssignExprASTNode);
+            break;
+        case NK_COND_EXPR:
+            n = new CondExprASTNode(CHILD(0), CHILD(1), CHILD(2));
+            break;
+        case NK_CALL_EXPR:
+            n = new CallExprASTNode(CHILD(0), CHILD(1));
+            break;
+        case NK_VOID_TYPE:
+            n = new VoidTypeASTNode();
+            break;
+        case NK_INTEGRAL_TYPE:
+            n = new IntegralTypeASTNode(value >> 1, value & 1);
+            break;
+        case NK_REAL_TYPE:
+            n = new RealTypeASTNode(value >> 1, value & 1);
+            break;
+        case NK_ENUMERAL_TYPE:
+            n = new EnumeralTypeASTNode(CHILD(0), CHILD(1));
+            break;
+        case NK_POINTER_TYPE:
+            n = new PointerTypeASTNode(CHILD(0));
+            break;
+        case NK_FUNCTION_TYPE:
+            n = new FunctionTypeASTNode(CHILD(0), CHILD(1));
+            break;
+        case NK_ARRAY_TYPE:
+            n = new ArrayTypeASTNode(CHILD(0), CHILD(1));
+            break;
+        case NK_STRUCT_TYPE:
+        {
+            StructTypeASTNode *t = new StructTypeASTNode(CHILD(0), CHILD(1));
+
+            t->setRecordType(symbols.getRecordType(id));
+            n = t;
+            break;
+        }
+        case NK_UNION_TYPE:
+        {
+            UnionTypeASTNode *t = new UnionTypeASTNode(CHILD(0), CHILD(1));
+
+            t->setRecordType(symbols.getRecordType(id));
+            n = t;
+            break;
+        }
+        case NK_LIST:
+        {
+            SequenceASTNode *s = new SequenceASTNode();
+
+            for (unsigned i = 0; i < getNumChildren(id); i++)
+                s->addElement(CHILD(i));
+            s->setScope(symbols.getScope(id));
+            n = s;
+            break;
+        }
+        default:
+            return NULL_AST_NODE;
+    }
+
+    n->setLineNum(_lineNums[id]);
+    n->setFlags(_flags[id]);
+    return n;
+}
+
+// Children have smaller ids than their parents, so creating the nodes of
+// the subtree in increasing id order always finds the children ready.
+ASTNode *FlatTree::expandTree(FlatNodeId id, const FlatTreeSymbols &symbols,
+                             bool copyShared)
+{
+    std::vector<FlatNodeId> subtree;
+    std::vector<FlatNodeId> stack;
+    std::unordered_map<FlatNodeId, ASTNode *> nodes;
+
+    if (id == FLAT_NULL_NODE)
+        return NULL_AST_NODE;
+
+    stack.push_back(id);
+    while (!stack.empty())
+    {
+        FlatNodeId i = stack.back();
+
+        stack.pop_back();
+        subtree.push_back(i);
+        for (unsigned c = 0; c < getNumChildren(i); c++)
+            if (getChild(i, c) != FLAT_NULL_NODE)
+                stack.push_back(getChild(i, c));
+    }
+
+    std::sort(subtree.begin(), subtree.end());
+    subtree.erase(std::unique(subtree.begin(), subtree.end()), subtree.end());
+
+    nodes[FLAT_NULL_NODE] = NULL_AST_NODE;
+    for (unsigned i = 0; i < subtree.size(); i++)
+        nodes[subtree[i]] =
+            createNode(subtree[i], nodes, symbols, copyShared);
+
+    return nodes[id];
+}
+
+ASTNode *FlatTree::expand(FlatNodeId id)
+{
+    return expandTree(id, _symbols, false);
+}
+
+ASTNode *FlatTree::expand(FlatNodeId id, const FlatTreeSymbols &symbols)
+{
+    return expandTree(id, symbols, true);
+}
+
+void FlatTree::visit(TreeVisitor *visitor)
+{
+    for (unsigned i = 0; i < _topLevel.size(); i++)
+    {
+        SequenceASTNode *seq = new SequenceASTNode();
+
+        seq->addElement(expand(_topLevel[i]));
+        visitor->visit(seq);
+        ASTNode::destroy(seq);
+    }
+}
+
+size_t FlatTree::getMemoryUsage()
+{
+    size_t bytes = _kinds.capacity() * sizeof(uint8_t) +
+                   _lineNums.capacity() * sizeof(int) +
+                   _flags.capacity() * sizeof(unsigned) +
+                   _values.capacity() * sizeof(uint32_t) +
+                   _firstChild.capacity() * sizeof(uint32_t) +
+                   _numChildren.capacity() * sizeof(uint32_t) +
+                   _children.capacity() * sizeof(FlatNodeId);
+
+    for (unsigned i = 0; i < _strings.size(); i++)
+        bytes += _strings[i].capacity();
+    return bytes;
+}
+
+} // namespace cparser
@@ -0,0 +1,338 @@
+// Formatter server and client - implementation file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#include "../include/FormatServer.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace cparser
+{
+
+// Longest request or response header line
+#define MAX_HEADER_LEN 64
+
+// Seconds a request process waits for the whole request
+#define REQUEST_TIMEOUT 10
+
+static bool readAll(int fd, char *buf, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t n = read(fd, buf, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        buf += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool writeAll(int fd, const char *buf, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t n = write(fd, buf, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        buf += n;
+        size -= n;
+    }
+    return true;
+}
+
+// Read a header line without the newline.
+static bool readHeader(int fd, char *buf)
+{
+    for (unsigned i = 0; i < MAX_HEADER_LEN; i++)
+    {
+        if (!readAll(fd, buf + i, 1))
+            return false;
+        if (buf[i] == '\n')
+        {
+            buf[i] = '\0';
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool makeAddress(const char *socketPath, struct sockaddr_un *addr)
+{
+    if (strlen(socketPath) >= sizeof(addr->sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, socketPath);
+    return true;
+}
+
+// Run format on the source in a child process and capture everything it
+// prints, together with its exit status.
+static int formatInChild(const std::string &source, unsigned flags,
+                         FormatFunc format, std::string &output)
+{
+    FILE *out = tmpfile();
+
+    if (out == NULL)
+        return -1;
+
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        dup2(fileno(out), STDOUT_FILENO);
+        dup2(fileno(out), STDERR_FILENO);
+
+        // fmemopen() can not open an empty buffer.
+        FILE *in = source.empty()
+                       ? fopen("/dev/null", "r")
+                       : fmemopen((void *) source.data(), source.size(), "r");
+        if (in == NULL)
+            exit(1);
+        format(in, flags);
+        exit(0);
+    }
+
+    int status = -1;
+    if (pid > 0)
+    {
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+            ;
+        if (WIFEXITED(status))
+            status = WEXITSTATUS(status);
+        else
+            status = 128 + WTERMSIG(status);
+
+        long size;
+        if (fseek(out, 0, SEEK_END) == 0 && (size = ftell(out)) > 0)
+        {
+            output.resize(size);
+            rewind(out);
+            if (fread(&output[0], 1, size, out) != (size_t) size)
+                status = -1;
+        }
+    }
+    fclose(out);
+    return status;
+}
+
+static bool readRequest(int conn, unsigned &flags, std::string &source)
+{
+    char header[MAX_HEADER_LEN];
+    size_t size;
+
+    if (!readHeader(conn, header) ||
+        sscanf(header, "FORMAT %u %zu", &flags, &size) != 2)
+        return false;
+
+    source.resize(size);
+    return size == 0 || readAll(conn, &source[0], size);
+}
+
+// Serve the request on conn, in the process forked for it. The note of
+// prepare is written to notes.
+static void serveConnection(int conn, FormatFunc format, PrepareFunc prepare,
+                            int notes)
+{
+    char header[MAX_HEADER_LEN];
+    unsigned flags;
+    std::string source;
+    std::string output;
+
+    // A client that does not send the whole request in time is dropped.
+    alarm(REQUEST_TIMEOUT);
+    if (!readRequest(conn, flags, source))
+        return;
+    alarm(0);
+
+    if (prepare != NULL)
+    {
+        std::string note = prepare(source, flags);
+
+        writeAll(notes, note.data(), note.size());
+        close(notes);
+    }
+
+    int status = formatInChild(source, flags, format, output);
+
+    snprintf(header, sizeof(header), "%d %zu\n", status, output.size());
+    if (writeAll(conn, header, strlen(header)))
+        writeAll(conn, output.data(), output.size());
+}
+
+// A process serving a request, and the pipe its note is read from
+struct Handler
+{
+    int notes;
+    std::string note;
+};
+
+bool runFormatServer(const char *socketPath, FormatFunc format,
+                     PrepareFunc prepare, AdoptFunc adopt)
+{
+    struct sockaddr_un addr;
+    struct stat st;
+    int fd;
+
+    if (!makeAddress(socketPath, &addr))
+        return false;
+
+    // Only the socket of an earlier server is replaced, never another file.
+    if (lstat(socketPath, &st) == 0)
+    {
+        if (!S_ISSOCK(st.st_mode))
+        {
+            errno = EEXIST;
+            return false;
+        }
+        unlink(socketPath);
+    }
+
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+        return false;
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+        listen(fd, SOMAXCONN) < 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    std::vector<Handler> handlers;
+    std::vector<struct pollfd> fds;
+
+    for (;;)
+    {
+        // Connection handlers that are done are reaped.
+        while (waitpid(-1, NULL, WNOHANG) > 0)
+            ;
+
+        fds.assign(1, pollfd{fd, POLLIN, 0});
+        for (const Handler &h : handlers)
+            fds.push_back(pollfd{h.notes, POLLIN, 0});
+        if (poll(&fds[0], fds.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            close(fd);
+            return false;
+        }
+
+        // A note is adopted once its handler has written all of it.
+        for (size_t i = handlers.size(); i-- > 0;)
+        {
+            char buf[4096];
+            ssize_t n;
+
+            if (fds[i + 1].revents == 0)
+                continue;
+            n = read(handlers[i].notes, buf, sizeof(buf));
+            if (n > 0 || (n < 0 && errno == EINTR))
+            {
+                handlers[i].note.append(buf, n > 0 ? n : 0);
+                continue;
+            }
+            close(handlers[i].notes);
+            if (!handlers[i].note.empty() && adopt != NULL)
+                adopt(handlers[i].note);
+            handlers.erase(handlers.begin() + i);
+        }
+
+        if ((fds[0].revents & POLLIN) == 0)
+            continue;
+
+        int conn = accept(fd, NULL, NULL);
+        if (conn < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            close(fd);
+            return false;
+        }
+
+        int notes[2] = {-1, -1};
+        if (prepare != NULL && pipe(notes) < 0)
+        {
+            close(conn);
+            continue;
+        }
+
+        // Each request is read and formatted by its own process, so a slow
+        // client does not hold up the others.
+        fflush(stdout);
+        fflush(stderr);
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            close(fd);
+            for (const Handler &h : handlers)
+                close(h.notes);
+            if (notes[0] >= 0)
+                close(notes[0]);
+            serveConnection(conn, format, prepare, notes[1]);
+            close(conn);
+            _exit(0);
+        }
+        close(conn);
+        if (notes[1] >= 0)
+            close(notes[1]);
+        if (pid > 0 && notes[0] >= 0)
+            handlers.push_back(Handler{notes[0], ""});
+        else if (notes[0] >= 0)
+            close(notes[0]);
+    }
+}
+
+int formatRemote(const char *socketPath, const std::string &source,
+                 unsigned flags, std::string &output)
+{
+    struct sockaddr_un addr;
+    char header[MAX_HEADER_LEN];
+    int fd;
+
+    if (!makeAddress(socketPath, &addr) ||
+        (fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+        return -1;
+
+    int status = -1;
+    int remoteStatus;
+    size_t size;
+    snprintf(header, sizeof(header), "FORMAT %u %zu\n", flags, source.size());
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0 &&
+        writeAll(fd, header, strlen(header)) &&
+        writeAll(fd, source.data(), source.size()) && readHeader(fd, header) &&
+        sscanf(header, "%d %zu", &remoteStatus, &size) == 2)
+    {
+        output.resize(size);
+        if (size == 0 || readAll(fd, &output[0], size))
+            status = remoteStatus;
+    }
+    close(fd);
+    return status;
+}
+
+} // namespace cparser
@@ -9,6 +9,7 @@
 #include "../include/ASTNode.h"
 #include "../include/TreeVisitor.h"
 
+#include <cstdio>
 #include <iostream>
 
 #define TAB_SIZE 4
@@ -16,61 +17,97 @@
 namespace cparser
 {
 
-static void printTab(int n)
+void GenCVisitor::printTab(int n)
 {
     int i, x;
 
     x = n * TAB_SIZE;
     for (i = 0; i < x; i++)
-        std::cout << " ";
+        *_out << " ";
 }
 
 void GenCVisitor::visit(IdentASTNode *n)
 {
-    std::cout << n->getValue();
+    *_out << n->getValue();
 }
 
 void GenCVisitor::visit(IntegerConstASTNode *n)
 {
-    std::cout << n->getValue();
+    *_out << n->getValue();
 }
 
 void GenCVisitor::visit(StringConstASTNode *n)
 {
-    std::cout << "\"" << n->getValue() << "\"";
+    *_out << "\"" << n->getValue() << "\"";
 }
 
 void GenCVisitor::visit(CharConstASTNode *n)
 {
     if (n->getValue() == '\n')
-        std::cout << "'\\n'";
+        *_out << "'\\n'";
     else
-        std::cout << "'" << (char) n->getValue() << "'";
+        *_out << "'" << (char) n->getValue() << "'";
+}
+
+// The values are formatted into one buffer and written at once.
+void GenCVisitor::visit(PackedConstArrayASTNode *n)
+{
+    std::string buf;
+    char num[16];
+    bool isChar = n->getElementKind() == NK_CHAR_CONST;
+
+    buf.reserve(n->size() * (isChar ? 5 : 6) + 2);
+    buf += '{';
+    for (unsigned i = 0; i < n->size(); i++)
+    {
+        int value = n->getValue(i);
+
+        if (i > 0)
+            buf += ", ";
+
+        if (!isChar)
+        {
+            buf.append(num, snprintf(num, sizeof(num), "%d", value));
+        }
+        else if (value == '\n')
+        {
+            buf += "'\\n'";
+        }
+        else
+        {
+            buf += '\'';
+            buf += (char) value;
+            buf += '\'';
+        }
+    }
+    buf += '}';
+
+    _out->write(buf.data(), buf.size());
 }
 
 void GenCVisitor::visit(SizeOfExprASTNode *n)
 {
-    std::cout << "sizeof(";
+    *_out << "sizeof(";
     if (n->getExpr() != NULL_AST_NODE)
         n->getExpr()->accept(this);
 
-    std::cout << ")";
+    *_out << ")";
 }
 
 void GenCVisitor::visit(AlignOfExprASTNode *n)
 {
-    std::cout << "_Alignof(";
+    *_out << "_Alignof(";
     if (n->getExpr() != NULL_AST_NODE)
         n->getExpr()->accept(this);
 
-    std::cout << ")";
+    *_out << ")";
 }
 
 void GenCVisitor::visit(TypeDeclASTNode *n)
 {
-    std::cout << "typedef ";
+    *_out << "typedef ";
     n->getBody()->accept(this);
-    std::cout << " ";
+    *_out << " ";
     n->getName()->accept(this);
 }
 
@@ -78,15 +115,15 @@ void GenCVisitor::visit(FunctionDeclASTNode *n)
 {
     n->getType()->accept(this);
 
-    std::cout << " ";
+    *_out << " ";
 
     n->getName()->accept(this);
 
-    std::cout << "(";
+    *_out << "(";
     _inList++;
     n->getPrms()->accept(this);
     _inList--;
-    std::cout << ")" << std::endl;
+    *_out << ")" << std::endl;
 
     n->getBody()->accept(this);
 }
@@ -96,39 +133,51 @@ void GenCVisitor::visit(VarDeclASTNode *n)
     // if (n->getType()->getKind() == NK_FUNCTION_TYPE)
     // {
     //     static_cast<FunctionTypeASTNode *>(n->getType())->getType()->accept(this);
-    //     std::cout << "(*";
+    //     *_out << "(*";
     //     n->getName()->accept(this);
-    //     std::cout << ")";
-    //     std::cout << "(";
+    //     *_out << ")";
+    //     *_out << "(";
     //     _inList++;
     //     static_cast<FunctionTypeASTNode *>(n->getType())->getPrms()->accept(this);
     //     _inList--;
-    //     std::cout << ")";
+    //     *_out << ")";
     // }
     // else
     // {
 
     n->getType()->accept(this);
 
-    std::cout << " ";
+    *_out << " ";
 
 //    if (n->getType()->getKind() == NK_POINTER_TYPE)
-//        std::cout << "*";
+//        *_out << "*";
 
     n->getName()->accept(this);
 
     if (n->getType()->getKind() == NK_ARRAY_TYPE)
     {
-        std::cout << "[";
+        *_out << "[";
         // Print out type expression
         static_cast<ArrayTypeASTNode *>(n->getType())->getExpr()->accept(this);
-        std::cout << "]";
+        *_out << "]";
     }
 
     if (n->getInit() != NULL_AST_NODE)
     {
-        std::cout << " = ";
-        n->getInit()->accept(this);
+        *_out << " = ";
+        if (n->getInit()->getKind() == NK_LIST)
+        {
+            // Initializer list
+            *_out << "{";
+            _inList++;
+            n->getInit()->accept(this);
+            _inList--;
+            *_out << "}";
+        }
+        else
+        {
+            n->getInit()->accept(this);
+        }
     }
 
     // }
@@ -139,10 +188,10 @@ void GenCVisitor::visit(ParmDeclASTNode *n)
     if (n->getType() != NULL_AST_NODE)
         n->getType()->accept(this);
 
-    std::cout << " ";
+    *_out << " ";
 
 //    if (n->getType()->getKind() == NK_POINTER_TYPE)
-//        std::cout << "*";
+//        *_out << "*";
 
     if (n->getName() != NULL_AST_NODE)
         n->getName()->accept(this);
@@ -152,17 +201,17 @@ void GenCVisitor::visit(FieldDeclASTNode *n)
 {
 //    _level++;
 //    printTab(_level);
-//    std::cout << "NK_FIELD_DECL" << std::endl;
+//    *_out << "NK_FIELD_DECL" << std::endl;
 //    if (n->getName() != NULL_AST_NODE)
 //    {
 //        printTab(_level);
-//        std::cout << "Name:" << std::endl;
+//        *_out << "Name:" << std::endl;
 //        n->getName()->accept(this);
 //    }
 //    if (n->getType() != NULL_AST_NODE)
 //    {
 //        printTab(_level);
-//        std::cout << "Type:" << std::endl;
+//        *_out << "Type:" << std::endl;
 //        n->getType()->accept(this);
 //    }
 //    _level--;
@@ -170,43 +219,55 @@ void GenCVisitor::visit(FieldDeclASTNode *n)
     if (n->getType() != NULL_AST_NODE)
         n->getType()->accept(this);
 
-    std::cout << " ";
-
     if (n->getName() != NULL_AST_NODE)
+    {
+        *_out << " ";
         n->getName()->accept(this);
+    }
 
+    // A flexible array member
+    if (n->getType()->getKind() == NK_ARRAY_TYPE &&
+        static_cast<ArrayTypeASTNode *>(n->getType())->getExpr() ==
+            NULL_AST_NODE)
+        *_out << "[]";
+
+    if (n->getBitWidth() != NULL_AST_NODE)
+    {
+        *_out << " : ";
+        n->getBitWidth()->accept(this);
+    }
 }
 
 void GenCVisitor::visit(AsmStmtASTNode *n)
 {
     printTab(_level + 1);
-    std::cout << "NK_ASM_STMT" << std::endl;
+    *_out << "NK_ASM_STMT" << std::endl;
     printTab(_level + 1);
-    std::cout << "Data:" << std::endl;
+    *_out << "Data:" << std::endl;
     printTab(_level + 2);
-    std::cout << n->getData() << std::endl;
+    *_out << n->getData() << std::endl;
 }
 
 void GenCVisitor::visit(BreakStmtASTNode *n)
 {
-    std::cout << "break";
+    *_out << "break";
 }
 
 void GenCVisitor::visit(CaseLabelASTNode *n)
 {
     _level++;
     printTab(_level);
-    std::cout << "CASE_LABEL" << std::endl;
+    *_out << "CASE_LABEL" << std::endl;
     if (n->getExpr() != NULL_AST_NODE)
     {
         printTab(_level);
-        std::cout << "Expression:" << std::endl;
+        *_out << "Expression:" << std::endl;
         n->getExpr()->accept(this);
     }
     if (n->getStmt() != NULL_AST_NODE)
     {
         printTab(_level);
-        std::cout << "Statement:" << std::endl;
+        *_out << "Statement:" << std::endl;
         n->getStmt()->accept(this);
     }
     _level--;
@@ -215,7 +276,7 @@ void GenCVisitor::visit(CaseLabelASTNode *n)
 void GenCVisitor::visit(CompoundStmtASTNode *n)
 {
     printTab(_level);
-    std::cout << "{" << std::endl;
+    *_out << "{" << std::endl;
 
     _level++;
 
@@ -232,59 +293,59 @@ void GenCVisitor::visit(CompoundStmtASTNode *n)
     _level--;
 
     printTab(_level);
-    std::cout << "}" << std::endl;
+    *_out << "}" << std::endl;
 }
 
 void GenCVisitor::visit(ContinueStmtASTNode *n)
 {
-    std::cout << "continue";
+    *_out << "continue";
 }
 
 void GenCVisitor::visit(DoStmtASTNode *n)
 {
-    std::cout << "do" << std::endl;
+    *_out << "do" << std::endl;
     n->getBody()->accept(this);
     printTab(_level);
-    std::cout << "while (";
+    *_out << "while (";
     n->getCondition()->accept(this);
-    std::cout << ");" << std::endl;
+    *_out << ");" << std::endl;
 }
 
 void GenCVisitor::visit(ForStmtASTNode *n)
 {
-    std::cout << "for (";
+    *_out << "for (";
     if (n->getInit() != NULL_AST_NODE)
         n->getInit()->accept(this);
 
-    std::cout << ";";
+    *_out << ";";
     if (n->getCondition() != NULL_AST_NODE)
     {
-        std::cout << " ";
+        *_out << " ";
         n->getCondition()->accept(this);
     }
-    std::cout << ";";
+    *_out << ";";
     if (n->getStep() != NULL_AST_NODE)
     {
-        std::cout << " ";
+        *_out << " ";
         n->getStep()->accept(this);
     }
 
-    std::cout << ")" << std::endl;
+    *_out << ")" << std::endl;
     n->getBody()->accept(this);
 }
 
 void GenCVisitor::visit(GotoStmtASTNode *n)
 {
-    std::cout << "goto ";
+    *_out << "goto ";
     n->getLabel()->accept(this);
 }
 
 void GenCVisitor::visit(IfStmtASTNode *n)
 {
-    std::cout << "if (";
+    *_out << "if (";
     if (n->getCondition() != NULL_AST_NODE)
         n->getCondition()->accept(this);
-    std::cout << ")" << std::endl;
+    *_out << ")" << std::endl;
 
     if (n->getThenClause() != NULL_AST_NODE)
     {
@@ -296,17 +357,17 @@ void GenCVisitor::visit(IfStmtASTNode *n)
     if (n->getElseClause() != NULL_AST_NODE)
     {
         printTab(_level);
-        std::cout << "else";
+        *_out << "else";
         if (n->getElseClause()->getKind() == NK_IF_STMT)
-            std::cout << " ";
+            *_out << " ";
         else
-            std::cout << std::endl;
+            *_out << std::endl;
         if (n->getElseClause()->getKind() != NK_COMPOUND_STMT &&
             n->getElseClause()->getKind() != NK_IF_STMT)
             printTab(_level+1);
         n->getElseClause()->accept(this);
     }
-    std::cout << std::endl;
+    *_out << std::endl;
 }
 
 void GenCVisitor::visit(LabelStmtASTNode *n)
@@ -315,17 +376,17 @@ void GenCVisitor::visit(LabelStmtASTNode *n)
     _level = 0;
     n->getLabel()->accept(this);
     _level = prevLevel;
-    std::cout << ":" << std::endl;
+    *_out << ":" << std::endl;
     printTab(_level);
     n->getStmt()->accept(this);
 }
 
 void GenCVisitor::visit(ReturnStmtASTNode *n)
 {
-    std::cout << "return";
+    *_out << "return";
     if (n->getExpr() != NULL_AST_NODE)
     {
-        std::cout << " ";
+        *_out << " ";
         n->getExpr()->accept(this);
     }
 }
@@ -334,17 +395,17 @@ void GenCVisitor::visit(SwitchStmtASTNode *n)
 {
     _level++;
     printTab(_level);
-    std::cout << "SWITCH_STMT" << std::endl;
+    *_out << "SWITCH_STMT" << std::endl;
     if (n->getExpr() != NULL_AST_NODE)
     {
         printTab(_level);
-        std::cout << "Expression:" << std::endl;
+        *_out << "Expression:" << std::endl;
         n->getExpr()->accept(this);
     }
     if (n->getStmt() != NULL_AST_NODE)
     {
         printTab(_level);
-        std::cout << "Statement:" << std::endl;
+        *_out << "Statement:" << std::endl;
         n->getStmt()->accept(this);
     }
     _level--;
@@ -352,10 +413,10 @@ void GenCVisitor::visit(SwitchStmtASTNode *n)
 
 void GenCVisitor::visit(WhileStmtASTNode *n)
 {
-    std::cout << "while (";
+    *_out << "while (";
     if (n->getCondition() != NULL_AST_NODE)
         n->getCondition()->accept(this);
-    std::cout << ")" << std::endl;
+    *_out << ")" << std::endl;
 
     if (n->getBody() != NULL_AST_NODE)
         n->getBody()->accept(this);
@@ -365,87 +426,87 @@ void GenCVisitor::visit(CastExprASTNode *n)
 {
 //    _level++;
 //    printTab(_level);
-//    std::cout << "NK_CAST_EXPR" << std::endl;
+//    *_out << "NK_CAST_EXPR" << std::endl;
 //    if (n->getExpr() != NULL_AST_NODE)
 //    {
 //        printTab(_level);
-//        std::cout << "Expression:" << std::endl;
+//        *_out << "Expression:" << std::endl;
 //        n->getExpr()->accept(this);
 //    }
 //    if (n->getType() != NULL_AST_NODE)
 //    {
 //        printTab(_level);
-//        std::cout << "Type:" << std::endl;
+//        *_out << "Type:" << std::endl;
 //        n->getType()->accept(this);
 //    }
 //    _level--;
 
-    std::cout << "(";
+    *_out << "(";
     n->getType()->accept(this);
-    std::cout << ") ";
+    *_out << ") ";
     n->getExpr()->accept(this);
 }
 
 void GenCVisitor::visit(BitNotExprASTNode *n)
 {
-    std::cout << "~";
+    *_out << "~";
     n->getExpr()->accept(this);
 }
 
 void GenCVisitor::visit(LogNotExprASTNode *n)
 {
-    std::cout << "!";
+    *_out << "!";
     n->getExpr()->accept(this);
 }
 
 void GenCVisitor::visit(PredecrementExprASTNode *n)
 {
-    std::cout << "--";
+    *_out << "--";
     n->getExpr()->accept(this);
 }
 
 void GenCVisitor::visit(PreincrementExprASTNode *n)
 {
-    std::cout << "++";
+    *_out << "++";
     n->getExpr()->accept(this);
 }
 
 void GenCVisitor::visit(PostdecrementExprASTNode *n)
 {
     n->getExpr()->accept(this);
-    std::cout << "--";
+    *_out << "--";
 }
 
 void GenCVisitor::visit(PostincrementExprASTNode *n)
 {
     n->getExpr()->accept(this);
-    std::cout << "++";
+    *_out << "++";
 }
 
 void GenCVisitor::visit(AddrExprASTNode *n)
 {
-    std::cout << "&";
+    *_out << "&";
     n->getExpr()->accept(this);
 }
 
 void GenCVisitor::visit(IndirectRefASTNode *n)
 {
     if (n->getField() == NULL_AST_NODE)
-        std::cout << "*";
+        *_out << "*";
 
     if (n->getExpr() != NULL_AST_NODE)
         n->getExpr()->accept(this);
 
     if (n->getField() != NULL_AST_NODE)
     {
-        std::cout << "->";
+        *_out << "->";
         n->getField()->accept(this);
     }
 
 //    if (n->getType() != NULL_AST_NODE)
 //    {
 //        printTab(_level);
-//        std::cout << "Type:" << std::endl;
+//        *_out << "Type:" << std::endl;
 //        n->getType()->accept(this);
 //    }
 //    _level--;
@@ -455,91 +516,91 @@ void GenCVisitor::visit(NopExprASTNode *n)
 {
     _level++;
     printTab(_level);
-    std::cout << "NK_NOP_EXPR" << std::endl;
+    *_out << "NK_NOP_EXPR" << std::endl;
     _level--;
 }
 
 void GenCVisitor::visit(LShiftExprASTNode *n)
 {
     n->getLhs()->accept(this);
-    std::cout << " << ";
+    *_out << " << ";
     n->getRhs()->accept(this);
 }
 
 void GenCVisitor::visit(RShiftExprASTNode *n)
 {
     n->getLhs()->accept(this);
-    std::cout << " >> ";
+    *_out << " >> ";
     n->getRhs()->accept(this);
 }
 
 void GenCVisitor::visit(BitIorExprASTNode *n)
 {
     n->getLhs()->accept(this);
-    std::cout << " | ";
+    *_out << " | ";
     n->getRhs()->accept(this);
 }
 
 void GenCVisitor::visit(BitXorExprASTNode *n)
 {
     n->getLhs()->accept(this);
-    std::cout << " ^ ";
+    *_out << " ^ ";
     n->getRhs()->accept(this);
 }
 
 void GenCVisitor::visit(BitAndExprASTNode *n)
 {
     n->getLhs()->accept(this);
-    std::cout << " & ";
+    *_out << " & ";
     n->getRhs()->accept(this);
 }
 
 void GenCVisitor::visit(LogAndExprASTNode *n)
 {
     n->getLhs()->accept(this);
-    std::cout << " && ";
+    *_out << " && ";
     n->getRhs()->accept(this);
 }
 
 void GenCVisitor::visit(LogOrExprASTNode *n)
 {
     n->getLhs()->accept(this);
-    std::cout << " || ";
+    *_out << " || ";
     n->getRhs()->accept(this);
 }
 
 void GenCVisitor::visit(PlusExprASTNode *n)
 {
     n->getLhs()->accept(this);
-    std::cout << " + ";
+    *_out << " + ";
     n->getRhs()->accept(this);
 }
 
 void GenCVisitor::visit(MinusExprASTNode *n)
 {
     n->getLhs()->accept(this);
-    std::cout << " - ";
+    *_out << " - ";
     n->getRhs()->accept(this);
 }
 
 void GenCVisitor::visit(MultExprASTNode *n)
 {
     n->getLhs()->accept(this);
-    std::cout << " * ";
+    *_out << " * ";
     n->getRhs()->accept(this);
 }
 
 void GenCVisitor::visit(TruncDivExprASTNode *n)
 {
     n->getLhs()->accept(this);
-    std::cout << " / ";
+    *_out << " / ";
     n->getRhs()->accept(this);
 }
 
 void GenCVisitor::visit(TruncModExprASTNode *n)
 {
     n->getLhs()->accept(this);
-    std::cout << " % ";
+    *_out << " % ";
     n->getRhs()->accept(this);
 }
 
@@ -547,23 +608,23 @@ void GenCVisitor::visit(ArrayRefASTNode *n)
 {
 //    _level++;
 //    printTab(_level);
-//    std::cout << "ARRAY_REF" << std::endl;
+//    *_out << "ARRAY_REF" << std::endl;
 //    if (n->getExpr() != NULL_AST_NODE)
 //    {
 //        printTab(_level);
-//        std::cout << "Expression:" << std::endl;
+//        *_out << "Expression:" << std::endl;
 //        n->getExpr()->accept(this);
 //    }
 //    if (n->getIndex() != NULL_AST_NODE)
 //    {
 //        printTab(_level);
-//        std::cout << "Index:" << std::endl;
+//        *_out << "Index:" << std::endl;
 //        n->getIndex()->accept(this);
 //    }
 //    if (n->getType() != NULL_AST_NODE)
 //    {
 //        printTab(_level);
-//        std::cout << "Element type:" << std::endl;
+//        *_out << "Element type:" << std::endl;
 //        n->getType()->accept(this);
 //    }
 //    _level--;
@@ -571,29 +632,29 @@ void GenCVisitor::visit(ArrayRefASTNode *n)
     if (n->getExpr() != NULL_AST_NODE)
         n->getExpr()->accept(this);
 
-    std::cout << "[";
+    *_out << "[";
 
     if (n->getIndex() != NULL_AST_NODE)
         n->getIndex()->accept(this);
 
-    std::cout << "]";
+    *_out << "]";
 }
 
 void GenCVisitor::visit(StructRefASTNode *n)
 {
 //    _level++;
 //    printTab(_level);
-//    std::cout << "STRUCT_REF" << std::endl;
+//    *_out << "STRUCT_REF" << std::endl;
 //    if (n->getName() != NULL_AST_NODE)
 //    {
 //        printTab(_level);
-//        std::cout << "Name:" << std::endl;
+//        *_out << "Name:" << std::endl;
 //        n->getName()->accept(this);
 //    }
 //    if (n->getMember() != NULL_AST_NODE)
 //    {
 //        printTab(_level);
-//        std::cout << "Member:" << std::endl;
+//        *_out << "Member:" << std::endl;
 //        n->getMember()->accept(this);
 //    }
 //    _level--;
@@ -601,7 +662,7 @@ void GenCVisitor::visit(StructRefASTNode *n)
     if (n->getName() != NULL_AST_NODE)
         n->getName()->accept(this);
 
-    std::cout << ".";
+    *_out << ".";
 
     if (n->getMember() != NULL_AST_NODE)
         n->getMember()->accept(this);
@@ -610,58 +671,58 @@ void GenCVisitor::visit(StructRefASTNode *n)
 void GenCVisitor::visit(LtExprASTNode *n)
 {
     n->getLhs()->accept(this);
-    std::cout << " < ";
+    *_out << " < ";
     n->getRhs()->accept(this);
 }
 
 void GenCVisitor::visit(LeExprASTNode *n)
 {
     n->getLhs()->accept(this);
-    std::cout << " <= ";
+    *_out << " <= ";
     n->getRhs()->accept(this);
 }
 
 void GenCVisitor::visit(GtExprASTNode *n)
 {
     n->getLhs()->accept(this);
-    std::cout << " > ";
+    *_out << " > ";
     n->getRhs()->accept(this);
 }
 
 void GenCVisitor::visit(GeExprASTNode *n)
 {
     n->getLhs()->accept(this);
-    std::cout << " >= ";
+    *_out << " >= ";
     n->getRhs()->accept(this);
 }
 
 void GenCVisitor::visit(EqExprASTNode *n)
 {
     n->getLhs()->accept(this);
-    std::cout << " == ";
+    *_out << " == ";
     n->getRhs()->accept(this);
 }
 
 void GenCVisitor::visit(NeExprASTNode *n)
 {
     n->getLhs()->accept(this);
-    std::cout << " != ";
+    *_out << " != ";
     n->getRhs()->accept(this);
 }
 
 void GenCVisitor::visit(AssignExprASTNode *n)
 {
     n->getLhs()->accept(this);
-    std::cout << " = ";
+    *_out << " = ";
     n->getRhs()->accept(this);
 }
 
 void GenCVisitor::visit(CondExprASTNode *n)
 {
     n->getCondition()->accept(this);
-    std::cout << " ? ";
+    *_out << " ? ";
     n->getThenClause()->accept(this);
-    std::cout << " : ";
+    *_out << " : ";
     n->getElseClause()->accept(this);
 }
 
@@ -669,41 +730,41 @@ void GenCVisitor::visit(CallExprASTNode *n)
 {
     n->getExpr()->accept(this);
 
-    std::cout << "(";
+    *_out << "(";
 
     _inList++;
     n->getArgs()->accept(this);
     _inList--;
 
-    std::cout << ")";
+    *_out << ")";
 }
 
 void GenCVisitor::visit(VoidTypeASTNode *n)
 {
-    std::cout << "void";
+    *_out << "void";
 }
 
 void GenCVisitor::visit(IntegralTypeASTNode *n)
 {
     if (!n->getIsSigned())
-        std::cout << "unsigned ";
+        *_out << "unsigned ";
 
     switch (n->getAlignment())
     {
         case 1:
-            std::cout << "char";
+            *_out << "char";
             break;
         case 2:
-            std::cout << "short";
+            *_out << "short";
             break;
         case 4:
-            std::cout << "int";
+            *_out << "int";
             break;
         case 8:
-            std::cout << "long";
+            *_out << "long";
             break;
         default:
-            std::cout << "int";
+            *_out << "int";
             break;
     }
 }
@@ -711,73 +772,73 @@ void GenCVisitor::visit(IntegralTypeASTNode *n)
 void GenCVisitor::visit(RealTypeASTNode *n)
 {
     if (n->getIsDouble())
-        std::cout << "double";
+        *_out << "double";
     else
-        std::cout << "float";
+        *_out << "float";
 }
 
 void GenCVisitor::visit(EnumeralTypeASTNode *n)
 {
-    std::cout << "enum ";
+    *_out << "enum ";
     n->getName()->accept(this);
     printTab(_level);
-    std::cout << std::endl << "{" << std::endl;
+    *_out << std::endl << "{" << std::endl;
     _level++;
     _inList++;
     n->getBody()->accept(this);
     _inList--;
     _level--;
     printTab(_level);
-    std::cout << "}";
+    *_out << "}";
 }
 
 void GenCVisitor::visit(PointerTypeASTNode *n)
 {
-//    std::cout << "* ";
+//    *_out << "* ";
     n->getBaseType()->accept(this);
-    std::cout << "*";
+    *_out << "*";
 }
 
 void GenCVisitor::visit(FunctionTypeASTNode *n)
 {
     // n->getType()->accept(this);
-    // std::cout << "(*";
+    // *_out << "(*";
     // // Name
-    // std::cout << ")";
-    std::cout << "(";
+    // *_out << ")";
+    *_out << "(";
     _inList++;
     n->getPrms()->accept(this);
     _inList--;
-    std::cout << ")";
+    *_out << ")";
 }
 
 void GenCVisitor::visit(ArrayTypeASTNode *n)
 {
-    // std::cout << "[";
+    // *_out << "[";
     // n->getExpr()->accept(this);
-    // std::cout << "]" << std::endl;
+    // *_out << "]" << std::endl;
     n->getElementType()->accept(this);
 }
 
 void GenCVisitor::visit(StructTypeASTNode *n)
 {
-    std::cout << "struct ";
+    *_out << "struct ";
 
     if (n->getName() != NULL_AST_NODE)
         n->getName()->accept(this);
 
     if (n->getBody() != NULL_AST_NODE)
     {
-        std::cout << std::endl;
+        *_out << std::endl;
         printTab(_level);
-        std::cout << "{" << std::endl;
+        *_out << "{" << std::endl;
 
         _level++;
         n->getBody()->accept(this);
         _level--;
 
         printTab(_level);
-        std::cout << "}";
+        *_out << "}";
     }
 }
 
@@ -798,37 +859,73 @@ static bool isNonSemi(ASTNodeKind n)
            n == NK_INTEGRAL_TYPE;
 }
 
+void GenCVisitor::emitElement(ASTNode *n, bool first)
+{
+    if (!_inList)
+        printTab(_level);
+    else if (!first)
+        *_out << ", ";
+    n->accept(this);
+    if (!_inList)
+    {
+        if (!isNonSemi(n->getKind()))
+            *_out << ";" << std::endl;
+    }
+}
+
 void GenCVisitor::visit(SequenceASTNode *n)
 {
     std::vector<ASTNode *> &elements = n->getElements();
 
     if (elements.size() > 0)
-    {
-        if (!_inList)
-            printTab(_level);
-        elements[0]->accept(this);
-        if (!_inList)
-        {
-            if (!isNonSemi(elements[0]->getKind()))
-                std::cout << ";" << std::endl;
-        }
-    }
+        emitElement(elements[0], true);
 
     for (unsigned i = 1; i < elements.size(); i++)
     {
         if (elements[i] == NULL_AST_NODE)
             continue;
 
-        if (!_inList)
-            printTab(_level);
-        else
-            std::cout << ", ";
-        elements[i]->accept(this);
-        if (!_inList)
-        {
-            if (!isNonSemi(elements[i]->getKind()))
-                std::cout << ";" << std::endl;
-        }
+        emitElement(elements[i], false);
+    }
+}
+
+// The clone writes to its own buffer, which merge() copies to the output of
+// this visitor.
+TreeVisitor *GenCVisitor::clone()
+{
+    GenCVisitor *v = new GenCVisitor(_level);
+
+    v->_buffer = new std::ostringstream();
+    v->_out = v->_buffer;
+    return v;
+}
+
+void GenCVisitor::merge(TreeVisitor *v)
+{
+    GenCVisitor *g = static_cast<GenCVisitor *>(v);
+
+    if (g->_buffer != nullptr)
+        *_out << g->_buffer->str();
+}
+
+void GenCVisitor::emitDeclaration(ASTNode *decl)
+{
+    if (decl == NULL_AST_NODE)
+        return;
+
+    // A declaration of several variables comes as a list. In the tree its
+    // elements are spliced into the translation unit.
+    if (decl->getKind() == NK_LIST)
+    {
+        std::vector<ASTNode *> &elements =
+            static_cast<SequenceASTNode *>(decl)->getElements();
+
+        for (unsigned i = 0; i < elements.size(); i++)
+            emitElement(elements[i], true);
+    }
+    else
+    {
+        emitElement(decl, true);
     }
 }
 
@@ -0,0 +1,412 @@
+// Header modules - implementation file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#include "../include/HeaderModule.h"
+#include "../include/FlatTree.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace cparser
+{
+
+static bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static size_t skipBlanks(const char *text, size_t i, size_t end)
+{
+    while (i < end && isBlank(text[i]))
+        i++;
+    return i;
+}
+
+static bool startsWith(const char *text, size_t i, size_t end, const char *s)
+{
+    size_t n = strlen(s);
+
+    return end - i >= n && strncmp(text + i, s, n) == 0;
+}
+
+// Lines are taken one at a time. A line that is not blank, a comment or a
+// plain #include ends the preamble, and so does anything unusual, such as a
+// line continuation or an #include of a macro.
+bool findPreamble(const char *text, size_t size, Preamble &preamble)
+{
+    bool inComment = false;
+    size_t pos = 0;
+    int line = 1;
+
+    preamble.directives.clear();
+    preamble.hasQuoted = false;
+    preamble.end = 0;
+    preamble.endLine = 1;
+
+    for (; pos < size; line++)
+    {
+        size_t eol = pos;
+
+        while (eol < size && text[eol] != '\n')
+            eol++;
+
+        size_t last = eol;
+        while (last > pos && isBlank(text[last - 1]))
+            last--;
+        if (last > pos && text[last - 1] == '\\')
+            break;
+
+        // Comments before anything else on the line
+        size_t i = pos;
+        for (;;)
+        {
+            if (inComment)
+            {
+                while (i < eol && !startsWith(text, i, eol, "*/"))
+                    i++;
+                if (i >= eol)
+                    break;
+                i += 2;
+                inComment = false;
+            }
+            i = skipBlanks(text, i, eol);
+            if (!startsWith(text, i, eol, "/*"))
+                break;
+            i += 2;
+            inComment = true;
+        }
+
+        if (i < eol && !startsWith(text, i, eol, "//"))
+        {
+            if (text[i] != '#')
+                break;
+            i = skipBlanks(text, i + 1, eol);
+            if (!startsWith(text, i, eol, "include"))
+                break;
+            i = skipBlanks(text, i + 7, eol);
+            if (i >= eol || (text[i] != '<' && text[i] != '"'))
+                break;
+
+            char close = text[i] == '<' ? '>' : '"';
+            size_t name = i++;
+
+            while (i < eol && text[i] != close)
+                i++;
+            if (i >= eol)
+                break;
+
+            std::string directive(text + name, i + 1 - name);
+
+            i = skipBlanks(text, i + 1, eol);
+            if (i < eol && !startsWith(text, i, eol, "//"))
+                break;
+
+            preamble.directives += "#include " + directive + "\n";
+            preamble.hasQuoted |= close == '"';
+            preamble.end = eol < size ? eol + 1 : size;
+            preamble.endLine = line + 1;
+        }
+
+        pos = eol + 1;
+    }
+
+    return !preamble.directives.empty();
+}
+
+static bool readFile(const char *path, std::string &text)
+{
+    FILE *fp = fopen(path, "rb");
+    char buf[65536];
+    size_t n;
+
+    if (fp == NULL)
+        return false;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        text.append(buf, n);
+    fclose(fp);
+    return true;
+}
+
+static std::string getDirectory(const char *path)
+{
+    const char *slash = path != NULL ? strrchr(path, '/') : NULL;
+
+    return slash != NULL ? std::string(path, slash - path) : ".";
+}
+
+static std::string getModuleKey(const char *path, const Preamble &preamble)
+{
+    if (!preamble.hasQuoted)
+        return preamble.directives;
+    return getDirectory(path) + "\n" + preamble.directives;
+}
+
+HeaderModuleCache::HeaderModuleCache(
+    const std::vector<const char *> &includeDirs,
+    const std::vector<const char *> &macros, bool skipSystemHeaders,
+    const std::string &options)
+    : _includeDirs(includeDirs.begin(), includeDirs.end()),
+      _macros(macros.begin(), macros.end()),
+      _skipSystemHeaders(skipSystemHeaders), _options(options),
+      _checkFiles(false)
+{
+}
+
+HeaderModuleCache::~HeaderModuleCache()
+{
+    for (auto &it : _modules)
+        delete it.second.snapshot;
+    for (PrecompiledHeader *snapshot : _replaced)
+        delete snapshot;
+}
+
+// Whether module, which is ready, can be used. Called with _mutex locked.
+bool HeaderModuleCache::isCurrent(Module &module)
+{
+    if (!_checkFiles || module.isChecked)
+        return true;
+    module.isChecked =
+        module.snapshot != nullptr && module.snapshot->isCurrent();
+    return module.isChecked;
+}
+
+// Publish module for key. Threads may still restore the snapshot it
+// replaces. Called with _mutex locked.
+void HeaderModuleCache::replace(const std::string &key, const Module &module)
+{
+    auto it = _modules.find(key);
+
+    if (it != _modules.end() && it->second.snapshot != nullptr)
+        _replaced.push_back(it->second.snapshot);
+    _modules[key] = module;
+}
+
+Preprocessor *HeaderModuleCache::createPreprocessor(const char *path)
+{
+    Preprocessor *pp = new Preprocessor(path);
+
+    for (const std::string &dir : _includeDirs)
+        pp->addIncludeDir(dir);
+    for (const std::string &macro : _macros)
+        pp->defineMacro(macro);
+    for (const std::string &prefix : _ignoredPaths)
+        pp->getSourceManager()->addIgnoredPath(prefix);
+    pp->setSkipCache(&_skipCache);
+    return pp;
+}
+
+// Parse only the preamble of text, see attach(). Its snapshot is made in
+// snapshot, or written to the file at output if snapshot is nullptr.
+bool HeaderModuleCache::parsePreamble(const char *path,
+                                      const std::string &text,
+                                      const Preamble &preamble,
+                                      ReferenceSink *refSink,
+                                      PrecompiledHeader *snapshot,
+                                      const char *output)
+{
+    Preprocessor *pp = createPreprocessor(path);
+    const char *header = path != NULL ? path : "<stdin>";
+    bool ok;
+
+    if (path == NULL)
+        pp->setMainText(&text);
+    pp->setMainFileRange(0, 1, preamble.end);
+    {
+        CParser parser(pp);
+        FlatTree tree;
+        FlatTreeBuilder builder(&tree);
+
+        parser.setSkipSystemHeaders(_skipSystemHeaders);
+        parser.setDeclarationSink(&builder);
+        parser.setReferenceSink(refSink);
+        parser.parse("");
+        if (snapshot != nullptr)
+            ok = snapshot->build(_options, header, &parser, &tree, pp);
+        else
+            ok = PrecompiledHeader::write(output, _options, header, &parser,
+                                          &tree, pp);
+    }
+    delete pp;
+    return ok;
+}
+
+PrecompiledHeader *HeaderModuleCache::build(const char *path,
+                                            const std::string &text,
+                                            const Preamble &preamble,
+                                            ReferenceSink *refSink)
+{
+    PrecompiledHeader *snapshot = new PrecompiledHeader();
+
+    if (!parsePreamble(path, text, preamble, refSink, snapshot, nullptr))
+    {
+        delete snapshot;
+        snapshot = nullptr;
+    }
+    return snapshot;
+}
+
+std::string HeaderModuleCache::prepare(const char *path,
+                                       const std::string &text)
+{
+    Preamble preamble;
+
+    if (!findPreamble(text.data(), text.size(), preamble))
+        return "";
+
+    std::string key = getModuleKey(path, preamble);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _modules.find(key);
+
+        if (it != _modules.end() && it->second.isReady &&
+            isCurrent(it->second))
+            return "";
+    }
+
+    char output[] = "/tmp/cformat-module-XXXXXX";
+    int fd = mkstemp(output);
+
+    if (fd < 0)
+        return "";
+    close(fd);
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        int null = open("/dev/null", O_WRONLY);
+
+        if (null >= 0)
+        {
+            dup2(null, STDOUT_FILENO);
+            dup2(null, STDERR_FILENO);
+        }
+        _exit(parsePreamble(path, text, preamble, nullptr, nullptr, output)
+                  ? 0
+                  : 1);
+    }
+
+    int status = 1;
+    if (pid > 0)
+    {
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+            ;
+    }
+
+    // A module that could not be made is kept too, so it is not tried again
+    // by this process.
+    PrecompiledHeader *snapshot = nullptr;
+    if (pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0)
+    {
+        snapshot = new PrecompiledHeader();
+        if (!snapshot->load(output, _options))
+        {
+            delete snapshot;
+            snapshot = nullptr;
+        }
+    }
+    if (snapshot == nullptr)
+        unlink(output);
+
+    if (pid > 0)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        replace(key, Module{true, true, snapshot});
+    }
+    return snapshot != nullptr ? std::string(output) + "\n" + key : "";
+}
+
+void HeaderModuleCache::adopt(const std::string &note)
+{
+    size_t newline = note.find('\n');
+
+    if (newline == std::string::npos)
+        return;
+
+    std::string output = note.substr(0, newline);
+    PrecompiledHeader *snapshot = new PrecompiledHeader();
+
+    if (snapshot->load(output.c_str(), _options))
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        replace(note.substr(newline + 1), Module{true, false, snapshot});
+    }
+    else
+        delete snapshot;
+    unlink(output.c_str());
+}
+
+bool HeaderModuleCache::attach(const char *path, Preprocessor *pp,
+                               CParser *parser, ReferenceSink *refSink,
+                               bool *isBuilt)
+{
+    std::string text;
+
+    if (isBuilt != nullptr)
+        *isBuilt = false;
+
+    if (!readFile(path, text))
+        return false;
+    return attach(path, text, pp, parser, refSink, isBuilt);
+}
+
+bool HeaderModuleCache::attach(const char *path, const std::string &text,
+                               Preprocessor *pp, CParser *parser,
+                               ReferenceSink *refSink, bool *isBuilt)
+{
+    Preamble preamble;
+
+    if (isBuilt != nullptr)
+        *isBuilt = false;
+
+    if (!findPreamble(text.data(), text.size(), preamble))
+        return false;
+
+    std::string key = getModuleKey(path, preamble);
+
+    PrecompiledHeader *snapshot;
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    auto it = _modules.find(key);
+
+    if (it != _modules.end() && it->second.isReady && !isCurrent(it->second))
+        it = _modules.end();
+    if (it == _modules.end())
+    {
+        // Other translation units with the preamble wait until it is built.
+        replace(key, Module{false, false, nullptr});
+        lock.unlock();
+        snapshot = build(path, text, preamble, refSink);
+        if (isBuilt != nullptr)
+            *isBuilt = true;
+        lock.lock();
+        _modules[key] = Module{true, true, snapshot};
+        _ready.notify_all();
+    }
+    else
+    {
+        _ready.wait(lock, [&]() { return _modules[key].isReady; });
+        snapshot = _modules[key].snapshot;
+    }
+    lock.unlock();
+
+    if (snapshot == nullptr)
+        return false;
+    pp->setMainFileRange(preamble.end, preamble.endLine, -1);
+    snapshot->restoreMacros(pp);
+    parser->setPrecompiledHeader(snapshot);
+    return true;
+}
+
+} // namespace cparser
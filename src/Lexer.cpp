@@ -7,6 +7,8 @@
 
 #include "../include/Lexer.h"
 
+#include <cassert>
+#include <cstdarg>
 #include <cstdio>
 #include <ctype.h>
 #include <iostream>
@@ -59,6 +61,7 @@ int Lexer::powr(int x, int n)
 void Lexer::nextCh()
 {
     _ch = getc(_fp);
+    _offset++;
     _col++;
     if (_ch == '\n')
     {
@@ -67,11 +70,56 @@ void Lexer::nextCh()
     }
 }
 
+Lexer::State Lexer::getState() const
+{
+    State s;
+
+    s.offset = _offset;
+    s.ch = _ch;
+    s.line = _line;
+    s.col = _col;
+    return s;
+}
+
+void Lexer::setState(const State &s)
+{
+    assert(_seekable && "input is not seekable");
+
+    fseek(_fp, s.offset, SEEK_SET);
+    _offset = s.offset;
+    _ch = s.ch;
+    _line = s.line;
+    _col = s.col;
+}
+
+// Continue reading at the token starting at the given offset.
+void Lexer::seek(long offset, int line, int col)
+{
+    assert(_seekable && "input is not seekable");
+
+    fseek(_fp, offset, SEEK_SET);
+    _ch = getc(_fp);
+    _offset = offset + 1;
+    _line = line;
+    _col = col;
+}
+
+Lexer::Lexer()
+{
+    _line = 1;
+    _col = 0;
+    _ch = 0;
+    _offset = 0;
+    _fp = NULL;
+    _seekable = false;
+}
+
 Lexer::Lexer(const char *filename)
 {
     _line = 1;
     _col = 0;
     _ch = 0;
+    _offset = 0;
 
     // Load source file
     if (filename == NULL)
@@ -84,6 +132,18 @@ Lexer::Lexer(const char *filename)
         printf("Fatal error: file '%s' does not exists!\n", filename);
         exit(1);
     }
+
+    _seekable = filename != NULL && fseek(_fp, 0, SEEK_CUR) == 0;
+}
+
+Lexer::Lexer(FILE *fp)
+{
+    _line = 1;
+    _col = 0;
+    _ch = 0;
+    _offset = 0;
+    _fp = fp;
+    _seekable = fseek(_fp, 0, SEEK_CUR) == 0;
 }
 
 } // namespace cparser
@@ -13,6 +13,8 @@
 namespace cparser
 {
 
+std::map<unsigned, const char *> Parser::_name;
+
 void Parser::getTok()
 {
     _tokIdx = _laIdx;
@@ -75,6 +77,12 @@ void Parser::initTokenBuffer()
     _lex->next(&_tokbuf[1]);
     _lex->next(&_tokbuf[2]);
     _laIdx = 0;
+
+    // No token is taken yet. The current token is the slot before the first
+    // lookahead one, placed at the first token for error messages.
+    _tokIdx = TOK_BUF_LEN - 1;
+    _tokbuf[_tokIdx] = _tokbuf[0];
+    _tok = &_tokbuf[_tokIdx];
 }
 
 } // namespace cparser
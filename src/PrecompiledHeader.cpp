@@ -0,0 +1,948 @@
+// Precompiled header - implementation file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#include "../include/PrecompiledHeader.h"
+#include "../include/TreeWalker.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace cparser
+{
+
+#define PCH_MAGIC "CFPCH\0\0\4"
+#define PCH_MAGIC_LEN 8
+
+// Reference to nothing
+#define PCH_NONE 0xffffffffu
+
+// Type references below this are the predefined types of the symbol table,
+// in the order of getPredefinedTypes().
+#define PCH_PREDEFINED_TYPES 10
+
+static void getPredefinedTypes(SymbolTable *stb, STType **types)
+{
+    types[0] = stb->charType;
+    types[1] = stb->shortType;
+    types[2] = stb->intType;
+    types[3] = stb->unsignedType;
+    types[4] = stb->longType;
+    types[5] = stb->floatType;
+    types[6] = stb->doubleType;
+    types[7] = stb->voidType;
+    types[8] = stb->nullType;
+    types[9] = stb->noType;
+}
+
+static uint64_t hashBytes(const char *data, size_t size)
+{
+    uint64_t h = 14695981039346656037ull; // FNV-1a
+
+    for (size_t i = 0; i < size; i++)
+    {
+        h ^= (unsigned char) data[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// Size and hash of the contents of the file at path
+static bool hashFile(const std::string &path, uint64_t &size, uint64_t &hash)
+{
+    struct stat st;
+    int fd = open(path.c_str(), O_RDONLY);
+    bool ok = false;
+
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+    {
+        size = st.st_size;
+        if (size == 0)
+        {
+            hash = hashBytes("", 0);
+            ok = true;
+        }
+        else
+        {
+            void *p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (p != MAP_FAILED)
+            {
+                hash = hashBytes((const char *) p, size);
+                munmap(p, size);
+                ok = true;
+            }
+        }
+    }
+    close(fd);
+    return ok;
+}
+
+//
+// Encoding
+//
+
+// All numbers are written as 32 or 64-bit little-endian words, strings as
+// their length and bytes.
+class PchBuffer
+{
+    std::string _data;
+
+public:
+    void u8(uint8_t v) { _data.push_back(v); }
+
+    void u32(uint32_t v)
+    {
+        for (int i = 0; i < 4; i++)
+            _data.push_back((v >> (8 * i)) & 0xff);
+    }
+
+    void u64(uint64_t v)
+    {
+        u32(v);
+        u32(v >> 32);
+    }
+
+    void str(const std::string &s)
+    {
+        u32(s.size());
+        _data += s;
+    }
+
+    const std::string &getData() { return _data; }
+};
+
+// Reads back what PchBuffer wrote. Reading past the end sets an error and
+// returns zeros.
+class PchReader
+{
+    const unsigned char *_p;
+    const unsigned char *_end;
+    bool _ok;
+
+public:
+    PchReader(const char *data, size_t size)
+        : _p((const unsigned char *) data),
+          _end((const unsigned char *) data + size), _ok(true)
+    {
+    }
+
+    bool ok() { return _ok; }
+
+    bool skip(size_t n)
+    {
+        if ((size_t)(_end - _p) < n)
+        {
+            _ok = false;
+            _p = _end;
+            return false;
+        }
+        _p += n;
+        return true;
+    }
+
+    uint8_t u8()
+    {
+        const unsigned char *p = _p;
+
+        return skip(1) ? p[0] : 0;
+    }
+
+    uint32_t u32()
+    {
+        const unsigned char *p = _p;
+
+        if (!skip(4))
+            return 0;
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+    }
+
+    uint64_t u64()
+    {
+        uint64_t low = u32();
+
+        return low | ((uint64_t) u32() << 32);
+    }
+
+    std::string str()
+    {
+        uint32_t n = u32();
+        const unsigned char *p = _p;
+
+        if (!skip(n))
+            return std::string();
+        return std::string((const char *) p, n);
+    }
+
+    // Number of records that follow, each at least minSize bytes. Counts
+    // that can not fit are an error, so they are safe to reserve.
+    uint32_t count(size_t minSize)
+    {
+        uint32_t n = u32();
+
+        if ((size_t)(_end - _p) / minSize < n)
+        {
+            _ok = false;
+            return 0;
+        }
+        return n;
+    }
+};
+
+// Numbers the scopes, objects and types reachable from the global scope,
+// and writes them.
+class SymbolWriter
+{
+    STType *_predefined[PCH_PREDEFINED_TYPES];
+    STScope *_universe; // Outer scope of the global scope
+
+    std::unordered_map<STScope *, uint32_t> _scopeIds;
+    std::unordered_map<STObject *, uint32_t> _objectIds;
+    std::unordered_map<STType *, uint32_t> _typeIds;
+    std::vector<STScope *> _scopes;
+    std::vector<STObject *> _objects;
+    std::vector<STType *> _types;
+
+public:
+    SymbolWriter(SymbolTable *stb, STScope *global)
+    {
+        getPredefinedTypes(stb, _predefined);
+        for (uint32_t i = 0; i < PCH_PREDEFINED_TYPES; i++)
+            _typeIds[_predefined[i]] = i;
+        _universe = global->outer;
+        scopeRef(global);
+    }
+
+    uint32_t scopeRef(STScope *s)
+    {
+        if (s == nullptr || s == _universe)
+            return PCH_NONE;
+
+        auto it = _scopeIds.find(s);
+        if (it != _scopeIds.end())
+            return it->second;
+        _scopes.push_back(s);
+        return _scopeIds[s] = _scopes.size() - 1;
+    }
+
+    uint32_t objectRef(STObject *o)
+    {
+        if (o == nullptr)
+            return PCH_NONE;
+
+        auto it = _objectIds.find(o);
+        if (it != _objectIds.end())
+            return it->second;
+        _objects.push_back(o);
+        return _objectIds[o] = _objects.size() - 1;
+    }
+
+    uint32_t typeRef(STType *t)
+    {
+        if (t == nullptr)
+            return PCH_NONE;
+
+        auto it = _typeIds.find(t);
+        if (it != _typeIds.end())
+            return it->second;
+        _types.push_back(t);
+        return _typeIds[t] = PCH_PREDEFINED_TYPES + _types.size() - 1;
+    }
+
+    // Number everything reachable from what is numbered so far.
+    void close()
+    {
+        size_t s = 0, o = 0, t = 0;
+
+        while (s < _scopes.size() || o < _objects.size() || t < _types.size())
+        {
+            for (; s < _scopes.size(); s++)
+            {
+                scopeRef(_scopes[s]->outer);
+                objectRef(_scopes[s]->locals);
+            }
+            for (; o < _objects.size(); o++)
+            {
+                typeRef(_objects[o]->type);
+                objectRef(_objects[o]->locals);
+                objectRef(_objects[o]->next);
+            }
+            for (; t < _types.size(); t++)
+            {
+                typeRef(_types[t]->elemType);
+                typeRef(_types[t]->baseType);
+                typeRef(_types[t]->funcType);
+                objectRef(_types[t]->fields);
+                if (_types[t]->layout != nullptr)
+                    for (const FieldLayout &f : _types[t]->layout->getFields())
+                        typeRef(f.type.record);
+            }
+        }
+    }
+
+    // Objects located in the input itself are in header.
+    void write(PchBuffer &b, const char *header)
+    {
+        b.u32(_scopes.size());
+        for (STScope *s : _scopes)
+        {
+            b.u32(scopeRef(s->outer));
+            b.u32(objectRef(s->locals));
+            b.u32(s->nVars);
+            b.u32(s->nPars);
+            b.u32(s->size);
+        }
+
+        b.u32(_types.size());
+        for (STType *t : _types)
+        {
+            b.u32(t->kind);
+            b.u32(typeRef(t->elemType));
+            b.u32(typeRef(t->baseType));
+            b.u32(typeRef(t->funcType));
+            b.u32(objectRef(t->fields));
+            b.u32(t->nFields);
+            b.u32(t->length);
+            b.u32(t->size);
+            b.u8(t->isSigned);
+            b.str(t->name != nullptr ? t->name : "");
+            b.u8(t->layout != nullptr);
+            if (t->layout == nullptr)
+                continue;
+
+            RecordLayout *l = t->layout;
+            b.u8(l->isUnion());
+            b.u8(l->isComplete());
+            b.u32(l->getSize());
+            b.u32(l->getAlignment());
+            b.u32(l->getFields().size());
+            for (const FieldLayout &f : l->getFields())
+            {
+                b.str(f.name);
+                b.u32(f.offset);
+                b.u32(f.size);
+                b.u32(f.bitOffset);
+                b.u32(f.bitWidth);
+                b.u32(typeRef(f.type.record));
+                b.u32(f.type.indirection);
+            }
+        }
+
+        b.u32(_objects.size());
+        for (STObject *o : _objects)
+        {
+            b.u32(o->kind);
+            b.str(o->name);
+            b.u32(typeRef(o->type));
+            b.u32(objectRef(o->locals));
+            b.u32(objectRef(o->next));
+            b.u32(o->ival);
+            b.u32(o->level);
+            b.u32(o->prmc);
+            b.u8(o->isConstant);
+            b.str(o->file != nullptr ? o->file : header);
+            b.u32(o->line);
+            b.u8(o->isDefinition);
+            b.u8(o->isStatic);
+        }
+    }
+};
+
+static bool isStringNode(ASTNodeKind kind)
+{
+    return kind == NK_IDENT_NODE || kind == NK_STRING_CONST ||
+           kind == NK_ASM_STMT;
+}
+
+// Nodes whose reference is a type, see FlatTreeSymbols::recordTypes.
+static bool hasRecordType(ASTNodeKind kind)
+{
+    return kind == NK_STRUCT_TYPE || kind == NK_UNION_TYPE ||
+           kind == NK_STRUCT_REF || kind == NK_INDIRECT_REF;
+}
+
+static void writeTree(PchBuffer &b, FlatTree *tree, SymbolWriter &symbols)
+{
+    b.u32(tree->size());
+    for (FlatNodeId id = 1; id < tree->size(); id++)
+    {
+        ASTNodeKind kind = tree->getKind(id);
+        uint32_t ref = PCH_NONE;
+
+        b.u8(kind);
+        b.u32(tree->getLineNum(id));
+        b.u32(tree->getFlags(id));
+
+        if (isStringNode(kind))
+            b.str(tree->getString(id));
+        else if (kind == NK_PACKED_CONST_ARRAY)
+        {
+            PackedConstArrayASTNode *array =
+                static_cast<PackedConstArrayASTNode *>(
+                    tree->getPackedArray(id));
+
+            b.u8(array->getElementKind());
+            b.u32(array->size());
+            for (unsigned i = 0; i < array->size(); i++)
+                b.u32(array->getValue(i));
+            continue;
+        }
+        else
+            b.u32(tree->getValue(id));
+
+        if (hasRecordType(kind))
+            ref = symbols.typeRef(tree->getRecordType(id));
+        else if (tree->getScope(id) != nullptr)
+            ref = symbols.scopeRef(tree->getScope(id));
+        b.u32(ref);
+
+        b.u32(tree->getNumChildren(id));
+        for (unsigned i = 0; i < tree->getNumChildren(id); i++)
+            b.u32(tree->getChild(id, i));
+    }
+
+    b.u32(tree->getTopLevel().size());
+    for (FlatNodeId id : tree->getTopLevel())
+        b.u32(id);
+}
+
+static void writeMacros(PchBuffer &b, Preprocessor *pp)
+{
+    uint32_t n = 0;
+
+    for (auto &it : pp->getMacros())
+        n += it.second.isDefined;
+
+    b.u32(n);
+    for (auto &it : pp->getMacros())
+    {
+        const Macro &m = it.second;
+
+        if (!m.isDefined)
+            continue;
+        b.str(it.first);
+        b.u8(m.isFunctionLike);
+        b.u8(m.isVariadic);
+        b.u32(m.params.size());
+        for (const std::string &param : m.params)
+            b.str(param);
+        b.u32(m.body.size());
+        for (size_t i = 0; i < m.body.size(); i++)
+        {
+            const PPToken &t = m.body[i];
+
+            b.u32(t.tok.kind);
+            b.u32(t.tok.info.ival);
+            b.str(t.tok.sval);
+            b.str(std::string(t.spelling, t.length));
+            b.u8(t.hasSpace);
+            b.u32(m.bodyParams[i]);
+        }
+    }
+}
+
+bool PrecompiledHeader::encode(std::string &data, const std::string &options,
+                               const char *header, CParser *parser,
+                               FlatTree *tree, Preprocessor *pp)
+{
+    PchBuffer b;
+    SequenceASTNode *root =
+        static_cast<SequenceASTNode *>(parser->getAST()->getRoot());
+    SymbolWriter symbols(parser->getSymbolTable(), root->getScope());
+    std::vector<std::string> files;
+
+    // Files the contents of the snapshot depend on
+    if (pp != nullptr)
+    {
+        std::vector<const SourceFile *> sourceFiles;
+
+        pp->getSourceFiles(sourceFiles);
+        for (const SourceFile *f : sourceFiles)
+            files.push_back(f->path);
+    }
+    else
+        files.push_back(header);
+
+    b.u32(0); // Room for the magic
+    b.u32(0);
+    b.str(header);
+    b.str(options);
+    b.u32(files.size());
+    for (const std::string &file : files)
+    {
+        uint64_t size, hash;
+
+        if (!hashFile(file, size, hash))
+            return false;
+        b.str(file);
+        b.u64(size);
+        b.u64(hash);
+    }
+
+    // The tree goes first to number the scopes and types it refers to.
+    PchBuffer treeBuffer;
+    writeTree(treeBuffer, tree, symbols);
+    symbols.close();
+    symbols.write(b, header);
+
+    data = b.getData() + treeBuffer.getData();
+    PchBuffer rest;
+
+    if (pp != nullptr)
+    {
+        std::vector<const SourceFile *> sourceFiles;
+        std::vector<std::pair<std::string, std::string>> guards;
+
+        writeMacros(rest, pp);
+        pp->getSourceFiles(sourceFiles);
+        for (const SourceFile *f : sourceFiles)
+        {
+            bool isOnce;
+            std::string guard, id;
+
+            if (pp->getSkipCache()->find(f->path, isOnce, guard, id))
+                guards.push_back({f->path, isOnce ? "" : guard});
+        }
+        rest.u32(guards.size());
+        for (auto &g : guards)
+        {
+            rest.str(g.first);
+            rest.u8(g.second.empty());
+            rest.str(g.second);
+        }
+    }
+    else
+    {
+        rest.u32(0);
+        rest.u32(0);
+    }
+    data += rest.getData();
+    memcpy(&data[0], PCH_MAGIC, PCH_MAGIC_LEN);
+    return true;
+}
+
+bool PrecompiledHeader::write(const char *path, const std::string &options,
+                              const char *header, CParser *parser,
+                              FlatTree *tree, Preprocessor *pp)
+{
+    std::string data;
+
+    if (!encode(data, options, header, parser, tree, pp))
+        return false;
+
+    // Write a temporary file and rename it, so a snapshot that is read at
+    // the same time is never seen half written.
+    std::string tmp = std::string(path) + ".tmp";
+    FILE *fp = fopen(tmp.c_str(), "wb");
+
+    if (fp == NULL)
+        return false;
+    bool ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+    ok = fclose(fp) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path) != 0)
+    {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+//
+// Decoding
+//
+
+bool PrecompiledHeader::load(const char *path, const std::string &options)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    bool ok = false;
+
+    _error = "can not read it";
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (p != MAP_FAILED)
+        {
+            ok = decode((const char *) p, st.st_size, options);
+            munmap(p, st.st_size);
+        }
+    }
+    close(fd);
+    return ok;
+}
+
+bool PrecompiledHeader::decode(const char *data, size_t size,
+                               const std::string &options)
+{
+    PchReader r(data, size);
+
+    if (size < PCH_MAGIC_LEN || memcmp(data, PCH_MAGIC, PCH_MAGIC_LEN) != 0)
+    {
+        _error = "not a precompiled header";
+        return false;
+    }
+    r.skip(PCH_MAGIC_LEN);
+
+    // The header is known even if the snapshot is not used.
+    _header = r.str();
+    if (r.str() != options)
+    {
+        _error = "it was made with other options";
+        return false;
+    }
+
+    uint32_t n = r.count(20);
+    _sourceFiles.clear();
+    _sourceStamps.clear();
+    for (uint32_t i = 0; i < n && r.ok(); i++)
+    {
+        std::string file = r.str();
+        uint64_t expectedSize = r.u64(), expectedHash = r.u64();
+        uint64_t fileSize, hash;
+
+        if (r.ok() && (!hashFile(file, fileSize, hash) ||
+                       fileSize != expectedSize || hash != expectedHash))
+        {
+            _error = "'" + file + "' changed";
+            return false;
+        }
+        _sourceFiles.push_back(file);
+        _sourceStamps.push_back(std::make_pair(expectedSize, expectedHash));
+    }
+
+    n = r.count(20);
+    _scopes.resize(n);
+    for (ScopeRecord &s : _scopes)
+    {
+        s.outer = r.u32();
+        s.locals = r.u32();
+        s.nVars = r.u32();
+        s.nPars = r.u32();
+        s.size = r.u32();
+    }
+
+    n = r.count(42);
+    _types.resize(n);
+    for (TypeRecord &t : _types)
+    {
+        t.kind = (STTypeKind) r.u32();
+        t.elemType = r.u32();
+        t.baseType = r.u32();
+        t.funcType = r.u32();
+        t.fields = r.u32();
+        t.nFields = r.u32();
+        t.length = r.u32();
+        t.size = r.u32();
+        t.isSigned = r.u8();
+        std::string name = r.str();
+        t.name = name.empty() ? nullptr : internName(name);
+        t.layout = PCH_NONE;
+        if (!r.u8())
+            continue;
+
+        bool isUnion = r.u8(), isComplete = r.u8();
+        unsigned layoutSize = r.u32(), alignment = r.u32();
+        std::vector<FieldLayout> fields(r.count(28));
+
+        t.fieldRecords.resize(fields.size());
+        for (size_t i = 0; i < fields.size(); i++)
+        {
+            FieldLayout &f = fields[i];
+
+            f.name = r.str();
+            f.offset = r.u32();
+            f.size = r.u32();
+            f.bitOffset = r.u32();
+            f.bitWidth = r.u32();
+            t.fieldRecords[i] = r.u32();
+            f.type = RecordRef{nullptr, r.u32()};
+        }
+        t.layout = _layouts.size();
+        _layouts.push_back(
+            RecordLayout(isUnion, isComplete, layoutSize, alignment, fields));
+    }
+
+    n = r.count(47);
+    _objects.resize(n);
+    for (ObjectRecord &o : _objects)
+    {
+        o.kind = (STObjectKind) r.u32();
+        o.name = internName(r.str());
+        o.type = r.u32();
+        o.locals = r.u32();
+        o.next = r.u32();
+        o.ival = r.u32();
+        o.level = r.u32();
+        o.prmc = r.u32();
+        o.isConstant = r.u8();
+        o.file = internName(r.str());
+        o.line = r.u32();
+        o.isDefinition = r.u8();
+        o.isStatic = r.u8();
+    }
+
+    // Node 0 is the null node of the tree.
+    n = r.count(1);
+    std::vector<FlatNodeId> children;
+    for (FlatNodeId id = 1; id < n && r.ok(); id++)
+    {
+        ASTNodeKind kind = (ASTNodeKind) r.u8();
+        int line = r.u32();
+        unsigned flags = r.u32();
+        uint32_t value;
+
+        if (kind == NK_PACKED_CONST_ARRAY)
+        {
+            ASTNodeKind elementKind = (ASTNodeKind) r.u8();
+            std::vector<int> values(r.count(4));
+
+            for (int &v : values)
+                v = r.u32();
+
+            ASTNode *array = new PackedConstArrayASTNode(elementKind, values);
+            array->setLineNum(line);
+            array->setFlags(flags);
+            _tree.add(array);
+            continue;
+        }
+
+        if (isStringNode(kind))
+            value = _tree.addString(r.str().c_str());
+        else
+            value = r.u32();
+
+        uint32_t ref = r.u32();
+        children.resize(r.count(4));
+        for (FlatNodeId &child : children)
+        {
+            child = r.u32();
+            if (child >= id)
+                r.skip(size); // Children come before their parents.
+        }
+
+        _tree.addNode(kind, line, flags, value, children);
+        if (ref != PCH_NONE)
+            _nodeRefs.push_back({id, ref, hasRecordType(kind)});
+    }
+
+    n = r.count(4);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        FlatNodeId id = r.u32();
+
+        if (id == FLAT_NULL_NODE || id >= _tree.size())
+            r.skip(size);
+        _tree.getTopLevel().push_back(id);
+    }
+
+    n = r.count(10);
+    _macros.resize(n);
+    for (auto &it : _macros)
+    {
+        Macro &m = it.second;
+
+        it.first = r.str();
+        m.isDefined = true;
+        m.isFunctionLike = r.u8();
+        m.isVariadic = r.u8();
+        m.isDisabled = false;
+        m.params.resize(r.count(4));
+        for (std::string &param : m.params)
+            param = r.str();
+        m.body.resize(r.count(21));
+        m.bodyParams.resize(m.body.size());
+        for (size_t i = 0; i < m.body.size(); i++)
+        {
+            PPToken &t = m.body[i];
+
+            t.tok.kind = r.u32();
+            t.tok.info.ival = r.u32();
+            t.tok.sval = r.str();
+            t.tok.line = t.tok.col = 0;
+            t.tok.offset = 0;
+            t.file = nullptr;
+            _spellings.push_back(r.str());
+            t.spelling = _spellings.back().data();
+            t.length = _spellings.back().size();
+            t.hasSpace = r.u8();
+            t.noExpand = false;
+            m.bodyParams[i] = r.u32();
+            if (m.bodyParams[i] >= (int) m.params.size())
+                r.skip(size);
+        }
+    }
+
+    n = r.count(9);
+    _readFiles.resize(n);
+    for (ReadFile &f : _readFiles)
+    {
+        f.path = r.str();
+        f.isOnce = r.u8();
+        f.guard = r.str();
+    }
+
+    if (!r.ok())
+    {
+        _error = "it is damaged";
+        return false;
+    }
+    return true;
+}
+
+bool PrecompiledHeader::build(const std::string &options, const char *header,
+                              CParser *parser, FlatTree *tree,
+                              Preprocessor *pp)
+{
+    std::string data;
+
+    if (!encode(data, options, header, parser, tree, pp))
+    {
+        _error = "can not read the files of it";
+        return false;
+    }
+    return decode(data.data(), data.size(), options);
+}
+
+bool PrecompiledHeader::isCurrent()
+{
+    for (size_t i = 0; i < _sourceFiles.size(); i++)
+    {
+        uint64_t size, hash;
+
+        if (!hashFile(_sourceFiles[i], size, hash) ||
+            size != _sourceStamps[i].first || hash != _sourceStamps[i].second)
+        {
+            _error = "'" + _sourceFiles[i] + "' changed";
+            return false;
+        }
+    }
+    return true;
+}
+
+void PrecompiledHeader::restoreMacros(Preprocessor *pp)
+{
+    for (auto &it : _macros)
+        pp->addMacro(it.first, it.second);
+    for (const ReadFile &f : _readFiles)
+        pp->addReadFile(f.path, f.isOnce, f.guard);
+}
+
+void PrecompiledHeader::restoreSymbols(SymbolTable *stb,
+                                       FlatTreeSymbols &nodeSymbols)
+{
+    STType *predefined[PCH_PREDEFINED_TYPES];
+    STScope *global = stb->getTopScope();
+    std::vector<STScope *> scopes(_scopes.size());
+    std::vector<STObject *> objects(_objects.size());
+    std::vector<STType *> types(_types.size());
+
+    getPredefinedTypes(stb, predefined);
+
+    // Allocate everything first, the records refer to each other.
+    for (size_t i = 0; i < scopes.size(); i++)
+        scopes[i] = i == 0 ? global : stb->allocScope();
+    for (size_t i = 0; i < types.size(); i++)
+        types[i] = stb->allocType(_types[i].kind);
+    for (size_t i = 0; i < objects.size(); i++)
+        objects[i] = stb->allocObject(_objects[i].name,
+                                      _objects[i].kind, nullptr);
+
+    auto scope = [&](uint32_t ref) {
+        return ref < scopes.size() ? scopes[ref] : global->outer;
+    };
+    auto object = [&](uint32_t ref) {
+        return ref < objects.size() ? objects[ref] : nullptr;
+    };
+    auto type = [&](uint32_t ref) -> STType * {
+        if (ref < PCH_PREDEFINED_TYPES)
+            return predefined[ref];
+        ref -= PCH_PREDEFINED_TYPES;
+        return ref < types.size() ? types[ref] : nullptr;
+    };
+
+    for (size_t i = 0; i < scopes.size(); i++)
+    {
+        const ScopeRecord &r = _scopes[i];
+
+        if (i > 0)
+            scopes[i]->outer = scope(r.outer);
+        scopes[i]->locals = object(r.locals);
+        scopes[i]->nVars = r.nVars;
+        scopes[i]->nPars = r.nPars;
+        scopes[i]->size = r.size;
+    }
+
+    // The universe is at level -1, the global scope at 0
+    for (size_t i = 1; i < scopes.size(); i++)
+    {
+        int level = -2;
+        for (STScope *s = scopes[i]; s; s = s->outer)
+            level++;
+        scopes[i]->level = level;
+    }
+
+    for (size_t i = 0; i < types.size(); i++)
+    {
+        const TypeRecord &r = _types[i];
+        STType *t = types[i];
+
+        t->elemType = type(r.elemType);
+        t->baseType = type(r.baseType);
+        t->funcType = type(r.funcType);
+        t->fields = object(r.fields);
+        t->nFields = r.nFields;
+        t->length = r.length;
+        t->size = r.size;
+        t->isSigned = r.isSigned;
+        t->name = r.name;
+        if (r.layout < _layouts.size())
+        {
+            t->layout = new RecordLayout(_layouts[r.layout]);
+
+            std::vector<FieldLayout> &fields = t->layout->getFields();
+            for (size_t j = 0; j < fields.size(); j++)
+                fields[j].type.record = type(r.fieldRecords[j]);
+        }
+    }
+
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        const ObjectRecord &r = _objects[i];
+        STObject *o = objects[i];
+
+        o->type = type(r.type);
+        o->locals = object(r.locals);
+        o->next = object(r.next);
+        o->ival = r.ival;
+        o->level = r.level;
+        o->prmc = r.prmc;
+        o->isConstant = r.isConstant;
+        o->file = r.file;
+        o->line = r.line;
+        o->isDefinition = r.isDefinition;
+        o->isStatic = r.isStatic;
+    }
+
+    for (const NodeRef &n : _nodeRefs)
+    {
+        if (n.isRecordType)
+            nodeSymbols.recordTypes[n.id] = type(n.ref);
+        else
+            nodeSymbols.scopes[n.id] = scope(n.ref);
+    }
+}
+
+} // namespace cparser
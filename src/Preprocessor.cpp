@@ -0,0 +1,1532 @@
+// Preprocessor - implementation file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#include "../include/Preprocessor.h"
+
+#include <cctype>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cparser
+{
+
+// Deeper nesting of #include files is most likely a file that includes
+// itself.
+#define MAX_INCLUDE_DEPTH 200
+
+#define PREDEFINED_MACROS                                                      \
+    "#define __STDC__ 1\n"                                                     \
+    "#define __STDC_VERSION__ 201112L\n"                                       \
+    "#define __STDC_HOSTED__ 1\n"                                              \
+    "#define __CHAR_BIT__ 8\n"                                                 \
+    "#define __LP64__ 1\n"                                                     \
+    "#define __x86_64__ 1\n"                                                   \
+    "#define __linux__ 1\n"                                                    \
+    "#define __unix__ 1\n"                                                     \
+    "#define __SIZE_TYPE__ long unsigned int\n"                                \
+    "#define __PTRDIFF_TYPE__ long int\n"                                      \
+    "#define __WCHAR_TYPE__ int\n"                                             \
+    "#define __WINT_TYPE__ unsigned int\n"                                     \
+    "#define __INTMAX_TYPE__ long int\n"                                       \
+    "#define __UINTMAX_TYPE__ long unsigned int\n"                             \
+    "#define __CHAR16_TYPE__ short unsigned int\n"                             \
+    "#define __CHAR32_TYPE__ unsigned int\n"                                   \
+    "#define __SCHAR_MAX__ 0x7f\n"                                             \
+    "#define __SHRT_MAX__ 0x7fff\n"                                            \
+    "#define __INT_MAX__ 0x7fffffff\n"                                         \
+    "#define __LONG_MAX__ 0x7fffffffffffffffL\n"                               \
+    "#define __LONG_LONG_MAX__ 0x7fffffffffffffffLL\n"                         \
+    "#define __WCHAR_MAX__ 0x7fffffff\n"                                       \
+    "#define __WCHAR_MIN__ (-__WCHAR_MAX__ - 1)\n"                             \
+    "#define __SIZEOF_INT__ 4\n"                                               \
+    "#define __SIZEOF_LONG__ 8\n"                                              \
+    "#define __SIZEOF_LONG_LONG__ 8\n"                                         \
+    "#define __SIZEOF_POINTER__ 8\n"                                           \
+    "#define __SIZEOF_SIZE_T__ 8\n"
+
+// Headers of the compiler itself, as stddef.h, are in a directory named
+// after its version.
+#define COMPILER_DIR "/usr/lib/gcc/x86_64-linux-gnu"
+
+static const char *s_standardIncludeDirs[] = {
+    "/usr/local/include", "", "/usr/include/x86_64-linux-gnu", "/usr/include",
+    NULL};
+
+// Include directory of the newest compiler version, or an empty string.
+static std::string findCompilerIncludeDir()
+{
+    DIR *dir = opendir(COMPILER_DIR);
+    std::string best;
+    struct dirent *entry;
+    struct stat st;
+
+    if (dir == NULL)
+        return best;
+
+    while ((entry = readdir(dir)) != NULL)
+    {
+        std::string path =
+            std::string(COMPILER_DIR "/") + entry->d_name + "/include";
+
+        if (!isdigit((unsigned char) entry->d_name[0]) ||
+            stat((path + "/stddef.h").c_str(), &st) != 0)
+            continue;
+        if (best.empty() || strverscmp(path.c_str(), best.c_str()) > 0)
+            best = path;
+    }
+    closedir(dir);
+    return best;
+}
+
+// Identity of a file, see SourceFile::id
+static std::string getFileId(const struct stat &st)
+{
+    return std::to_string(st.st_dev) + ":" + std::to_string(st.st_ino);
+}
+
+// Keywords keep their spelling in sval, as identifiers do.
+static inline bool isName(const PPToken &t)
+{
+    return !t.tok.sval.empty() && t.tok.kind != TK_STRING_LIT;
+}
+
+static std::string getText(const std::vector<PPToken> &tokens, size_t first)
+{
+    std::string text;
+
+    for (size_t i = first; i < tokens.size(); i++)
+    {
+        if (i > first && tokens[i].hasSpace)
+            text += ' ';
+        text.append(tokens[i].spelling, tokens[i].length);
+    }
+    return text;
+}
+
+Preprocessor::Preprocessor(const char *filename)
+    : _mainPath(filename), _mainText(nullptr), _mainStart(0),
+      _mainStartLine(1), _mainEnd(-1), _started(false),
+      _predefined(PREDEFINED_MACROS),
+      _skipCache(&_ownSkipCache), _outFile(nullptr), _outLine(0),
+      _outSourceLine(0)
+{
+    CLexer::initialize();
+}
+
+Preprocessor::~Preprocessor()
+{
+    while (!_files.empty())
+        popFile();
+
+    for (auto &it : _sourceFiles)
+    {
+        SourceFile *file = it.second;
+
+        if (file != nullptr && file->isMapped)
+            munmap((void *) file->data, file->size);
+        delete file;
+    }
+}
+
+void IncludeSkipCache::setOnce(const std::string &path, const std::string &id)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _entries[path] = Entry{true, "", id};
+}
+
+void IncludeSkipCache::setGuard(const std::string &path,
+                                const std::string &macro)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // #pragma once takes precedence.
+    _entries.emplace(path, Entry{false, macro, ""});
+}
+
+bool IncludeSkipCache::find(const std::string &path, bool &isOnce,
+                            std::string &guard, std::string &id)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _entries.find(path);
+
+    if (it == _entries.end())
+        return false;
+    isOnce = it->second.isOnce;
+    guard = it->second.guard;
+    id = it->second.id;
+    return true;
+}
+
+void Preprocessor::fatal(const char *format, ...)
+{
+    char dest[4096];
+
+    va_list argptr;
+    va_start(argptr, format);
+    vsnprintf(dest, sizeof(dest), format, argptr);
+    va_end(argptr);
+
+    if (_files.empty())
+        printf("error: %s\n", dest);
+    else
+        printf("error: %s; file %s, line %d\n", dest,
+               _files.back().file->path.c_str(), _files.back().line);
+
+    exit(1);
+}
+
+void Preprocessor::addIncludeDir(const std::string &dir, bool isSystem)
+{
+    _includeDirs.push_back({dir, isSystem});
+}
+
+void Preprocessor::defineMacro(const std::string &definition)
+{
+    size_t eq = definition.find('=');
+
+    if (eq == std::string::npos)
+        _predefined += "#define " + definition + " 1\n";
+    else
+        _predefined += "#define " + definition.substr(0, eq) + " " +
+                       definition.substr(eq + 1) + "\n";
+}
+
+void Preprocessor::addForcedInclude(const std::string &path)
+{
+    _predefined += "#include \"" + path + "\"\n";
+}
+
+void Preprocessor::addMacro(const std::string &name, const Macro &macro)
+{
+    Macro &m = _macros[name];
+
+    m = macro;
+    m.isDisabled = false;
+    for (PPToken &t : m.body)
+    {
+        _spellings.push_back(std::string(t.spelling, t.length));
+        t.spelling = _spellings.back().data();
+        t.file = nullptr;
+    }
+}
+
+void Preprocessor::getSourceFiles(std::vector<const SourceFile *> &files)
+{
+    for (auto &it : _sourceFiles)
+        if (it.second != nullptr && it.first != "<built-in>" &&
+            it.first != "<stdin>")
+            files.push_back(it.second);
+}
+
+void Preprocessor::addReadFile(const std::string &path, bool isOnce,
+                               const std::string &guard)
+{
+    struct stat st;
+
+    if (isOnce)
+    {
+        if (stat(path.c_str(), &st) == 0)
+        {
+            std::string id = getFileId(st);
+
+            _skipCache->setOnce(path, id);
+            _onceIncluded.insert(id);
+        }
+    }
+    else
+        _skipCache->setGuard(path, guard);
+}
+
+//
+// Files
+//
+
+// Files are looked up once, the ones that do not exist are remembered too.
+SourceFile *Preprocessor::loadFile(const std::string &path,
+                                   bool isSystemHeader)
+{
+    auto it = _sourceFiles.find(path);
+
+    if (it != _sourceFiles.end())
+        return it->second;
+
+    SourceFile *file = nullptr;
+    struct stat st;
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+    {
+        file = new SourceFile();
+        file->path = path;
+        file->id = getFileId(st);
+        file->data = "";
+        file->size = st.st_size;
+        file->isMapped = false;
+        file->isSystemHeader = isSystemHeader;
+
+        if (file->size > 0)
+        {
+            void *p = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (p == MAP_FAILED)
+            {
+                delete file;
+                file = nullptr;
+            }
+            else
+            {
+                file->data = (const char *) p;
+                file->isMapped = true;
+            }
+        }
+    }
+    if (fd >= 0)
+        close(fd);
+
+    _sourceFiles[path] = file;
+    return file;
+}
+
+void Preprocessor::pushFile(SourceFile *file, int dirIndex)
+{
+    IncludedFile f;
+
+    if (_files.size() >= MAX_INCLUDE_DEPTH)
+        fatal("#include nested too deeply");
+
+    // There is nothing to read in an empty file.
+    if (file->size == 0)
+        return;
+
+    f.file = file;
+    f.fp = fmemopen((void *) file->data, file->size, "r");
+    if (f.fp == NULL)
+        fatal("can not read '%s'", file->path.c_str());
+    f.lexer = new CLexer(f.fp);
+    f.lexer->setPreprocessing(true);
+    f.lexer->start();
+    f.dirIndex = dirIndex;
+    f.condDepth = _conds.size();
+    f.lastEnd = 0;
+    f.line = 1;
+    f.guardState = GS_START;
+    f.guardCond = 0;
+    _files.push_back(f);
+}
+
+void Preprocessor::popFile()
+{
+    delete _files.back().lexer;
+    fclose(_files.back().fp);
+    _files.pop_back();
+}
+
+// Load the file at path for #include, unless reading it again is known to
+// give nothing. Then skip is set instead.
+SourceFile *Preprocessor::loadInclude(const std::string &path,
+                                      bool isSystemHeader, bool &skip)
+{
+    bool isOnce;
+    std::string guard, id;
+
+    if (_skipCache->find(path, isOnce, guard, id) &&
+        (isOnce ? _onceIncluded.count(id) != 0 : isMacroDefined(guard)))
+    {
+        skip = true;
+        return nullptr;
+    }
+
+    // A #pragma once file may be included by another path.
+    SourceFile *file = loadFile(path, isSystemHeader);
+
+    if (file != nullptr && _onceIncluded.count(file->id) != 0)
+    {
+        skip = true;
+        return nullptr;
+    }
+    return file;
+}
+
+SourceFile *Preprocessor::findInclude(const std::string &name, bool isQuoted,
+                                      bool isNext, int &dirIndex, bool &skip)
+{
+    IncludedFile &current = _files.back();
+    size_t first = 0;
+
+    dirIndex = -1;
+    skip = false;
+    if (!name.empty() && name[0] == '/')
+        return loadInclude(name, false, skip);
+
+    if (isNext)
+        first = current.dirIndex + 1;
+    else if (isQuoted)
+    {
+        // Quoted names are looked up next to the including file first.
+        const std::string &path = current.file->path;
+        size_t slash = path.rfind('/');
+        SourceFile *file =
+            loadInclude(slash == std::string::npos
+                            ? name
+                            : path.substr(0, slash + 1) + name,
+                        current.file->isSystemHeader, skip);
+
+        if (file != nullptr || skip)
+        {
+            dirIndex = current.dirIndex;
+            return file;
+        }
+    }
+
+    for (size_t i = first; i < _includeDirs.size(); i++)
+    {
+        SourceFile *file = loadInclude(_includeDirs[i].path + "/" + name,
+                                       _includeDirs[i].isSystem, skip);
+
+        if (file != nullptr || skip)
+        {
+            dirIndex = i;
+            return file;
+        }
+    }
+    return nullptr;
+}
+
+void Preprocessor::start()
+{
+    SourceFile *file;
+
+    if (_started)
+        return;
+    _started = true;
+
+    for (const char **dir = s_standardIncludeDirs; *dir != NULL; dir++)
+    {
+        std::string path = **dir != '\0' ? *dir : findCompilerIncludeDir();
+
+        if (!path.empty())
+            addIncludeDir(path, true);
+    }
+
+    if (_mainPath != NULL)
+        file = loadFile(_mainPath, false);
+    else
+    {
+        char buf[65536];
+        size_t n;
+
+        file = new SourceFile();
+        file->path = "<stdin>";
+        file->id = file->path;
+        if (_mainText != nullptr)
+            file->text = *_mainText;
+        else
+            while ((n = fread(buf, 1, sizeof(buf), stdin)) > 0)
+                file->text.append(buf, n);
+        _sourceFiles[file->path] = file;
+    }
+
+    if (file == nullptr)
+    {
+        printf("Fatal error: file '%s' does not exists!\n", _mainPath);
+        exit(1);
+    }
+    if (_mainPath == NULL)
+    {
+        file->data = file->text.data();
+        file->size = file->text.size();
+        file->isMapped = false;
+        file->isSystemHeader = false;
+    }
+    pushFile(file, -1);
+    if (_mainStart > 0 && !_files.empty())
+    {
+        IncludedFile &f = _files.back();
+
+        // The line before ends with a newline.
+        f.lexer->seek(_mainStart, _mainStartLine, 1);
+        f.lastEnd = _mainStart - 1;
+        f.line = _mainStartLine;
+    }
+
+    // The predefined macros are read before the main file.
+    file = new SourceFile();
+    file->path = "<built-in>";
+    file->id = file->path;
+    file->text = _predefined;
+    file->data = file->text.data();
+    file->size = file->text.size();
+    file->isMapped = false;
+    file->isSystemHeader = false;
+    _sourceFiles[file->path] = file;
+    pushFile(file, -1);
+}
+
+//
+// Tokens
+//
+
+void Preprocessor::lexToken(IncludedFile &f, PPToken &t)
+{
+    t.tok.sval.clear();
+    f.lexer->next(&t.tok);
+
+    long end = f.lexer->getState().offset - 1;
+    if (end > (long) f.file->size)
+        end = f.file->size;
+
+    t.file = f.file;
+    t.spelling = f.file->data + t.tok.offset;
+    t.length = end > t.tok.offset ? end - t.tok.offset : 0;
+    t.hasSpace = t.tok.offset != f.lastEnd;
+    t.noExpand = false;
+    f.lastEnd = end;
+    // The newline that ends a directive is counted on the next line.
+    if (t.tok.kind != TK_PP_LINE_END)
+        f.line = t.tok.line;
+}
+
+// Next token of the included files. Directives are carried out on the way.
+void Preprocessor::readFileToken(PPToken &t)
+{
+    // Nothing is lexed into t once the files have ended.
+    if (_files.empty())
+        t = PPToken();
+
+    while (!_files.empty())
+    {
+        IncludedFile &f = _files.back();
+
+        lexToken(f, t);
+        // The rest of the main file is not read, see setMainFileRange().
+        if (_files.size() == 1 && _mainEnd >= 0 && t.tok.offset >= _mainEnd)
+            t.tok.kind = TK_EOF;
+
+        if (t.tok.kind == TK_PP_DIRECTIVE)
+            directive();
+        else if (t.tok.kind != TK_EOF)
+        {
+            // Tokens outside the guard mean the file is not guarded.
+            if (f.guardState != GS_INSIDE)
+                f.guardState = GS_NONE;
+            return;
+        }
+        else
+        {
+            if (_conds.size() > f.condDepth)
+                fatal("unterminated conditional directive");
+            if (f.guardState == GS_AFTER)
+                _skipCache->setGuard(f.file->path, f.guardMacro);
+            popFile();
+        }
+    }
+
+    t = makeToken(t, TK_EOF, 0, "", 0);
+    t.file = nullptr;
+}
+
+void Preprocessor::readToken(PPToken &t)
+{
+    while (!_contexts.empty())
+    {
+        Context &c = _contexts.back();
+
+        if (c.pos < c.tokens.size())
+        {
+            t = std::move(c.tokens[c.pos++]);
+            return;
+        }
+        if (c.macro != nullptr)
+            c.macro->isDisabled = false;
+        _contexts.pop_back();
+    }
+    readFileToken(t);
+}
+
+void Preprocessor::ungetToken(const PPToken &t)
+{
+    _contexts.push_back(Context{std::vector<PPToken>(1, t), 0, nullptr});
+}
+
+void Preprocessor::readDirectiveLine(std::vector<PPToken> &line)
+{
+    IncludedFile &f = _files.back();
+    PPToken t;
+
+    line.clear();
+    for (;;)
+    {
+        lexToken(f, t);
+        if (t.tok.kind == TK_PP_LINE_END)
+            break;
+        line.push_back(t);
+    }
+}
+
+PPToken Preprocessor::makeToken(const PPToken &where, unsigned kind,
+                                int value, const char *spelling,
+                                unsigned length)
+{
+    PPToken t;
+
+    t.tok.kind = kind;
+    t.tok.info.ival = value;
+    t.tok.line = where.tok.line;
+    t.tok.col = where.tok.col;
+    t.tok.offset = where.tok.offset;
+    t.file = where.file;
+    t.spelling = spelling;
+    t.length = length;
+    t.hasSpace = where.hasSpace;
+    t.noExpand = false;
+    return t;
+}
+
+// The first line of every file gets a line marker, and lines of a file are
+// numbered on as in the file.
+int Preprocessor::getOutputLine(const PPToken &t)
+{
+    if (t.file == nullptr)
+        return _outLine;
+
+    if (t.file != _outFile)
+    {
+        _outLine++;
+        _outFile = t.file;
+        _outSourceLine = t.tok.line;
+        _srcMgr.addLineMarker(_outLine, _outSourceLine, t.file->path,
+                              t.file->isSystemHeader);
+    }
+    else if (t.tok.line > _outSourceLine)
+    {
+        _outLine += t.tok.line - _outSourceLine;
+        _outSourceLine = t.tok.line;
+    }
+    return _outLine;
+}
+
+unsigned Preprocessor::next(Token *t)
+{
+    PPToken tok;
+
+    nextExpanded(tok);
+    if (tok.tok.kind == TK_STRING_LIT)
+    {
+        PPToken following;
+
+        // Adjacent string literals are concatenated after macro expansion.
+        for (;;)
+        {
+            nextExpanded(following);
+            if (following.tok.kind != TK_STRING_LIT)
+                break;
+            tok.tok.sval += following.tok.sval;
+        }
+        following.noExpand = true;
+        ungetToken(following);
+    }
+
+    int line = getOutputLine(tok);
+    std::swap(*t, tok.tok);
+    t->line = line;
+    return t->kind;
+}
+
+//
+// Directives
+//
+
+void Preprocessor::directive()
+{
+    std::vector<PPToken> line;
+
+    readDirectiveLine(line);
+
+    // A # alone is a null directive, and # 123 "file.c" a line marker of
+    // preprocessed input.
+    if (line.empty() || line[0].tok.kind == TK_INT_LIT)
+        return;
+    if (!isName(line[0]))
+        fatal("invalid preprocessing directive");
+
+    const std::string name = line[0].tok.sval;
+
+    updateGuardState(line);
+    if (name == "define")
+        defineDirective(line);
+    else if (name == "undef")
+    {
+        if (line.size() < 2 || !isName(line[1]))
+            fatal("macro name missing");
+
+        auto it = _macros.find(line[1].tok.sval);
+        if (it != _macros.end())
+            it->second.isDefined = false;
+    }
+    else if (name == "include")
+        includeDirective(line, false);
+    else if (name == "include_next")
+        includeDirective(line, true);
+    else if (name == "if" || name == "ifdef" || name == "ifndef")
+    {
+        bool value;
+
+        if (name == "if")
+            value = evaluateCondition(line);
+        else if (line.size() < 2 || !isName(line[1]))
+            fatal("macro name missing");
+        else
+            value = isMacroDefined(line[1].tok.sval) == (name == "ifdef");
+
+        _conds.push_back({value, false});
+        if (!value)
+            skipGroup();
+    }
+    else if (name == "elif" || name == "else")
+    {
+        if (_conds.size() <= _files.back().condDepth)
+            fatal("#%s without #if", name.c_str());
+        if (_conds.back().hasElse)
+            fatal("#%s after #else", name.c_str());
+
+        // The group before was read, the rest are skipped.
+        _conds.back().hasElse = name == "else";
+        skipGroup();
+    }
+    else if (name == "endif")
+    {
+        if (_conds.size() <= _files.back().condDepth)
+            fatal("#endif without #if");
+        _conds.pop_back();
+    }
+    else if (name == "error")
+        fatal("#error %s", getText(line, 1).c_str());
+    else if (name == "warning")
+        std::cerr << "warning: #warning " << getText(line, 1) << std::endl;
+    else if (name == "pragma")
+    {
+        // Other pragmas are left to the compiler.
+        if (line.size() == 2 && isName(line[1]) && line[1].tok.sval == "once")
+        {
+            const SourceFile *file = _files.back().file;
+
+            _skipCache->setOnce(file->path, file->id);
+            _onceIncluded.insert(file->id);
+        }
+    }
+    else if (name != "line" && name != "ident")
+        fatal("invalid preprocessing directive #%s", name.c_str());
+}
+
+// Follow the directive line of the current file through the include guard
+// pattern: #ifndef X, or #if !defined X, as the first directive with no
+// tokens before it, and its #endif with nothing after it.
+void Preprocessor::updateGuardState(const std::vector<PPToken> &line)
+{
+    IncludedFile &f = _files.back();
+    const std::string &name = line[0].tok.sval;
+
+    switch (f.guardState)
+    {
+        case GS_START:
+            f.guardState = GS_NONE;
+            if (name == "ifndef" && line.size() == 2 && isName(line[1]))
+                f.guardMacro = line[1].tok.sval;
+            else if (name == "if" && line.size() >= 4 &&
+                     line[1].tok.kind == TK_NOT && isName(line[2]) &&
+                     line[2].tok.sval == "defined")
+            {
+                bool paren = line[3].tok.kind == TK_LPAR;
+
+                if (line.size() != (paren ? 6u : 4u) ||
+                    !isName(line[paren ? 4 : 3]) ||
+                    (paren && line[5].tok.kind != TK_RPAR))
+                    break;
+                f.guardMacro = line[paren ? 4 : 3].tok.sval;
+            }
+            else
+                break;
+            f.guardState = GS_INSIDE;
+            f.guardCond = _conds.size();
+            break;
+        case GS_INSIDE:
+            if (name == "endif" || name == "elif" || name == "else")
+                endGuardedGroup(name == "endif");
+            break;
+        case GS_AFTER:
+            f.guardState = GS_NONE;
+            break;
+        case GS_NONE:
+            break;
+    }
+}
+
+// The current file reached an #endif, #elif or #else of the innermost
+// conditional. If that is the guard, the file is guarded only if it was the
+// #endif.
+void Preprocessor::endGuardedGroup(bool isEndif)
+{
+    IncludedFile &f = _files.back();
+
+    if (f.guardState == GS_INSIDE && _conds.size() == f.guardCond + 1)
+        f.guardState = isEndif ? GS_AFTER : GS_NONE;
+}
+
+void Preprocessor::defineDirective(std::vector<PPToken> &line)
+{
+    Macro m;
+    size_t i = 2;
+
+    if (line.size() < 2 || !isName(line[1]))
+        fatal("macro name missing");
+
+    m.isDefined = true;
+    m.isFunctionLike = false;
+    m.isVariadic = false;
+
+    // Parameters start with a parenthesis right after the name.
+    if (i < line.size() && line[i].tok.kind == TK_LPAR && !line[i].hasSpace)
+    {
+        m.isFunctionLike = true;
+        for (i++;; i++)
+        {
+            if (i >= line.size())
+                fatal("missing ')' in macro parameter list");
+            if (line[i].tok.kind == TK_RPAR && m.params.empty())
+                break;
+
+            if (line[i].tok.kind == TK_ELLIPSIS)
+            {
+                m.params.push_back("__VA_ARGS__");
+                m.isVariadic = true;
+            }
+            else if (isName(line[i]))
+            {
+                m.params.push_back(line[i].tok.sval);
+                // GNU named variable arguments, as in args...
+                if (i + 1 < line.size() && line[i + 1].tok.kind == TK_ELLIPSIS)
+                {
+                    m.isVariadic = true;
+                    i++;
+                }
+            }
+            else
+                fatal("invalid macro parameter list");
+
+            i++;
+            if (i < line.size() && line[i].tok.kind == TK_RPAR)
+                break;
+            if (m.isVariadic || i >= line.size() ||
+                line[i].tok.kind != TK_COMMA)
+                fatal("expected ',' or ')' in macro parameter list");
+        }
+        i++;
+    }
+
+    m.body.assign(line.begin() + i, line.end());
+    if (!m.body.empty())
+    {
+        m.body[0].hasSpace = false;
+        if (m.body.front().tok.kind == TK_HASHHASH ||
+            m.body.back().tok.kind == TK_HASHHASH)
+            fatal("'##' cannot appear at either end of a macro expansion");
+    }
+
+    for (const PPToken &t : m.body)
+    {
+        int param = -1;
+
+        if (isName(t))
+            for (size_t j = 0; j < m.params.size() && param < 0; j++)
+                if (m.params[j] == t.tok.sval)
+                    param = j;
+        m.bodyParams.push_back(param);
+    }
+
+    // A macro can be redefined while it is being expanded.
+    Macro &slot = _macros[line[1].tok.sval];
+    m.isDisabled = slot.isDisabled;
+    slot = std::move(m);
+}
+
+void Preprocessor::includeDirective(std::vector<PPToken> &line, bool isNext)
+{
+    std::vector<PPToken> tokens(line.begin() + 1, line.end());
+    std::string name;
+    bool isQuoted = false;
+    size_t i;
+
+    // Other forms than "file" and <file> are macro expanded first.
+    if (!tokens.empty() && tokens[0].tok.kind != TK_STRING_LIT &&
+        tokens[0].tok.kind != TK_LSS)
+    {
+        std::vector<PPToken> expanded;
+
+        expandTokens(tokens, expanded);
+        tokens.swap(expanded);
+    }
+
+    if (!tokens.empty() && tokens[0].tok.kind == TK_STRING_LIT)
+    {
+        name = tokens[0].tok.sval;
+        isQuoted = true;
+    }
+    else if (!tokens.empty() && tokens[0].tok.kind == TK_LSS)
+    {
+        for (i = 1; i < tokens.size() && tokens[i].tok.kind != TK_GTR; i++)
+        {
+            if (i > 1 && tokens[i].hasSpace)
+                name += ' ';
+            name.append(tokens[i].spelling, tokens[i].length);
+        }
+        if (i == tokens.size())
+            fatal("missing terminating > character");
+    }
+    else
+        fatal("#include expects \"FILENAME\" or <FILENAME>");
+
+    int dirIndex;
+    bool skip;
+    SourceFile *file = findInclude(name, isQuoted, isNext, dirIndex, skip);
+
+    if (skip)
+        return;
+    if (file == nullptr)
+        fatal("'%s' file not found", name.c_str());
+    pushFile(file, dirIndex);
+}
+
+// Skip the groups of the innermost conditional up to the one that is read,
+// or to its #endif. Only directive names are lexed on the way.
+void Preprocessor::skipGroup()
+{
+    IncludedFile &f = _files.back();
+    std::vector<PPToken> line;
+    PPToken t;
+    int depth = 0;
+
+    for (;;)
+    {
+        if (!f.lexer->skipGroup())
+            fatal("unterminated conditional directive");
+
+        lexToken(f, t); // The #
+        lexToken(f, t);
+        if (t.tok.kind == TK_PP_LINE_END)
+            continue;
+
+        if (!isName(t))
+        {
+            f.lexer->skipLine();
+            continue;
+        }
+
+        const std::string &name = t.tok.sval;
+        Conditional &c = _conds.back();
+
+        if (name == "if" || name == "ifdef" || name == "ifndef")
+            depth++;
+        else if (name == "endif")
+        {
+            if (depth-- == 0)
+            {
+                endGuardedGroup(true);
+                _conds.pop_back();
+                f.lexer->skipLine();
+                return;
+            }
+        }
+        else if (depth == 0 && (name == "elif" || name == "else"))
+        {
+            if (c.hasElse)
+                fatal("#%s after #else", name.c_str());
+
+            endGuardedGroup(false);
+            if (name == "else")
+            {
+                c.hasElse = true;
+                if (!c.wasTaken)
+                {
+                    c.wasTaken = true;
+                    f.lexer->skipLine();
+                    return;
+                }
+            }
+            else if (!c.wasTaken)
+            {
+                readDirectiveLine(line);
+                line.insert(line.begin(), t);
+                if (evaluateCondition(line))
+                {
+                    c.wasTaken = true;
+                    return;
+                }
+                continue;
+            }
+        }
+        f.lexer->skipLine();
+    }
+}
+
+bool Preprocessor::isMacroDefined(const std::string &name)
+{
+    auto it = _macros.find(name);
+
+    return (it != _macros.end() && it->second.isDefined) ||
+           name == "__FILE__" || name == "__LINE__";
+}
+
+bool Preprocessor::evaluateCondition(std::vector<PPToken> &line)
+{
+    std::vector<PPToken> tokens, expanded;
+    size_t pos = 0;
+
+    // defined NAME and defined(NAME) are replaced before macro expansion.
+    for (size_t i = 1; i < line.size(); i++)
+    {
+        if (!isName(line[i]) || line[i].tok.sval != "defined")
+        {
+            tokens.push_back(line[i]);
+            continue;
+        }
+
+        bool paren = i + 1 < line.size() && line[i + 1].tok.kind == TK_LPAR;
+        size_t n = paren ? i + 2 : i + 1;
+
+        if (n >= line.size() || !isName(line[n]) ||
+            (paren &&
+             (n + 1 >= line.size() || line[n + 1].tok.kind != TK_RPAR)))
+            fatal("macro name missing after 'defined'");
+
+        bool value = isMacroDefined(line[n].tok.sval);
+        tokens.push_back(
+            makeToken(line[i], TK_INT_LIT, value, value ? "1" : "0", 1));
+        i = paren ? n + 1 : n;
+    }
+
+    expandTokens(tokens, expanded);
+    if (expanded.empty())
+        fatal("#%s with no expression", line[0].tok.sval.c_str());
+
+    int64_t value = evaluateExpression(expanded, pos, true);
+    if (pos != expanded.size())
+        fatal("missing binary operator in #%s", line[0].tok.sval.c_str());
+    return value != 0;
+}
+
+static int getPrecedence(unsigned kind)
+{
+    switch (kind)
+    {
+        case TK_TIMES:
+        case TK_DIV:
+        case TK_MOD:
+            return 10;
+        case TK_PLUS:
+        case TK_MINUS:
+            return 9;
+        case TK_LSHIFT_OP:
+        case TK_RSHIFT_OP:
+            return 8;
+        case TK_LSS:
+        case TK_GTR:
+        case TK_LEQ:
+        case TK_GEQ:
+            return 7;
+        case TK_EQL:
+        case TK_NEQ:
+            return 6;
+        case TK_AND:
+            return 5;
+        case TK_EXCLUSIVE_OR:
+            return 4;
+        case TK_OR:
+            return 3;
+        case TK_LOGICAL_AND:
+            return 2;
+        case TK_LOGICAL_OR:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Operands that are not evaluated, such as the right one of 0 && x, are
+// parsed with live false. They can not fail.
+int64_t Preprocessor::evaluateExpression(const std::vector<PPToken> &tokens,
+                                         size_t &pos, bool live)
+{
+    int64_t condition = evaluateBinary(tokens, pos, 1, live);
+
+    if (pos >= tokens.size() || tokens[pos].tok.kind != TK_COND_OP)
+        return condition;
+    pos++;
+
+    int64_t a = evaluateExpression(tokens, pos, live && condition != 0);
+    if (pos >= tokens.size() || tokens[pos].tok.kind != TK_COLON)
+        fatal("expected ':' in preprocessor expression");
+    pos++;
+    int64_t b = evaluateExpression(tokens, pos, live && condition == 0);
+
+    return condition != 0 ? a : b;
+}
+
+int64_t Preprocessor::evaluateBinary(const std::vector<PPToken> &tokens,
+                                     size_t &pos, int minPrecedence,
+                                     bool live)
+{
+    int64_t lhs = evaluateUnary(tokens, pos, live);
+
+    while (pos < tokens.size())
+    {
+        unsigned op = tokens[pos].tok.kind;
+        int precedence = getPrecedence(op);
+
+        if (precedence == 0 || precedence < minPrecedence)
+            break;
+        pos++;
+
+        bool rhsLive = live && !(op == TK_LOGICAL_AND && lhs == 0) &&
+                       !(op == TK_LOGICAL_OR && lhs != 0);
+        int64_t rhs = evaluateBinary(tokens, pos, precedence + 1, rhsLive);
+        // Wrap around instead of overflowing.
+        uint64_t a = lhs, b = rhs;
+
+        switch (op)
+        {
+            case TK_TIMES:
+                lhs = a * b;
+                break;
+            case TK_DIV:
+            case TK_MOD:
+                if (rhs == 0 || (lhs == INT64_MIN && rhs == -1))
+                {
+                    if (live)
+                        fatal("division by zero in preprocessor expression");
+                    lhs = 0;
+                }
+                else
+                    lhs = op == TK_DIV ? lhs / rhs : lhs % rhs;
+                break;
+            case TK_PLUS:
+                lhs = a + b;
+                break;
+            case TK_MINUS:
+                lhs = a - b;
+                break;
+            case TK_LSHIFT_OP:
+                lhs = b < 64 ? a << b : 0;
+                break;
+            case TK_RSHIFT_OP:
+                lhs = b < 64 ? lhs >> b : (lhs < 0 ? -1 : 0);
+                break;
+            case TK_LSS:
+                lhs = lhs < rhs;
+                break;
+            case TK_GTR:
+                lhs = lhs > rhs;
+                break;
+            case TK_LEQ:
+                lhs = lhs <= rhs;
+                break;
+            case TK_GEQ:
+                lhs = lhs >= rhs;
+                break;
+            case TK_EQL:
+                lhs = lhs == rhs;
+                break;
+            case TK_NEQ:
+                lhs = lhs != rhs;
+                break;
+            case TK_AND:
+                lhs = a & b;
+                break;
+            case TK_EXCLUSIVE_OR:
+                lhs = a ^ b;
+                break;
+            case TK_OR:
+                lhs = a | b;
+                break;
+            case TK_LOGICAL_AND:
+                lhs = lhs != 0 && rhs != 0;
+                break;
+            case TK_LOGICAL_OR:
+                lhs = lhs != 0 || rhs != 0;
+                break;
+        }
+    }
+    return lhs;
+}
+
+int64_t Preprocessor::evaluateUnary(const std::vector<PPToken> &tokens,
+                                    size_t &pos, bool live)
+{
+    if (pos >= tokens.size())
+        fatal("preprocessor expression ends unexpectedly");
+
+    const PPToken &t = tokens[pos++];
+
+    switch (t.tok.kind)
+    {
+        case TK_PLUS:
+            return evaluateUnary(tokens, pos, live);
+        case TK_MINUS:
+            return -(uint64_t) evaluateUnary(tokens, pos, live);
+        case TK_TILDA:
+            return ~evaluateUnary(tokens, pos, live);
+        case TK_NOT:
+            return !evaluateUnary(tokens, pos, live);
+        case TK_LPAR:
+        {
+            int64_t value = evaluateExpression(tokens, pos, live);
+
+            if (pos >= tokens.size() || tokens[pos].tok.kind != TK_RPAR)
+                fatal("missing ')' in preprocessor expression");
+            pos++;
+            return value;
+        }
+        case TK_INT_LIT:
+            // The spelling has the full value, in any base.
+            return strtoull(std::string(t.spelling, t.length).c_str(), NULL,
+                            0);
+        case TK_CHAR_LIT:
+            return t.tok.info.ival;
+        default:
+            // Identifiers left after macro expansion are zero.
+            if (isName(t))
+                return 0;
+            fatal("'%.*s' is not valid in preprocessor expressions",
+                  (int) t.length, t.spelling);
+            return 0;
+    }
+}
+
+//
+// Macro expansion
+//
+
+// Next token after macro expansion
+void Preprocessor::nextExpanded(PPToken &t)
+{
+    do
+        readToken(t);
+    while (!t.noExpand && isName(t) && expandMacro(t));
+}
+
+// If name is a macro call, read its arguments and push the tokens it
+// expands to. Returns false if name is not expanded.
+bool Preprocessor::expandMacro(PPToken &name)
+{
+    const std::string &s = name.tok.sval;
+    std::vector<PPToken> result;
+    Macro *m = nullptr;
+
+    if (s == "__LINE__")
+    {
+        _spellings.push_back(std::to_string(name.tok.line));
+        result.push_back(makeToken(name, TK_INT_LIT, name.tok.line,
+                                   _spellings.back().data(),
+                                   _spellings.back().size()));
+    }
+    else if (s == "__FILE__")
+    {
+        std::vector<PPToken> path(1, name);
+
+        path[0].spelling = name.file->path.data();
+        path[0].length = name.file->path.size();
+        result.push_back(stringify(name, path));
+    }
+    else
+    {
+        auto it = _macros.find(s);
+
+        if (it == _macros.end() || !it->second.isDefined)
+            return false;
+        m = &it->second;
+
+        // Calls of a macro in its own expansion are left as they are.
+        if (m->isDisabled)
+        {
+            name.noExpand = true;
+            return false;
+        }
+
+        std::vector<std::vector<PPToken>> args;
+        if (m->isFunctionLike)
+        {
+            PPToken lpar;
+
+            readToken(lpar);
+            if (lpar.tok.kind != TK_LPAR)
+            {
+                ungetToken(lpar);
+                return false;
+            }
+            collectArguments(*m, name, args);
+        }
+        substitute(*m, args, result);
+    }
+
+    // The tokens take the place and the spacing of the call.
+    for (PPToken &t : result)
+    {
+        t.file = name.file;
+        t.tok.line = name.tok.line;
+        t.tok.col = name.tok.col;
+    }
+    if (!result.empty())
+        result[0].hasSpace = name.hasSpace;
+
+    if (m != nullptr)
+        m->isDisabled = true;
+    _contexts.push_back(Context{std::move(result), 0, m});
+    return true;
+}
+
+void Preprocessor::collectArguments(Macro &m, const PPToken &name,
+                                    std::vector<std::vector<PPToken>> &args)
+{
+    PPToken t;
+    int depth = 0;
+
+    args.emplace_back();
+    for (;;)
+    {
+        readToken(t);
+        if (t.tok.kind == TK_EOF)
+            fatal("unterminated argument list invoking macro '%s'",
+                  name.tok.sval.c_str());
+
+        if (t.tok.kind == TK_LPAR)
+            depth++;
+        else if (t.tok.kind == TK_RPAR && depth-- == 0)
+            break;
+        else if (t.tok.kind == TK_COMMA && depth == 0 &&
+                 !(m.isVariadic && args.size() == m.params.size()))
+        {
+            args.emplace_back();
+            continue;
+        }
+        args.back().push_back(t);
+    }
+
+    // f() has no arguments, and the variable arguments can be left out.
+    if (m.params.empty() && args.size() == 1 && args[0].empty())
+        args.clear();
+    if (m.isVariadic && args.size() + 1 == m.params.size())
+        args.emplace_back();
+
+    if (args.size() != m.params.size())
+        fatal("macro '%s' requires %u arguments, but %u given",
+              name.tok.sval.c_str(), (unsigned) m.params.size(),
+              (unsigned) args.size());
+}
+
+void Preprocessor::substitute(Macro &m,
+                              std::vector<std::vector<PPToken>> &args,
+                              std::vector<PPToken> &result)
+{
+    std::vector<std::vector<PPToken>> expanded(args.size());
+    std::vector<bool> isExpanded(args.size(), false);
+    size_t n = m.body.size();
+    bool placemarker = false; // The operand before ## was empty
+
+    for (size_t i = 0; i < n; i++)
+    {
+        const PPToken &t = m.body[i];
+        int param = m.bodyParams[i];
+
+        if (t.tok.kind == TK_HASH && m.isFunctionLike && i + 1 < n &&
+            m.bodyParams[i + 1] >= 0)
+        {
+            result.push_back(stringify(t, args[m.bodyParams[++i]]));
+            placemarker = false;
+            continue;
+        }
+
+        if (t.tok.kind == TK_HASHHASH)
+        {
+            int rhsParam = m.bodyParams[++i];
+            std::vector<PPToken> operand;
+
+            // Operands of ## are not macro expanded.
+            if (rhsParam >= 0)
+                operand = args[rhsParam];
+            else
+                operand.push_back(m.body[i]);
+
+            // , ## __VA_ARGS__ drops the comma if there are no variable
+            // arguments, as GCC does.
+            if (m.isVariadic && rhsParam == (int) m.params.size() - 1 &&
+                !placemarker && !result.empty() &&
+                result.back().tok.kind == TK_COMMA)
+            {
+                if (operand.empty())
+                    result.pop_back();
+                else
+                    result.insert(result.end(), operand.begin(),
+                                  operand.end());
+                continue;
+            }
+
+            if (operand.empty())
+                continue;
+            if (placemarker || result.empty())
+                result.insert(result.end(), operand.begin(), operand.end());
+            else
+            {
+                result.back() = paste(result.back(), operand[0]);
+                result.insert(result.end(), operand.begin() + 1,
+                              operand.end());
+            }
+            placemarker = false;
+            continue;
+        }
+
+        placemarker = false;
+        if (param < 0)
+        {
+            result.push_back(t);
+            continue;
+        }
+
+        std::vector<PPToken> *arg = &args[param];
+        bool beforePaste = i + 1 < n && m.body[i + 1].tok.kind == TK_HASHHASH;
+
+        if (!beforePaste)
+        {
+            if (!isExpanded[param])
+            {
+                expandTokens(args[param], expanded[param]);
+                isExpanded[param] = true;
+            }
+            arg = &expanded[param];
+        }
+
+        if (arg->empty())
+        {
+            placemarker = beforePaste;
+            continue;
+        }
+        size_t first = result.size();
+        result.insert(result.end(), arg->begin(), arg->end());
+        result[first].hasSpace = t.hasSpace;
+    }
+}
+
+// Macro expand tokens on their own, as the arguments of a call are before
+// they are substituted.
+void Preprocessor::expandTokens(const std::vector<PPToken> &tokens,
+                                std::vector<PPToken> &result)
+{
+    size_t depth = _contexts.size();
+    PPToken t;
+
+    if (tokens.empty())
+        return;
+
+    // The end is marked with an end of file token.
+    std::vector<PPToken> marked(tokens);
+    marked.push_back(makeToken(tokens.back(), TK_EOF, 0, "", 0));
+    _contexts.push_back(Context{std::move(marked), 0, nullptr});
+
+    for (;;)
+    {
+        nextExpanded(t);
+        if (t.tok.kind == TK_EOF)
+            break;
+        result.push_back(t);
+    }
+
+    while (_contexts.size() > depth)
+    {
+        if (_contexts.back().macro != nullptr)
+            _contexts.back().macro->isDisabled = false;
+        _contexts.pop_back();
+    }
+}
+
+PPToken Preprocessor::stringify(const PPToken &hash,
+                                const std::vector<PPToken> &arg)
+{
+    std::string s;
+
+    for (size_t i = 0; i < arg.size(); i++)
+    {
+        const PPToken &t = arg[i];
+
+        if (i > 0 && t.hasSpace)
+            s += ' ';
+        if (t.tok.kind != TK_STRING_LIT && t.tok.kind != TK_CHAR_LIT)
+        {
+            s.append(t.spelling, t.length);
+            continue;
+        }
+        for (unsigned j = 0; j < t.length; j++)
+        {
+            if (t.spelling[j] == '"' || t.spelling[j] == '\\')
+                s += '\\';
+            s += t.spelling[j];
+        }
+    }
+
+    _spellings.push_back('"' + s + '"');
+    PPToken t = makeToken(hash, TK_STRING_LIT, 0, _spellings.back().data(),
+                          _spellings.back().size());
+    t.tok.sval = s;
+    return t;
+}
+
+PPToken Preprocessor::paste(const PPToken &lhs, const PPToken &rhs)
+{
+    _spellings.push_back(std::string(lhs.spelling, lhs.length) +
+                         std::string(rhs.spelling, rhs.length));
+
+    const std::string &s = _spellings.back();
+    PPToken t = makeToken(lhs, TK_UNKNOWN, 0, s.data(), s.size());
+
+    // The lexer would take a # at the start of the text for a directive,
+    // as in #define hash_hash # ## #.
+    if (s == "#" || s == "##")
+    {
+        t.tok.kind = s.size() == 1 ? TK_HASH : TK_HASHHASH;
+        return t;
+    }
+
+    FILE *fp = fmemopen((void *) s.data(), s.size(), "r");
+    long end;
+
+    if (fp == NULL)
+        fatal("can not paste '%s'", s.c_str());
+    {
+        CLexer lexer(fp);
+
+        lexer.setPreprocessing(true);
+        lexer.start();
+        lexer.next(&t.tok);
+        end = lexer.getState().offset - 1;
+    }
+    fclose(fp);
+
+    if (t.tok.offset != 0 || end < (long) s.size())
+        fatal("pasting does not give a valid preprocessing token '%s'",
+              s.c_str());
+    t.tok.line = lhs.tok.line;
+    t.tok.col = lhs.tok.col;
+    return t;
+}
+
+} // namespace cparser
@@ -10,308 +10,258 @@
 #include "../include/TreeVisitor.h"
 
 #include <iostream>
-
-#define TAB_SIZE 4
+#include <string>
+#include <vector>
 
 namespace cparser
 {
 
-static void printTab(int n)
-{
-    int i, x;
-
-    x = n * TAB_SIZE;
-    for (i = 0; i < x; i++)
-        std::cout << " ";
-}
-
 void PrintTreeVisitor::visit(IdentASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_IDENT_NODE" << std::endl;
-    printTab(_level);
-    std::cout << "Value: " << n->getValue() << std::endl;
-    _level--;
+    _emitter->beginNode("NK_IDENT_NODE");
+    _emitter->stringField("Value", n->getValue());
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(IntegerConstASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_INTEGER_CONST" << std::endl;
-    printTab(_level);
-    std::cout << "Value: " << n->getValue() << std::endl;
-    _level--;
+    _emitter->beginNode("NK_INTEGER_CONST");
+    _emitter->intField("Value", n->getValue());
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(StringConstASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_STRING_CONST" << std::endl;
-    printTab(_level);
-    std::cout << "Value: " << n->getValue() << std::endl;
-    _level--;
+    _emitter->beginNode("NK_STRING_CONST");
+    _emitter->stringField("Value", n->getValue());
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(CharConstASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_CHAR_CONST" << std::endl;
-    printTab(_level);
+    _emitter->beginNode("NK_CHAR_CONST");
     if (n->getValue() == '\n')
-        std::cout << "Value: newline character" << std::endl;
+        _emitter->stringField("Value", "newline character");
     else
-        std::cout << "Value: " << (char) n->getValue() << std::endl;
-    _level--;
+        _emitter->stringField("Value", std::string(1, (char) n->getValue()));
+    _emitter->endNode();
+}
+
+void PrintTreeVisitor::visit(PackedConstArrayASTNode *n)
+{
+    _emitter->beginNode("NK_PACKED_CONST_ARRAY");
+    _emitter->intField("Element size", n->getElementSize());
+
+    std::vector<int> values(n->size());
+    for (unsigned i = 0; i < n->size(); i++)
+        values[i] = n->getValue(i);
+    _emitter->intListField("Values", values,
+                           n->getElementKind() == NK_CHAR_CONST);
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(SizeOfExprASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_SIZEOF_EXPR" << std::endl;
+    _emitter->beginNode("NK_SIZEOF_EXPR");
     if (n->getExpr() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Expression:" << std::endl;
+        _emitter->child("Expression");
         n->getExpr()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(TypeDeclASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_TYPE_DECL" << std::endl;
+    _emitter->beginNode("NK_TYPE_DECL");
     if (n->getName() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Type name:" << std::endl;
+        _emitter->child("Type name");
         n->getName()->accept(this);
     }
     if (n->getBody() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Body:" << std::endl;
+        _emitter->child("Body");
         n->getBody()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(FunctionDeclASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_FUNCTION_DECL" << std::endl;
+    _emitter->beginNode("NK_FUNCTION_DECL");
     if (n->getName() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Function name:" << std::endl;
+        _emitter->child("Function name");
         n->getName()->accept(this);
     }
     if (n->getType() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Type:" << std::endl;
+        _emitter->child("Type");
         n->getType()->accept(this);
     }
     if (n->getPrms() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Parameters:" << std::endl;
+        _emitter->child("Parameters");
         n->getPrms()->accept(this);
     }
     if (n->getBody() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Body:" << std::endl;
+        _emitter->child("Body");
         n->getBody()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(VarDeclASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_VAR_DECL" << std::endl;
+    _emitter->beginNode("NK_VAR_DECL");
     if (n->getName() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Name:" << std::endl;
+        _emitter->child("Name");
         n->getName()->accept(this);
     }
     if (n->getType() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Type:" << std::endl;
+        _emitter->child("Type");
         n->getType()->accept(this);
     }
     if (n->getInit() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Init:" << std::endl;
+        _emitter->child("Init");
         n->getInit()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(ParmDeclASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_PARM_DECL" << std::endl;
+    _emitter->beginNode("NK_PARM_DECL");
     if (n->getName() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Name:" << std::endl;
+        _emitter->child("Name");
         n->getName()->accept(this);
     }
     if (n->getType() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Type:" << std::endl;
+        _emitter->child("Type");
         n->getType()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(FieldDeclASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_FIELD_DECL" << std::endl;
+    _emitter->beginNode("NK_FIELD_DECL");
     if (n->getName() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Name:" << std::endl;
+        _emitter->child("Name");
         n->getName()->accept(this);
     }
     if (n->getType() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Type:" << std::endl;
+        _emitter->child("Type");
         n->getType()->accept(this);
     }
-    _level--;
+    if (n->getBitWidth() != NULL_AST_NODE)
+    {
+        _emitter->child("Bit width");
+        n->getBitWidth()->accept(this);
+    }
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(AsmStmtASTNode *n)
 {
-    printTab(_level + 1);
-    std::cout << "NK_ASM_STMT" << std::endl;
-    printTab(_level + 1);
-    std::cout << "Data:" << std::endl;
-    printTab(_level + 2);
-    std::cout << n->getData() << std::endl;
+    _emitter->beginNode("NK_ASM_STMT");
+    _emitter->dataField("Data", n->getData());
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(BreakStmtASTNode *n)
 {
-    printTab(_level + 1);
-    std::cout << "NK_BREAK_STMT" << std::endl;
+    _emitter->beginNode("NK_BREAK_STMT");
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(CaseLabelASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "CASE_LABEL" << std::endl;
+    _emitter->beginNode("CASE_LABEL");
     if (n->getExpr() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Expression:" << std::endl;
+        _emitter->child("Expression");
         n->getExpr()->accept(this);
     }
     if (n->getStmt() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Statement:" << std::endl;
+        _emitter->child("Statement");
         n->getStmt()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(CompoundStmtASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_COMPOUND_STMT" << std::endl;
+    _emitter->beginNode("NK_COMPOUND_STMT");
     if (n->getDecls() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Declarations:" << std::endl;
+        _emitter->child("Declarations");
         n->getDecls()->accept(this);
     }
     if (n->getStmts() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Statements:" << std::endl;
+        _emitter->child("Statements");
         n->getStmts()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(ContinueStmtASTNode *n)
 {
-    printTab(_level + 1);
-    std::cout << "NK_CONTINUE_STMT" << std::endl;
+    _emitter->beginNode("NK_CONTINUE_STMT");
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(DoStmtASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_DO_STMT" << std::endl;
+    _emitter->beginNode("NK_DO_STMT");
     if (n->getCondition() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "condition:" << std::endl;
+        _emitter->child("condition");
         n->getCondition()->accept(this);
     }
     if (n->getBody() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "body:" << std::endl;
+        _emitter->child("body");
         n->getBody()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(ForStmtASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_FOR_STMT" << std::endl;
+    _emitter->beginNode("NK_FOR_STMT");
     if (n->getInit() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Init:" << std::endl;
+        _emitter->child("Init");
         n->getInit()->accept(this);
     }
     if (n->getCondition() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Condition:" << std::endl;
+        _emitter->child("Condition");
         n->getCondition()->accept(this);
     }
     if (n->getStep() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Step:" << std::endl;
+        _emitter->child("Step");
         n->getStep()->accept(this);
     }
     if (n->getBody() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Body:" << std::endl;
+        _emitter->child("Body");
         n->getBody()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(GotoStmtASTNode *n)
@@ -321,147 +271,117 @@ void PrintTreeVisitor::visit(GotoStmtASTNode *n)
 
 void PrintTreeVisitor::visit(IfStmtASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_IF_STMT" << std::endl;
+    _emitter->beginNode("NK_IF_STMT");
     if (n->getCondition() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Condition:" << std::endl;
+        _emitter->child("Condition");
         n->getCondition()->accept(this);
     }
     if (n->getThenClause() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "If clause:" << std::endl;
+        _emitter->child("If clause");
         n->getThenClause()->accept(this);
     }
     if (n->getElseClause() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Else clause:" << std::endl;
+        _emitter->child("Else clause");
         n->getElseClause()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(LabelStmtASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "LABEL_STMT" << std::endl;
+    _emitter->beginNode("LABEL_STMT");
     if (n->getLabel() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Label:" << std::endl;
+        _emitter->child("Label");
         n->getLabel()->accept(this);
     }
     if (n->getStmt() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Statement:" << std::endl;
+        _emitter->child("Statement");
         n->getStmt()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(ReturnStmtASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "RETURN_STMT" << std::endl;
+    _emitter->beginNode("RETURN_STMT");
     if (n->getExpr() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Expression:" << std::endl;
+        _emitter->child("Expression");
         n->getExpr()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(SwitchStmtASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "SWITCH_STMT" << std::endl;
+    _emitter->beginNode("SWITCH_STMT");
     if (n->getExpr() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Expression:" << std::endl;
+        _emitter->child("Expression");
         n->getExpr()->accept(this);
     }
     if (n->getStmt() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Statement:" << std::endl;
+        _emitter->child("Statement");
         n->getStmt()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(WhileStmtASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "WHILE_STMT" << std::endl;
+    _emitter->beginNode("WHILE_STMT");
     if (n->getCondition() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Condition:" << std::endl;
+        _emitter->child("Condition");
         n->getCondition()->accept(this);
     }
     if (n->getBody() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Body:" << std::endl;
+        _emitter->child("Body");
         n->getBody()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(CastExprASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_CAST_EXPR" << std::endl;
+    _emitter->beginNode("NK_CAST_EXPR");
     if (n->getExpr() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Expression:" << std::endl;
+        _emitter->child("Expression");
         n->getExpr()->accept(this);
     }
     if (n->getType() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Type:" << std::endl;
+        _emitter->child("Type");
         n->getType()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(BitNotExprASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_BIT_NOT_EXPR" << std::endl;
+    _emitter->beginNode("NK_BIT_NOT_EXPR");
     if (n->getExpr() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Expression:" << std::endl;
+        _emitter->child("Expression");
         n->getExpr()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(LogNotExprASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_LOG_NOT_EXPR" << std::endl;
-    printTab(_level);
-    std::cout << "Expression:" << std::endl;
+    _emitter->beginNode("NK_LOG_NOT_EXPR");
+    _emitter->child("Expression");
     n->getExpr()->accept(this);
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(PredecrementExprASTNode *n)
@@ -476,636 +396,476 @@ void PrintTreeVisitor::visit(PreincrementExprASTNode *n)
 
 void PrintTreeVisitor::visit(PostdecrementExprASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_POSTDECREMENT_EXPR" << std::endl;
-    printTab(_level);
-    std::cout << "Expression:" << std::endl;
+    _emitter->beginNode("NK_POSTDECREMENT_EXPR");
+    _emitter->child("Expression");
     n->getExpr()->accept(this);
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(PostincrementExprASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_POSTINCREMENT_EXPR" << std::endl;
-    printTab(_level);
-    std::cout << "Expression:" << std::endl;
+    _emitter->beginNode("NK_POSTINCREMENT_EXPR");
+    _emitter->child("Expression");
     n->getExpr()->accept(this);
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(AddrExprASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_ADDR_EXPR" << std::endl;
-    printTab(_level);
-    std::cout << "Expression:" << std::endl;
+    _emitter->beginNode("NK_ADDR_EXPR");
+    _emitter->child("Expression");
     n->getExpr()->accept(this);
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(IndirectRefASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_INDIRECT_REF" << std::endl;
+    _emitter->beginNode("NK_INDIRECT_REF");
     if (n->getExpr() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Expression:" << std::endl;
+        _emitter->child("Expression");
         n->getExpr()->accept(this);
     }
     if (n->getField() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Field:" << std::endl;
+        _emitter->child("Field");
         n->getField()->accept(this);
     }
     if (n->getType() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Type:" << std::endl;
+        _emitter->child("Type");
         n->getType()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(NopExprASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_NOP_EXPR" << std::endl;
-    _level--;
+    _emitter->beginNode("NK_NOP_EXPR");
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(LShiftExprASTNode *n)
 {
-    _level++;
-
-    printTab(_level);
-    std::cout << "NK_LSHIFT_EXPR" << std::endl;
+    _emitter->beginNode("NK_LSHIFT_EXPR");
 
-    printTab(_level);
-    std::cout << "Lhs:" << std::endl;
+    _emitter->child("Lhs");
     n->getLhs()->accept(this);
 
-    printTab(_level);
-    std::cout << "Rhs:" << std::endl;
+    _emitter->child("Rhs");
     n->getRhs()->accept(this);
 
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(RShiftExprASTNode *n)
 {
-    _level++;
+    _emitter->beginNode("NK_RSHIFT_EXPR");
 
-    printTab(_level);
-    std::cout << "NK_RSHIFT_EXPR" << std::endl;
-
-    printTab(_level);
-    std::cout << "Lhs:" << std::endl;
+    _emitter->child("Lhs");
     n->getLhs()->accept(this);
 
-    printTab(_level);
-    std::cout << "Rhs:" << std::endl;
+    _emitter->child("Rhs");
     n->getRhs()->accept(this);
 
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(BitIorExprASTNode *n)
 {
-    _level++;
-
-    printTab(_level);
-    std::cout << "NK_BIT_IOR_EXPR" << std::endl;
+    _emitter->beginNode("NK_BIT_IOR_EXPR");
 
-    printTab(_level);
-    std::cout << "Lhs:" << std::endl;
+    _emitter->child("Lhs");
     n->getLhs()->accept(this);
 
-    printTab(_level);
-    std::cout << "Rhs:" << std::endl;
+    _emitter->child("Rhs");
     n->getRhs()->accept(this);
 
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(BitXorExprASTNode *n)
 {
-    _level++;
+    _emitter->beginNode("NK_BIT_XOR_EXPR");
 
-    printTab(_level);
-    std::cout << "NK_BIT_XOR_EXPR" << std::endl;
-
-    printTab(_level);
-    std::cout << "Lhs:" << std::endl;
+    _emitter->child("Lhs");
     n->getLhs()->accept(this);
 
-    printTab(_level);
-    std::cout << "Rhs:" << std::endl;
+    _emitter->child("Rhs");
     n->getRhs()->accept(this);
 
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(BitAndExprASTNode *n)
 {
-    _level++;
-
-    printTab(_level);
-    std::cout << "NK_BIT_AND_EXPR" << std::endl;
+    _emitter->beginNode("NK_BIT_AND_EXPR");
 
-    printTab(_level);
-    std::cout << "Lhs:" << std::endl;
+    _emitter->child("Lhs");
     n->getLhs()->accept(this);
 
-    printTab(_level);
-    std::cout << "Rhs:" << std::endl;
+    _emitter->child("Rhs");
     n->getRhs()->accept(this);
 
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(LogAndExprASTNode *n)
 {
-    _level++;
+    _emitter->beginNode("NK_LOG_AND_EXPR");
 
-    printTab(_level);
-    std::cout << "NK_LOG_AND_EXPR" << std::endl;
-
-    printTab(_level);
-    std::cout << "Lhs:" << std::endl;
+    _emitter->child("Lhs");
     n->getLhs()->accept(this);
 
-    printTab(_level);
-    std::cout << "Rhs:" << std::endl;
+    _emitter->child("Rhs");
     n->getRhs()->accept(this);
 
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(LogOrExprASTNode *n)
 {
-    _level++;
-
-    printTab(_level);
-    std::cout << "NK_LOG_OR_EXPR" << std::endl;
+    _emitter->beginNode("NK_LOG_OR_EXPR");
 
-    printTab(_level);
-    std::cout << "Lhs:" << std::endl;
+    _emitter->child("Lhs");
     n->getLhs()->accept(this);
 
-    printTab(_level);
-    std::cout << "Rhs:" << std::endl;
+    _emitter->child("Rhs");
     n->getRhs()->accept(this);
 
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(PlusExprASTNode *n)
 {
-    _level++;
+    _emitter->beginNode("NK_PLUS_EXPR");
 
-    printTab(_level);
-    std::cout << "NK_PLUS_EXPR" << std::endl;
-
-    printTab(_level);
-    std::cout << "Lhs:" << std::endl;
+    _emitter->child("Lhs");
     n->getLhs()->accept(this);
 
-    printTab(_level);
-    std::cout << "Rhs:" << std::endl;
+    _emitter->child("Rhs");
     n->getRhs()->accept(this);
 
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(MinusExprASTNode *n)
 {
-    _level++;
-
-    printTab(_level);
-    std::cout << "NK_MINUS_EXPR" << std::endl;
+    _emitter->beginNode("NK_MINUS_EXPR");
 
-    printTab(_level);
-    std::cout << "Lhs:" << std::endl;
+    _emitter->child("Lhs");
     n->getLhs()->accept(this);
 
-    printTab(_level);
-    std::cout << "Rhs:" << std::endl;
+    _emitter->child("Rhs");
     n->getRhs()->accept(this);
 
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(MultExprASTNode *n)
 {
-    _level++;
+    _emitter->beginNode("NK_MULT_EXPR");
 
-    printTab(_level);
-    std::cout << "NK_MULT_EXPR" << std::endl;
-
-    printTab(_level);
-    std::cout << "Lhs:" << std::endl;
+    _emitter->child("Lhs");
     n->getLhs()->accept(this);
 
-    printTab(_level);
-    std::cout << "Rhs:" << std::endl;
+    _emitter->child("Rhs");
     n->getRhs()->accept(this);
 
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(TruncDivExprASTNode *n)
 {
-    _level++;
-
-    printTab(_level);
-    std::cout << "NK_TRUNC_DIV_EXPR" << std::endl;
+    _emitter->beginNode("NK_TRUNC_DIV_EXPR");
 
-    printTab(_level);
-    std::cout << "Lhs:" << std::endl;
+    _emitter->child("Lhs");
     n->getLhs()->accept(this);
 
-    printTab(_level);
-    std::cout << "Rhs:" << std::endl;
+    _emitter->child("Rhs");
     n->getRhs()->accept(this);
 
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(TruncModExprASTNode *n)
 {
-    _level++;
+    _emitter->beginNode("NK_TRUNC_MOD_EXPR");
 
-    printTab(_level);
-    std::cout << "NK_TRUNC_MOD_EXPR" << std::endl;
-
-    printTab(_level);
-    std::cout << "Lhs:" << std::endl;
+    _emitter->child("Lhs");
     n->getLhs()->accept(this);
 
-    printTab(_level);
-    std::cout << "Rhs:" << std::endl;
+    _emitter->child("Rhs");
     n->getRhs()->accept(this);
 
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(ArrayRefASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "ARRAY_REF" << std::endl;
+    _emitter->beginNode("ARRAY_REF");
     if (n->getExpr() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Expression:" << std::endl;
+        _emitter->child("Expression");
         n->getExpr()->accept(this);
     }
     if (n->getIndex() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Index:" << std::endl;
+        _emitter->child("Index");
         n->getIndex()->accept(this);
     }
     if (n->getType() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Element type:" << std::endl;
+        _emitter->child("Element type");
         n->getType()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(StructRefASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "STRUCT_REF" << std::endl;
+    _emitter->beginNode("STRUCT_REF");
     if (n->getName() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Name:" << std::endl;
+        _emitter->child("Name");
         n->getName()->accept(this);
     }
     if (n->getMember() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Member:" << std::endl;
+        _emitter->child("Member");
         n->getMember()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(LtExprASTNode *n)
 {
-    _level++;
-
-    printTab(_level);
-    std::cout << "NK_LT_EXPR" << std::endl;
+    _emitter->beginNode("NK_LT_EXPR");
 
-    printTab(_level);
-    std::cout << "Lhs:" << std::endl;
+    _emitter->child("Lhs");
     n->getLhs()->accept(this);
 
-    printTab(_level);
-    std::cout << "Rhs:" << std::endl;
+    _emitter->child("Rhs");
     n->getRhs()->accept(this);
 
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(LeExprASTNode *n)
 {
-    _level++;
+    _emitter->beginNode("NK_LE_EXPR");
 
-    printTab(_level);
-    std::cout << "NK_LE_EXPR" << std::endl;
-
-    printTab(_level);
-    std::cout << "Lhs:" << std::endl;
+    _emitter->child("Lhs");
     n->getLhs()->accept(this);
 
-    printTab(_level);
-    std::cout << "Rhs:" << std::endl;
+    _emitter->child("Rhs");
     n->getRhs()->accept(this);
 
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(GtExprASTNode *n)
 {
-    _level++;
-
-    printTab(_level);
-    std::cout << "NK_GT_EXPR" << std::endl;
+    _emitter->beginNode("NK_GT_EXPR");
 
-    printTab(_level);
-    std::cout << "Lhs:" << std::endl;
+    _emitter->child("Lhs");
     n->getLhs()->accept(this);
 
-    printTab(_level);
-    std::cout << "Rhs:" << std::endl;
+    _emitter->child("Rhs");
     n->getRhs()->accept(this);
 
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(GeExprASTNode *n)
 {
-    _level++;
+    _emitter->beginNode("NK_GE_EXPR");
 
-    printTab(_level);
-    std::cout << "NK_GE_EXPR" << std::endl;
-
-    printTab(_level);
-    std::cout << "Lhs:" << std::endl;
+    _emitter->child("Lhs");
     n->getLhs()->accept(this);
 
-    printTab(_level);
-    std::cout << "Rhs:" << std::endl;
+    _emitter->child("Rhs");
     n->getRhs()->accept(this);
 
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(EqExprASTNode *n)
 {
-    _level++;
-
-    printTab(_level);
-    std::cout << "NK_EQ_EXPR" << std::endl;
+    _emitter->beginNode("NK_EQ_EXPR");
 
-    printTab(_level);
-    std::cout << "Lhs:" << std::endl;
+    _emitter->child("Lhs");
     n->getLhs()->accept(this);
 
-    printTab(_level);
-    std::cout << "Rhs:" << std::endl;
+    _emitter->child("Rhs");
     n->getRhs()->accept(this);
 
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(NeExprASTNode *n)
 {
-    _level++;
+    _emitter->beginNode("NK_NE_EXPR");
 
-    printTab(_level);
-    std::cout << "NK_NE_EXPR" << std::endl;
-
-    printTab(_level);
-    std::cout << "Lhs:" << std::endl;
+    _emitter->child("Lhs");
     n->getLhs()->accept(this);
 
-    printTab(_level);
-    std::cout << "Rhs:" << std::endl;
+    _emitter->child("Rhs");
     n->getRhs()->accept(this);
 
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(AssignExprASTNode *n)
 {
-    _level++;
-
-    printTab(_level);
-    std::cout << "NK_ASSIGN_EXPR" << std::endl;
+    _emitter->beginNode("NK_ASSIGN_EXPR");
 
-    printTab(_level);
-    std::cout << "Lhs:" << std::endl;
+    _emitter->child("Lhs");
     n->getLhs()->accept(this);
 
-    printTab(_level);
-    std::cout << "Rhs:" << std::endl;
+    _emitter->child("Rhs");
     n->getRhs()->accept(this);
 
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(CondExprASTNode *n) { /* TODO: Implement. */}
 
 void PrintTreeVisitor::visit(CallExprASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_CALL_EXPR" << std::endl;
+    _emitter->beginNode("NK_CALL_EXPR");
     if (n->getExpr() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Function name:" << std::endl;
+        _emitter->child("Function name");
         n->getExpr()->accept(this);
     }
     if (n->getArgs() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Actual parameters:" << std::endl;
+        _emitter->child("Actual parameters");
         n->getArgs()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(VoidTypeASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_VOID_TYPE" << std::endl;
-    _level--;
+    _emitter->beginNode("NK_VOID_TYPE");
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(IntegralTypeASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_INTEGRAL_TYPE" << std::endl;
-    printTab(_level);
-    std::cout << "Alignment: " << n->getAlignment() << std::endl;
-    printTab(_level);
-    if (n->getIsSigned())
-        std::cout << "Signed: true" << std::endl;
-    else
-        std::cout << "Signed: false" << std::endl;
-    _level--;
+    _emitter->beginNode("NK_INTEGRAL_TYPE");
+    _emitter->intField("Alignment", n->getAlignment());
+    _emitter->boolField("Signed", n->getIsSigned());
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(RealTypeASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_REAL_TYPE" << std::endl;
-    printTab(_level);
-    std::cout << "Alignment: " << n->getAlignment() << std::endl;
-    printTab(_level);
-    if (n->getIsDouble())
-        std::cout << "Double: true" << std::endl;
-    else
-        std::cout << "Double: false" << std::endl;
-    _level--;
+    _emitter->beginNode("NK_REAL_TYPE");
+    _emitter->intField("Alignment", n->getAlignment());
+    _emitter->boolField("Double", n->getIsDouble());
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(EnumeralTypeASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_ENUMERAL_TYPE" << std::endl;
+    _emitter->beginNode("NK_ENUMERAL_TYPE");
     if (n->getName() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Name:" << std::endl;
+        _emitter->child("Name");
         n->getName()->accept(this);
     }
     if (n->getBody() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Body:" << std::endl;
+        _emitter->child("Body");
         n->getBody()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(PointerTypeASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_POINTER_TYPE" << std::endl;
+    _emitter->beginNode("NK_POINTER_TYPE");
     if (n->getBaseType() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Base type:" << std::endl;
+        _emitter->child("Base type");
         n->getBaseType()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(FunctionTypeASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_FUNCTION_TYPE" << std::endl;
+    _emitter->beginNode("NK_FUNCTION_TYPE");
     if (n->getType() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Type:" << std::endl;
+        _emitter->child("Type");
         n->getType()->accept(this);
     }
     if (n->getPrms() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Parameters:" << std::endl;
+        _emitter->child("Parameters");
         n->getPrms()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(ArrayTypeASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_ARRAY_TYPE" << std::endl;
+    _emitter->beginNode("NK_ARRAY_TYPE");
     if (n->getExpr() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Expression:" << std::endl;
+        _emitter->child("Expression");
         n->getExpr()->accept(this);
     }
     if (n->getElementType() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Element type:" << std::endl;
+        _emitter->child("Element type");
         n->getElementType()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(StructTypeASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_STRUCT_TYPE" << std::endl;
+    _emitter->beginNode("NK_STRUCT_TYPE");
     if (n->getName() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Name:" << std::endl;
+        _emitter->child("Name");
         n->getName()->accept(this);
     }
     if (n->getBody() != NULL_AST_NODE)
     {
-        printTab(_level);
-        std::cout << "Body:" << std::endl;
+        _emitter->child("Body");
         n->getBody()->accept(this);
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(UnionTypeASTNode *n) { /* TODO: Implement. */}
 
 void PrintTreeVisitor::visit(NullASTNode *n)
 {
-    printTab(_level + 1);
-    std::cout << "NK_UNKNOWN" << std::endl;
+    _emitter->beginNode("NK_UNKNOWN");
+    _emitter->endNode();
 }
 
 void PrintTreeVisitor::visit(SequenceASTNode *n)
 {
-    _level++;
-    printTab(_level);
-    std::cout << "NK_LIST" << std::endl;
+    _emitter->beginNode("NK_LIST");
     std::vector<ASTNode *> &elements = n->getElements();
 
     for (unsigned i = 0; i < elements.size(); i++)
     {
-        printTab(_level);
-        std::cout << "Element "<< i << ":" << std::endl;
+        _emitter->element(i);
         if (elements[i] != nullptr && elements[i] != NULL_AST_NODE)
             elements[i]->accept(this);
+        else
+            _emitter->missing();
     }
-    _level--;
+    _emitter->endNode();
 }
 
 void CountCallExprVisitor::visit(CallExprASTNode *n) { callExprCount++; }
@@ -0,0 +1,402 @@
+// Record layout - implementation file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#include "../include/RecordLayout.h"
+#include "../include/AbstractSyntaxTree.h"
+#include "../include/ConstEval.h"
+
+namespace cparser
+{
+
+#define POINTER_SIZE 8
+#define ENUM_SIZE 4
+
+static inline uint64_t roundUp(uint64_t x, uint64_t align)
+{
+    return align == 0 ? x : (x + align - 1) / align * align;
+}
+
+static uint32_t hashName(const char *s)
+{
+    uint32_t h = 2166136261u; // FNV-1a
+
+    for (; *s; s++)
+    {
+        h ^= (unsigned char) *s;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static inline std::vector<ASTNode *> &getElements(ASTNode *list)
+{
+    return static_cast<SequenceASTNode *>(list)->getElements();
+}
+
+static RecordLayout *getRecordLayout(ASTNode *type)
+{
+    STType *recordType = nullptr;
+
+    if (type->getKind() == NK_STRUCT_TYPE)
+        recordType = static_cast<StructTypeASTNode *>(type)->getRecordType();
+    else if (type->getKind() == NK_UNION_TYPE)
+        recordType = static_cast<UnionTypeASTNode *>(type)->getRecordType();
+
+    return recordType != nullptr ? recordType->layout : nullptr;
+}
+
+// The struct or union defined by the specifier list type, or nullptr.
+static ASTNode *findRecordDefinition(ASTNode *type)
+{
+    if (type->getKind() == NK_LIST)
+    {
+        for (ASTNode *n : getElements(type))
+            if (n != nullptr && n != NULL_AST_NODE &&
+                (type = findRecordDefinition(n)) != nullptr)
+                return type;
+        return nullptr;
+    }
+    if (type->getKind() == NK_STRUCT_TYPE &&
+        static_cast<StructTypeASTNode *>(type)->getBody() != NULL_AST_NODE)
+        return type;
+    if (type->getKind() == NK_UNION_TYPE &&
+        static_cast<UnionTypeASTNode *>(type)->getBody() != NULL_AST_NODE)
+        return type;
+    return nullptr;
+}
+
+bool getTypeLayout(ASTNode *type, unsigned &size, unsigned &alignment)
+{
+    switch (type->getKind())
+    {
+        case NK_LIST:
+        {
+            // A specifier list such as "unsigned char" or "long int". The
+            // narrowest of char and short wins, otherwise the widest.
+            unsigned narrowest = ~0u, widest = 0;
+
+            for (ASTNode *n : getElements(type))
+            {
+                if (n == nullptr || n == NULL_AST_NODE)
+                    continue;
+                if (n->getKind() != NK_INTEGRAL_TYPE)
+                    return getTypeLayout(n, size, alignment);
+
+                unsigned a =
+                    static_cast<IntegralTypeASTNode *>(n)->getAlignment();
+                if (a < narrowest)
+                    narrowest = a;
+                if (a > widest)
+                    widest = a;
+            }
+            if (widest == 0)
+                return false;
+            size = alignment = narrowest < 4 ? narrowest : widest;
+            return true;
+        }
+        case NK_INTEGRAL_TYPE:
+            size = alignment =
+                static_cast<IntegralTypeASTNode *>(type)->getAlignment();
+            return true;
+        case NK_REAL_TYPE:
+            size = alignment =
+                static_cast<RealTypeASTNode *>(type)->getAlignment();
+            return true;
+        case NK_ENUMERAL_TYPE:
+            size = alignment = ENUM_SIZE;
+            return true;
+        case NK_POINTER_TYPE:
+            size = alignment = POINTER_SIZE;
+            return true;
+        case NK_ARRAY_TYPE:
+        {
+            ArrayTypeASTNode *array = static_cast<ArrayTypeASTNode *>(type);
+            ASTNode *length = array->getExpr();
+            unsigned elementSize;
+            int64_t n;
+
+            if (!getTypeLayout(array->getElementType(), elementSize, alignment))
+                return false;
+            // An array without a length is a flexible array member.
+            if (length == NULL_AST_NODE)
+                size = 0;
+            else if (evaluateConstant(length, n) && n >= 0)
+                size = elementSize * n;
+            else
+                return false;
+            return true;
+        }
+        case NK_STRUCT_TYPE:
+        case NK_UNION_TYPE:
+        {
+            RecordLayout *layout = getRecordLayout(type);
+
+            if (layout == nullptr || !layout->isComplete())
+                return false;
+            size = layout->getSize();
+            alignment = layout->getAlignment();
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+RecordRef getRecordRef(ASTNode *type)
+{
+    RecordRef ref = {nullptr, 0};
+
+    for (;;)
+    {
+        switch (type->getKind())
+        {
+            case NK_LIST:
+            {
+                // A specifier list holds at most one struct or union.
+                ASTNode *record = nullptr;
+
+                for (ASTNode *n : getElements(type))
+                    if (n != nullptr && (n->getKind() == NK_STRUCT_TYPE ||
+                                         n->getKind() == NK_UNION_TYPE))
+                        record = n;
+                if (record == nullptr)
+                    return ref;
+                type = record;
+                break;
+            }
+            case NK_POINTER_TYPE:
+                type = static_cast<PointerTypeASTNode *>(type)->getBaseType();
+                ref.indirection++;
+                break;
+            case NK_ARRAY_TYPE:
+                type =
+                    static_cast<ArrayTypeASTNode *>(type)->getElementType();
+                ref.indirection++;
+                break;
+            case NK_STRUCT_TYPE:
+                ref.record =
+                    static_cast<StructTypeASTNode *>(type)->getRecordType();
+                return ref;
+            case NK_UNION_TYPE:
+                ref.record =
+                    static_cast<UnionTypeASTNode *>(type)->getRecordType();
+                return ref;
+            default:
+                return ref;
+        }
+    }
+}
+
+const FieldLayout *getFieldLayout(ASTNode *ref)
+{
+    STType *record;
+    ASTNode *field;
+
+    if (ref->getKind() == NK_STRUCT_REF)
+    {
+        StructRefASTNode *s = static_cast<StructRefASTNode *>(ref);
+
+        record = s->getRecordType();
+        field = s->getMember();
+    }
+    else if (ref->getKind() == NK_INDIRECT_REF)
+    {
+        IndirectRefASTNode *s = static_cast<IndirectRefASTNode *>(ref);
+
+        record = s->getRecordType();
+        field = s->getField();
+    }
+    else
+        return nullptr;
+
+    // In a.b->c the field of the . is the start of its member b->c.
+    for (;;)
+    {
+        if (field->getKind() == NK_STRUCT_REF)
+            field = static_cast<StructRefASTNode *>(field)->getName();
+        else if (field->getKind() == NK_INDIRECT_REF)
+            field = static_cast<IndirectRefASTNode *>(field)->getExpr();
+        else
+            break;
+    }
+
+    if (record == nullptr || record->layout == nullptr ||
+        !AST_MATCH_IDENT(field))
+        return nullptr;
+    return record->layout->findField(AST_IDENT_VALUE(field));
+}
+
+RecordLayout::RecordLayout(bool isUnion, bool isComplete, unsigned size,
+                           unsigned alignment,
+                           const std::vector<FieldLayout> &fields)
+    : _isUnion(isUnion), _isComplete(isComplete), _size(size),
+      _alignment(alignment), _fields(fields)
+{
+    buildIndex();
+}
+
+RecordLayout::RecordLayout(ASTNode *body, bool isUnion)
+    : _isUnion(isUnion), _isComplete(true), _size(0), _alignment(1)
+{
+    uint64_t end = 0;
+
+    if (body->getKind() == NK_LIST)
+    {
+        // Field declaration lists are spliced into the body.
+        for (ASTNode *n : getElements(body))
+        {
+            if (n == nullptr || n->getKind() != NK_FIELD_DECL)
+                continue;
+
+            FieldDeclASTNode *field = static_cast<FieldDeclASTNode *>(n);
+            ASTNode *name = field->getName();
+            uint64_t bitPos = _isUnion ? 0 : end;
+
+            if (name == NULL_AST_NODE && field->getBitWidth() == NULL_AST_NODE)
+            {
+                // Without a name only a nested record declares members.
+                ASTNode *record = findRecordDefinition(field->getType());
+                RecordLayout *nested =
+                    record ? getRecordLayout(record) : nullptr;
+                if (nested == nullptr || !nested->isComplete())
+                    continue;
+                addAnonymousRecord(nested, bitPos);
+            }
+            else
+                addField(field->getType(),
+                         name != NULL_AST_NODE ? AST_IDENT_VALUE(name)
+                                               : nullptr,
+                         field->getBitWidth(), bitPos);
+
+            if (!_isComplete)
+                break;
+            if (bitPos > end)
+                end = bitPos;
+        }
+    }
+
+    _size = roundUp(roundUp(end, 8) / 8, _alignment);
+    buildIndex();
+}
+
+void RecordLayout::addField(const FieldLayout &field, unsigned alignment)
+{
+    if (alignment > _alignment)
+        _alignment = alignment;
+    if (!field.name.empty())
+        _fields.push_back(field);
+}
+
+void RecordLayout::addField(ASTNode *type, const char *name,
+                            ASTNode *bitWidth, uint64_t &bitPos)
+{
+    FieldLayout field = {name ? name : "", 0, 0, 0, 0, getRecordRef(type)};
+    unsigned size, alignment;
+
+    if (!getTypeLayout(type, size, alignment))
+    {
+        _isComplete = false;
+        return;
+    }
+
+    if (bitWidth == NULL_AST_NODE)
+    {
+        bitPos = roundUp(bitPos, alignment * 8);
+        field.offset = bitPos / 8;
+        field.size = size;
+        bitPos += (uint64_t) size * 8;
+        addField(field, alignment);
+        return;
+    }
+
+    // Bit-fields are packed into storage units of their declared type and
+    // do not straddle a unit boundary.
+    uint64_t unitBits = (uint64_t) size * 8;
+    int64_t width;
+
+    if (!evaluateConstant(bitWidth, width) || width < 0 ||
+        (uint64_t) width > unitBits)
+    {
+        _isComplete = false;
+        return;
+    }
+
+    // A zero width bit-field only closes the current unit.
+    if (width == 0)
+    {
+        bitPos = roundUp(bitPos, unitBits);
+        return;
+    }
+
+    if (bitPos % unitBits + width > unitBits)
+        bitPos = roundUp(bitPos, unitBits);
+    field.offset = bitPos / unitBits * size;
+    field.size = size;
+    field.bitOffset = bitPos % unitBits;
+    field.bitWidth = width;
+    bitPos += width;
+
+    // Unnamed bit-fields are padding, they do not align the record.
+    if (name != nullptr)
+        addField(field, alignment);
+}
+
+void RecordLayout::addAnonymousRecord(RecordLayout *nested, uint64_t &bitPos)
+{
+    bitPos = roundUp(bitPos, nested->getAlignment() * 8);
+    unsigned base = bitPos / 8;
+
+    for (FieldLayout field : nested->getFields())
+    {
+        field.offset += base;
+        _fields.push_back(field);
+    }
+    if (nested->getAlignment() > _alignment)
+        _alignment = nested->getAlignment();
+    bitPos += (uint64_t) nested->getSize() * 8;
+}
+
+void RecordLayout::buildIndex()
+{
+    if (_fields.empty())
+        return;
+
+    size_t capacity = 2;
+    while (capacity < _fields.size() * 2)
+        capacity *= 2;
+    _index.assign(capacity, 0);
+
+    for (uint32_t i = 0; i < _fields.size(); i++)
+    {
+        size_t slot = hashName(_fields[i].name.c_str()) & (capacity - 1);
+
+        while (_index[slot] != 0 &&
+               _fields[_index[slot] - 1].name != _fields[i].name)
+            slot = (slot + 1) & (capacity - 1);
+        // The first of fields with the same name is kept.
+        if (_index[slot] == 0)
+            _index[slot] = i + 1;
+    }
+}
+
+const FieldLayout *RecordLayout::findField(const char *name)
+{
+    if (_index.empty())
+        return nullptr;
+
+    size_t mask = _index.size() - 1;
+    for (size_t slot = hashName(name) & mask; _index[slot] != 0;
+         slot = (slot + 1) & mask)
+    {
+        const FieldLayout &field = _fields[_index[slot] - 1];
+        if (field.name == name)
+            return &field;
+    }
+    return nullptr;
+}
+
+} // namespace cparser
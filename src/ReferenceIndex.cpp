@@ -0,0 +1,729 @@
+// Cross-reference index - implementation file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#include "../include/ReferenceIndex.h"
+#include "../include/CLexer.h"
+#include "../include/PrecompiledHeader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_set>
+
+namespace cparser
+{
+
+#define XREF_MAGIC "CFXRF\0\0\1"
+#define XREF_MAGIC_LEN 8
+#define XREF_HEADER_SIZE (XREF_MAGIC_LEN + 7 * 4)
+
+// FNV-1a
+static uint64_t hashBytes(const char *data, size_t size)
+{
+    uint64_t h = 14695981039346656037ull;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        h ^= (unsigned char) data[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// Size and hash of the contents of the file at path
+static FileStamp stampFile(const char *path)
+{
+    FileStamp stamp = {UINT64_MAX, 0};
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+        return stamp;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+    {
+        if (st.st_size == 0)
+            stamp = {0, hashBytes("", 0)};
+        else
+        {
+            void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+            if (p != MAP_FAILED)
+            {
+                stamp = {(uint64_t) st.st_size,
+                         hashBytes((const char *) p, st.st_size)};
+                munmap(p, st.st_size);
+            }
+        }
+    }
+    close(fd);
+    return stamp;
+}
+
+const FileStamp &ReferenceDatabase::getStamp(const char *file)
+{
+    auto it = _stamps.find(file);
+
+    if (it == _stamps.end())
+        it = _stamps.insert({file, stampFile(file)}).first;
+    return it->second;
+}
+
+//
+// Parsing
+//
+
+// The references of one translation unit with the files they are in, the
+// files it read, and of them, the ones it parsed. The others were parsed
+// into a module by another translation unit.
+struct UnitReferences
+{
+    std::vector<const char *> files;
+    std::unordered_set<const char *> parsedFiles;
+    std::vector<std::pair<const char *, Reference>> references;
+};
+
+class UnitReferenceSink : public ReferenceSink
+{
+    const char *_unitFile;
+    UnitReferences &_unit;
+
+public:
+    UnitReferenceSink(const char *unitFile, UnitReferences &unit)
+        : _unitFile(unitFile), _unit(unit)
+    {
+    }
+
+    void reference(ReferenceKind kind, const char *name, const char *file,
+                   int line, int col, const char *function)
+    {
+        Reference r = {name, kind, line, col, function};
+
+        _unit.references.push_back({file != nullptr ? file : _unitFile, r});
+    }
+};
+
+// Only the references are needed, not the declarations.
+class ReferenceDeclarationSink : public DeclarationSink
+{
+public:
+    bool declaration(ASTNode *decl) { return false; }
+};
+
+static void parseUnit(const char *path, bool preprocess,
+                      HeaderModuleCache *modules, UnitReferences &unit)
+{
+    const char *unitFile = internName(path);
+    std::unordered_set<const char *> seen;
+    Lexer *lexer;
+
+    auto addFile = [&](const char *file, bool isParsed) {
+        if (seen.insert(file).second)
+            unit.files.push_back(file);
+        if (isParsed)
+            unit.parsedFiles.insert(file);
+    };
+
+    if (preprocess)
+        lexer = modules->createPreprocessor(path);
+    else
+        lexer = new CLexer(path);
+
+    addFile(unitFile, true);
+    {
+        CParser parser(lexer);
+        ReferenceDeclarationSink sink;
+        UnitReferenceSink refSink(unitFile, unit);
+        bool isBuilt = false;
+
+        // The references of the preamble are only seen by the translation
+        // unit that builds its module.
+        if (preprocess)
+            modules->attach(path, static_cast<Preprocessor *>(lexer), &parser,
+                            &refSink, &isBuilt);
+        parser.setDeclarationSink(&sink);
+        parser.setReferenceSink(&refSink);
+        parser.parse("");
+
+        if (preprocess)
+        {
+            std::vector<const SourceFile *> sourceFiles;
+
+            static_cast<Preprocessor *>(lexer)->getSourceFiles(sourceFiles);
+            for (const SourceFile *f : sourceFiles)
+                addFile(internName(f->path), true);
+        }
+        if (parser.getPrecompiledHeader() != nullptr)
+        {
+            PrecompiledHeader *pch = parser.getPrecompiledHeader();
+
+            // The module was made from the beginning of another
+            // translation unit, only the rest of it is this one's.
+            for (const std::string &file : pch->getSourceFiles())
+                if (file != pch->getHeader())
+                    addFile(internName(file), isBuilt);
+        }
+    }
+    // Line markers may name files that were not read.
+    for (auto &r : unit.references)
+        addFile(r.first, true);
+    delete lexer;
+}
+
+unsigned ReferenceDatabase::update(const std::vector<const char *> &paths,
+                                   unsigned jobs, bool preprocess,
+                                   HeaderModuleCache *modules)
+{
+    std::vector<ReferenceUnit> units;
+    std::vector<unsigned> parsed; // Units to parse
+    std::unordered_set<std::string> inputs(paths.begin(), paths.end());
+
+    // Units whose files all stayed the same are kept as they are.
+    for (ReferenceUnit &unit : _units)
+    {
+        bool isChanged = inputs.erase(unit.path) > 0;
+
+        if (!isChanged && getStamp(unit.files[0]).size == UINT64_MAX)
+            continue;
+        for (size_t i = 0; !isChanged && i < unit.files.size(); i++)
+        {
+            auto it = _oldStamps.find(unit.files[i]);
+
+            isChanged = it == _oldStamps.end() ||
+                        it->second != getStamp(unit.files[i]);
+        }
+        if (isChanged)
+            parsed.push_back(units.size());
+        units.push_back(unit);
+    }
+    for (const char *path : paths)
+    {
+        if (inputs.erase(path) == 0)
+            continue;
+        parsed.push_back(units.size());
+        units.push_back(ReferenceUnit{path, {}});
+    }
+
+    std::vector<UnitReferences> results(parsed.size());
+    std::atomic<unsigned> next(0);
+    std::vector<std::thread> threads;
+
+    // Tables that are built on first use are built before the threads start.
+    CLexer::initialize();
+    CParser::initNames();
+    NullASTNode::getInstance();
+
+    auto parser = [&]() {
+        unsigned i;
+
+        while ((i = next++) < parsed.size())
+            parseUnit(units[parsed[i]].path.c_str(), preprocess, modules,
+                      results[i]);
+    };
+    for (unsigned i = 0; i < jobs && i < parsed.size(); i++)
+        threads.push_back(std::thread(parser));
+    for (unsigned i = 0; i < threads.size(); i++)
+        threads[i].join();
+
+    // Each file parsed gets the references of the first unit that parsed
+    // it. The others keep the ones they have.
+    std::unordered_map<const char *, unsigned> owners;
+
+    for (unsigned i = 0; i < parsed.size(); i++)
+    {
+        units[parsed[i]].files = results[i].files;
+        for (const char *file : results[i].parsedFiles)
+        {
+            if (owners.insert({file, i}).second)
+                _files[file].clear();
+        }
+        for (auto &r : results[i].references)
+            if (owners[r.first] == i)
+                _files[r.first].push_back(r.second);
+        std::vector<std::pair<const char *, Reference>>().swap(
+            results[i].references);
+    }
+
+    // Files no unit reads any more are dropped.
+    std::unordered_set<const char *> files;
+    for (const ReferenceUnit &unit : units)
+        files.insert(unit.files.begin(), unit.files.end());
+    for (auto it = _files.begin(); it != _files.end();)
+    {
+        if (files.count(it->first) == 0)
+            it = _files.erase(it);
+        else
+            ++it;
+    }
+
+    _units.swap(units);
+    return parsed.size();
+}
+
+bool ReferenceDatabase::read(const ReferenceIndex &index)
+{
+    std::vector<const char *> files(index.getNumFiles());
+    std::vector<IndexedReference> refs;
+
+    _units.clear();
+    _files.clear();
+    _oldStamps.clear();
+    for (unsigned i = 0; i < index.getNumFiles(); i++)
+    {
+        files[i] = internName(index.getFile(i));
+        _oldStamps[files[i]] = index.getFileStamp(i);
+    }
+    for (unsigned i = 0; i < index.getNumUnits(); i++)
+    {
+        ReferenceUnit unit = {index.getUnit(i), {}};
+
+        for (unsigned j = 0; j < index.getNumDependencies(i); j++)
+        {
+            unsigned file = index.getDependency(i, j);
+
+            if (file >= files.size())
+                return false;
+            unit.files.push_back(files[file]);
+        }
+        if (unit.files.empty())
+            return false;
+        _units.push_back(unit);
+    }
+    // Strings are stored once, so each one is interned once.
+    std::unordered_map<const char *, const char *> interned;
+    auto intern = [&](const char *s) {
+        auto it = interned.find(s);
+
+        if (it == interned.end())
+            it = interned.insert({s, internName(s)}).first;
+        return it->second;
+    };
+
+    for (unsigned i = 0; i < index.getNumNames(); i++)
+    {
+        const char *name = internName(index.getName(i));
+
+        refs.clear();
+        if (!index.getReferences(i, refs))
+            return false;
+        for (const IndexedReference &r : refs)
+        {
+            Reference ref = {name, r.kind, (int) r.line, (int) r.col,
+                             r.function != nullptr ? intern(r.function)
+                                                   : nullptr};
+            _files[intern(r.file)].push_back(ref);
+        }
+    }
+    return true;
+}
+
+//
+// Index file
+//
+
+static void putWord(std::string &data, uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+        data.push_back((v >> (8 * i)) & 0xff);
+}
+
+static void putVarint(std::string &data, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        data.push_back((v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    data.push_back(v);
+}
+
+// Returns false if the number does not end before end.
+static bool getVarint(const unsigned char *&p, const unsigned char *end,
+                      uint64_t &v)
+{
+    v = 0;
+    for (unsigned shift = 0; p < end && shift < 64; shift += 7)
+    {
+        unsigned char c = *p++;
+
+        v |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80))
+            return true;
+    }
+    return false;
+}
+
+// A reference with its name and file numbered
+struct Posting
+{
+    uint32_t name;
+    uint32_t file;
+    uint32_t line;
+    uint32_t col;
+    ReferenceKind kind;
+    const char *function;
+
+    bool operator<(const Posting &p) const
+    {
+        if (name != p.name)
+            return name < p.name;
+        if (file != p.file)
+            return file < p.file;
+        if (line != p.line)
+            return line < p.line;
+        if (col != p.col)
+            return col < p.col;
+        return kind < p.kind;
+    }
+    bool operator==(const Posting &p) const
+    {
+        return name == p.name && file == p.file && line == p.line &&
+               col == p.col && kind == p.kind;
+    }
+};
+
+static bool lessString(const char *a, const char *b)
+{
+    return strcmp(a, b) < 0;
+}
+
+bool ReferenceDatabase::write(const char *path)
+{
+    std::string strings, unitTable, dependencyTable, fileTable, nameTable;
+    std::string postings;
+    std::unordered_map<const char *, uint32_t> offsets;
+
+    // Strings are interned, each one is written once.
+    auto stringOffset = [&](const char *s) {
+        auto it = offsets.find(s);
+
+        if (it != offsets.end())
+            return it->second;
+
+        uint32_t offset = strings.size();
+        strings.append(s, strlen(s) + 1);
+        offsets[s] = offset;
+        return offset;
+    };
+
+    // Files and names are numbered in the order of their strings.
+    std::vector<const char *> files, names;
+    std::unordered_map<const char *, uint32_t> fileNumbers, nameNumbers;
+
+    for (const ReferenceUnit &unit : _units)
+        for (const char *file : unit.files)
+            if (fileNumbers.insert({file, 0}).second)
+                files.push_back(file);
+    std::sort(files.begin(), files.end(), lessString);
+    for (uint32_t i = 0; i < files.size(); i++)
+        fileNumbers[files[i]] = i;
+
+    for (auto &f : _files)
+        for (const Reference &r : f.second)
+            if (nameNumbers.insert({r.name, 0}).second)
+                names.push_back(r.name);
+    std::sort(names.begin(), names.end(), lessString);
+    for (uint32_t i = 0; i < names.size(); i++)
+        nameNumbers[names[i]] = i;
+
+    std::vector<Posting> refs;
+    for (auto &f : _files)
+    {
+        uint32_t file = fileNumbers[f.first];
+
+        for (const Reference &r : f.second)
+        {
+            Posting p = {nameNumbers[r.name], file,
+                         (uint32_t) std::max(r.line, 0),
+                         (uint32_t) std::max(r.col, 0), r.kind, r.function};
+            refs.push_back(p);
+        }
+    }
+    std::sort(refs.begin(), refs.end());
+    refs.erase(std::unique(refs.begin(), refs.end()), refs.end());
+
+    uint32_t nDependencies = 0;
+    for (const ReferenceUnit &unit : _units)
+    {
+        putWord(unitTable, stringOffset(internName(unit.path)));
+        putWord(unitTable, nDependencies);
+        putWord(unitTable, unit.files.size());
+        for (const char *file : unit.files)
+            putWord(dependencyTable, fileNumbers[file]);
+        nDependencies += unit.files.size();
+    }
+    for (const char *file : files)
+    {
+        const FileStamp &stamp = getStamp(file);
+
+        putWord(fileTable, stringOffset(file));
+        putWord(fileTable, stamp.size);
+        putWord(fileTable, stamp.size >> 32);
+        putWord(fileTable, stamp.hash);
+        putWord(fileTable, stamp.hash >> 32);
+    }
+
+    // The references to a name are differences to the one before: to the
+    // file, to the line, and the column, to the one before on the same
+    // line. The last number holds the kind and the function.
+    size_t i = 0;
+    for (uint32_t name = 0; name < names.size(); name++)
+    {
+        uint32_t file = 0, line = 0, col = 0;
+        size_t first = i;
+
+        putWord(nameTable, stringOffset(names[name]));
+        putWord(nameTable, postings.size());
+        for (; i < refs.size() && refs[i].name == name; i++)
+        {
+            const Posting &p = refs[i];
+
+            putVarint(postings, p.file - file);
+            if (p.file != file)
+                line = col = 0;
+            putVarint(postings, p.line - line);
+            if (p.line != line)
+                col = 0;
+            putVarint(postings, p.col - col);
+            putVarint(postings,
+                      p.kind | (p.function != nullptr
+                                    ? ((uint64_t) stringOffset(p.function) + 1)
+                                          << 2
+                                    : 0));
+            file = p.file;
+            line = p.line;
+            col = p.col;
+        }
+        putWord(nameTable, i - first);
+    }
+
+    uint32_t options = stringOffset(internName(_options));
+    std::string data(XREF_MAGIC, XREF_MAGIC_LEN);
+    putWord(data, _units.size());
+    putWord(data, nDependencies);
+    putWord(data, files.size());
+    putWord(data, names.size());
+    putWord(data, postings.size());
+    putWord(data, strings.size());
+    putWord(data, options);
+    data += unitTable + dependencyTable + fileTable + nameTable + postings +
+            strings;
+
+    // Written as a temporary file and renamed, as PrecompiledHeader is.
+    std::string tmp = std::string(path) + ".tmp";
+    FILE *fp = fopen(tmp.c_str(), "wb");
+
+    if (fp == NULL)
+        return false;
+    bool ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+    ok = fclose(fp) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path) != 0)
+    {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+ReferenceIndex::ReferenceIndex()
+    : _data(nullptr), _size(0), _nUnits(0), _nDependencies(0), _nFiles(0),
+      _nNames(0), _postingsSize(0), _stringsSize(0), _options(0),
+      _unitTable(nullptr), _dependencyTable(nullptr), _fileTable(nullptr),
+      _nameTable(nullptr), _postings(nullptr), _strings(nullptr)
+{
+}
+
+ReferenceIndex::~ReferenceIndex()
+{
+    if (_data != nullptr)
+        munmap((void *) _data, _size);
+}
+
+uint32_t ReferenceIndex::word(const char *p, unsigned i) const
+{
+    const unsigned char *q = (const unsigned char *) p + 4 * (size_t) i;
+
+    return q[0] | (q[1] << 8) | (q[2] << 16) | ((uint32_t) q[3] << 24);
+}
+
+bool ReferenceIndex::load(const char *path)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if (_data != nullptr)
+        munmap((void *) _data, _size);
+    _data = nullptr;
+    _nUnits = _nDependencies = _nFiles = _nNames = 0;
+    _postingsSize = _stringsSize = _options = 0;
+    _error = "can not read it";
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (p != MAP_FAILED)
+        {
+            _data = (const char *) p;
+            _size = st.st_size;
+        }
+    }
+    close(fd);
+    if (_data == nullptr)
+        return false;
+
+    if (_size < XREF_HEADER_SIZE ||
+        memcmp(_data, XREF_MAGIC, XREF_MAGIC_LEN) != 0)
+    {
+        _error = "not a cross-reference index";
+        return false;
+    }
+
+    const char *header = _data + XREF_MAGIC_LEN;
+    uint64_t nUnits = word(header, 0), nDependencies = word(header, 1);
+    uint64_t nFiles = word(header, 2), nNames = word(header, 3);
+    uint64_t postingsSize = word(header, 4), stringsSize = word(header, 5);
+    uint64_t size = XREF_HEADER_SIZE +
+                    4 * (3 * nUnits + nDependencies + 5 * nFiles +
+                         3 * nNames) +
+                    postingsSize + stringsSize;
+
+    // Every string ends within the strings, so none can be read past them.
+    if (size != _size || stringsSize == 0 || _data[_size - 1] != '\0' ||
+        word(header, 6) >= stringsSize)
+    {
+        _error = "the index is damaged";
+        return false;
+    }
+
+    _nUnits = nUnits;
+    _nDependencies = nDependencies;
+    _nFiles = nFiles;
+    _nNames = nNames;
+    _postingsSize = postingsSize;
+    _stringsSize = stringsSize;
+    _options = word(header, 6);
+    _unitTable = _data + XREF_HEADER_SIZE;
+    _dependencyTable = _unitTable + 4 * 3 * nUnits;
+    _fileTable = _dependencyTable + 4 * nDependencies;
+    _nameTable = _fileTable + 4 * 5 * nFiles;
+    _postings = _nameTable + 4 * 3 * nNames;
+    _strings = _postings + postingsSize;
+    return true;
+}
+
+const char *ReferenceIndex::string(uint32_t offset) const
+{
+    return offset < _stringsSize ? _strings + offset : "";
+}
+
+const char *ReferenceIndex::getUnit(unsigned unit) const
+{
+    return string(word(_unitTable, 3 * unit));
+}
+
+unsigned ReferenceIndex::getNumDependencies(unsigned unit) const
+{
+    uint64_t first = word(_unitTable, 3 * unit + 1);
+    uint64_t n = word(_unitTable, 3 * unit + 2);
+
+    return first + n <= _nDependencies ? n : 0;
+}
+
+unsigned ReferenceIndex::getDependency(unsigned unit, unsigned i) const
+{
+    return word(_dependencyTable, word(_unitTable, 3 * unit + 1) + i);
+}
+
+const char *ReferenceIndex::getFile(unsigned file) const
+{
+    return string(word(_fileTable, 5 * file));
+}
+
+FileStamp ReferenceIndex::getFileStamp(unsigned file) const
+{
+    FileStamp stamp;
+
+    stamp.size = word(_fileTable, 5 * file + 1) |
+                 (uint64_t) word(_fileTable, 5 * file + 2) << 32;
+    stamp.hash = word(_fileTable, 5 * file + 3) |
+                 (uint64_t) word(_fileTable, 5 * file + 4) << 32;
+    return stamp;
+}
+
+const char *ReferenceIndex::getName(unsigned name) const
+{
+    return string(word(_nameTable, 3 * name));
+}
+
+int ReferenceIndex::find(const char *name) const
+{
+    unsigned lo = 0, hi = _nNames;
+
+    while (lo < hi)
+    {
+        unsigned mid = lo + (hi - lo) / 2;
+        int c = strcmp(getName(mid), name);
+
+        if (c == 0)
+            return mid;
+        if (c < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return -1;
+}
+
+bool ReferenceIndex::getReferences(unsigned name,
+                                   std::vector<IndexedReference> &refs) const
+{
+    uint32_t first = word(_nameTable, 3 * name + 1);
+    uint32_t last = name + 1 < _nNames ? word(_nameTable, 3 * name + 4)
+                                       : _postingsSize;
+    uint32_t n = word(_nameTable, 3 * name + 2);
+
+    if (first > last || last > _postingsSize)
+        return false;
+
+    const unsigned char *p = (const unsigned char *) _postings + first;
+    const unsigned char *end = (const unsigned char *) _postings + last;
+    uint64_t file = 0, line = 0, col = 0;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint64_t dFile, dLine, dCol, tag;
+
+        if (!getVarint(p, end, dFile) || !getVarint(p, end, dLine) ||
+            !getVarint(p, end, dCol) || !getVarint(p, end, tag))
+            return false;
+        if (dFile != 0)
+            line = col = 0;
+        if (dLine != 0)
+            col = 0;
+        file += dFile;
+        line += dLine;
+        col += dCol;
+        if (file >= _nFiles || line > UINT32_MAX || col > UINT32_MAX)
+            return false;
+
+        IndexedReference r = {(ReferenceKind)(tag & 3), getFile(file),
+                              (unsigned) line, (unsigned) col,
+                              tag >> 2 != 0 ? string((tag >> 2) - 1)
+                                            : nullptr};
+        refs.push_back(r);
+    }
+    return p == end;
+}
+
+} // namespace cparser
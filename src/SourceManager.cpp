@@ -0,0 +1,116 @@
+// Source manager - implementation file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#include "../include/SourceManager.h"
+
+namespace cparser
+{
+
+unsigned SourceManager::getFileId(const std::string &name)
+{
+    std::map<std::string, unsigned>::iterator it = _fileIds.find(name);
+
+    if (it != _fileIds.end())
+        return it->second;
+
+    unsigned fileId = _files.size();
+    _files.push_back(name);
+    _fileIds.insert(std::make_pair(name, fileId));
+    return fileId;
+}
+
+void SourceManager::addIgnoredPath(const std::string &prefix)
+{
+    _ignoredPaths.push_back(prefix);
+}
+
+bool SourceManager::isIgnoredFile(const std::string &name) const
+{
+    for (unsigned i = 0; i < _ignoredPaths.size(); i++)
+        if (name.compare(0, _ignoredPaths[i].size(), _ignoredPaths[i]) == 0)
+            return true;
+
+    return false;
+}
+
+void SourceManager::addLineMarker(int physLine, int presumedLine,
+                                  const std::string &file, bool isSystemHeader)
+{
+    LineMarker marker;
+
+    marker.physLine = physLine;
+    marker.presumedLine = presumedLine;
+    marker.fileId = getFileId(file);
+    marker.isSystemHeader = isSystemHeader || isIgnoredFile(file);
+
+    // Markers arrive in order; a later marker for the same line wins.
+    if (!_markers.empty() && _markers.back().physLine == physLine)
+        _markers.back() = marker;
+    else
+        _markers.push_back(marker);
+}
+
+const LineMarker *SourceManager::findLineMarker(int physLine)
+{
+    if (_markers.empty() || physLine < _markers[0].physLine)
+        return nullptr;
+
+    // Queries mostly go forward, so try the last marker and its successor
+    // before falling back to a binary search.
+    if (_lastMarker < _markers.size() &&
+        _markers[_lastMarker].physLine <= physLine)
+    {
+        if (_lastMarker + 1 == _markers.size() ||
+            physLine < _markers[_lastMarker + 1].physLine)
+            return &_markers[_lastMarker];
+
+        if (_lastMarker + 2 == _markers.size() ||
+            physLine < _markers[_lastMarker + 2].physLine)
+            return &_markers[++_lastMarker];
+    }
+
+    unsigned lo = 0, hi = _markers.size();
+
+    // Find the last marker with physLine not greater than the given one.
+    while (hi - lo > 1)
+    {
+        unsigned mid = (lo + hi) / 2;
+
+        if (_markers[mid].physLine <= physLine)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    _lastMarker = lo;
+    return &_markers[lo];
+}
+
+bool SourceManager::isSystemHeader(int physLine)
+{
+    const LineMarker *marker = findLineMarker(physLine);
+
+    return marker != nullptr && marker->isSystemHeader;
+}
+
+int SourceManager::getPresumedLine(int physLine)
+{
+    const LineMarker *marker = findLineMarker(physLine);
+
+    if (marker == nullptr)
+        return physLine;
+
+    return marker->presumedLine + physLine - marker->physLine;
+}
+
+const char *SourceManager::getPresumedFileName(int physLine)
+{
+    const LineMarker *marker = findLineMarker(physLine);
+
+    return marker != nullptr ? getFileName(marker->fileId) : nullptr;
+}
+
+} // namespace cparser
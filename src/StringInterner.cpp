@@ -0,0 +1,212 @@
+// String interner - implementation file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#include "../include/StringInterner.h"
+
+namespace cparser
+{
+
+#define INTERNER_INITIAL_SLOTS 64
+#define INTERNER_BLOCK_SIZE 65536
+
+// FNV-1a
+static uint64_t hashString(const char *s, size_t length)
+{
+    uint64_t h = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        h ^= (unsigned char) s[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static StringInterner *instance = nullptr;
+static std::once_flag instanceOnce;
+
+StringInterner *StringInterner::getInstance()
+{
+    // Never deleted, so handles stay valid while exit() runs destructors
+    // and other threads are still parsing.
+    std::call_once(instanceOnce, []() { instance = new StringInterner(); });
+    return instance;
+}
+
+StringInterner::StringInterner()
+{
+    for (Shard &shard : _shards)
+    {
+        Table *table = new Table;
+
+        table->mask = INTERNER_INITIAL_SLOTS - 1;
+        table->slots = new std::atomic<Entry *>[INTERNER_INITIAL_SLOTS];
+        for (size_t i = 0; i < INTERNER_INITIAL_SLOTS; i++)
+            table->slots[i].store(nullptr, std::memory_order_relaxed);
+        table->previous = nullptr;
+        shard.table.store(table, std::memory_order_relaxed);
+        shard.count = 0;
+        shard.blockLeft = 0;
+    }
+}
+
+StringInterner::~StringInterner()
+{
+    for (Shard &shard : _shards)
+    {
+        Table *table = shard.table.load(std::memory_order_relaxed);
+
+        while (table != nullptr)
+        {
+            Table *previous = table->previous;
+
+            delete[] table->slots;
+            delete table;
+            table = previous;
+        }
+        for (char *block : shard.blocks)
+            delete[] block;
+    }
+}
+
+StringInterner::Entry *StringInterner::lookup(Table *table, uint64_t hash,
+                                              const char *s, size_t length)
+{
+    // Linear probing. Slots are only ever filled, so an empty slot ends
+    // the search.
+    for (size_t i = hash & table->mask;; i = (i + 1) & table->mask)
+    {
+        Entry *e = table->slots[i].load(std::memory_order_acquire);
+
+        if (e == nullptr)
+            return nullptr;
+        if (e->hash == hash && e->length == length &&
+            memcmp(e->chars, s, length) == 0)
+            return e;
+    }
+}
+
+StringInterner::Entry *StringInterner::allocEntry(Shard &shard,
+                                                  uint64_t hash,
+                                                  const char *s,
+                                                  size_t length)
+{
+    size_t align = alignof(Entry);
+    size_t size = (offsetof(Entry, chars) + length + 1 + align - 1) &
+                  ~(align - 1);
+    char *p;
+
+    if (size > INTERNER_BLOCK_SIZE / 4)
+    {
+        // A long name gets a block of its own.
+        p = new char[size];
+        shard.blocks.push_back(p);
+    }
+    else
+    {
+        if (size > shard.blockLeft)
+        {
+            shard.blocks.push_back(new char[INTERNER_BLOCK_SIZE]);
+            shard.blockLeft = INTERNER_BLOCK_SIZE;
+        }
+        p = shard.blocks.back() + INTERNER_BLOCK_SIZE - shard.blockLeft;
+        shard.blockLeft -= size;
+    }
+
+    Entry *e = reinterpret_cast<Entry *>(p);
+    e->hash = hash;
+    e->length = length;
+    memcpy(e->chars, s, length);
+    e->chars[length] = '\0';
+    return e;
+}
+
+// Called with the lock of shard held
+void StringInterner::grow(Shard &shard)
+{
+    Table *old = shard.table.load(std::memory_order_relaxed);
+    Table *table = new Table;
+    size_t n = (old->mask + 1) * 2;
+
+    table->mask = n - 1;
+    table->slots = new std::atomic<Entry *>[n];
+    for (size_t i = 0; i < n; i++)
+        table->slots[i].store(nullptr, std::memory_order_relaxed);
+    for (size_t i = 0; i <= old->mask; i++)
+    {
+        Entry *e = old->slots[i].load(std::memory_order_relaxed);
+
+        if (e == nullptr)
+            continue;
+
+        size_t j = e->hash & table->mask;
+        while (table->slots[j].load(std::memory_order_relaxed) != nullptr)
+            j = (j + 1) & table->mask;
+        table->slots[j].store(e, std::memory_order_relaxed);
+    }
+    table->previous = old;
+    shard.table.store(table, std::memory_order_release);
+}
+
+const char *StringInterner::intern(const char *s, size_t length)
+{
+    uint64_t hash = hashString(s, length);
+    Shard &shard = _shards[hash >> (64 - INTERNER_SHARD_BITS)];
+    Entry *e = lookup(shard.table.load(std::memory_order_acquire), hash, s,
+                      length);
+
+    if (e != nullptr)
+        return e->chars;
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    // Another thread may have added it meanwhile.
+    Table *table = shard.table.load(std::memory_order_relaxed);
+    e = lookup(table, hash, s, length);
+    if (e != nullptr)
+        return e->chars;
+
+    // At most half full
+    if ((shard.count + 1) * 2 > table->mask + 1)
+    {
+        grow(shard);
+        table = shard.table.load(std::memory_order_relaxed);
+    }
+
+    e = allocEntry(shard, hash, s, length);
+
+    size_t i = hash & table->mask;
+    while (table->slots[i].load(std::memory_order_relaxed) != nullptr)
+        i = (i + 1) & table->mask;
+    table->slots[i].store(e, std::memory_order_release);
+    shard.count++;
+    return e->chars;
+}
+
+const char *StringInterner::find(const char *s, size_t length)
+{
+    uint64_t hash = hashString(s, length);
+    Shard &shard = _shards[hash >> (64 - INTERNER_SHARD_BITS)];
+    Entry *e = lookup(shard.table.load(std::memory_order_acquire), hash, s,
+                      length);
+
+    return e != nullptr ? e->chars : nullptr;
+}
+
+size_t StringInterner::size()
+{
+    size_t n = 0;
+
+    for (Shard &shard : _shards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        n += shard.count;
+    }
+    return n;
+}
+
+} // namespace cparser
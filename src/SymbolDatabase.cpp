@@ -0,0 +1,528 @@
+// Symbol database - implementation file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#include "../include/SymbolDatabase.h"
+#include "../include/CLexer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iterator>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace cparser
+{
+
+#define SYMDB_MAGIC "CFSYM\0\0\1"
+#define SYMDB_MAGIC_LEN 8
+#define SYMDB_HEADER_SIZE (SYMDB_MAGIC_LEN + 4 * 4)
+
+#define SYMDB_SHARD_BITS 6
+#define SYMDB_SHARDS (1 << SYMDB_SHARD_BITS)
+
+// Symbol of the global scope of one translation unit
+struct UnitSymbol
+{
+    const char *name;
+    const char *file;
+    int line;
+    STObjectKind kind;
+    bool isDefinition;
+    bool isStatic;
+};
+
+// Symbols of one translation unit, by shard
+struct UnitShards
+{
+    std::vector<UnitSymbol> shards[SYMDB_SHARDS];
+};
+
+// Names are interned, so the shard of a name is found from its handle.
+static unsigned getShard(const char *name)
+{
+    uint64_t h = (uint64_t)(uintptr_t) name * 0x9e3779b97f4a7c15ull;
+
+    return h >> (64 - SYMDB_SHARD_BITS);
+}
+
+// The parser keeps none of the declarations, only its symbol table is
+// needed.
+class ReleaseDeclarationSink : public DeclarationSink
+{
+public:
+    bool declaration(ASTNode *decl) { return false; }
+};
+
+//
+// Map
+//
+
+static void mapUnit(const char *path, bool preprocess,
+                    HeaderModuleCache *modules, UnitShards &shards)
+{
+    Lexer *lexer;
+
+    if (preprocess)
+        lexer = modules->createPreprocessor(path);
+    else
+        lexer = new CLexer(path);
+
+    {
+        CParser parser(lexer);
+        ReleaseDeclarationSink sink;
+
+        if (preprocess)
+            modules->attach(path, static_cast<Preprocessor *>(lexer), &parser);
+        // Function bodies hold no global symbols.
+        parser.setLazyFunctionBodies(true);
+        parser.setDeclarationSink(&sink);
+        parser.parse("");
+
+        SequenceASTNode *root =
+            static_cast<SequenceASTNode *>(parser.getAST()->getRoot());
+        const char *unitFile = internName(path);
+
+        for (STObject *o = root->getScope()->locals; o != nullptr;
+             o = o->next)
+        {
+            if (o->line == 0 || (o->kind != STOK_FUNC &&
+                                 o->kind != STOK_VAR && o->kind != STOK_TYPE))
+                continue;
+
+            UnitSymbol s = {o->name, o->file != nullptr ? o->file : unitFile,
+                            o->line, o->kind, o->isDefinition, o->isStatic};
+            shards.shards[getShard(o->name)].push_back(s);
+        }
+    }
+    delete lexer;
+}
+
+//
+// Reduce
+//
+
+// Types, functions and variables with external linkage, and those with
+// internal linkage of each translation unit are apart.
+struct SymbolKey
+{
+    const char *name;
+    uint32_t space; // 0 for types, 1 for external, 2 + unit for internal
+
+    bool operator==(const SymbolKey &k) const
+    {
+        return name == k.name && space == k.space;
+    }
+};
+
+struct SymbolKeyHash
+{
+    size_t operator()(const SymbolKey &k) const
+    {
+        return std::hash<const void *>()(k.name) * 31 + k.space;
+    }
+};
+
+static bool hasSite(const std::vector<SymbolSite> &sites, const char *file,
+                    int line)
+{
+    for (const SymbolSite &site : sites)
+        if (site.file == file && site.line == line)
+            return true;
+    return false;
+}
+
+// Merge shard of every translation unit, in the order of the units.
+static void reduceShard(const std::vector<UnitShards> &units, unsigned shard,
+                        std::vector<Symbol> &symbols)
+{
+    std::unordered_map<SymbolKey, size_t, SymbolKeyHash> index;
+
+    for (uint32_t unit = 0; unit < units.size(); unit++)
+    {
+        for (const UnitSymbol &s : units[unit].shards[shard])
+        {
+            SymbolKey key = {s.name, s.kind == STOK_TYPE ? 0u
+                                     : s.isStatic        ? 2 + unit
+                                                         : 1u};
+            auto it = index.find(key);
+            size_t i;
+
+            if (it == index.end())
+            {
+                i = symbols.size();
+                index[key] = i;
+                symbols.push_back(Symbol());
+                symbols[i].name = s.name;
+                symbols[i].kind = s.kind;
+                symbols[i].isStatic = s.isStatic && s.kind != STOK_TYPE;
+            }
+            else
+                i = it->second;
+
+            Symbol &symbol = symbols[i];
+            SymbolSite site = {unit, s.file, s.line};
+
+            // Types from the same place are one definition, functions and
+            // variables are defined once for the whole program.
+            if (s.isDefinition)
+            {
+                if (s.kind != STOK_TYPE ||
+                    !hasSite(symbol.definitions, s.file, s.line))
+                    symbol.definitions.push_back(site);
+            }
+            else if (!hasSite(symbol.declarations, s.file, s.line))
+                symbol.declarations.push_back(site);
+        }
+    }
+
+    // A declaration that is also a definition elsewhere is not repeated.
+    for (Symbol &symbol : symbols)
+    {
+        std::vector<SymbolSite> declarations;
+
+        for (const SymbolSite &site : symbol.declarations)
+            if (!hasSite(symbol.definitions, site.file, site.line))
+                declarations.push_back(site);
+        symbol.declarations.swap(declarations);
+    }
+}
+
+static uint32_t getFirstUnit(const Symbol &s)
+{
+    return !s.definitions.empty() ? s.definitions[0].unit
+                                  : s.declarations[0].unit;
+}
+
+// By name, types first, then external symbols, then internal ones by unit
+static bool lessSymbol(const Symbol &a, const Symbol &b)
+{
+    int c = a.name == b.name ? 0 : strcmp(a.name, b.name);
+
+    if (c != 0)
+        return c < 0;
+    if ((a.kind == STOK_TYPE) != (b.kind == STOK_TYPE))
+        return a.kind == STOK_TYPE;
+    if (a.isStatic != b.isStatic)
+        return b.isStatic;
+    return getFirstUnit(a) < getFirstUnit(b);
+}
+
+void SymbolDatabase::build(const std::vector<const char *> &paths,
+                           unsigned jobs, bool preprocess,
+                           HeaderModuleCache *modules)
+{
+    std::vector<UnitShards> units(paths.size());
+    std::vector<std::vector<Symbol>> shards(SYMDB_SHARDS);
+    std::atomic<unsigned> next(0);
+    std::vector<std::thread> threads;
+
+    _units.assign(paths.begin(), paths.end());
+    _symbols.clear();
+
+    // Tables that are built on first use are built before the threads start.
+    CLexer::initialize();
+    CParser::initNames();
+    NullASTNode::getInstance();
+
+    auto mapper = [&]() {
+        unsigned i;
+
+        while ((i = next++) < paths.size())
+            mapUnit(paths[i], preprocess, modules, units[i]);
+    };
+    for (unsigned i = 0; i < jobs && i < paths.size(); i++)
+        threads.push_back(std::thread(mapper));
+    for (unsigned i = 0; i < threads.size(); i++)
+        threads[i].join();
+    threads.clear();
+
+    next = 0;
+    auto reducer = [&]() {
+        unsigned i;
+
+        while ((i = next++) < SYMDB_SHARDS)
+        {
+            reduceShard(units, i, shards[i]);
+            std::sort(shards[i].begin(), shards[i].end(), lessSymbol);
+        }
+    };
+    for (unsigned i = 0; i < jobs && i < SYMDB_SHARDS; i++)
+        threads.push_back(std::thread(reducer));
+    for (unsigned i = 0; i < threads.size(); i++)
+        threads[i].join();
+
+    size_t n = 0;
+    for (const std::vector<Symbol> &shard : shards)
+        n += shard.size();
+    _symbols.reserve(n);
+    for (std::vector<Symbol> &shard : shards)
+    {
+        size_t middle = _symbols.size();
+
+        std::move(shard.begin(), shard.end(), std::back_inserter(_symbols));
+        std::inplace_merge(_symbols.begin(), _symbols.begin() + middle,
+                           _symbols.end(), lessSymbol);
+        std::vector<Symbol>().swap(shard);
+    }
+}
+
+//
+// Index file
+//
+
+static void putWord(std::string &data, uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+        data.push_back((v >> (8 * i)) & 0xff);
+}
+
+bool SymbolDatabase::write(const char *path)
+{
+    std::string strings, unitTable, symbolTable, siteTable;
+    std::unordered_map<const char *, uint32_t> offsets;
+    uint32_t nSites = 0;
+
+    // Names and files are interned, each one is written once.
+    auto stringOffset = [&](const char *s) {
+        auto it = offsets.find(s);
+
+        if (it != offsets.end())
+            return it->second;
+
+        uint32_t offset = strings.size();
+        strings.append(s, strlen(s) + 1);
+        offsets[s] = offset;
+        return offset;
+    };
+    auto putSite = [&](const SymbolSite &site) {
+        putWord(siteTable, site.unit);
+        putWord(siteTable, stringOffset(site.file));
+        putWord(siteTable, site.line);
+        nSites++;
+    };
+
+    for (const std::string &unit : _units)
+    {
+        putWord(unitTable, strings.size());
+        strings.append(unit.c_str(), unit.size() + 1);
+    }
+    for (const Symbol &s : _symbols)
+    {
+        putWord(symbolTable, stringOffset(s.name));
+        putWord(symbolTable, s.kind | (s.isStatic << 8));
+        putWord(symbolTable, nSites);
+        putWord(symbolTable, s.definitions.size());
+        putWord(symbolTable, s.declarations.size());
+        for (const SymbolSite &site : s.definitions)
+            putSite(site);
+        for (const SymbolSite &site : s.declarations)
+            putSite(site);
+    }
+
+    std::string data(SYMDB_MAGIC, SYMDB_MAGIC_LEN);
+    putWord(data, _units.size());
+    putWord(data, _symbols.size());
+    putWord(data, nSites);
+    putWord(data, strings.size());
+    data += unitTable + symbolTable + siteTable + strings;
+
+    // Written as a temporary file and renamed, as PrecompiledHeader is.
+    std::string tmp = std::string(path) + ".tmp";
+    FILE *fp = fopen(tmp.c_str(), "wb");
+
+    if (fp == NULL)
+        return false;
+    bool ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+    ok = fclose(fp) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path) != 0)
+    {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+SymbolIndex::SymbolIndex()
+    : _data(nullptr), _size(0), _nUnits(0), _nSymbols(0), _nSites(0),
+      _stringsSize(0), _unitTable(nullptr), _symbolTable(nullptr),
+      _siteTable(nullptr), _strings(nullptr)
+{
+}
+
+SymbolIndex::~SymbolIndex()
+{
+    if (_data != nullptr)
+        munmap((void *) _data, _size);
+}
+
+uint32_t SymbolIndex::word(const char *p, unsigned i) const
+{
+    const unsigned char *q = (const unsigned char *) p + 4 * (size_t) i;
+
+    return q[0] | (q[1] << 8) | (q[2] << 16) | ((uint32_t) q[3] << 24);
+}
+
+bool SymbolIndex::load(const char *path)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if (_data != nullptr)
+        munmap((void *) _data, _size);
+    _data = nullptr;
+    _nUnits = _nSymbols = _nSites = _stringsSize = 0;
+    _error = "can not read it";
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (p != MAP_FAILED)
+        {
+            _data = (const char *) p;
+            _size = st.st_size;
+        }
+    }
+    close(fd);
+    if (_data == nullptr)
+        return false;
+
+    if (_size < SYMDB_HEADER_SIZE ||
+        memcmp(_data, SYMDB_MAGIC, SYMDB_MAGIC_LEN) != 0)
+    {
+        _error = "not a symbol index";
+        return false;
+    }
+
+    const char *header = _data + SYMDB_MAGIC_LEN;
+    uint64_t nUnits = word(header, 0), nSymbols = word(header, 1);
+    uint64_t nSites = word(header, 2), stringsSize = word(header, 3);
+    uint64_t size = SYMDB_HEADER_SIZE + 4 * (nUnits + 5 * nSymbols +
+                                             3 * nSites) + stringsSize;
+
+    // Every string ends within the strings, so none can be read past them.
+    if (size != _size || stringsSize == 0 || _data[_size - 1] != '\0')
+    {
+        _error = "the index is damaged";
+        return false;
+    }
+
+    _nUnits = nUnits;
+    _nSymbols = nSymbols;
+    _nSites = nSites;
+    _stringsSize = stringsSize;
+    _unitTable = _data + SYMDB_HEADER_SIZE;
+    _symbolTable = _unitTable + 4 * nUnits;
+    _siteTable = _symbolTable + 4 * 5 * nSymbols;
+    _strings = _siteTable + 4 * 3 * nSites;
+
+    // The sites of every symbol are within the sites, so the counts read
+    // from the index can be trusted.
+    for (unsigned i = 0; i < _nSymbols; i++)
+    {
+        uint64_t end = (uint64_t) symbolWord(i, 2) + symbolWord(i, 3) +
+                       symbolWord(i, 4);
+
+        if (end > _nSites)
+        {
+            _nUnits = _nSymbols = _nSites = _stringsSize = 0;
+            _error = "the index is damaged";
+            return false;
+        }
+    }
+    return true;
+}
+
+const char *SymbolIndex::string(uint32_t offset) const
+{
+    return offset < _stringsSize ? _strings + offset : "";
+}
+
+SymbolLocation SymbolIndex::site(uint32_t i) const
+{
+    SymbolLocation location = {"", "", 0};
+
+    if (i < _nSites)
+    {
+        uint32_t unit = word(_siteTable, 3 * i);
+
+        if (unit < _nUnits)
+            location.unit = string(word(_unitTable, unit));
+        location.file = string(word(_siteTable, 3 * i + 1));
+        location.line = word(_siteTable, 3 * i + 2);
+    }
+    return location;
+}
+
+void SymbolIndex::find(const char *name, unsigned &first,
+                       unsigned &last) const
+{
+    unsigned lo = 0, hi = _nSymbols;
+
+    while (lo < hi)
+    {
+        unsigned mid = lo + (hi - lo) / 2;
+
+        if (strcmp(getName(mid), name) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    first = last = lo;
+    while (last < _nSymbols && strcmp(getName(last), name) == 0)
+        last++;
+}
+
+const char *SymbolIndex::getName(unsigned symbol) const
+{
+    return string(symbolWord(symbol, 0));
+}
+
+STObjectKind SymbolIndex::getKind(unsigned symbol) const
+{
+    return (STObjectKind)(symbolWord(symbol, 1) & 0xff);
+}
+
+bool SymbolIndex::isStatic(unsigned symbol) const
+{
+    return (symbolWord(symbol, 1) >> 8) & 1;
+}
+
+unsigned SymbolIndex::getNumDefinitions(unsigned symbol) const
+{
+    return symbolWord(symbol, 3);
+}
+
+unsigned SymbolIndex::getNumDeclarations(unsigned symbol) const
+{
+    return symbolWord(symbol, 4);
+}
+
+bool SymbolIndex::isDuplicate(unsigned symbol) const
+{
+    return getKind(symbol) != STOK_TYPE && !isStatic(symbol) &&
+           getNumDefinitions(symbol) > 1;
+}
+
+SymbolLocation SymbolIndex::getDefinition(unsigned symbol, unsigned i) const
+{
+    return site(symbolWord(symbol, 2) + i);
+}
+
+SymbolLocation SymbolIndex::getDeclaration(unsigned symbol, unsigned i) const
+{
+    return site(symbolWord(symbol, 2) + getNumDefinitions(symbol) + i);
+}
+
+} // namespace cparser
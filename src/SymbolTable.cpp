@@ -6,8 +6,10 @@
 // See the LICENSE file for more details.
 
 #include "../include/SymbolTable.h"
+#include "../include/RecordLayout.h"
 
 #include <cassert>
+#include <climits>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -15,6 +17,8 @@
 namespace cparser
 {
 
+STType::~STType() { delete layout; }
+
 STType *SymbolTable::allocType(STTypeKind kind)
 {
     STType *type = new STType(kind);
@@ -26,6 +30,7 @@ STObject *
 SymbolTable::allocObject(const char *name, STObjectKind kind, STType *type)
 {
     STObject *obj = new STObject(name, kind, type);
+    obj->serial = objectPool.size();
     objectPool.push_back(obj);
     return obj;
 }
@@ -40,6 +45,7 @@ STScope *SymbolTable::allocScope()
 SymbolTable::SymbolTable()
 {
     level = -1;
+    globalLimit = UINT_MAX;
     topScope = allocScope();
     topScope->outer = nullptr;
     globalScope = topScope;
@@ -125,7 +131,7 @@ STObject *SymbolTable::insert(const char *name, STObjectKind kind, STType *type)
     last = nullptr;
     while (p != nullptr)
     {
-        if (strcmp(p->name, name) == 0)
+        if (p->name == obj->name)
             return noObj;
         last = p;
         p = p->next;
@@ -141,9 +147,15 @@ STObject *SymbolTable::insert(const char *name, STObjectKind kind, STType *type)
 
 STObject *SymbolTable::find(const char *name)
 {
+    // Names of objects are interned, so a name that is not is in no scope.
+    const char *key = StringInterner::getInstance()->find(name);
+
+    if (key == nullptr)
+        return noObj;
+
     for (STScope *s = topScope; s != nullptr; s = s->outer)
         for (STObject *p = s->locals; p != nullptr; p = p->next)
-            if (strcmp(p->name, name) == 0)
+            if (p->name == key && (p->level > 0 || p->serial < globalLimit))
                 return p;
 
     return noObj;
@@ -157,6 +169,7 @@ void SymbolTable::openScope(void)
     topScope = s;
     topScope->size = 0;
     level++;
+    topScope->level = level;
 }
 
 void SymbolTable::closeScope(void)
@@ -165,7 +178,11 @@ void SymbolTable::closeScope(void)
     level--;
 }
 
-void SymbolTable::setTopScope(STScope *s) { topScope = s; }
+void SymbolTable::setTopScope(STScope *s)
+{
+    topScope = s;
+    level = s != nullptr ? s->level : -1;
+}
 
 STScope *SymbolTable::getTopScope() { return topScope; }
 
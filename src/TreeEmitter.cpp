@@ -0,0 +1,320 @@
+// Tree dump emitters - implementation file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#include "../include/TreeEmitter.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace cparser
+{
+
+void TreeEmitter::flush()
+{
+    if (!_buf.empty())
+    {
+        _out.write(_buf.data(), _buf.size());
+        _buf.clear();
+    }
+    _out.flush();
+}
+
+//
+// Text
+//
+
+void TextTreeEmitter::beginNode(const char *kind)
+{
+    flushIfFull();
+    _depth++;
+    indent(_depth);
+    _buf += kind;
+    _buf += '\n';
+}
+
+void TextTreeEmitter::child(const char *label)
+{
+    indent(_depth);
+    _buf += label;
+    _buf += ":\n";
+}
+
+void TextTreeEmitter::element(unsigned index)
+{
+    indent(_depth);
+    _buf += "Element ";
+    _buf += std::to_string(index);
+    _buf += ":\n";
+}
+
+void TextTreeEmitter::stringField(const char *name, const std::string &value)
+{
+    indent(_depth);
+    _buf += name;
+    _buf += ": ";
+    _buf += value;
+    _buf += '\n';
+}
+
+void TextTreeEmitter::intField(const char *name, long value)
+{
+    stringField(name, std::to_string(value));
+}
+
+void TextTreeEmitter::boolField(const char *name, bool value)
+{
+    stringField(name, value ? "true" : "false");
+}
+
+void TextTreeEmitter::intListField(const char *name,
+                                   const std::vector<int> &values,
+                                   bool asChars)
+{
+    indent(_depth);
+    _buf += name;
+    _buf += ':';
+    for (int v : values)
+    {
+        _buf += ' ';
+        if (asChars)
+            _buf += (char) v;
+        else
+            _buf += std::to_string(v);
+    }
+    _buf += '\n';
+    flushIfFull();
+}
+
+void TextTreeEmitter::dataField(const char *name, const std::string &value)
+{
+    indent(_depth);
+    _buf += name;
+    _buf += ":\n";
+    indent(_depth + 1);
+    _buf += value;
+    _buf += '\n';
+}
+
+//
+// JSON
+//
+
+void JSONTreeEmitter::appendString(const std::string &s)
+{
+    _buf += '"';
+    for (char c : s)
+    {
+        switch (c)
+        {
+        case '"':
+            _buf += "\\\"";
+            break;
+        case '\\':
+            _buf += "\\\\";
+            break;
+        case '\n':
+            _buf += "\\n";
+            break;
+        case '\t':
+            _buf += "\\t";
+            break;
+        default:
+            if ((unsigned char) c < 0x20)
+            {
+                char esc[8];
+                snprintf(esc, sizeof(esc), "\\u%04x", c);
+                _buf += esc;
+            }
+            else
+                _buf += c;
+            break;
+        }
+    }
+    _buf += '"';
+}
+
+// Every node starts with its kind, so other members always follow a comma.
+void JSONTreeEmitter::appendKey(const char *name)
+{
+    if (_valuePending)
+        missing();
+    _buf += ",\"";
+    _buf += name;
+    _buf += "\":";
+}
+
+void JSONTreeEmitter::beginNode(const char *kind)
+{
+    flushIfFull();
+    _buf += "{\"kind\":\"";
+    _buf += kind;
+    _buf += '"';
+    _inElements.push_back(false);
+    _valuePending = false;
+}
+
+void JSONTreeEmitter::endNode()
+{
+    if (_valuePending)
+        missing();
+    if (_inElements.back())
+        _buf += ']';
+    _buf += '}';
+    _inElements.pop_back();
+    if (_inElements.empty())
+        _buf += '\n';
+}
+
+void JSONTreeEmitter::child(const char *label)
+{
+    appendKey(label);
+    _valuePending = true;
+}
+
+void JSONTreeEmitter::element(unsigned index)
+{
+    if (_valuePending)
+        missing();
+    if (_inElements.back())
+        _buf += ',';
+    else
+    {
+        appendKey("elements");
+        _buf += '[';
+        _inElements.back() = true;
+    }
+    _valuePending = true;
+}
+
+void JSONTreeEmitter::missing()
+{
+    _buf += "null";
+    _valuePending = false;
+}
+
+void JSONTreeEmitter::stringField(const char *name, const std::string &value)
+{
+    appendKey(name);
+    appendString(value);
+}
+
+void JSONTreeEmitter::intField(const char *name, long value)
+{
+    appendKey(name);
+    _buf += std::to_string(value);
+}
+
+void JSONTreeEmitter::boolField(const char *name, bool value)
+{
+    appendKey(name);
+    _buf += value ? "true" : "false";
+}
+
+void JSONTreeEmitter::intListField(const char *name,
+                                   const std::vector<int> &values,
+                                   bool asChars)
+{
+    if (asChars)
+    {
+        stringField(name, std::string(values.begin(), values.end()));
+        return;
+    }
+
+    appendKey(name);
+    _buf += '[';
+    for (unsigned i = 0; i < values.size(); i++)
+    {
+        if (i > 0)
+            _buf += ',';
+        _buf += std::to_string(values[i]);
+    }
+    _buf += ']';
+    flushIfFull();
+}
+
+//
+// Binary
+//
+
+void BinaryTreeEmitter::appendInt(uint64_t v, unsigned size)
+{
+    for (unsigned i = 0; i < size; i++)
+        _buf += (char) (v >> (8 * i));
+}
+
+void BinaryTreeEmitter::appendName(const char *s)
+{
+    size_t len = strlen(s);
+
+    appendInt(len, 2);
+    _buf.append(s, len);
+}
+
+void BinaryTreeEmitter::beginNode(const char *kind)
+{
+    flushIfFull();
+    _buf += (char) BTT_BEGIN_NODE;
+    appendName(kind);
+}
+
+void BinaryTreeEmitter::endNode() { _buf += (char) BTT_END_NODE; }
+
+void BinaryTreeEmitter::child(const char *label)
+{
+    _buf += (char) BTT_CHILD;
+    appendName(label);
+}
+
+void BinaryTreeEmitter::element(unsigned index)
+{
+    _buf += (char) BTT_ELEMENT;
+    appendInt(index, 4);
+}
+
+void BinaryTreeEmitter::missing() { _buf += (char) BTT_MISSING; }
+
+void BinaryTreeEmitter::stringField(const char *name, const std::string &value)
+{
+    _buf += (char) BTT_STRING;
+    appendName(name);
+    appendInt(value.size(), 4);
+    _buf += value;
+}
+
+void BinaryTreeEmitter::intField(const char *name, long value)
+{
+    _buf += (char) BTT_INT;
+    appendName(name);
+    appendInt(value, 8);
+}
+
+void BinaryTreeEmitter::boolField(const char *name, bool value)
+{
+    _buf += (char) BTT_BOOL;
+    appendName(name);
+    _buf += (char) value;
+}
+
+void BinaryTreeEmitter::intListField(const char *name,
+                                     const std::vector<int> &values,
+                                     bool asChars)
+{
+    if (asChars)
+    {
+        stringField(name, std::string(values.begin(), values.end()));
+        return;
+    }
+
+    _buf += (char) BTT_INT_LIST;
+    appendName(name);
+    appendInt(values.size(), 4);
+    for (int v : values)
+        appendInt((uint32_t) v, 4);
+    flushIfFull();
+}
+
+} // namespace cparser
@@ -0,0 +1,255 @@
+// Structural tree hashing and diff - implementation file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#include "../include/TreeHash.h"
+#include "../include/ASTNode.h"
+#include "../include/TreeWalker.h"
+
+#include <unordered_map>
+
+namespace cparser
+{
+
+// Hash of a null child slot
+#define NULL_NODE_HASH 0x9e3779b97f4a7c15ULL
+
+static inline uint64_t mix(uint64_t h, uint64_t v)
+{
+    h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static uint64_t hashString(const char *s)
+{
+    uint64_t h = 0xcbf29ce484222325ULL; // FNV-1a
+
+    for (; *s; s++)
+    {
+        h ^= (unsigned char) *s;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// Hash of what a node holds besides its children
+static uint64_t hashValue(ASTNode *n)
+{
+    switch (n->getKind())
+    {
+        case NK_IDENT_NODE:
+            return hashString(static_cast<IdentASTNode *>(n)->getValue());
+        case NK_STRING_CONST:
+            return hashString(static_cast<StringConstASTNode *>(n)->getValue());
+        case NK_ASM_STMT:
+            return hashString(static_cast<AsmStmtASTNode *>(n)->getData());
+        case NK_INTEGER_CONST:
+            return static_cast<IntegerConstASTNode *>(n)->getValue();
+        case NK_REAL_CONST:
+            return (int) static_cast<RealConstASTNode *>(n)->getValue();
+        case NK_CHAR_CONST:
+            return static_cast<CharConstASTNode *>(n)->getValue();
+        case NK_INTEGRAL_TYPE:
+        {
+            IntegralTypeASTNode *t = static_cast<IntegralTypeASTNode *>(n);
+
+            return (t->getAlignment() << 1) | t->getIsSigned();
+        }
+        case NK_REAL_TYPE:
+        {
+            RealTypeASTNode *t = static_cast<RealTypeASTNode *>(n);
+
+            return (t->getAlignment() << 1) | t->getIsDouble();
+        }
+        case NK_PACKED_CONST_ARRAY:
+        {
+            PackedConstArrayASTNode *a =
+                static_cast<PackedConstArrayASTNode *>(n);
+            uint64_t h = mix(a->getElementKind(), a->size());
+
+            for (unsigned i = 0; i < a->size(); i++)
+                h = mix(h, a->getValue(i));
+            return h;
+        }
+        default:
+            return 0;
+    }
+}
+
+// Post-order with an explicit stack. Subtrees that already carry a hash are
+// not descended into.
+uint64_t hashTree(ASTNode *n)
+{
+    struct Frame
+    {
+        ASTNode *node;
+        bool post;
+    };
+
+    std::vector<Frame> stack;
+    std::vector<ASTNode *> slots;
+
+    if (n == NULL_AST_NODE)
+        return NULL_NODE_HASH;
+
+    stack.push_back({n, false});
+    while (!stack.empty())
+    {
+        Frame f = stack.back();
+
+        if (f.node->getHash() != 0)
+        {
+            stack.pop_back();
+            continue;
+        }
+
+        slots.clear();
+        TreeWalker::getSlots(f.node, slots);
+
+        if (!f.post)
+        {
+            stack.back().post = true;
+            for (size_t i = 0; i < slots.size(); i++)
+                if (slots[i] != NULL_AST_NODE && slots[i]->getHash() == 0)
+                    stack.push_back({slots[i], false});
+            continue;
+        }
+
+        stack.pop_back();
+
+        uint64_t h = mix(f.node->getKind(), f.node->getFlags());
+
+        h = mix(h, hashValue(f.node));
+        h = mix(h, slots.size());
+        for (size_t i = 0; i < slots.size(); i++)
+        {
+            if (slots[i] == NULL_AST_NODE)
+                h = mix(h, NULL_NODE_HASH);
+            else
+                h = mix(h, slots[i]->getHash());
+        }
+
+        // 0 means not computed yet
+        f.node->setHash(h != 0 ? h : 1);
+    }
+
+    return n->getHash();
+}
+
+static std::string getDeclarationName(ASTNode *decl)
+{
+    ASTNode *name = NULL_AST_NODE;
+
+    switch (decl->getKind())
+    {
+        case NK_FUNCTION_DECL:
+            name = static_cast<FunctionDeclASTNode *>(decl)->getName();
+            break;
+        case NK_VAR_DECL:
+            name = static_cast<VarDeclASTNode *>(decl)->getName();
+            break;
+        case NK_TYPE_DECL:
+            name = static_cast<TypeDeclASTNode *>(decl)->getName();
+            break;
+        case NK_STRUCT_TYPE:
+            name = static_cast<StructTypeASTNode *>(decl)->getName();
+            break;
+        case NK_UNION_TYPE:
+            name = static_cast<UnionTypeASTNode *>(decl)->getName();
+            break;
+        case NK_ENUMERAL_TYPE:
+            name = static_cast<EnumeralTypeASTNode *>(decl)->getName();
+            break;
+        default:
+            break;
+    }
+
+    if (name->getKind() != NK_IDENT_NODE)
+        return std::string();
+    return static_cast<IdentASTNode *>(name)->getValue();
+}
+
+static void getDeclarations(ASTNode *root, std::vector<ASTNode *> &decls)
+{
+    if (root == NULL_AST_NODE || root == nullptr)
+        return;
+
+    if (root->getKind() != NK_LIST)
+    {
+        decls.push_back(root);
+        return;
+    }
+
+    std::vector<ASTNode *> &elements =
+        static_cast<SequenceASTNode *>(root)->getElements();
+
+    for (unsigned i = 0; i < elements.size(); i++)
+        if (elements[i] != NULL_AST_NODE)
+            decls.push_back(elements[i]);
+}
+
+void diffTrees(ASTNode *oldRoot, ASTNode *newRoot,
+               std::vector<DeclChange> &changes)
+{
+    std::vector<ASTNode *> oldDecls, newDecls;
+    std::vector<bool> oldMatched;
+
+    // Unmatched old declarations, by name (in order) and by hash
+    std::unordered_map<std::string, std::vector<unsigned>> byName;
+    std::unordered_map<uint64_t, std::vector<unsigned>> byHash;
+
+    getDeclarations(oldRoot, oldDecls);
+    getDeclarations(newRoot, newDecls);
+    oldMatched.resize(oldDecls.size(), false);
+
+    // Push in reverse so that back() is the first occurrence.
+    for (unsigned i = oldDecls.size(); i > 0; i--)
+    {
+        std::string name = getDeclarationName(oldDecls[i - 1]);
+
+        if (name.empty())
+            byHash[hashTree(oldDecls[i - 1])].push_back(i - 1);
+        else
+            byName[name].push_back(i - 1);
+    }
+
+    for (unsigned i = 0; i < newDecls.size(); i++)
+    {
+        ASTNode *decl = newDecls[i];
+        std::string name = getDeclarationName(decl);
+        std::vector<unsigned> *candidates;
+
+        if (name.empty())
+            candidates = &byHash[hashTree(decl)];
+        else
+            candidates = &byName[name];
+
+        if (candidates->empty())
+        {
+            changes.push_back({DECL_ADDED, name, NULL_AST_NODE, decl});
+            continue;
+        }
+
+        unsigned o = candidates->back();
+
+        candidates->pop_back();
+        oldMatched[o] = true;
+        if (hashTree(oldDecls[o]) != hashTree(decl))
+            changes.push_back({DECL_CHANGED, name, oldDecls[o], decl});
+    }
+
+    for (unsigned i = 0; i < oldDecls.size(); i++)
+    {
+        if (!oldMatched[i])
+            changes.push_back({DECL_REMOVED, getDeclarationName(oldDecls[i]),
+                               oldDecls[i], NULL_AST_NODE});
+    }
+}
+
+} // namespace cparser
@@ -16,6 +16,7 @@ void TreeVisitor::visit(IntegerConstASTNode *n) {}
 void TreeVisitor::visit(RealConstASTNode *n) {}
 void TreeVisitor::visit(StringConstASTNode *n) {}
 void TreeVisitor::visit(CharConstASTNode *n) {}
+void TreeVisitor::visit(PackedConstArrayASTNode *n) {}
 
 void TreeVisitor::visit(SizeOfExprASTNode *n) { n->getExpr()->accept(this); }
 void TreeVisitor::visit(AlignOfExprASTNode *n) { n->getExpr()->accept(this); }
@@ -51,6 +52,7 @@ void TreeVisitor::visit(FieldDeclASTNode *n)
 {
     n->getName()->accept(this);
     n->getType()->accept(this);
+    n->getBitWidth()->accept(this);
 }
 
 void TreeVisitor::visit(AsmStmtASTNode *n) {}
@@ -0,0 +1,522 @@
+// Tree walker - implementation file.
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#include "../include/TreeWalker.h"
+#include "../include/ASTNode.h"
+
+namespace cparser
+{
+
+void TreeWalker::walk(ASTNode *root)
+{
+    if (root == NULL_AST_NODE)
+        return;
+
+    size_t base = _stack.size();
+
+    _stack.push_back({root, 0, false});
+    while (_stack.size() > base)
+    {
+        Frame f = _stack.back();
+
+        _stack.pop_back();
+        if (f.post)
+        {
+            postVisit(f.node, f.depth);
+            continue;
+        }
+
+        _stack.push_back({f.node, f.depth, true});
+        if (!preVisit(f.node, f.depth))
+            continue;
+
+        // Push the children in reverse so that the first one is on top.
+        _children.clear();
+        getChildren(f.node, _children);
+        for (size_t i = _children.size(); i > 0; i--)
+            _stack.push_back({_children[i - 1], f.depth + 1, false});
+    }
+}
+
+#define ADD_CHILD(c)                                                           \
+    {                                                                          \
+        ASTNode *tmp = c;                                                      \
+        if (tmp != NULL_AST_NODE)                                              \
+            children.push_back(tmp);                                           \
+    }
+
+#define ADD_OPERANDS(T)                                                        \
+    ADD_CHILD(static_cast<T *>(n)->getLhs());                                  \
+    ADD_CHILD(static_cast<T *>(n)->getRhs());
+
+void TreeWalker::getChildren(ASTNode *n, std::vector<ASTNode *> &children)
+{
+    switch (n->getKind())
+    {
+        case NK_SIZEOF_EXPR:
+            ADD_CHILD(static_cast<SizeOfExprASTNode *>(n)->getExpr());
+            break;
+        case NK_ALIGNOF_EXPR:
+            ADD_CHILD(static_cast<AlignOfExprASTNode *>(n)->getExpr());
+            break;
+        case NK_TYPE_DECL:
+        {
+            TypeDeclASTNode *d = static_cast<TypeDeclASTNode *>(n);
+
+            ADD_CHILD(d->getName());
+            ADD_CHILD(d->getBody());
+            break;
+        }
+        case NK_FUNCTION_DECL:
+        {
+            FunctionDeclASTNode *d = static_cast<FunctionDeclASTNode *>(n);
+
+            ADD_CHILD(d->getName());
+            ADD_CHILD(d->getType());
+            ADD_CHILD(d->getPrms());
+            ADD_CHILD(d->getBody());
+            break;
+        }
+        case NK_VAR_DECL:
+        {
+            VarDeclASTNode *d = static_cast<VarDeclASTNode *>(n);
+
+            ADD_CHILD(d->getName());
+            ADD_CHILD(d->getType());
+            ADD_CHILD(d->getInit());
+            break;
+        }
+        case NK_PARM_DECL:
+            ADD_CHILD(static_cast<ParmDeclASTNode *>(n)->getName());
+            ADD_CHILD(static_cast<ParmDeclASTNode *>(n)->getType());
+            break;
+        case NK_FIELD_DECL:
+            ADD_CHILD(static_cast<FieldDeclASTNode *>(n)->getName());
+            ADD_CHILD(static_cast<FieldDeclASTNode *>(n)->getType());
+            ADD_CHILD(static_cast<FieldDeclASTNode *>(n)->getBitWidth());
+            break;
+        case NK_CASE_LABEL:
+            ADD_CHILD(static_cast<CaseLabelASTNode *>(n)->getExpr());
+            ADD_CHILD(static_cast<CaseLabelASTNode *>(n)->getStmt());
+            break;
+        case NK_COMPOUND_STMT:
+            ADD_CHILD(static_cast<CompoundStmtASTNode *>(n)->getDecls());
+            ADD_CHILD(static_cast<CompoundStmtASTNode *>(n)->getStmts());
+            break;
+        case NK_DO_STMT:
+            ADD_CHILD(static_cast<DoStmtASTNode *>(n)->getBody());
+            ADD_CHILD(static_cast<DoStmtASTNode *>(n)->getCondition());
+            break;
+        case NK_FOR_STMT:
+        {
+            ForStmtASTNode *s = static_cast<ForStmtASTNode *>(n);
+
+            ADD_CHILD(s->getInit());
+            ADD_CHILD(s->getCondition());
+            ADD_CHILD(s->getStep());
+            ADD_CHILD(s->getBody());
+            break;
+        }
+        case NK_GOTO_STMT:
+            ADD_CHILD(static_cast<GotoStmtASTNode *>(n)->getLabel());
+            break;
+        case NK_IF_STMT:
+        {
+            IfStmtASTNode *s = static_cast<IfStmtASTNode *>(n);
+
+            ADD_CHILD(s->getCondition());
+            ADD_CHILD(s->getThenClause());
+            ADD_CHILD(s->getElseClause());
+            break;
+        }
+        case NK_LABEL_STMT:
+            ADD_CHILD(static_cast<LabelStmtASTNode *>(n)->getLabel());
+            ADD_CHILD(static_cast<LabelStmtASTNode *>(n)->getStmt());
+            break;
+        case NK_RETURN_STMT:
+            ADD_CHILD(static_cast<ReturnStmtASTNode *>(n)->getExpr());
+            break;
+        case NK_SWITCH_STMT:
+            ADD_CHILD(static_cast<SwitchStmtASTNode *>(n)->getExpr());
+            ADD_CHILD(static_cast<SwitchStmtASTNode *>(n)->getStmt());
+            break;
+        case NK_WHILE_STMT:
+            ADD_CHILD(static_cast<WhileStmtASTNode *>(n)->getCondition());
+            ADD_CHILD(static_cast<WhileStmtASTNode *>(n)->getBody());
+            break;
+        case NK_CAST_EXPR:
+            ADD_CHILD(static_cast<CastExprASTNode *>(n)->getType());
+            ADD_CHILD(static_cast<CastExprASTNode *>(n)->getExpr());
+            break;
+        case NK_BIT_NOT_EXPR:
+            ADD_CHILD(static_cast<BitNotExprASTNode *>(n)->getExpr());
+            break;
+        case NK_LOG_NOT_EXPR:
+            ADD_CHILD(static_cast<LogNotExprASTNode *>(n)->getExpr());
+            break;
+        case NK_PREDECREMENT_EXPR:
+            ADD_CHILD(static_cast<PredecrementExprASTNode *>(n)->getExpr());
+            break;
+        case NK_PREINCREMENT_EXPR:
+            ADD_CHILD(static_cast<PreincrementExprASTNode *>(n)->getExpr());
+            break;
+        case NK_POSTDECREMENT_EXPR:
+            ADD_CHILD(static_cast<PostdecrementExprASTNode *>(n)->getExpr());
+            break;
+        case NK_POSTINCREMENT_EXPR:
+            ADD_CHILD(static_cast<PostincrementExprASTNode *>(n)->getExpr());
+            break;
+        case NK_ADDR_EXPR:
+            ADD_CHILD(static_cast<AddrExprASTNode *>(n)->getExpr());
+            break;
+        case NK_INDIRECT_REF:
+            ADD_CHILD(static_cast<IndirectRefASTNode *>(n)->getExpr());
+            ADD_CHILD(static_cast<IndirectRefASTNode *>(n)->getField());
+            break;
+        case NK_LSHIFT_EXPR:
+            ADD_OPERANDS(LShiftExprASTNode);
+            break;
+        case NK_RSHIFT_EXPR:
+            ADD_OPERANDS(RShiftExprASTNode);
+            break;
+        case NK_BIT_IOR_EXPR:
+            ADD_OPERANDS(BitIorExprASTNode);
+            break;
+        case NK_BIT_XOR_EXPR:
+            ADD_OPERANDS(BitXorExprASTNode);
+            break;
+        case NK_BIT_AND_EXPR:
+            ADD_OPERANDS(BitAndExprASTNode);
+            break;
+        case NK_LOG_AND_EXPR:
+            ADD_OPERANDS(LogAndExprASTNode);
+            break;
+        case NK_LOG_OR_EXPR:
+            ADD_OPERANDS(LogOrExprASTNode);
+            break;
+        case NK_PLUS_EXPR:
+            ADD_OPERANDS(PlusExprASTNode);
+            break;
+        case NK_MINUS_EXPR:
+            ADD_OPERANDS(MinusExprASTNode);
+            break;
+        case NK_MULT_EXPR:
+            ADD_OPERANDS(MultExprASTNode);
+            break;
+        case NK_TRUNC_DIV_EXPR:
+            ADD_OPERANDS(TruncDivExprASTNode);
+            break;
+        case NK_TRUNC_MOD_EXPR:
+            ADD_OPERANDS(TruncModExprASTNode);
+            break;
+        case NK_ARRAY_REF:
+            ADD_CHILD(static_cast<ArrayRefASTNode *>(n)->getExpr());
+            ADD_CHILD(static_cast<ArrayRefASTNode *>(n)->getIndex());
+            break;
+        case NK_STRUCT_REF:
+            ADD_CHILD(static_cast<StructRefASTNode *>(n)->getName());
+            ADD_CHILD(static_cast<StructRefASTNode *>(n)->getMember());
+            break;
+        case NK_LT_EXPR:
+            ADD_OPERANDS(LtExprASTNode);
+            break;
+        case NK_LE_EXPR:
+            ADD_OPERANDS(LeExprASTNode);
+            break;
+        case NK_GT_EXPR:
+            ADD_OPERANDS(GtExprASTNode);
+            break;
+        case NK_GE_EXPR:
+            ADD_OPERANDS(GeExprASTNode);
+            break;
+        case NK_EQ_EXPR:
+            ADD_OPERANDS(EqExprASTNode);
+            break;
+        case NK_NE_EXPR:
+            ADD_OPERANDS(NeExprASTNode);
+            break;
+        case NK_ASSIGN_EXPR:
+            ADD_OPERANDS(AssignExprASTNode);
+            break;
+        case NK_COND_EXPR:
+        {
+            CondExprASTNode *e = static_cast<CondExprASTNode *>(n);
+
+            ADD_CHILD(e->getCondition());
+            ADD_CHILD(e->getThenClause());
+            ADD_CHILD(e->getElseClause());
+            break;
+        }
+        case NK_CALL_EXPR:
+            ADD_CHILD(static_cast<CallExprASTNode *>(n)->getExpr());
+            ADD_CHILD(static_cast<CallExprASTNode *>(n)->getArgs());
+            break;
+        case NK_ENUMERAL_TYPE:
+            ADD_CHILD(static_cast<EnumeralTypeASTNode *>(n)->getName());
+            ADD_CHILD(static_cast<EnumeralTypeASTNode *>(n)->getBody());
+            break;
+        case NK_POINTER_TYPE:
+            ADD_CHILD(static_cast<PointerTypeASTNode *>(n)->getBaseType());
+            break;
+        case NK_FUNCTION_TYPE:
+            ADD_CHILD(static_cast<FunctionTypeASTNode *>(n)->getType());
+            ADD_CHILD(static_cast<FunctionTypeASTNode *>(n)->getPrms());
+            break;
+        case NK_ARRAY_TYPE:
+            ADD_CHILD(static_cast<ArrayTypeASTNode *>(n)->getElementType());
+            ADD_CHILD(static_cast<ArrayTypeASTNode *>(n)->getExpr());
+            break;
+        case NK_STRUCT_TYPE:
+            ADD_CHILD(static_cast<StructTypeASTNode *>(n)->getName());
+            ADD_CHILD(static_cast<StructTypeASTNode *>(n)->getBody());
+            break;
+        case NK_UNION_TYPE:
+            ADD_CHILD(static_cast<UnionTypeASTNode *>(n)->getName());
+            ADD_CHILD(static_cast<UnionTypeASTNode *>(n)->getBody());
+            break;
+        case NK_LIST:
+        {
+            std::vector<ASTNode *> &elements =
+                static_cast<SequenceASTNode *>(n)->getElements();
+
+            for (unsigned i = 0; i < elements.size(); i++)
+                ADD_CHILD(elements[i]);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+#define SLOT(T, get) slots.push_back(static_cast<T *>(n)->get())
+
+#define BINARY_SLOTS(T)                                                        \
+    SLOT(T, getType);                                                          \
+    SLOT(T, getLhs);                                                           \
+    SLOT(T, getRhs);
+
+void TreeWalker::getSlots(ASTNode *n, std::vector<ASTNode *> &slots)
+{
+    switch (n->getKind())
+    {
+        case NK_SIZEOF_EXPR:
+            SLOT(SizeOfExprASTNode, getExpr);
+            break;
+        case NK_ALIGNOF_EXPR:
+            SLOT(AlignOfExprASTNode, getExpr);
+            break;
+        case NK_TYPE_DECL:
+            SLOT(TypeDeclASTNode, getName);
+            SLOT(TypeDeclASTNode, getBody);
+            break;
+        case NK_FUNCTION_DECL:
+            SLOT(FunctionDeclASTNode, getType);
+            SLOT(FunctionDeclASTNode, getName);
+            SLOT(FunctionDeclASTNode, getPrms);
+            SLOT(FunctionDeclASTNode, getBody);
+            break;
+        case NK_VAR_DECL:
+            SLOT(VarDeclASTNode, getType);
+            SLOT(VarDeclASTNode, getName);
+            SLOT(VarDeclASTNode, getInit);
+            break;
+        case NK_PARM_DECL:
+            SLOT(ParmDeclASTNode, getType);
+            SLOT(ParmDeclASTNode, getName);
+            break;
+        case NK_FIELD_DECL:
+            SLOT(FieldDeclASTNode, getType);
+            SLOT(FieldDeclASTNode, getName);
+            SLOT(FieldDeclASTNode, getBitWidth);
+            break;
+        case NK_CASE_LABEL:
+            SLOT(CaseLabelASTNode, getExpr);
+            SLOT(CaseLabelASTNode, getStmt);
+            break;
+        case NK_COMPOUND_STMT:
+            SLOT(CompoundStmtASTNode, getDecls);
+            SLOT(CompoundStmtASTNode, getStmts);
+            break;
+        case NK_DO_STMT:
+            SLOT(DoStmtASTNode, getCondition);
+            SLOT(DoStmtASTNode, getBody);
+            break;
+        case NK_FOR_STMT:
+            SLOT(ForStmtASTNode, getInit);
+            SLOT(ForStmtASTNode, getCondition);
+            SLOT(ForStmtASTNode, getStep);
+            SLOT(ForStmtASTNode, getBody);
+            break;
+        case NK_GOTO_STMT:
+            SLOT(GotoStmtASTNode, getLabel);
+            break;
+        case NK_IF_STMT:
+            SLOT(IfStmtASTNode, getCondition);
+            SLOT(IfStmtASTNode, getThenClause);
+            SLOT(IfStmtASTNode, getElseClause);
+            break;
+        case NK_LABEL_STMT:
+            SLOT(LabelStmtASTNode, getLabel);
+            SLOT(LabelStmtASTNode, getStmt);
+            break;
+        case NK_RETURN_STMT:
+            SLOT(ReturnStmtASTNode, getType);
+            SLOT(ReturnStmtASTNode, getExpr);
+            break;
+        case NK_SWITCH_STMT:
+            SLOT(SwitchStmtASTNode, getExpr);
+            SLOT(SwitchStmtASTNode, getStmt);
+            break;
+        case NK_WHILE_STMT:
+            SLOT(WhileStmtASTNode, getCondition);
+            SLOT(WhileStmtASTNode, getBody);
+            break;
+        case NK_CAST_EXPR:
+            SLOT(CastExprASTNode, getType);
+            SLOT(CastExprASTNode, getExpr);
+            break;
+        case NK_BIT_NOT_EXPR:
+            SLOT(BitNotExprASTNode, getType);
+            SLOT(BitNotExprASTNode, getExpr);
+            break;
+        case NK_LOG_NOT_EXPR:
+            SLOT(LogNotExprASTNode, getType);
+            SLOT(LogNotExprASTNode, getExpr);
+            break;
+        case NK_PREDECREMENT_EXPR:
+            SLOT(PredecrementExprASTNode, getExpr);
+            break;
+        case NK_PREINCREMENT_EXPR:
+            SLOT(PreincrementExprASTNode, getExpr);
+            break;
+        case NK_POSTDECREMENT_EXPR:
+            SLOT(PostdecrementExprASTNode, getExpr);
+            break;
+        case NK_POSTINCREMENT_EXPR:
+            SLOT(PostincrementExprASTNode, getExpr);
+            break;
+        case NK_ADDR_EXPR:
+            SLOT(AddrExprASTNode, getType);
+            SLOT(AddrExprASTNode, getExpr);
+            break;
+        case NK_INDIRECT_REF:
+            SLOT(IndirectRefASTNode, getType);
+            SLOT(IndirectRefASTNode, getExpr);
+            SLOT(IndirectRefASTNode, getField);
+            break;
+        case NK_LSHIFT_EXPR:
+            BINARY_SLOTS(LShiftExprASTNode);
+            break;
+        case NK_RSHIFT_EXPR:
+            BINARY_SLOTS(RShiftExprASTNode);
+            break;
+        case NK_BIT_IOR_EXPR:
+            BINARY_SLOTS(BitIorExprASTNode);
+            break;
+        case NK_BIT_XOR_EXPR:
+            BINARY_SLOTS(BitXorExprASTNode);
+            break;
+        case NK_BIT_AND_EXPR:
+            BINARY_SLOTS(BitAndExprASTNode);
+            break;
+        case NK_LOG_AND_EXPR:
+            BINARY_SLOTS(LogAndExprASTNode);
+            break;
+        case NK_LOG_OR_EXPR:
+            BINARY_SLOTS(LogOrExprASTNode);
+            break;
+        case NK_PLUS_EXPR:
+            BINARY_SLOTS(PlusExprASTNode);
+            break;
+        case NK_MINUS_EXPR:
+            BINARY_SLOTS(MinusExprASTNode);
+            break;
+        case NK_MULT_EXPR:
+            BINARY_SLOTS(MultExprASTNode);
+            break;
+        case NK_TRUNC_DIV_EXPR:
+            BINARY_SLOTS(TruncDivExprASTNode);
+            break;
+        case NK_TRUNC_MOD_EXPR:
+            BINARY_SLOTS(TruncModExprASTNode);
+            break;
+        case NK_ARRAY_REF:
+            SLOT(ArrayRefASTNode, getType);
+            SLOT(ArrayRefASTNode, getExpr);
+            SLOT(ArrayRefASTNode, getIndex);
+            break;
+        case NK_STRUCT_REF:
+            SLOT(StructRefASTNode, getName);
+            SLOT(StructRefASTNode, getMember);
+            break;
+        case NK_LT_EXPR:
+            BINARY_SLOTS(LtExprASTNode);
+            break;
+        case NK_LE_EXPR:
+            BINARY_SLOTS(LeExprASTNode);
+            break;
+        case NK_GT_EXPR:
+            BINARY_SLOTS(GtExprASTNode);
+            break;
+        case NK_GE_EXPR:
+            BINARY_SLOTS(GeExprASTNode);
+            break;
+        case NK_EQ_EXPR:
+            BINARY_SLOTS(EqExprASTNode);
+            break;
+        case NK_NE_EXPR:
+            BINARY_SLOTS(NeExprASTNode);
+            break;
+        case NK_ASSIGN_EXPR:
+            BINARY_SLOTS(AssignExprASTNode);
+            break;
+        case NK_COND_EXPR:
+            SLOT(CondExprASTNode, getCondition);
+            SLOT(CondExprASTNode, getThenClause);
+            SLOT(CondExprASTNode, getElseClause);
+            break;
+        case NK_CALL_EXPR:
+            SLOT(CallExprASTNode, getExpr);
+            SLOT(CallExprASTNode, getArgs);
+            break;
+        case NK_ENUMERAL_TYPE:
+            SLOT(EnumeralTypeASTNode, getName);
+            SLOT(EnumeralTypeASTNode, getBody);
+            break;
+        case NK_POINTER_TYPE:
+            SLOT(PointerTypeASTNode, getBaseType);
+            break;
+        case NK_FUNCTION_TYPE:
+            SLOT(FunctionTypeASTNode, getType);
+            SLOT(FunctionTypeASTNode, getPrms);
+            break;
+        case NK_ARRAY_TYPE:
+            SLOT(ArrayTypeASTNode, getElementType);
+            SLOT(ArrayTypeASTNode, getExpr);
+            break;
+        case NK_STRUCT_TYPE:
+            SLOT(StructTypeASTNode, getName);
+            SLOT(StructTypeASTNode, getBody);
+            break;
+        case NK_UNION_TYPE:
+            SLOT(UnionTypeASTNode, getName);
+            SLOT(UnionTypeASTNode, getBody);
+            break;
+        case NK_LIST:
+        {
+            std::vector<ASTNode *> &elements =
+                static_cast<SequenceASTNode *>(n)->getElements();
+
+            slots.insert(slots.end(), elements.begin(), elements.end());
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+} // namespace cparser
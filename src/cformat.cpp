@@ -5,13 +5,27 @@
 //
 // See the LICENSE file for more details.
 
+#include <atomic>
+#include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
 
 #include "../include/CLexer.h"
 #include "../include/CParser.h"
+#include "../include/Fingerprint.h"
+#include "../include/FlatTree.h"
+#include "../include/FormatServer.h"
+#include "../include/HeaderModule.h"
+#include "../include/PrecompiledHeader.h"
+#include "../include/Preprocessor.h"
 #include "../include/PrintTreeVisitor.h"
 #include "../include/GenCVisitor.h"
 
@@ -23,11 +37,307 @@
     "All Rights Reserved.\n\n"
 
 #define HELP_STR                                                               \
-    "INPUT and OUTPUT stands for input and output files respectively\n\n"      \
+    "INPUT and OUTPUT stands for input and output files respectively\n"        \
+    "Use - as INPUT to read from the standard input\n"                         \
+    "Several INPUTs are formatted as a batch, N at a time with -j\n\n"          \
     "  -o, --output             Output file\n"                                 \
+    "  -p, --preprocess         Preprocess INPUT before formatting it\n"      \
+    "  -I DIR                   Search DIR for #include files, with -p\n"     \
+    "  -D NAME[=VALUE]          Define the macro NAME, with -p\n"             \
+    "  -s, --skip-system-headers\n"                                            \
+    "                           Do not format declarations from system\n"     \
+    "                           headers of preprocessed input\n"              \
+    "  --ignore-path PREFIX     Treat the headers whose path starts with\n"   \
+    "                           PREFIX as system headers, implies -s\n"      \
+    "  -j, --jobs N             Format on N threads\n"                        \
+    "  -f, --fingerprint MANIFEST\n"                                           \
+    "                           Print nothing if the tokens of INPUT did\n"   \
+    "                           not change since the run recorded in\n"       \
+    "                           MANIFEST\n"                                    \
+    "  -a, --ast FORMAT         Print the abstract syntax tree instead, as\n"  \
+    "                           text, json or binary\n"                      \
+    "  --pch-create FILE        Do not format, write the precompiled\n"      \
+    "                           header of INPUT to FILE instead\n"          \
+    "  --include-pch FILE       Start from the precompiled header FILE, as\n" \
+    "                           if INPUT began with #include of its header\n" \
+    "  --server SOCKET          Serve format requests on the Unix domain\n"   \
+    "                           socket SOCKET, see cformatc. The other\n"    \
+    "                           options apply to every request\n"            \
     "  -h, --help               Print out this help information\n"             \
     "  -v, --version            Print out only version information\n\n"
 
+// Emits each top-level declaration as soon as it is parsed and releases it,
+// so the whole tree is never held in memory.
+class EmitDeclarationSink : public cparser::DeclarationSink
+{
+    cparser::GenCVisitor *_visitor;
+
+public:
+    EmitDeclarationSink(cparser::GenCVisitor *visitor) : _visitor(visitor) {}
+
+    bool declaration(cparser::ASTNode *decl)
+    {
+        _visitor->emitDeclaration(decl);
+        return false;
+    }
+};
+
+// Options of the format server. The modules are kept by the server, one
+// cache without and one with -s, and are NULL unless it preprocesses.
+static cparser::HeaderModuleCache *s_serverModules[2];
+static std::vector<const char *> s_serverIgnoredPaths;
+static bool s_serverSkipSystemHeaders;
+
+// Index of the module cache of a request
+static int get_server_cache(unsigned flags)
+{
+    bool skip = (flags & FORMAT_SKIP_SYSTEM_HEADERS) ||
+                s_serverSkipSystemHeaders;
+
+    return skip ? 1 : 0;
+}
+
+// Builds the module of the #include lines of a request, unless the one the
+// server has is current. The note names the cache it belongs to.
+static std::string prepare_stream(const std::string &source, unsigned flags)
+{
+    int cache = get_server_cache(flags);
+    std::string note;
+
+    if (s_serverModules[cache] != NULL)
+        note = s_serverModules[cache]->prepare(NULL, source);
+    return note.empty() ? note : std::to_string(cache) + note;
+}
+
+// Keeps a module built for a request in the server, so the requests that
+// follow start from it.
+static void adopt_stream(const std::string &note)
+{
+    int cache = note[0] == '1' ? 1 : 0;
+
+    if (s_serverModules[cache] != NULL)
+        s_serverModules[cache]->adopt(note.substr(1));
+}
+
+// Formats one request of the format server.
+static void format_stream(FILE *input, unsigned flags)
+{
+    cparser::HeaderModuleCache *modules =
+        s_serverModules[get_server_cache(flags)];
+    cparser::Lexer *lexer;
+    std::string text;
+
+    if (modules == NULL)
+    {
+        lexer = new cparser::CLexer(input);
+        for (const char *prefix : s_serverIgnoredPaths)
+            lexer->getSourceManager()->addIgnoredPath(prefix);
+    }
+    else
+    {
+        char buf[4096];
+        size_t n;
+
+        while ((n = fread(buf, 1, sizeof(buf), input)) > 0)
+            text.append(buf, n);
+        cparser::Preprocessor *pp = modules->createPreprocessor(NULL);
+        pp->setMainText(&text);
+        lexer = pp;
+    }
+
+    {
+        cparser::CParser parser(lexer);
+        cparser::GenCVisitor genCVisitor;
+        EmitDeclarationSink sink(&genCVisitor);
+
+        parser.setSkipSystemHeaders((flags & FORMAT_SKIP_SYSTEM_HEADERS) ||
+                                    s_serverSkipSystemHeaders);
+        if (modules != NULL)
+            modules->attach(NULL, text,
+                            static_cast<cparser::Preprocessor *>(lexer),
+                            &parser);
+        parser.setDeclarationSink(&sink);
+        parser.parse("");
+    }
+    delete lexer;
+}
+
+// Formats one input of a batch to out. With preprocess, the input starts
+// from the module of its #include lines, see HeaderModuleCache.
+static void format_batch_input(const char *input, bool preprocess,
+                               bool skipSystemHeaders,
+                               cparser::HeaderModuleCache *modules,
+                               std::ostream &out)
+{
+    cparser::Lexer *lexer;
+
+    if (preprocess)
+    {
+        lexer = modules->createPreprocessor(input);
+    }
+    else
+    {
+        lexer = new cparser::CLexer(input);
+        for (const std::string &prefix : modules->getIgnoredPaths())
+            lexer->getSourceManager()->addIgnoredPath(prefix);
+    }
+
+    {
+        cparser::CParser parser(lexer);
+        cparser::GenCVisitor genCVisitor;
+        EmitDeclarationSink sink(&genCVisitor);
+
+        genCVisitor.setOutput(&out);
+        parser.setSkipSystemHeaders(skipSystemHeaders);
+        if (preprocess)
+            modules->attach(input, static_cast<cparser::Preprocessor *>(lexer),
+                            &parser);
+        parser.setDeclarationSink(&sink);
+        parser.parse("");
+    }
+    delete lexer;
+}
+
+// Formats the inputs on jobs threads. The outputs are printed in the order
+// of the inputs, each one as soon as the ones before it are printed.
+static void format_batch(const std::vector<const char *> &inputs,
+                         unsigned jobs, bool preprocess,
+                         bool skipSystemHeaders,
+                         cparser::HeaderModuleCache *modules)
+{
+    std::vector<std::ostringstream> outputs(inputs.size());
+    std::vector<bool> done(inputs.size(), false);
+    unsigned nextPrinted = 0;
+    std::atomic<unsigned> nextInput(0);
+    std::mutex mutex;
+
+    // Tables that are built on first use are built before the threads start.
+    cparser::CLexer::initialize();
+    cparser::CParser::initNames();
+    cparser::NullASTNode::getInstance();
+
+    auto worker = [&]() {
+        unsigned i;
+
+        while ((i = nextInput++) < inputs.size())
+        {
+            format_batch_input(inputs[i], preprocess, skipSystemHeaders,
+                               modules, outputs[i]);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            done[i] = true;
+            while (nextPrinted < inputs.size() && done[nextPrinted])
+            {
+                std::cout << outputs[nextPrinted].str();
+                outputs[nextPrinted].str("");
+                nextPrinted++;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    for (unsigned i = 0; i < jobs && i < inputs.size(); i++)
+        threads.push_back(std::thread(worker));
+    for (unsigned i = 0; i < threads.size(); i++)
+        threads[i].join();
+}
+
+static bool is_ast_format(const char *format)
+{
+    return strcmp(format, "text") == 0 || strcmp(format, "json") == 0 ||
+           strcmp(format, "binary") == 0;
+}
+
+static void dump_ast(cparser::AbstractSyntaxTree *ast, const char *format)
+{
+    cparser::TreeEmitter *emitter;
+
+    if (strcmp(format, "json") == 0)
+        emitter = new cparser::JSONTreeEmitter(std::cout);
+    else if (strcmp(format, "binary") == 0)
+        emitter = new cparser::BinaryTreeEmitter(std::cout);
+    else
+        emitter = new cparser::TextTreeEmitter(std::cout);
+
+    cparser::PrintTreeVisitor visitor(emitter);
+    ast->visit(&visitor);
+    delete emitter;
+}
+
+// Lexer for input, with the preprocessor in front of it if preprocess is
+// set. input is NULL for the standard input. The preprocessor reads the
+// header include first, unless it is NULL. The files under ignoredPaths are
+// treated as system headers.
+static cparser::Lexer *
+create_lexer(const char *input, bool preprocess,
+             const std::vector<const char *> &dirs,
+             const std::vector<const char *> &macros,
+             const std::vector<const char *> &ignoredPaths, const char *include)
+{
+    cparser::Lexer *lexer;
+
+    if (!preprocess)
+    {
+        lexer = new cparser::CLexer(input);
+    }
+    else
+    {
+        cparser::Preprocessor *pp = new cparser::Preprocessor(input);
+        for (const char *dir : dirs)
+            pp->addIncludeDir(dir);
+        for (const char *macro : macros)
+            pp->defineMacro(macro);
+        if (include != NULL)
+            pp->addForcedInclude(include);
+        lexer = pp;
+    }
+    for (const char *prefix : ignoredPaths)
+        lexer->getSourceManager()->addIgnoredPath(prefix);
+    return lexer;
+}
+
+// Version recorded in the fingerprint manifest. The size and time of the
+// executable are part of it, so a rebuilt formatter formats the files
+// again even if VERSION is the same.
+static const char *get_manifest_version()
+{
+    static const std::string version = []() {
+        struct stat st;
+        std::string v = VERSION;
+
+        if (stat("/proc/self/exe", &st) == 0)
+            v += "+" + std::to_string(st.st_size) + "." +
+                 std::to_string(st.st_mtime);
+        return v;
+    }();
+
+    return version.c_str();
+}
+
+// Options that change what a precompiled header holds. A header made with
+// other options is not used.
+static std::string
+get_pch_options(bool preprocess, bool skipSystemHeaders,
+                const std::vector<const char *> &dirs,
+                const std::vector<const char *> &macros,
+                const std::vector<const char *> &ignoredPaths)
+{
+    std::string options = VERSION;
+
+    if (preprocess)
+        options += " -p";
+    if (skipSystemHeaders)
+        options += " -s";
+    for (const char *dir : dirs)
+        options += std::string(" -I") + dir;
+    for (const char *macro : macros)
+        options += std::string(" -D") + macro;
+    for (const char *prefix : ignoredPaths)
+        options += std::string(" --ignore-path ") + prefix;
+    return options;
+}
+
 void print_info() { std::cout << INFO_STR; }
 
 void print_help() { std::cout << HELP_STR; }
@@ -42,10 +352,22 @@ int main(int argc, char **argv)
     }
 
     char *input = NULL;
+    std::vector<const char *> inputs;
     char output[256];
     // bool outputOk = false;
     bool printHelp = false;
     bool printVersion = false;
+    bool skipSystemHeaders = false;
+    bool preprocess = false;
+    std::vector<const char *> includeDirs;
+    std::vector<const char *> macros;
+    std::vector<const char *> ignoredPaths;
+    unsigned jobs = 1;
+    const char *manifestPath = NULL;
+    const char *socketPath = NULL;
+    const char *astFormat = NULL;
+    const char *pchCreatePath = NULL;
+    const char *pchPath = NULL;
     int n = 1;
 
     while (n < argc)
@@ -55,6 +377,100 @@ int main(int argc, char **argv)
             strcpy(output, argv[++n]);
             // outputOk = true;
         }
+        else if (strcmp(argv[n], "-s") == 0 ||
+                 strcmp(argv[n], "--skip-system-headers") == 0)
+        {
+            skipSystemHeaders = true;
+        }
+        else if (strcmp(argv[n], "--ignore-path") == 0)
+        {
+            if (n + 1 >= argc)
+            {
+                std::cerr << "cformat: fatal error: argument to '" << argv[n]
+                          << "' is missing" << std::endl;
+                exit(1);
+            }
+            ignoredPaths.push_back(argv[++n]);
+            skipSystemHeaders = true;
+        }
+        else if (strcmp(argv[n], "-p") == 0 ||
+                 strcmp(argv[n], "--preprocess") == 0)
+        {
+            preprocess = true;
+        }
+        else if (strncmp(argv[n], "-I", 2) == 0 ||
+                 strncmp(argv[n], "-D", 2) == 0)
+        {
+            std::vector<const char *> &list =
+                argv[n][1] == 'I' ? includeDirs : macros;
+
+            // Both -IDIR and -I DIR are accepted.
+            if (argv[n][2] != '\0')
+                list.push_back(argv[n] + 2);
+            else if (n + 1 < argc)
+                list.push_back(argv[++n]);
+            else
+            {
+                std::cerr << "cformat: fatal error: argument to '" << argv[n]
+                          << "' is missing" << std::endl;
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[n], "-j") == 0 || strcmp(argv[n], "--jobs") == 0)
+        {
+            if (n + 1 >= argc || atoi(argv[n + 1]) <= 0)
+            {
+                std::cerr << "cformat: fatal error: invalid number of jobs"
+                          << std::endl;
+                exit(1);
+            }
+            jobs = atoi(argv[++n]);
+        }
+        else if (strcmp(argv[n], "-f") == 0 ||
+                 strcmp(argv[n], "--fingerprint") == 0)
+        {
+            if (n + 1 >= argc)
+            {
+                std::cerr << "cformat: fatal error: no manifest file"
+                          << std::endl;
+                exit(1);
+            }
+            manifestPath = argv[++n];
+        }
+        else if (strcmp(argv[n], "-a") == 0 || strcmp(argv[n], "--ast") == 0)
+        {
+            if (n + 1 >= argc || !is_ast_format(argv[n + 1]))
+            {
+                std::cerr << "cformat: fatal error: invalid tree format"
+                          << std::endl;
+                exit(1);
+            }
+            astFormat = argv[++n];
+        }
+        else if (strcmp(argv[n], "--pch-create") == 0 ||
+                 strcmp(argv[n], "--include-pch") == 0)
+        {
+            if (n + 1 >= argc)
+            {
+                std::cerr << "cformat: fatal error: no precompiled header file"
+                          << std::endl;
+                exit(1);
+            }
+            if (argv[n][2] == 'p')
+                pchCreatePath = argv[++n];
+            else
+                pchPath = argv[++n];
+        }
+        else if (strcmp(argv[n], "--server") == 0)
+        {
+            if (n + 1 >= argc)
+            {
+                std::cerr << "cformat: fatal error: no socket file"
+                          << std::endl;
+                exit(1);
+            }
+            socketPath = argv[++n];
+        }
         else if (strcmp(argv[n], "-h") == 0 || strcmp(argv[n], "--help") == 0)
         {
             printHelp = true;
@@ -67,6 +483,7 @@ int main(int argc, char **argv)
         else
         {
             input = argv[n];
+            inputs.push_back(input);
         }
         n++;
     }
@@ -84,30 +501,217 @@ int main(int argc, char **argv)
         exit(0);
     }
 
+    if (socketPath != NULL)
+    {
+        // Build the tables once, every request is served by a copy of this
+        // process.
+        cparser::CLexer::initialize();
+        cparser::CParser::initNames();
+        s_serverIgnoredPaths = ignoredPaths;
+        s_serverSkipSystemHeaders = skipSystemHeaders;
+        if (preprocess)
+        {
+            for (int skip = 0; skip < 2; skip++)
+            {
+                s_serverModules[skip] = new cparser::HeaderModuleCache(
+                    includeDirs, macros, skip || skipSystemHeaders,
+                    get_pch_options(true, skip || skipSystemHeaders,
+                                    includeDirs, macros, ignoredPaths));
+                for (const char *prefix : ignoredPaths)
+                    s_serverModules[skip]->addIgnoredPath(prefix);
+                s_serverModules[skip]->setCheckFiles(true);
+            }
+        }
+        cparser::runFormatServer(socketPath, format_stream, prepare_stream,
+                                 adopt_stream);
+        std::cerr << "cformat: fatal error: can not listen on '" << socketPath
+                  << "', " << strerror(errno) << std::endl;
+        exit(1);
+    }
+
     if (input == NULL)
     {
         std::cerr << "cformat: fatal error: no input file" << std::endl;
         exit(1);
     }
 
-    cparser::CLexer lexer(input);
-    cparser::CParser parser(&lexer);
-    parser.parse(output);
+    if (inputs.size() > 1)
+    {
+        if (manifestPath != NULL || astFormat != NULL ||
+            pchCreatePath != NULL || pchPath != NULL)
+        {
+            std::cerr << "cformat: fatal error: -f, -a, --pch-create and "
+                         "--include-pch take only one INPUT"
+                      << std::endl;
+            exit(1);
+        }
+        for (const char *batchInput : inputs)
+        {
+            if (strcmp(batchInput, "-") == 0)
+            {
+                std::cerr << "cformat: fatal error: the standard input can "
+                             "not be formatted in a batch"
+                          << std::endl;
+                exit(1);
+            }
+        }
+
+        cparser::HeaderModuleCache modules(
+            includeDirs, macros, skipSystemHeaders,
+            get_pch_options(preprocess, skipSystemHeaders, includeDirs,
+                            macros, ignoredPaths));
+        for (const char *prefix : ignoredPaths)
+            modules.addIgnoredPath(prefix);
+        format_batch(inputs, jobs, preprocess, skipSystemHeaders, &modules);
+        return 0;
+    }
 
-    cparser::AbstractSyntaxTree *ast = parser.getAST();
+    if (strcmp(input, "-") == 0)
+        input = NULL;
+
+    std::string pchOptions = get_pch_options(preprocess, skipSystemHeaders,
+                                             includeDirs, macros, ignoredPaths);
+    cparser::PrecompiledHeader pch;
+    const char *pchHeader = NULL;
+    bool usePch = false;
+    if (pchPath != NULL)
+    {
+        usePch = pch.load(pchPath, pchOptions);
+        if (!pch.getHeader().empty())
+            pchHeader = pch.getHeader().c_str();
+
+        // The preprocessor can read the header instead.
+        if (!usePch && (!preprocess || pchHeader == NULL))
+        {
+            std::cerr << "cformat: fatal error: can not use precompiled "
+                         "header '"
+                      << pchPath << "', " << pch.getError() << std::endl;
+            exit(1);
+        }
+        if (!usePch)
+            std::cerr << "cformat: warning: precompiled header '" << pchPath
+                      << "' not used, " << pch.getError() << std::endl;
+    }
+
+    uint64_t fingerprint = 0;
+    cparser::FingerprintManifest manifest(manifestPath ? manifestPath : "");
+    if (manifestPath != NULL)
+    {
+        if (input == NULL)
+        {
+            std::cerr << "cformat: fatal error: standard input can not be "
+                         "fingerprinted"
+                      << std::endl;
+            exit(1);
+        }
+        if (astFormat != NULL)
+        {
+            std::cerr << "cformat: fatal error: the tree can not be printed "
+                         "with fingerprints"
+                      << std::endl;
+            exit(1);
+        }
+        if (pchPath != NULL && !preprocess)
+        {
+            std::cerr << "cformat: fatal error: precompiled headers can be "
+                         "fingerprinted only with -p"
+                      << std::endl;
+            exit(1);
+        }
+
+        // Only lex the input, the parser is skipped for unchanged files.
+        // The tokens of the precompiled header are lexed from its header.
+        cparser::Lexer *fingerprintLexer = create_lexer(
+            input, preprocess, includeDirs, macros, ignoredPaths, pchHeader);
+        fingerprint =
+            cparser::fingerprintTokens(fingerprintLexer, skipSystemHeaders);
+        delete fingerprintLexer;
+        manifest.load();
+        if (manifest.isUnchanged(input, fingerprint, get_manifest_version()))
+            return 0;
+    }
+
+    cparser::Lexer *lexer =
+        create_lexer(input, preprocess, includeDirs, macros, ignoredPaths,
+                     usePch ? NULL : pchHeader);
+    cparser::CParser parser(lexer);
+    cparser::GenCVisitor *genCVisitor = new cparser::GenCVisitor();
+    EmitDeclarationSink sink(genCVisitor);
+
+    parser.setSkipSystemHeaders(skipSystemHeaders);
+    if (usePch)
+    {
+        if (preprocess)
+            pch.restoreMacros(static_cast<cparser::Preprocessor *>(lexer));
+        parser.setPrecompiledHeader(&pch);
+    }
+
+    if (pchCreatePath != NULL)
+    {
+        cparser::FlatTree tree;
+        cparser::FlatTreeBuilder builder(&tree);
+
+        if (input == NULL)
+        {
+            std::cerr << "cformat: fatal error: no precompiled header of "
+                         "the standard input"
+                      << std::endl;
+            exit(1);
+        }
+        if (pchPath != NULL)
+        {
+            std::cerr << "cformat: fatal error: a precompiled header can "
+                         "not be made from another one"
+                      << std::endl;
+            exit(1);
+        }
+
+        parser.setDeclarationSink(&builder);
+        parser.parse(output);
+        if (!cparser::PrecompiledHeader::write(
+                pchCreatePath, pchOptions, input, &parser, &tree,
+                preprocess ? static_cast<cparser::Preprocessor *>(lexer)
+                           : nullptr))
+        {
+            std::cerr << "cformat: fatal error: can not write precompiled "
+                         "header '"
+                      << pchCreatePath << "'" << std::endl;
+            exit(1);
+        }
+    }
+    else if (astFormat != NULL)
+    {
+        parser.parse(output);
+        dump_ast(parser.getAST(), astFormat);
+    }
+    else if (jobs > 1)
+    {
+        // The whole tree is needed to split it between the threads.
+        parser.parse(output);
+        parser.getAST()->visit(genCVisitor, jobs);
+    }
+    else
+    {
+        // Declarations are emitted while parsing, see EmitDeclarationSink.
+        parser.setDeclarationSink(&sink);
+        parser.parse(output);
+    }
+
+    if (manifestPath != NULL &&
+        !manifest.update(input, fingerprint, get_manifest_version()))
+    {
+        std::cerr << "cformat: warning: can not update manifest '"
+                  << manifestPath << "'" << std::endl;
+    }
 
     // std::cout << std::endl << "Abstract syntax tree:" << std::endl << std::endl;
     // cparser::TreeVisitor *visitor = new cparser::PrintTreeVisitor();
-    // ast->visit(visitor);
+    // parser.getAST()->visit(visitor);
     // std::cout << std::endl;
 
-    // std::cout << "===============================================" << std::endl;
-
-    cparser::TreeVisitor *genCVisitor = new cparser::GenCVisitor();
-    ast->visit(genCVisitor);
-
     // delete visitor;
     delete genCVisitor;
+    delete lexer;
 
     return 0;
 }
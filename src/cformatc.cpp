@@ -0,0 +1,90 @@
+// cformatc - client of the cformat server
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "../include/FormatServer.h"
+
+#define USAGE_STR                                                              \
+    "Usage: cformatc SOCKET [-s] INPUT\n\n"                                    \
+    "Formats INPUT on the cformat server listening on SOCKET, see the\n"      \
+    "--server option of cformat. Use - as INPUT to read from the standard\n"  \
+    "input\n\n"                                                                \
+    "  -s, --skip-system-headers\n"                                            \
+    "                           Do not format declarations from system\n"     \
+    "                           headers of preprocessed input\n\n"
+
+static bool read_input(const char *input, std::string &source)
+{
+    FILE *fp = input == NULL ? stdin : fopen(input, "rb");
+    char buf[65536];
+    size_t n;
+
+    if (fp == NULL)
+        return false;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        source.append(buf, n);
+    if (fp != stdin)
+        fclose(fp);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    const char *socketPath = NULL;
+    const char *input = NULL;
+    unsigned flags = 0;
+
+    for (int n = 1; n < argc; n++)
+    {
+        if (strcmp(argv[n], "-s") == 0 ||
+            strcmp(argv[n], "--skip-system-headers") == 0)
+            flags |= FORMAT_SKIP_SYSTEM_HEADERS;
+        else if (strcmp(argv[n], "-h") == 0 ||
+                 strcmp(argv[n], "--help") == 0)
+        {
+            std::cout << USAGE_STR;
+            exit(0);
+        }
+        else if (socketPath == NULL)
+            socketPath = argv[n];
+        else
+            input = argv[n];
+    }
+
+    if (socketPath == NULL || input == NULL)
+    {
+        std::cerr << USAGE_STR;
+        exit(1);
+    }
+
+    if (strcmp(input, "-") == 0)
+        input = NULL;
+
+    std::string source;
+    if (!read_input(input, source))
+    {
+        std::cerr << "cformatc: fatal error: can not read '" << input << "'"
+                  << std::endl;
+        exit(1);
+    }
+
+    std::string output;
+    int status = cparser::formatRemote(socketPath, source, flags, output);
+    if (status < 0)
+    {
+        std::cerr << "cformatc: fatal error: no cformat server on '"
+                  << socketPath << "'" << std::endl;
+        exit(1);
+    }
+
+    fwrite(output.data(), 1, output.size(), stdout);
+    return status;
+}
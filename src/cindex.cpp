@@ -0,0 +1,478 @@
+// cindex
+// Copyright (C) 2017, 2018  Jozef Kolek <jkolek@gmail.com>
+//
+// All rights reserved.
+//
+// See the LICENSE file for more details.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../include/HeaderModule.h"
+#include "../include/ReferenceIndex.h"
+#include "../include/SymbolDatabase.h"
+
+#define VERSION "0.1"
+
+#define INFO_STR                                                               \
+    "cindex " VERSION "\n"                                                     \
+    "Copyright (C) 2017, 2018 Jozef Kolek  <jkolek@gmail.com>. "               \
+    "All Rights Reserved.\n\n"
+
+#define HELP_STR                                                               \
+    "Usage: cindex [OPTION]... -o INDEX INPUT...\n"                            \
+    "       cindex -i INDEX [-q NAME]... [-d]\n"                               \
+    "       cindex [OPTION]... [-u] -x XREF INPUT...\n"                        \
+    "       cindex -x XREF [-u] [-r NAME]... [-c NAME]...\n\n"                 \
+    "Writes the functions, variables and types of the translation units\n"    \
+    "INPUT to the symbol index INDEX, or looks them up in INDEX. Writes the\n" \
+    "references to them to the cross-reference index XREF, or looks them\n"   \
+    "up in XREF\n\n"                                                          \
+    "  -o, --output INDEX       Write the symbol index to INDEX\n"             \
+    "  -p, --preprocess         Preprocess INPUT first\n"                      \
+    "  -I DIR                   Search DIR for #include files, with -p\n"     \
+    "  -D NAME[=VALUE]          Define the macro NAME, with -p\n"             \
+    "  -j, --jobs N             Parse on N threads\n"                          \
+    "  -i, --index INDEX        Read the symbol index INDEX\n"                 \
+    "  -q, --query NAME         Print where NAME is defined and declared\n"   \
+    "  -d, --duplicates         Print the external functions and variables\n" \
+    "                           that are defined more than once, and exit\n" \
+    "                           with 1 if there are any\n"                    \
+    "  -x, --xref XREF          Write the cross-reference index XREF, or\n"   \
+    "                           read it\n"                                     \
+    "  -u, --update             Update XREF, parse INPUT again and the\n"     \
+    "                           translation units whose files changed\n"      \
+    "  -r, --references NAME    Print the references to NAME in XREF, a\n"    \
+    "                           member of a known struct as TAG.MEMBER\n"     \
+    "  -c, --callers NAME       Print the functions that call NAME in XREF\n" \
+    "  -h, --help               Print out this help information\n"             \
+    "  -v, --version            Print out only version information\n\n"
+
+static const char *get_kind_name(cparser::STObjectKind kind, bool isStatic)
+{
+    switch (kind)
+    {
+        case cparser::STOK_FUNC:
+            return isStatic ? "static function" : "function";
+        case cparser::STOK_VAR:
+            return isStatic ? "static variable" : "variable";
+        default:
+            return "type";
+    }
+}
+
+static void print_query(const cparser::SymbolIndex &index, const char *name)
+{
+    unsigned first, last;
+
+    index.find(name, first, last);
+    if (first == last)
+    {
+        std::cout << "'" << name << "' not found" << std::endl;
+        return;
+    }
+
+    for (unsigned i = first; i < last; i++)
+    {
+        const char *kind = get_kind_name(index.getKind(i), index.isStatic(i));
+
+        for (unsigned j = 0; j < index.getNumDefinitions(i); j++)
+        {
+            cparser::SymbolLocation l = index.getDefinition(i, j);
+
+            std::cout << l.file << ":" << l.line << ": " << kind << " '"
+                      << name << "' defined, in " << l.unit << std::endl;
+        }
+        for (unsigned j = 0; j < index.getNumDeclarations(i); j++)
+        {
+            cparser::SymbolLocation l = index.getDeclaration(i, j);
+
+            std::cout << l.file << ":" << l.line << ": " << kind << " '"
+                      << name << "' declared, in " << l.unit << std::endl;
+        }
+    }
+}
+
+// Returns the number of external functions and variables defined more than
+// once.
+static unsigned print_duplicates(const cparser::SymbolIndex &index)
+{
+    unsigned n = 0;
+
+    for (unsigned i = 0; i < index.getNumSymbols(); i++)
+    {
+        if (!index.isDuplicate(i))
+            continue;
+
+        std::cout << "error: "
+                  << get_kind_name(index.getKind(i), index.isStatic(i))
+                  << " '" << index.getName(i) << "' is defined more than once"
+                  << std::endl;
+        for (unsigned j = 0; j < index.getNumDefinitions(i); j++)
+        {
+            cparser::SymbolLocation l = index.getDefinition(i, j);
+
+            std::cout << l.file << ":" << l.line << ": note: defined here, in "
+                      << l.unit << std::endl;
+        }
+        n++;
+    }
+    return n;
+}
+
+// The options the translation units of a cross-reference index are read
+// with, an index made with other options is not updated.
+static std::string get_xref_options(bool preprocess,
+                                    const std::vector<const char *> &dirs,
+                                    const std::vector<const char *> &macros)
+{
+    std::string options = VERSION;
+
+    if (preprocess)
+        options += " -p";
+    for (const char *dir : dirs)
+        options += std::string(" -I") + dir;
+    for (const char *macro : macros)
+        options += std::string(" -D") + macro;
+    return options;
+}
+
+static const char *get_reference_kind_name(cparser::ReferenceKind kind)
+{
+    switch (kind)
+    {
+        case cparser::REF_CALL:
+            return "call of";
+        case cparser::REF_FIELD:
+            return "use of member";
+        case cparser::REF_TYPE:
+            return "use of type";
+        default:
+            return "use of";
+    }
+}
+
+// Print the references to name, or with callers only the functions that
+// call it, each one at its first call. Functions of different files are
+// apart, they may be static.
+static void print_references(const cparser::ReferenceIndex &index,
+                             const char *name, bool callers)
+{
+    std::vector<cparser::IndexedReference> refs;
+    std::set<std::pair<const char *, const char *>> functions;
+    int i = index.find(name);
+
+    if (i < 0)
+    {
+        std::cout << "'" << name << "' not found" << std::endl;
+        return;
+    }
+    if (!index.getReferences(i, refs))
+    {
+        std::cerr << "cindex: error: the references to '" << name
+                  << "' are damaged" << std::endl;
+        return;
+    }
+
+    for (const cparser::IndexedReference &r : refs)
+    {
+        if (!callers)
+        {
+            std::cout << r.file << ":" << r.line << ":" << r.col << ": "
+                      << get_reference_kind_name(r.kind) << " '" << name
+                      << "'";
+            if (r.function != nullptr)
+                std::cout << ", in function '" << r.function << "'";
+            std::cout << std::endl;
+        }
+        else if (r.kind == cparser::REF_CALL && r.function != nullptr &&
+                 functions.insert({r.file, r.function}).second)
+        {
+            // Strings are stored once, so equal names are equal pointers.
+            std::cout << r.file << ":" << r.line << ":" << r.col
+                      << ": function '" << r.function << "' calls '" << name
+                      << "'" << std::endl;
+        }
+    }
+    if (callers && functions.empty())
+        std::cout << "'" << name << "' is not called" << std::endl;
+}
+
+// Write, update or read the cross-reference index at xrefPath.
+static int run_xref(const char *xrefPath,
+                    const std::vector<const char *> &inputs,
+                    const std::vector<std::pair<bool, const char *>> &queries,
+                    bool update, unsigned jobs, bool preprocess,
+                    const std::vector<const char *> &includeDirs,
+                    const std::vector<const char *> &macros)
+{
+    std::string options = get_xref_options(preprocess, includeDirs, macros);
+    cparser::ReferenceIndex index;
+
+    if (!update && inputs.empty() && queries.empty())
+    {
+        std::cerr << "cindex: fatal error: no input file" << std::endl;
+        exit(1);
+    }
+    if (update || !inputs.empty())
+    {
+        cparser::HeaderModuleCache modules(includeDirs, macros, false,
+                                           options);
+        cparser::ReferenceDatabase database(options);
+
+        if (update)
+        {
+            if (!index.load(xrefPath))
+            {
+                std::cerr << "cindex: fatal error: can not update "
+                             "cross-reference index '"
+                          << xrefPath << "', " << index.getError()
+                          << std::endl;
+                exit(1);
+            }
+            if (options != index.getOptions())
+            {
+                std::cerr << "cindex: fatal error: cross-reference index '"
+                          << xrefPath << "' was made with other options"
+                          << std::endl;
+                exit(1);
+            }
+            if (!database.read(index))
+            {
+                std::cerr << "cindex: fatal error: cross-reference index '"
+                          << xrefPath << "' is damaged" << std::endl;
+                exit(1);
+            }
+        }
+        database.update(inputs, jobs, preprocess, &modules);
+        if (!database.write(xrefPath))
+        {
+            std::cerr << "cindex: fatal error: can not write "
+                         "cross-reference index '"
+                      << xrefPath << "'" << std::endl;
+            exit(1);
+        }
+        if (queries.empty())
+            return 0;
+    }
+
+    if (!index.load(xrefPath))
+    {
+        std::cerr << "cindex: fatal error: can not use cross-reference index '"
+                  << xrefPath << "', " << index.getError() << std::endl;
+        exit(1);
+    }
+    for (auto &query : queries)
+        print_references(index, query.second, query.first);
+
+    return 0;
+}
+
+void print_info() { std::cout << INFO_STR; }
+
+void print_help() { std::cout << HELP_STR; }
+
+int main(int argc, char **argv)
+{
+    if (argc <= 1)
+    {
+        print_info();
+        std::cout << "Try -h option for more info." << std::endl;
+        exit(1);
+    }
+
+    std::vector<const char *> inputs;
+    std::vector<const char *> includeDirs;
+    std::vector<const char *> macros;
+    std::vector<const char *> queries;
+    std::vector<std::pair<bool, const char *>> xrefQueries; // With callers
+    const char *outputPath = NULL;
+    const char *indexPath = NULL;
+    const char *xrefPath = NULL;
+    bool printHelp = false;
+    bool printVersion = false;
+    bool preprocess = false;
+    bool duplicates = false;
+    bool update = false;
+    unsigned jobs = 1;
+    int n = 1;
+
+    while (n < argc)
+    {
+        if (strcmp(argv[n], "-o") == 0 || strcmp(argv[n], "--output") == 0 ||
+            strcmp(argv[n], "-i") == 0 || strcmp(argv[n], "--index") == 0 ||
+            strcmp(argv[n], "-q") == 0 || strcmp(argv[n], "--query") == 0 ||
+            strcmp(argv[n], "-x") == 0 || strcmp(argv[n], "--xref") == 0 ||
+            strcmp(argv[n], "-r") == 0 ||
+            strcmp(argv[n], "--references") == 0 ||
+            strcmp(argv[n], "-c") == 0 || strcmp(argv[n], "--callers") == 0)
+        {
+            char option = argv[n][1] == '-' ? argv[n][2] : argv[n][1];
+
+            if (n + 1 >= argc)
+            {
+                std::cerr << "cindex: fatal error: argument to '" << argv[n]
+                          << "' is missing" << std::endl;
+                exit(1);
+            }
+            if (option == 'o')
+                outputPath = argv[++n];
+            else if (option == 'i')
+                indexPath = argv[++n];
+            else if (option == 'q')
+                queries.push_back(argv[++n]);
+            else if (option == 'x')
+                xrefPath = argv[++n];
+            else
+                xrefQueries.push_back({option == 'c', argv[++n]});
+        }
+        else if (strcmp(argv[n], "-p") == 0 ||
+                 strcmp(argv[n], "--preprocess") == 0)
+        {
+            preprocess = true;
+        }
+        else if (strncmp(argv[n], "-I", 2) == 0 ||
+                 strncmp(argv[n], "-D", 2) == 0)
+        {
+            std::vector<const char *> &list =
+                argv[n][1] == 'I' ? includeDirs : macros;
+
+            // Both -IDIR and -I DIR are accepted.
+            if (argv[n][2] != '\0')
+                list.push_back(argv[n] + 2);
+            else if (n + 1 < argc)
+                list.push_back(argv[++n]);
+            else
+            {
+                std::cerr << "cindex: fatal error: argument to '" << argv[n]
+                          << "' is missing" << std::endl;
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[n], "-j") == 0 || strcmp(argv[n], "--jobs") == 0)
+        {
+            if (n + 1 >= argc || atoi(argv[n + 1]) <= 0)
+            {
+                std::cerr << "cindex: fatal error: invalid number of jobs"
+                          << std::endl;
+                exit(1);
+            }
+            jobs = atoi(argv[++n]);
+        }
+        else if (strcmp(argv[n], "-d") == 0 ||
+                 strcmp(argv[n], "--duplicates") == 0)
+        {
+            duplicates = true;
+        }
+        else if (strcmp(argv[n], "-u") == 0 ||
+                 strcmp(argv[n], "--update") == 0)
+        {
+            update = true;
+        }
+        else if (strcmp(argv[n], "-h") == 0 || strcmp(argv[n], "--help") == 0)
+        {
+            printHelp = true;
+        }
+        else if (strcmp(argv[n], "-v") == 0 ||
+                 strcmp(argv[n], "--version") == 0)
+        {
+            printVersion = true;
+        }
+        else
+        {
+            inputs.push_back(argv[n]);
+        }
+        n++;
+    }
+
+    if (printHelp)
+    {
+        print_info();
+        print_help();
+        exit(0);
+    }
+
+    if (printVersion)
+    {
+        print_info();
+        exit(0);
+    }
+
+    if (xrefPath != NULL)
+    {
+        if (outputPath != NULL || indexPath != NULL || !queries.empty() ||
+            duplicates)
+        {
+            std::cerr << "cindex: fatal error: -x takes no symbol index"
+                      << std::endl;
+            exit(1);
+        }
+        return run_xref(xrefPath, inputs, xrefQueries, update, jobs,
+                        preprocess, includeDirs, macros);
+    }
+    if (!xrefQueries.empty() || update)
+    {
+        std::cerr << "cindex: fatal error: -r, -c and -u take the index "
+                     "from -x"
+                  << std::endl;
+        exit(1);
+    }
+
+    if (indexPath == NULL)
+    {
+        if (outputPath == NULL || inputs.empty())
+        {
+            std::cerr << "cindex: fatal error: no "
+                      << (outputPath == NULL ? "output" : "input") << " file"
+                      << std::endl;
+            exit(1);
+        }
+        if (!queries.empty())
+        {
+            std::cerr << "cindex: fatal error: -q takes the index from -i"
+                      << std::endl;
+            exit(1);
+        }
+
+        cparser::HeaderModuleCache modules(includeDirs, macros, false,
+                                           VERSION);
+        cparser::SymbolDatabase database;
+
+        database.build(inputs, jobs, preprocess, &modules);
+        if (!database.write(outputPath))
+        {
+            std::cerr << "cindex: fatal error: can not write symbol index '"
+                      << outputPath << "'" << std::endl;
+            exit(1);
+        }
+        if (!duplicates)
+            return 0;
+        indexPath = outputPath;
+    }
+    else if (!inputs.empty() || outputPath != NULL)
+    {
+        std::cerr << "cindex: fatal error: -i takes no INPUT" << std::endl;
+        exit(1);
+    }
+
+    cparser::SymbolIndex index;
+
+    if (!index.load(indexPath))
+    {
+        std::cerr << "cindex: fatal error: can not use symbol index '"
+                  << indexPath << "', " << index.getError() << std::endl;
+        exit(1);
+    }
+    for (const char *name : queries)
+        print_query(index, name);
+    if (duplicates && print_duplicates(index) > 0)
+        return 1;
+
+    return 0;
+}